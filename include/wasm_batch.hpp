@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "wasm_executor.hpp"
+#include "wasm_module.hpp"
+#include "wasm_tiering.hpp"
+
+// Runs the exported functions of several modules on a thread pool. Each module is
+// parsed once (its start function included) and shared; every run gets an instance
+// of its own: one per export, or one per module with `persist`, where the exports
+// run in order on it. Guest output and errors are gathered per run and written out
+// in file order, then export order, so the result is what running the files one
+// after another prints. A proc_exit or an error ends a module as it ends a run of
+// that file alone: the output of its later exports is dropped. The exit status is
+// the first nonzero one. Traces are not gathered: with tracing on, everything runs
+// on one thread.
+class WasmBatch {
+public:
+    struct Options {
+        size_t jobs = 1;
+        ExecutionEngine engine = ExecutionEngine::Stack;
+        WasmTiering::Options tiering;
+        size_t maxCallDepth = WasmExecutor::DEFAULT_MAX_CALL_DEPTH;
+        size_t outputBuffer = 0;   // see WasmInterpreter::setOutputBuffer
+        bool persist = false;
+        std::string cacheDirectory;   // see WasmInterpreter::setCacheDirectory
+        bool strictValidation = false;   // see WasmInterpreter::setStrictValidation
+    };
+
+    explicit WasmBatch(const Options& options) : options(options) {}
+
+    // Exit status of the whole batch
+    int run(const std::vector<std::string>& files);
+
+private:
+    Options options;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "struct.h"
+#include "wasm_instance.hpp"
+#include "wasm_decoder.hpp"
+
+// Decoder for the binary module format (.wasm). Sections are read in a single
+// pass over a memory-mapped file and land in the same tables the text parser fills.
+class WasmBinaryParser {
+public:
+    static bool isBinaryFile(const std::string& path);
+
+    void parseFile(const std::string& path,
+                   std::unordered_map<int, FuncType>& funcTypes,
+                   std::unordered_map<int, FuncDef>& functionsByID,
+                   std::unordered_map<std::string, WasmExport>& exports,
+                   WasmInstance& instance,
+                   WasmDecoder& decoder);
+
+    void parse(const uint8_t* data, size_t size,
+               std::unordered_map<int, FuncType>& funcTypes,
+               std::unordered_map<int, FuncDef>& functionsByID,
+               std::unordered_map<std::string, WasmExport>& exports,
+               WasmInstance& instance,
+               WasmDecoder& decoder);
+
+    int startFunction() const { return startIndex; }
+
+private:
+    class Reader;
+
+    std::vector<uint32_t> funcTypeIndices;   // type of each defined function
+    uint32_t importedFuncs = 0;
+    uint32_t importedGlobals = 0;
+    uint32_t globalCount = 0;
+    int startIndex = -1;
+
+    void readTypes(Reader& r, std::unordered_map<int, FuncType>& funcTypes);
+    void readImports(Reader& r, const std::unordered_map<int, FuncType>& funcTypes, WasmInstance& instance,
+                     WasmDecoder& decoder);
+    void readGlobals(Reader& r, WasmInstance& instance);
+    void readExports(Reader& r, std::unordered_map<std::string, WasmExport>& exports);
+    void readCode(Reader& r, const std::unordered_map<int, FuncType>& funcTypes,
+                  std::unordered_map<int, FuncDef>& functionsByID, WasmDecoder& decoder);
+    void readBody(Reader& r, FuncDef& func, const std::unordered_map<int, FuncType>& funcTypes,
+                  WasmDecoder& decoder);
+    void readData(Reader& r, WasmInstance& instance);
+    void readTables(Reader& r, WasmInstance& instance);
+    void readElems(Reader& r, WasmInstance& instance);
+    void readNames(Reader& r, std::unordered_map<int, FuncDef>& functionsByID);
+    WasmValue readConstExpr(Reader& r, const WasmInstance& instance);
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include "struct.h"
+
+// Opcode table and branch side-table builder shared by the text and binary parsers
+class WasmDecoder {
+public:
+    static const char* opcodeName(Opcode op);
+    static Opcode lookup(std::string_view mnemonic);
+    // Small integer shared by every structurally equal signature, so that call_indirect
+    // checks a callee's type with one compare
+    uint32_t signatureId(const FuncType& type);
+    const FuncType& signature(uint32_t id) const { return signatureTypes.at(id); }
+    // Ids are handed out in order, so signatureId() over 0..count-1 rebuilds the table
+    uint32_t signatureCount() const { return static_cast<uint32_t>(signatureTypes.size()); }
+    // Resolve structured control flow in func.code: every br / br_if / br_table carries
+    // in Instr::a an index into `depths`, its relative label depths (br_table: default last).
+    void link(FuncDef& func, const std::vector<std::vector<uint32_t>>& depths);
+    // The inverse of link and fuse: func.code as plain instructions, every branch naming
+    // in Instr::a its entry of `depths`, for passes that rewrite a body and link it again
+    static std::vector<Instr> unlink(const FuncDef& func, std::vector<std::vector<uint32_t>>& depths);
+    // Peephole pass over linked code: rewrite the first instruction of each common
+    // sequence into a superinstruction. No-op when built with WASM_FUSION=OFF.
+    void fuse(FuncDef& func);
+    // First instruction of the sequence a superinstruction stands for (WasmOptimizer's
+    // included); `op` itself otherwise
+    static Opcode unfused(Opcode op);
+
+private:
+    std::unordered_map<std::string, uint32_t> signatures;
+    std::vector<FuncType> signatureTypes;    // by id
+};
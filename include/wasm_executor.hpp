@@ -1,18 +1,80 @@
 #pragma once
 #include <vector>
 #include <cstdint>
-#include <unordered_map>
+#include <iostream>
+#include <stdexcept>
 #include "struct.h"
 #include "wasm_stack.hpp"
 #include "wasm_memory.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_trap.hpp"
+
+class WasmTiering;
 
 class WasmExecutor {
 public:
-    WasmStack lastStack;
-    void execute(const FuncDef& func,
-    std::unordered_map<int, FuncDef>& functionsByID,
-    std::unordered_map<std::string, FuncDef>& functionByName,
-    WasmMemory& memory,
-    std::unordered_map<std::string, WasmGlobal>& globals);
+    static constexpr size_t DEFAULT_MAX_CALL_DEPTH = 10000;
+
+    WasmExecutor();
+
+    // `functions`: call targets by function index (WasmModule::functions)
+    void execute(const FuncDef& entry,
+    const std::vector<WasmValue>& args,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance);
+
+    // Run `func` on top of `depth` calls active in another tier (see WasmTiering),
+    // reading its arguments from `args`; returns whether it left a `result`
+    bool invoke(const FuncDef& func,
+    const WasmSlot* args,
+    size_t depth,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance,
+    WasmSlot& result);
+
+    void setMaxCallDepth(size_t depth) { maxCallDepth = depth; }
+    size_t getMaxCallDepth() const { return maxCallDepth; }
+    // Count calls and loop back-edges, and hand hot functions to the register tier
+    void setTiering(WasmTiering* t) { tiering = t; }
+    // Where runtime diagnostics go (std::cerr by default)
+    void setErrorStream(std::ostream& stream) { errors = &stream; }
+    // The module passed WasmValidator: unless something is traced, run without operand
+    // stack checks and without keeping the operand types
+    void setValidated(bool v) { validated = v; }
+
 private:
+    // Run `entry` above whatever is already on the shared stacks until it returns;
+    // Validated: skip the checks WasmValidator has already made, and the types only
+    // the checks and the traces read
+    template <bool Validated>
+    void run(const FuncDef& entry,
+    const WasmSlot* args,
+    size_t argCount,
+    size_t depth,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance);
+
+    // Activation record of a suspended caller
+    struct Frame {
+        const FuncDef* func;
+        size_t pc;            // where the caller resumes
+        size_t localsBase;    // first slot of the caller in `locals`
+        size_t labelsBase;    // first open block of the caller in `labels`
+        size_t stackBase;     // operand stack height below the caller's operands
+    };
+
+    // Shared by every activation of one execution; calls and returns only move the bases
+    WasmStack stack;
+    std::vector<WasmSlot> locals;
+    std::vector<size_t> labels;   // operand stack height at entry of each open block
+    std::vector<Frame> frames;
+    // call_indirect inline caches, by function index and then call site. They live
+    // here rather than in the FuncDef so that a module can be run by several
+    // executors at once; table epochs are unique, so entries never match a table of
+    // another module.
+    std::vector<std::vector<IndirectCallCache>> callCaches;
+    size_t maxCallDepth = DEFAULT_MAX_CALL_DEPTH;
+    WasmTiering* tiering = nullptr;
+    std::ostream* errors = &std::cerr;
+    bool validated = false;
 };
@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <cstdint>
+#include "struct.h"
+
+// C++ <-> wasm value mapping used by typed host bindings
+template <typename T> struct HostArg;
+template <> struct HostArg<int32_t> {
+    static constexpr const char* type = "i32";
+    static int32_t get(const WasmSlot& v) { return v.i32; }
+    static WasmValue wrap(int32_t x) { return WasmValue(x); }
+};
+template <> struct HostArg<uint32_t> {
+    static constexpr const char* type = "i32";
+    static uint32_t get(const WasmSlot& v) { return static_cast<uint32_t>(v.i32); }
+    static WasmValue wrap(uint32_t x) { return WasmValue(static_cast<int32_t>(x)); }
+};
+template <> struct HostArg<int64_t> {
+    static constexpr const char* type = "i64";
+    static int64_t get(const WasmSlot& v) { return v.i64; }
+    static WasmValue wrap(int64_t x) { return WasmValue(x); }
+};
+template <> struct HostArg<uint64_t> {
+    static constexpr const char* type = "i64";
+    static uint64_t get(const WasmSlot& v) { return static_cast<uint64_t>(v.i64); }
+    static WasmValue wrap(uint64_t x) { return WasmValue(static_cast<int64_t>(x)); }
+};
+template <> struct HostArg<float> {
+    static constexpr const char* type = "f32";
+    static float get(const WasmSlot& v) { return v.f32; }
+    static WasmValue wrap(float x) { return WasmValue(x); }
+};
+template <> struct HostArg<double> {
+    static constexpr const char* type = "f64";
+    static double get(const WasmSlot& v) { return v.f64; }
+    static WasmValue wrap(double x) { return WasmValue(x); }
+};
+
+// Generates the HostFunction trampoline and the FuncType for `R fn(WasmInstance&, Args...)`
+template <typename Sig> struct HostBinding;
+template <typename R, typename... Args>
+struct HostBinding<R (*)(WasmInstance&, Args...)> {
+    template <R (*Fn)(WasmInstance&, Args...)>
+    static WasmValue call(WasmInstance& instance, const WasmSlot* args) {
+        return invoke<Fn>(instance, args, std::index_sequence_for<Args...>{});
+    }
+
+    static FuncType type() {
+        FuncType t;
+        t.params = {HostArg<Args>::type...};
+        if constexpr (std::is_void_v<R>) t.resultType = "void";
+        else t.resultType = HostArg<R>::type;
+        return t;
+    }
+
+private:
+    template <R (*Fn)(WasmInstance&, Args...), size_t... I>
+    static WasmValue invoke(WasmInstance& instance, [[maybe_unused]] const WasmSlot* args,
+                            std::index_sequence<I...>) {
+        if constexpr (std::is_void_v<R>) {
+            Fn(instance, HostArg<Args>::get(args[I])...);
+            return WasmValue();
+        } else {
+            return HostArg<R>::wrap(Fn(instance, HostArg<Args>::get(args[I])...));
+        }
+    }
+};
+
+// Host functions a module may import, keyed by "module.field". Registration is
+// typed: define<&fn>("env", "f") derives the wasm signature from fn's C++ one.
+// link() runs once per instantiation and stores the trampoline pointer in each
+// FuncImport, so a host call never goes through this map.
+class WasmHost {
+public:
+    template <auto Fn>
+    void define(const std::string& module, const std::string& field) {
+        using Binding = HostBinding<decltype(Fn)>;
+        define(module, field, Binding::type(), &Binding::template call<Fn>);
+    }
+    void define(const std::string& module, const std::string& field, const FuncType& type, HostFunction fn);
+
+    // Bind the imports of `instance`. A signature mismatch is an error; an unknown
+    // import is reported and left unbound (calling it traps). Returns the unbound count.
+    size_t link(WasmInstance& instance) const;
+
+private:
+    struct Entry {
+        FuncType type;
+        HostFunction fn;
+    };
+    std::unordered_map<std::string, Entry> functions;
+};
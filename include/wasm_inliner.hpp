@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include "struct.h"
+#include "wasm_instance.hpp"
+
+class WasmModule;
+
+// Load-time inlining of small helpers. A direct call to a function of at most
+// MAX_CALLEE_SIZE instructions that cannot reach itself through direct calls is
+// replaced by the callee's body: the callee's locals get slots of their own at the
+// end of the caller's frame, the arguments are stored into them, and the body runs
+// as a block that its `return`s branch out of. Callees are done before their
+// callers, so helpers of helpers are inlined all the way down, until a caller has
+// grown by CALLER_BUDGET instructions. Only functions WasmValidator accepts take
+// part, and a caller that would no longer validate keeps its code. Runs before
+// WasmOptimizer, which then folds across the inlined bodies. No-op when built with
+// WASM_OPTIMIZE=OFF.
+class WasmInliner {
+public:
+    static constexpr size_t MAX_CALLEE_SIZE = 24;
+    static constexpr size_t CALLER_BUDGET = 512;
+
+    static void inlineCalls(WasmModule& module, const WasmInstance& instance);
+};
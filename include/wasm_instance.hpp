@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "struct.h"
+#include "wasm_memory.hpp"
+#include "wasm_table.hpp"
+#include "wasm_wasi.hpp"
+
+// Runtime state of one instantiated module. It outlives individual calls, so
+// stores and global writes made by one export are visible to the next.
+class WasmInstance {
+public:
+    WasmMemory memory{1};
+    std::vector<WasmGlobal> globals;           // by global index, as global.get / global.set name them
+    std::vector<DataSegment> dataSegments;     // module data, read by memory.init
+    std::vector<bool> droppedData;             // per segment, set by data.drop
+    std::vector<WasmTable> tables;
+    std::vector<ElemSegment> elemSegments;     // module elements, read by table.init
+    std::vector<bool> droppedElems;            // per segment, set by elem.drop
+    std::vector<FuncImport> funcImports;       // function indices [0, size) are host imports
+    WasiOutput stdio;                          // guest stdout/stderr; not rolled back
+
+    // Apply the module's active data and element segments; called once parsing is complete
+    void instantiate();
+
+    // Everything but stdio, with linear memory as plain bytes: what a shared module
+    // keeps so that new instances start from it without it holding a live memory
+    struct Image {
+        size_t memoryPages = 0;
+        std::vector<uint8_t> memory;               // up to the last non-zero byte
+        std::vector<WasmGlobal> globals;
+        std::vector<DataSegment> dataSegments;
+        std::vector<bool> droppedData;
+        std::vector<WasmTable> tables;
+        std::vector<ElemSegment> elemSegments;
+        std::vector<bool> droppedElems;
+        std::vector<FuncImport> funcImports;
+    };
+    Image capture() const;
+    // Replace the whole state, checkpoint included, with `image`
+    void load(const Image& image);
+
+    // Optional isolation: checkpoint() before a call, rollback() after it to
+    // undo its effects. Memory cost is O(dirty pages).
+    void checkpoint();
+    void rollback();
+    void release();
+    bool hasCheckpoint() const { return memory.hasSnapshot(); }
+
+private:
+    std::vector<WasmGlobal> savedGlobals;
+    std::vector<bool> savedDropped;
+    std::vector<WasmTable> savedTables;
+    std::vector<bool> savedDroppedElems;
+};
@@ -2,34 +2,85 @@
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <ostream>
 #include "wasm_stack.hpp"
 #include "wasm_parser.hpp"
 #include "wasm_memory.hpp"
 #include "wasm_executor.hpp"
+#include "wasm_register.hpp"
+#include "wasm_register_executor.hpp"
+#include "wasm_jit.hpp"
+#include "wasm_tiering.hpp"
+#include "wasm_module.hpp"
+#include "wasm_decoder.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_binary_parser.hpp"
+#include "wasm_host.hpp"
+#include "wasm_wasi.hpp"
 #include "struct.h"
 
+// One instance of a module and the executors that run it. A module is either
+// loaded by this interpreter (loadFile + parse) or shared by another one.
 class WasmInterpreter {
 public:
+    WasmInterpreter();
+    ~WasmInterpreter();
     void loadFile(const std::string& path);
     void parse();
+    // Freeze the parsed module so other interpreters can instantiate it; this
+    // instance's current state becomes the state their instances start from
+    std::shared_ptr<const WasmModule> shareModule();
+    // Run a shared module on a fresh instance in its initial state
+    void instantiate(std::shared_ptr<const WasmModule> module);
     void callFunctionByExportName(const std::string& exportName);
     void showMemory(uint32_t start, uint32_t count);
+    void setMaxCallDepth(size_t depth) {
+        executor.setMaxCallDepth(depth);
+        registerExecutor.setMaxCallDepth(depth);
+    }
+    // Takes effect in parse()
+    void setEngine(ExecutionEngine e) { engine = e; }
+    // Keep decoded modules in `directory` (see WasmModuleCache); empty: always parse
+    void setCacheDirectory(const std::string& directory) { cacheDirectory = directory; }
+    // Reject (parse() throws) a module that WasmValidator does not accept, rather than
+    // running it with the stack executor's checks on
+    void setStrictValidation(bool strict) { strictValidation = strict; }
+    // Thresholds of the Tiered engine; with `stats` set, promotions and time per tier
+    // are reported on stderr when the interpreter goes away
+    void setTiering(const WasmTiering::Options& options) { tiering.setOptions(options); }
+    // When set, each export call runs against a checkpoint and its effects are rolled back
+    void setIsolatedCalls(bool isolated) { isolatedCalls = isolated; }
+    // Where engine fallbacks, traps, lookup errors and run-time diagnostics are reported
+    // (std::cerr by default)
+    void setErrorStream(std::ostream& stream) {
+        errors = &stream;
+        executor.setErrorStream(stream);
+    }
+    WasmInstance& getInstance() { return instance; }
+    // Host functions offered to imports (the WASI subset is preinstalled); bound in parse()
+    WasmHost& getHost() { return host; }
+    // Gather guest stdout/stderr writes up to `bytes` before a syscall; 0 = write through
+    void setOutputBuffer(size_t bytes) { instance.stdio.setBufferSize(bytes); }
     std::unordered_map<std::string, WasmExport> getExports() const;
+    // Exported functions in call order (see WasmModule::functionExports)
+    std::vector<std::pair<std::string, WasmExport>> getFunctionExports() const { return module->functionExports(); }
 private:
-    std::string sourceCode;
-    WasmParser parser;
+    std::string path;
     WasmExecutor executor;
-    bool inFunction = false;
-    std::string functionName = "";
-    int functionIndex = -1;
-    int brakes = 0;
-    std::unordered_map<std::string, WasmGlobal> globals;
+    WasmRegisterExecutor registerExecutor;
+    ExecutionEngine engine = ExecutionEngine::Stack;   // requested; the module has the one in use
+    std::string cacheDirectory;
+    bool strictValidation = false;
+    WasmTiering tiering{executor, registerExecutor};
+    WasmHost host;
+    bool isolatedCalls = false;
+    std::ostream* errors;
+    WasmInstance instance;
+    std::shared_ptr<const WasmModule> module;
+    std::shared_ptr<WasmModule> loaded;            // the module parse() built, until it is shared
 
-    std::unordered_map<int, FuncType> funcTypes;
-    std::unordered_map<int, FuncDef> functionsByID;
-    std::unordered_map<std::string, FuncDef> functionByName;
-    WasmMemory memory{1};
-    std::unordered_map<std::string, WasmExport> exports;
-
-    void executeLine(const std::string& line);
+    // Point the executors at `module` and `instance`
+    void prepare();
+    void run(const FuncDef& func);
 };
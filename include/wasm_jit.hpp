@@ -0,0 +1,62 @@
+#pragma once
+#include <csetjmp>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+#include "struct.h"
+#include "wasm_register.hpp"
+#include "wasm_instance.hpp"
+
+// State shared between the register executor and compiled code for one execute().
+// The first block is read by generated code at fixed offsets; the rest is only
+// touched by the runtime helpers it calls.
+struct JitContext {
+    uint8_t* const* memoryBase = nullptr;     // &WasmMemory::base, reloaded after every call out
+    const size_t* memorySize = nullptr;       // &WasmMemory::byteSize, for checked memory
+    const bool* memoryTracking = nullptr;     // &WasmMemory::tracking: stores go through the snapshot
+    WasmSlot* slotsEnd = nullptr;             // native frames must end before this slot
+    uint64_t depth = 0;                       // active calls, as WasmRegisterExecutor counts frames
+    uint64_t maxDepth = 0;
+    uintptr_t stackLimit = 0;                 // calls trap rather than grow the native stack below this
+
+    WasmInstance* instance = nullptr;
+    const std::vector<RegFunction>* functions = nullptr;
+    sigjmp_buf* trapEnv = nullptr;            // a trap siglongjmps here ...
+    std::exception_ptr* error = nullptr;      // ... with the host exception to rethrow, if any
+    char trapMessage[96] = {};                // ... or with the trap message
+};
+
+// Single-pass x86-64 compiler for the register form (see wasm_register.hpp).
+// Each instruction becomes a fixed machine code sequence over the same frame
+// slots the register executor uses, so compiled and interpreted functions call
+// each other with the same frame layout. A function is compiled only when every
+// instruction in it is covered and every function it calls is compiled too;
+// anything else keeps running on the register executor. Code lives in one
+// mapping that is writable while it is filled in and executable afterwards,
+// never both.
+class WasmJit {
+public:
+    WasmJit() = default;
+    ~WasmJit();
+    WasmJit(const WasmJit&) = delete;
+    WasmJit& operator=(const WasmJit&) = delete;
+
+    // True when this build can generate code for the host (x86-64 Linux, WASM_JIT)
+    static bool available();
+
+    // Compile what it can of `functions`, setting RegFunction::native; returns the
+    // number of functions compiled. Tracing that is switched on is compiled in.
+    size_t compile(std::vector<RegFunction>& functions);
+
+    // Largest frame of any compiled function, in slots
+    uint32_t maxFrameSize() const { return largestFrame; }
+
+    // Point `ctx` at the state generated code reads, for a run against `instance`
+    static void bind(JitContext& ctx, WasmInstance& instance);
+
+private:
+    uint8_t* code = nullptr;
+    size_t codeSize = 0;
+    uint32_t largestFrame = 0;
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only mapping of a whole file, unmapped on destruction
+class WasmMappedFile {
+public:
+    // Throws std::runtime_error when the file cannot be opened or mapped
+    explicit WasmMappedFile(const std::string& path);
+    ~WasmMappedFile();
+    WasmMappedFile(const WasmMappedFile&) = delete;
+    WasmMappedFile& operator=(const WasmMappedFile&) = delete;
+
+    const uint8_t* data = nullptr;   // null for an empty file
+    size_t size = 0;
+};
@@ -3,55 +3,134 @@
 #include <cstdint>
 #include <iostream>
 #include <cstring>
+#include <stdexcept>
+#if WASM_GUARD_PAGES
+#include <csetjmp>
+#endif
 
+// Linear memory backend, chosen at build time (see WASM_MEMORY in CMakeLists.txt).
+// Guard: the whole 32-bit address space plus the largest offset is reserved
+// PROT_NONE up front; grow only changes page protection, and loads/stores
+// carry no bounds check — an out-of-range access faults and becomes a trap.
+// Checked: a std::vector with an explicit bounds check on every access.
 class WasmMemory {
 public:
     static constexpr size_t PAGE_SIZE = 65536;
+    static constexpr size_t MAX_PAGES = 65536;   // 4 GiB
 
-    WasmMemory(size_t minPages = 1)
-        : minPages(minPages), data(minPages * PAGE_SIZE, 0) {}
+    WasmMemory(size_t minPages = 1);
+    ~WasmMemory();
+    WasmMemory(WasmMemory&& other) noexcept;
+    WasmMemory& operator=(WasmMemory&& other) noexcept;
+    WasmMemory(const WasmMemory&) = delete;
+    WasmMemory& operator=(const WasmMemory&) = delete;
 
     // ---- STORE ----
-    void store8(uint32_t addr, uint8_t value);
-    void store16(uint32_t addr, uint16_t value);
-    void store32(uint32_t addr, int32_t value);
-    void store64(uint32_t addr, int64_t value);
-    void storeF32(uint32_t addr, float value);
-    void storeF64(uint32_t addr, double value);
+    // Addresses are effective addresses (base + memarg offset), so up to 33 bits.
+    void store8(uint64_t addr, uint8_t value);
+    void store16(uint64_t addr, uint16_t value);
+    void store32(uint64_t addr, int32_t value);
+    void store64(uint64_t addr, int64_t value);
+    void storeF32(uint64_t addr, float value);
+    void storeF64(uint64_t addr, double value);
 
     // ---- LOAD ----
-    uint8_t  load8(uint32_t addr) const;
-    uint16_t load16(uint32_t addr) const;
-    int32_t  load32(uint32_t addr) const;
-    int64_t  load64(uint32_t addr) const;
-    float    loadF32(uint32_t addr) const;
-    double   loadF64(uint32_t addr) const;
+    uint8_t  load8(uint64_t addr) const;
+    uint16_t load16(uint64_t addr) const;
+    int32_t  load32(uint64_t addr) const;
+    int64_t  load64(uint64_t addr) const;
+    float    loadF32(uint64_t addr) const;
+    double   loadF64(uint64_t addr) const;
+
+    // ---- BULK ----
+    // Range-checked as a whole before anything is written (std::out_of_range)
+    void write(uint32_t addr, const uint8_t* src, size_t len);
+    void copy(uint32_t dst, uint32_t src, uint32_t len);
+    void fill(uint32_t dst, uint8_t value, uint32_t len);
+
+    // ---- HOST ACCESS ----
+    // [addr, addr + len) after a range check (std::out_of_range), for host functions
+    // that hand guest buffers to the OS. Valid until the next grow; read-only.
+    const uint8_t* view(uint64_t addr, uint64_t len) const;
 
     // ---- MANAGEMENT ----
     int32_t  grow(int32_t  additionalPages);
-    size_t sizeInPages() const { return data.size() / PAGE_SIZE; }
+    size_t sizeInPages() const { return byteSize / PAGE_SIZE; }
     int32_t size() const {
         return static_cast<int32_t>(sizeInPages());
     }
     void debugPrint(uint32_t start = 0, uint32_t count = 32) const;
+    // Start over as `pages` zeroed pages holding `len` bytes from `bytes` at address 0
+    void reset(size_t pages, const uint8_t* bytes, size_t len);
+    // Contents up to the last non-zero byte; with sizeInPages(), enough for reset()
+    std::vector<uint8_t> contents() const;
+
+    // ---- SNAPSHOT ----
+    // While a snapshot is active every page is copied once, on its first write,
+    // so restore() and discardSnapshot() cost O(dirty pages), not O(memory size).
+    void snapshot();
+    void restore();
+    void discardSnapshot();
+    bool hasSnapshot() const { return tracking; }
+    size_t dirtyPages() const { return dirtyList.size(); }
+
+#if WASM_GUARD_PAGES
+    // Active while guest code runs. A fault inside any guard reservation
+    // siglongjmps to the innermost scope: `if (sigsetjmp(scope.env, 0)) <trap>`.
+    // The handler unblocks the signal itself, so the mask need not be saved.
+    // Every entry point that can run nested under another (a call across tiers)
+    // opens its own scope: the jump then never skips frames that need unwinding.
+    struct FaultScope {
+        FaultScope();
+        ~FaultScope();
+        sigjmp_buf env;
+        FaultScope* prev;
+    };
+#endif
 
 private:
+    friend class WasmJit;   // generated code reads base, byteSize and tracking in place
+
     size_t minPages;
+    uint8_t* base = nullptr;                         // first byte of linear memory
+    size_t byteSize = 0;                             // accessible bytes
+#if !WASM_GUARD_PAGES
     std::vector<uint8_t> data;
+#endif
+
+    bool tracking = false;
+    size_t snapshotSize = 0;                         // bytes at snapshot time
+    std::vector<std::vector<uint8_t>> savedPages;    // original contents, empty until first write
+    std::vector<size_t> dirtyList;
+
+    void savePage(size_t page);
+    void checkRange(uint64_t addr, uint64_t len, const char* what) const;
+    void markDirty(uint64_t addr, uint64_t len);
+    bool resize(size_t newSize);
+    void release();
 
     template <typename T>
-    void writeBytes(uint32_t addr, const T& value) {
-        if (addr + sizeof(T) > data.size())
+    void writeBytes(uint64_t addr, const T& value) {
+#if !WASM_GUARD_PAGES
+        if (addr + sizeof(T) > byteSize)
             throw std::out_of_range("[memory] store out of bounds");
-        std::memcpy(&data[addr], &value, sizeof(T));
+#endif
+        if (tracking) {
+            size_t first = addr / PAGE_SIZE, last = (addr + sizeof(T) - 1) / PAGE_SIZE;
+            for (size_t p = first; p <= last; ++p)
+                if (p < savedPages.size() && savedPages[p].empty()) savePage(p);
+        }
+        std::memcpy(base + addr, &value, sizeof(T));
     }
 
     template <typename T>
-    T readBytes(uint32_t addr) const {
-        if (addr + sizeof(T) > data.size())
+    T readBytes(uint64_t addr) const {
+#if !WASM_GUARD_PAGES
+        if (addr + sizeof(T) > byteSize)
             throw std::out_of_range("[memory] load out of bounds");
+#endif
         T value;
-        std::memcpy(&value, &data[addr], sizeof(T));
+        std::memcpy(&value, base + addr, sizeof(T));
         return value;
     }
 };
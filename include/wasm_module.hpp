@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "struct.h"
+#include "wasm_decoder.hpp"
+#include "wasm_host.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_register.hpp"
+#include "wasm_jit.hpp"
+#include "wasm_module_cache.hpp"
+
+// Stack: run decoded code on the operand stack machine.
+// Register: translate each function to the register form first (falls back to
+// Stack, with a warning, when the module uses something it does not cover).
+// Jit: Register, with every function the baseline compiler covers run as x86-64
+// code (falls back to Register where the build has no compiler).
+// Tiered: start every function on Stack and move the hot ones to Register while
+// running (see WasmTiering).
+enum class ExecutionEngine { Stack, Register, Jit, Tiered };
+
+// The code side of a module: functions with their side tables, types, exports and
+// whatever the engine compiled from them. Loading also fills in an instance (memory,
+// globals, tables, segments, bound imports); `initial` is the state new instances
+// start from once the module is shared (WasmInterpreter::shareModule). Nothing in
+// a shared module changes, so it backs any number of instances on any threads.
+class WasmModule {
+public:
+    // Parse `path` (text or binary) into a new module and into `instance`, bind the
+    // imports from `host` and prepare `engine`, falling back as described above (with
+    // a warning on `errors`). Functions are checked by WasmValidator once parsed, then
+    // rewritten by WasmInliner and WasmOptimizer. With a `cache`, a matching entry
+    // replaces the parse and a parsed module is written to it.
+    static std::shared_ptr<WasmModule> load(const std::string& path,
+                                            const WasmHost& host,
+                                            ExecutionEngine engine,
+                                            WasmInstance& instance,
+                                            std::ostream& errors,
+                                            const WasmModuleCache* cache = nullptr);
+
+    // Exported functions in the order the command line calls them: by function index
+    std::vector<std::pair<std::string, WasmExport>> functionExports() const;
+    // Every function passed WasmValidator, so the stack executor can drop its checks
+    bool validated() const { return invalidFunctions == 0; }
+
+    ExecutionEngine engine = ExecutionEngine::Stack;   // after fallbacks
+    int startFunction = -1;
+    size_t invalidFunctions = 0;     // rejected by WasmValidator
+    std::string invalidReason;       // why the first of them was
+    std::unordered_map<int, FuncType> funcTypes;
+    std::unordered_map<int, FuncDef> functionsByID;
+    std::unordered_map<std::string, uint32_t> functionByName;   // function index of each named function
+    std::vector<const FuncDef*> functions;        // by function index into functionsByID; null for imports
+    std::unordered_map<std::string, WasmExport> exports;
+    WasmDecoder decoder;
+    std::vector<RegFunction> registerFunctions;   // by function index, Register and Jit engines
+    WasmJit jit;
+    WasmInstance::Image initial;
+
+private:
+    // Once the code is final: every call by a name some function has becomes a call
+    // by index, and `functions` is filled in, so the stack executor calls through
+    // neither map
+    void resolveCalls();
+};
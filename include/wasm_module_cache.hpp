@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "wasm_instance.hpp"
+
+class WasmModule;
+
+// On-disk cache of decoded modules. An entry holds everything parsing produces:
+// function code with its side tables, types, signatures, exports, and the instance
+// state before imports are bound and the start function runs. It is named after a
+// hash of the module bytes and of this build's format (instruction layout,
+// opcode set, fusion, optimizer), so a changed source or interpreter simply
+// misses. Entries are position-independent: lengths and plain values only, read
+// back from a mapping of the file with one copy per array instead of a parse.
+class WasmModuleCache {
+public:
+    explicit WasmModuleCache(std::string directory) : directory(std::move(directory)) {}
+
+    // Key of a module whose file holds `size` bytes at `data`
+    static uint64_t key(const uint8_t* data, size_t size);
+
+    // Fill `module` (code side) and `instance` from the entry for `key`; false when
+    // there is none or it is unusable, with both left to be parsed into
+    bool load(uint64_t key, WasmModule& module, WasmInstance& instance) const;
+    // Write the entry for `key` (through a temporary file renamed into place, so a
+    // concurrent reader sees the old entry or the new one); false on I/O failure
+    bool store(uint64_t key, const WasmModule& module, const WasmInstance& instance) const;
+
+    std::string pathFor(uint64_t key) const;
+
+private:
+    std::string directory;
+};
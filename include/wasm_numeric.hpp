@@ -0,0 +1,179 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "struct.h"
+#include "wasm_trap.hpp"
+
+// Semantics of the numeric instructions, shared by the stack and register executors.
+// Each engine expands WASM_NUMERIC_OPS with its own operand plumbing:
+//   BINARY(op, type, T, expr)   a, b read as T; result converted to `type`
+//   COMPARE(op, type, T, expr)  a, b of `type` read as T; i32 result 0 / 1
+//   UNARY(op, type, T, expr)    a read as T; result converted to `type`
+//   CONVERT(op, from, expr)     v: the WasmValue operand of type `from`; expr is the result
+// Integer division by zero yields 0 rather than trapping; signed division of the
+// most negative value by -1 traps (the quotient does not fit), the remainder is 0.
+
+static inline int countl_zero32(uint32_t x) { return x == 0 ? 32 : __builtin_clz(x); }
+static inline int countr_zero32(uint32_t x) { return x == 0 ? 32 : __builtin_ctz(x); }
+static inline int popcount32(uint32_t x) { return __builtin_popcount(x); }
+static inline int countl_zero64(uint64_t x) { return x == 0 ? 64 : __builtin_clzll(x); }
+static inline int countr_zero64(uint64_t x) { return x == 0 ? 64 : __builtin_ctzll(x); }
+static inline int popcount64(uint64_t x) { return __builtin_popcountll(x); }
+
+template <typename T>
+static inline T signedDivide(T a, T b) {
+    if (b == 0) return 0;
+    if (b == -1) {
+        if (a == std::numeric_limits<T>::min()) throw WasmTrap("integer overflow");
+        return -a;
+    }
+    return a / b;
+}
+
+template <typename T>
+static inline T signedRemainder(T a, T b) { return b == 0 || b == -1 ? 0 : a % b; }
+
+template <typename To, typename From>
+static inline To reinterpretBits(From from) {
+    static_assert(sizeof(To) == sizeof(From), "reinterpret between types of equal size");
+    To to;
+    std::memcpy(&to, &from, sizeof(to));
+    return to;
+}
+
+// x / d for a divisor d that is not a power of two (Granlund and Montgomery):
+// shift = ceil(log2 d), multiplier = floor(2^32 (2^shift - d) / d) + 1
+static inline uint32_t divideByConstant(uint32_t x, uint32_t multiplier, uint32_t shift) {
+    return static_cast<uint32_t>((((static_cast<uint64_t>(x) * multiplier) >> 32) + x) >> shift);
+}
+
+// C++ representation of each value type, for engines that address slot fields generically
+template <ValueType T> struct WasmScalar;
+template <> struct WasmScalar<ValueType::I32> { using type = int32_t; static int32_t get(const WasmSlot& v) { return v.i32; } };
+template <> struct WasmScalar<ValueType::I64> { using type = int64_t; static int64_t get(const WasmSlot& v) { return v.i64; } };
+template <> struct WasmScalar<ValueType::F32> { using type = float;   static float get(const WasmSlot& v) { return v.f32; } };
+template <> struct WasmScalar<ValueType::F64> { using type = double;  static double get(const WasmSlot& v) { return v.f64; } };
+
+#define WASM_NUMERIC_OPS(BINARY, COMPARE, UNARY, CONVERT) \
+    CONVERT(I32ReinterpretF32, F32, WasmValue(reinterpretBits<int32_t>(v.f32))) \
+    CONVERT(F32ReinterpretI32, I32, WasmValue(reinterpretBits<float>(v.i32))) \
+    CONVERT(I64ReinterpretF64, F64, WasmValue(reinterpretBits<int64_t>(v.f64))) \
+    CONVERT(F32ConvertI32S, I32, WasmValue(static_cast<float>(v.i32))) \
+    CONVERT(F32ConvertI32U, I32, WasmValue(static_cast<float>(static_cast<uint32_t>(v.i32)))) \
+    CONVERT(I32TruncF32S, F32, WasmValue(static_cast<int32_t>(std::trunc(v.f32)))) \
+    CONVERT(I32TruncF32U, F32, WasmValue(static_cast<int32_t>(static_cast<uint32_t>(std::trunc(v.f32))))) \
+    CONVERT(F64ConvertI32S, I32, WasmValue(static_cast<double>(v.i32))) \
+    CONVERT(I32TruncF64S, F64, WasmValue(static_cast<int32_t>(std::trunc(v.f64)))) \
+    CONVERT(F64PromoteF32, F32, WasmValue(static_cast<double>(v.f32))) \
+    CONVERT(F32DemoteF64, F64, WasmValue(static_cast<float>(v.f64))) \
+    CONVERT(I32WrapI64, I64, WasmValue(static_cast<int32_t>(v.i64))) \
+    \
+    BINARY(I32Add, I32, int32_t, a + b) \
+    BINARY(I32Sub, I32, int32_t, a - b) \
+    BINARY(I32Mul, I32, int32_t, a * b) \
+    BINARY(I32And, I32, int32_t, a & b) \
+    BINARY(I32Or, I32, int32_t, a | b) \
+    BINARY(I32Xor, I32, int32_t, a ^ b) \
+    BINARY(I32Min, I32, int32_t, a < b ? a : b) \
+    BINARY(I32Max, I32, int32_t, a > b ? a : b) \
+    UNARY(I32Abs, I32, int32_t, a < 0 ? -a : a) \
+    UNARY(I32Neg, I32, int32_t, -a) \
+    BINARY(I32Shl, I32, int32_t, a << (b & 31)) \
+    BINARY(I32ShrS, I32, int32_t, a >> (b & 31)) \
+    BINARY(I32ShrU, I32, int32_t, static_cast<int32_t>(static_cast<uint32_t>(a) >> (b & 31))) \
+    BINARY(I32Rotl, I32, uint32_t, (a << (b & 31)) | (a >> ((32 - b) & 31))) \
+    BINARY(I32Rotr, I32, uint32_t, (a >> (b & 31)) | (a << ((32 - b) & 31))) \
+    BINARY(I32DivS, I32, int32_t, signedDivide(a, b)) \
+    BINARY(I32DivU, I32, uint32_t, b == 0 ? 0 : a / b) \
+    BINARY(I32RemS, I32, int32_t, signedRemainder(a, b)) \
+    BINARY(I32RemU, I32, uint32_t, b == 0 ? 0 : a % b) \
+    COMPARE(I32Eq, I32, int32_t, a == b) \
+    COMPARE(I32Ne, I32, int32_t, a != b) \
+    COMPARE(I32LtS, I32, int32_t, a < b) \
+    COMPARE(I32LtU, I32, uint32_t, a < b) \
+    COMPARE(I32GtS, I32, int32_t, a > b) \
+    COMPARE(I32GtU, I32, uint32_t, a > b) \
+    COMPARE(I32LeS, I32, int32_t, a <= b) \
+    COMPARE(I32LeU, I32, uint32_t, a <= b) \
+    COMPARE(I32GeS, I32, int32_t, a >= b) \
+    COMPARE(I32GeU, I32, uint32_t, a >= b) \
+    UNARY(I32Eqz, I32, int32_t, a == 0 ? 1 : 0) \
+    UNARY(I32Clz, I32, uint32_t, countl_zero32(a)) \
+    UNARY(I32Ctz, I32, uint32_t, countr_zero32(a)) \
+    UNARY(I32Popcnt, I32, uint32_t, popcount32(a)) \
+    \
+    BINARY(I64Add, I64, int64_t, a + b) \
+    BINARY(I64Sub, I64, int64_t, a - b) \
+    BINARY(I64Mul, I64, int64_t, a * b) \
+    BINARY(I64And, I64, int64_t, a & b) \
+    BINARY(I64Or, I64, int64_t, a | b) \
+    BINARY(I64Xor, I64, int64_t, a ^ b) \
+    BINARY(I64Min, I64, int64_t, a < b ? a : b) \
+    BINARY(I64Max, I64, int64_t, a > b ? a : b) \
+    UNARY(I64Abs, I64, int64_t, a < 0 ? -a : a) \
+    UNARY(I64Neg, I64, int64_t, -a) \
+    BINARY(I64Shl, I64, int64_t, a << (b & 63)) \
+    BINARY(I64ShrS, I64, int64_t, a >> (b & 63)) \
+    BINARY(I64ShrU, I64, int64_t, static_cast<int64_t>(static_cast<uint64_t>(a) >> (b & 63))) \
+    BINARY(I64Rotl, I64, uint64_t, (a << (b & 63)) | (a >> ((64 - b) & 63))) \
+    BINARY(I64Rotr, I64, uint64_t, (a >> (b & 63)) | (a << ((64 - b) & 63))) \
+    BINARY(I64DivS, I64, int64_t, signedDivide(a, b)) \
+    BINARY(I64DivU, I64, uint64_t, b == 0 ? 0 : a / b) \
+    BINARY(I64RemS, I64, int64_t, signedRemainder(a, b)) \
+    BINARY(I64RemU, I64, uint64_t, b == 0 ? 0 : a % b) \
+    COMPARE(I64Eq, I64, int64_t, a == b) \
+    COMPARE(I64Ne, I64, int64_t, a != b) \
+    COMPARE(I64LtS, I64, int64_t, a < b) \
+    COMPARE(I64LtU, I64, uint64_t, a < b) \
+    COMPARE(I64GtS, I64, int64_t, a > b) \
+    COMPARE(I64GtU, I64, uint64_t, a > b) \
+    COMPARE(I64LeS, I64, int64_t, a <= b) \
+    COMPARE(I64LeU, I64, uint64_t, a <= b) \
+    COMPARE(I64GeS, I64, int64_t, a >= b) \
+    COMPARE(I64GeU, I64, uint64_t, a >= b) \
+    UNARY(I64Eqz, I64, int64_t, a == 0 ? 1 : 0) \
+    UNARY(I64Clz, I64, uint64_t, countl_zero64(a)) \
+    UNARY(I64Ctz, I64, uint64_t, countr_zero64(a)) \
+    UNARY(I64Popcnt, I64, uint64_t, popcount64(a)) \
+    \
+    BINARY(F32Add, F32, float, a + b) \
+    BINARY(F32Sub, F32, float, a - b) \
+    BINARY(F32Mul, F32, float, a * b) \
+    BINARY(F32Div, F32, float, a / b) \
+    BINARY(F32Min, F32, float, a < b ? a : b) \
+    BINARY(F32Max, F32, float, a > b ? a : b) \
+    UNARY(F32Abs, F32, float, a < 0 ? -a : a) \
+    UNARY(F32Neg, F32, float, -a) \
+    UNARY(F32Sqrt, F32, float, std::sqrt(a)) \
+    UNARY(F32Ceil, F32, float, std::ceil(a)) \
+    UNARY(F32Floor, F32, float, std::floor(a)) \
+    UNARY(F32Trunc, F32, float, std::trunc(a)) \
+    UNARY(F32Nearest, F32, float, std::nearbyint(a)) \
+    COMPARE(F32Eq, F32, float, a == b) \
+    COMPARE(F32Ne, F32, float, a != b) \
+    COMPARE(F32Lt, F32, float, a < b) \
+    COMPARE(F32Gt, F32, float, a > b) \
+    COMPARE(F32Le, F32, float, a <= b) \
+    COMPARE(F32Ge, F32, float, a >= b) \
+    \
+    BINARY(F64Add, F64, double, a + b) \
+    BINARY(F64Sub, F64, double, a - b) \
+    BINARY(F64Mul, F64, double, a * b) \
+    BINARY(F64Div, F64, double, a / b) \
+    BINARY(F64Min, F64, double, a < b ? a : b) \
+    BINARY(F64Max, F64, double, a > b ? a : b) \
+    UNARY(F64Abs, F64, double, a < 0 ? -a : a) \
+    UNARY(F64Neg, F64, double, -a) \
+    UNARY(F64Sqrt, F64, double, std::sqrt(a)) \
+    UNARY(F64Ceil, F64, double, std::ceil(a)) \
+    UNARY(F64Floor, F64, double, std::floor(a)) \
+    UNARY(F64Trunc, F64, double, std::trunc(a)) \
+    UNARY(F64Nearest, F64, double, std::nearbyint(a)) \
+    COMPARE(F64Eq, F64, double, a == b) \
+    COMPARE(F64Ne, F64, double, a != b) \
+    COMPARE(F64Lt, F64, double, a < b) \
+    COMPARE(F64Gt, F64, double, a > b) \
+    COMPARE(F64Le, F64, double, a <= b) \
+    COMPARE(F64Ge, F64, double, a >= b)
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "struct.h"
+#include "wasm_instance.hpp"
+
+class WasmModule;
+
+// Load-time rewriting of decoded function bodies, between validation and the
+// engines: reads of immutable globals become constants, constants are folded (with
+// the executors' own arithmetic, see wasm_numeric.hpp), code after br / br_table /
+// return and the arm of an `if` on a constant are dropped, br_if / select on
+// constants are resolved, and i32 / i64 multiplication, unsigned division and
+// remainder by constants become shifts and masks, or multiply-high for i32 divisors
+// that are not powers of two. Division by zero, signed division overflow and
+// float-to-integer truncation are never folded, so they behave at run time exactly
+// as before. Only functions WasmValidator accepts are rewritten, and each is
+// validated again afterwards (which also recomputes FuncDef::maxStack); one that
+// would not pass keeps its original code. Per-function instruction counts before and
+// after are traced (--trace=parser). No-op when built with WASM_OPTIMIZE=OFF.
+class WasmOptimizer {
+public:
+    static void optimize(WasmModule& module, const WasmInstance& instance);
+
+    // Per global index: immutable and never the target of a global.set, so every
+    // global.get of it can be replaced by its initial value
+    static std::vector<bool> constantGlobals(const WasmModule& module, const WasmInstance& instance);
+
+    // One function; false when it is left as it was
+    static bool optimizeFunction(FuncDef& func, WasmModule& module, const WasmInstance& instance,
+                                 const std::vector<bool>& constantGlobals);
+};
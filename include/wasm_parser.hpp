@@ -1,23 +1,113 @@
 #pragma once
 #include "wasm_memory.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_decoder.hpp"
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <cstdint>
 #include "struct.h"
 
+// Text format (.wat) parser: a single-pass tokenizer over the source buffer feeding a
+// recursive-descent parser. Instructions, flat or folded, are emitted straight into
+// FuncDef::code; tokens are views into the source and are never copied per line.
 class WasmParser {
 public:
-    void parseModule( std::unordered_map<std::string, WasmGlobal>& globals);
-    void parseGlobal(const std::string& line, std::unordered_map<std::string, WasmGlobal>& globals);
-    void parseType(const std::string& line, std::unordered_map<int, FuncType>& funcTypes);
-    FuncDef parseFunction(const std::string& line, std::unordered_map<int, FuncDef>& functionsByID,
-                       std::unordered_map<std::string, FuncDef>& functionByName,
-                       const std::unordered_map<int, FuncType>& funcTypes);
-    void parseBody(const std::string& line, FuncDef *func, bool toRemove);
-    void parseMemory(const std::string& line, WasmMemory& memory);
-    void parseExport(const std::string& line, std::unordered_map<std::string, WasmExport>& exports);
-    
+    void parseModule(std::string_view source,
+                     std::unordered_map<int, FuncType>& funcTypes,
+                     std::unordered_map<int, FuncDef>& functionsByID,
+                     std::unordered_map<std::string, uint32_t>& functionByName,
+                     std::unordered_map<std::string, WasmExport>& exports,
+                     WasmInstance& instance,
+                     WasmDecoder& decoder);
+
+    int startFunction() const { return startIndex; }
+
     void print_exports(const std::unordered_map<std::string, WasmExport>& exports) const;
-    void print_globals(const std::unordered_map<std::string, WasmGlobal>& globals) const;
-    void print_functions(const std::unordered_map<std::string, FuncDef>& functionByName, const std::unordered_map<int, FuncDef>& functionsByID) const;
+    void print_globals(const std::vector<WasmGlobal>& globals) const;
+    void print_functions(const std::unordered_map<std::string, uint32_t>& functionByName, const std::unordered_map<int, FuncDef>& functionsByID) const;
+
+private:
+    enum class TokenKind { LParen, RParen, Atom, String, Eof };
+    struct Token {
+        TokenKind kind = TokenKind::Eof;
+        std::string_view text;
+    };
+
+    // Per-function state while its body is being parsed
+    struct FuncState {
+        FuncDef* func = nullptr;
+        uint32_t slot = 0;                                        // position in `funcs`
+        std::unordered_map<std::string_view, uint32_t> localSlots;
+        std::unordered_map<std::string_view, uint32_t> symbolIds;
+        std::vector<std::string_view> labels;                     // open blocks, innermost last
+        std::vector<std::vector<uint32_t>> depths;                // branch immediates for WasmDecoder::link
+    };
+
+    // Instruction immediate naming a function, global or data segment defined further down
+    struct NameFixup { uint32_t slot; uint32_t pc; std::string_view name; };
+    struct ElemFixup { uint32_t segment; uint32_t position; std::string_view name; };
+    struct PendingExport { std::string name; std::string_view kind; std::string_view ref; int index; };
+
+    // ---- tokenizer ----
+    const char* cur = nullptr;
+    const char* end = nullptr;
+    size_t line = 1;
+    Token tok;
+
+    void next();
+    Token peek();
+    bool isForm(std::string_view keyword);
+    void expect(TokenKind kind, const char* what);
+    std::string_view atom(const char* what);
+    void skipToClose();
+    [[noreturn]] void error(const std::string& msg) const;
+
+    // ---- module state ----
+    std::unordered_map<int, FuncType>* types = nullptr;
+    WasmInstance* inst = nullptr;
+    WasmDecoder* decoder = nullptr;
+    std::unordered_map<std::string_view, uint32_t> typeNames;
+    std::unordered_map<std::string_view, uint32_t> funcNames;
+    std::unordered_map<std::string_view, uint32_t> globalNames;
+    std::unordered_map<std::string_view, uint32_t> dataNames;
+    std::unordered_map<std::string_view, uint32_t> tableNames;
+    std::unordered_map<std::string_view, uint32_t> elemNames;
+    std::vector<FuncDef> funcs;                                   // defined functions, index = importedFuncs + slot
+    uint32_t importedFuncs = 0;
+    std::vector<NameFixup> nameFixups;
+    std::vector<ElemFixup> elemFixups;
+    std::vector<PendingExport> pendingExports;
+    std::string_view startRef;
+    int startIndex = -1;
+
+    void parseField();
+    void parseType();
+    void parseImport();
+    void parseFunc();
+    void parseMemory();
+    void parseGlobal();
+    void parseExport();
+    void parseData();
+    void parseTable();
+    void parseElem();
+    void parseElemItems(ElemSegment& seg, uint32_t segment);
+    FuncType parseTypeUse(std::vector<std::string_view>* paramNames);
+    void parseValueTypes(std::vector<std::string>& out, std::vector<std::string_view>* names);
+    WasmValue parseConstExpr();
+    void addGlobal(std::string_view name, ValueType type, bool isMutable, WasmValue value);
+    std::string parseStrings(bool single = false);
+
+    // ---- function bodies ----
+    void parseInstrList(FuncState& fs);
+    void parseFolded(FuncState& fs);
+    void parsePlain(FuncState& fs);
+    Instr parseOperator(FuncState& fs, std::string_view mnemonic, std::string_view& forwardName);
+    void emit(FuncState& fs, const Instr& in, std::string_view forwardName = {});
+    int32_t parseBlockType(ValueType& type);
+    uint32_t labelDepth(FuncState& fs, std::string_view ref);
+    uint32_t intern(FuncState& fs, std::string_view key, const std::string& symbol);
+    uint32_t resolveIndex(std::string_view ref, const std::unordered_map<std::string_view, uint32_t>& names,
+                          const char* what);
 };
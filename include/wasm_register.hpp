@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "struct.h"
+#include "wasm_numeric.hpp"
+#include "wasm_decoder.hpp"
+#include "wasm_instance.hpp"
+
+// Register form of a function body: three-address code whose operands are slots
+// of the function's frame, laid out as
+//   [0, locals)                    params, then declared locals (as in FuncDef::locals)
+//   [locals, locals + constants)   constants of the body, preloaded on entry with the locals
+//   [.., + max operand height)     one temporary per operand stack height
+// local.get and constants become plain operand references, and a result feeding
+// local.set is written to the local directly, so most wasm arithmetic turns into
+// one instruction that reads its operands and writes its result in place.
+
+// Loads: X(name, "text", result type, value read at effective address `ea`)
+#define WASM_REGISTER_LOADS(X) \
+    X(I32Load8S, "i32.load8_s", int32_t, static_cast<int8_t>(memory.load8(ea))) \
+    X(I32Load8U, "i32.load8_u", int32_t, memory.load8(ea)) \
+    X(I32Load16S, "i32.load16_s", int32_t, static_cast<int16_t>(memory.load16(ea))) \
+    X(I32Load16U, "i32.load16_u", int32_t, memory.load16(ea)) \
+    X(I32Load, "i32.load", int32_t, memory.load32(ea)) \
+    X(I64Load8S, "i64.load8_s", int64_t, static_cast<int8_t>(memory.load8(ea))) \
+    X(I64Load8U, "i64.load8_u", int64_t, memory.load8(ea)) \
+    X(I64Load16S, "i64.load16_s", int64_t, static_cast<int16_t>(memory.load16(ea))) \
+    X(I64Load16U, "i64.load16_u", int64_t, memory.load16(ea)) \
+    X(I64Load32S, "i64.load32_s", int64_t, memory.load32(ea)) \
+    X(I64Load32U, "i64.load32_u", int64_t, static_cast<uint32_t>(memory.load32(ea))) \
+    X(I64Load, "i64.load", int64_t, memory.load64(ea)) \
+    X(F32Load, "f32.load", float, memory.loadF32(ea)) \
+    X(F64Load, "f64.load", double, memory.loadF64(ea))
+
+// Stores: X(name, "text", write of WasmSlot `v` at effective address `ea`)
+#define WASM_REGISTER_STORES(X) \
+    X(I32Store8, "i32.store8", memory.store8(ea, static_cast<uint8_t>(v.i32))) \
+    X(I32Store16, "i32.store16", memory.store16(ea, static_cast<uint16_t>(v.i32))) \
+    X(I32Store, "i32.store", memory.store32(ea, v.i32)) \
+    X(I64Store8, "i64.store8", memory.store8(ea, static_cast<uint8_t>(v.i64))) \
+    X(I64Store16, "i64.store16", memory.store16(ea, static_cast<uint16_t>(v.i64))) \
+    X(I64Store32, "i64.store32", memory.store32(ea, static_cast<int32_t>(v.i64))) \
+    X(I64Store, "i64.store", memory.store64(ea, v.i64)) \
+    X(F32Store, "f32.store", memory.storeF32(ea, v.f32)) \
+    X(F64Store, "f64.store", memory.storeF64(ea, v.f64))
+
+// i32 compare and branch, taken when the comparison holds: X(name, "text", operand type, test)
+#define WASM_REGISTER_COMPARE_BRANCHES(X) \
+    X(BrI32Eq, "i32.eq br_if", int32_t, a == b) \
+    X(BrI32Ne, "i32.ne br_if", int32_t, a != b) \
+    X(BrI32LtS, "i32.lt_s br_if", int32_t, a < b) \
+    X(BrI32LtU, "i32.lt_u br_if", uint32_t, a < b) \
+    X(BrI32GtS, "i32.gt_s br_if", int32_t, a > b) \
+    X(BrI32GtU, "i32.gt_u br_if", uint32_t, a > b) \
+    X(BrI32LeS, "i32.le_s br_if", int32_t, a <= b) \
+    X(BrI32LeU, "i32.le_u br_if", uint32_t, a <= b) \
+    X(BrI32GeS, "i32.ge_s br_if", int32_t, a >= b) \
+    X(BrI32GeU, "i32.ge_u br_if", uint32_t, a >= b)
+
+// Everything else: X(name, "text")
+#define WASM_REGISTER_OPS(X) \
+    X(Move, "move") \
+    X(Br, "br") \
+    X(BrIf, "br_if") \
+    X(BrUnless, "br_unless") \
+    X(BrTable, "br_table") \
+    X(Return, "return") \
+    X(Call, "call") \
+    X(CallHost, "call.host") \
+    X(CallIndirect, "call_indirect") \
+    X(Select, "select") \
+    X(GlobalGet, "global.get") \
+    X(GlobalSet, "global.set") \
+    X(MemorySize, "memory.size") \
+    X(MemoryGrow, "memory.grow") \
+    X(MemoryCopy, "memory.copy") \
+    X(MemoryFill, "memory.fill") \
+    X(MemoryInit, "memory.init") \
+    X(DataDrop, "data.drop") \
+    X(RefIsNull, "ref.is_null") \
+    X(TableGet, "table.get") \
+    X(TableSet, "table.set") \
+    X(TableSize, "table.size") \
+    X(TableGrow, "table.grow") \
+    X(TableFill, "table.fill") \
+    X(TableCopy, "table.copy") \
+    X(TableInit, "table.init") \
+    X(ElemDrop, "elem.drop")
+
+enum class RegOp : uint16_t {
+#define N(name, ...) name,
+    WASM_NUMERIC_OPS(N, N, N, N)
+    WASM_REGISTER_LOADS(N)
+    WASM_REGISTER_STORES(N)
+    WASM_REGISTER_COMPARE_BRANCHES(N)
+    WASM_REGISTER_OPS(N)
+#undef N
+    Count
+};
+
+// d, x and y are always frame slots; imm and aux are plain immediates
+struct RegInstr {
+    RegOp op = RegOp::Move;
+    uint32_t d = 0;       // result slot; call: first argument slot, which also receives the result
+    uint32_t x = 0;       // first operand slot (load / store: address)
+    uint32_t y = 0;       // second operand slot (store: value)
+    uint32_t imm = 0;     // branch target pc, memarg offset, return arity, or a function / symbol / segment / table index
+    uint32_t aux = 0;     // select: condition slot; call_indirect: table; table.copy / table.init: second index
+};
+
+struct JitContext;
+// Compiled body (see wasm_jit.hpp): runs the whole call on `frame`, already set up
+// as for the register executor, and leaves the result, if any, in frame[0]
+using JitEntry = void (*)(WasmSlot* frame, JitContext* ctx);
+
+// A loop header where a running stack-form activation can move into the register
+// form: the stack-form pc its back-edges resume at, the register pc of the same
+// point, and the frame slot holding each operand stack entry (those below the loop)
+struct RegOsrEntry {
+    uint32_t pc;
+    uint32_t regPc;
+    std::vector<uint32_t> stack;
+};
+
+struct RegFunction {
+    const FuncDef* def = nullptr;                    // null for imported functions
+    std::vector<RegInstr> code;
+    std::vector<WasmSlot> image;                     // initial locals, then constants
+    std::vector<std::vector<uint32_t>> brTables;     // br_table targets, default last
+    uint32_t paramCount = 0;
+    uint32_t frameSize = 0;                          // locals + constants + temporaries
+    bool hasResult = false;                          // the signature returns a value
+    JitEntry native = nullptr;                       // set by WasmJit::compile
+    std::vector<RegOsrEntry> osr;                    // one per reachable loop, by pc
+};
+
+// Stack-to-register translation, done once per module after parsing
+class WasmRegisterCompiler {
+public:
+    static const char* opName(RegOp op);
+    // Translate every defined function of `functions` (WasmModule::functions, calls by
+    // name already resolved) into `out`, indexed by function index. Returns
+    // false, with `reason`, when some function uses an instruction the register form
+    // does not cover; the module must then run on the stack executor as a whole.
+    static bool compile(const std::vector<const FuncDef*>& functions,
+                        const WasmInstance& instance,
+                        const WasmDecoder& decoder,
+                        std::vector<RegFunction>& out,
+                        std::string& reason);
+    // Translate one defined function into `out`; on failure `out` is left holding
+    // only its FuncDef and `reason` says why
+    static bool compileFunction(const FuncDef& func,
+                                const std::vector<const FuncDef*>& functions,
+                                const WasmInstance& instance,
+                                const WasmDecoder& decoder,
+                                RegFunction& out,
+                                std::string& reason);
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <csetjmp>
+#include <exception>
+#include "struct.h"
+#include "wasm_register.hpp"
+#include "wasm_jit.hpp"
+#include "wasm_executor.hpp"
+#include "wasm_instance.hpp"
+
+class WasmTiering;
+
+// Runs the register form of a module (see wasm_register.hpp). The frames of all
+// active calls sit back to back in one slot array; a call copies the callee's
+// initial locals and constants into place, then its arguments over the params.
+// Functions with a compiled body (RegFunction::native) run to completion in
+// machine code on the same frames; they never call back into the interpreter.
+// Under tiered execution (see WasmTiering) it also runs nested inside the stack
+// executor, and calls to functions not translated yet go back through the tiering.
+class WasmRegisterExecutor {
+public:
+    WasmRegisterExecutor();
+
+    void execute(const RegFunction& entry,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance);
+
+    void setMaxCallDepth(size_t depth) { maxCallDepth = depth; }
+    // Largest frame among compiled functions (WasmJit::maxFrameSize); 0 when none are
+    void setNativeFrameSize(uint32_t frameSize) { nativeFrameSize = frameSize; }
+    void setTiering(WasmTiering* t) { tiering = t; }
+
+    // Entries from the stack tier (see WasmTiering), on top of `depth` calls active
+    // there. invoke() calls `func` with the arguments at `args`; replace() continues
+    // a running activation of it at a loop header, given all its locals and the
+    // operands below the loop. Both return the function's result.
+    WasmSlot invoke(const RegFunction& func, const WasmSlot* args, size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance);
+    WasmSlot replace(const RegFunction& func, const RegOsrEntry& entry,
+    const WasmSlot* locals, const WasmSlot* operands, size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance);
+
+    // Drop frames a trap left behind, before the other tier starts an outermost call
+    void reset() { frames.clear(); slotsTop = 0; }
+
+private:
+    // Set up a frame for `func` at slotsTop holding `localCount` locals, then run it from `pc`
+    WasmSlot enter(const RegFunction& func, uint32_t pc,
+    const WasmSlot* locals, size_t localCount,
+    const std::vector<uint32_t>& operandSlots, const WasmSlot* operands,
+    size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance);
+
+    // Run `entry`, whose frame is set up at slot `base`, from `pc` until it returns
+    WasmSlot run(const RegFunction& entry, size_t base, uint32_t pc, size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance);
+
+    // Activation record of a suspended caller
+    struct Frame {
+        const RegFunction* func;
+        const RegInstr* ip;   // the call being made
+        size_t base;          // first slot of the caller's frame
+    };
+
+    // Run a compiled callee whose frame starts at slot `base`, `depth` calls deep
+    void runNative(const RegFunction& callee, size_t base, size_t depth);
+
+    std::vector<WasmSlot> slots;
+    std::vector<Frame> frames;
+    size_t slotsTop = 0;          // first slot free for a frame entered from the other tier
+    WasmTiering* tiering = nullptr;
+    size_t maxCallDepth = WasmExecutor::DEFAULT_MAX_CALL_DEPTH;
+
+    // Compiled code cannot move the slot array, so it is sized for the deepest chain
+    // of compiled frames up front (capped at MAX_NATIVE_SLOTS beyond the entry)
+    static constexpr size_t MAX_NATIVE_SLOTS = size_t(1) << 22;
+    uint32_t nativeFrameSize = 0;
+    JitContext jit;
+    sigjmp_buf jitEnv;
+    std::exception_ptr jitError;
+};
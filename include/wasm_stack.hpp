@@ -5,7 +5,10 @@
 #include <cstdint>
 #include <string>
 #include "struct.h"
+#include "wasm_trace.hpp"
 
+// Operand stack of untagged slots, with the type of each kept alongside by the
+// checked operations (they test it, and the traces print it)
 class WasmStack {
 public:
     void clear();
@@ -16,14 +19,46 @@ public:
 
     WasmValue top();
 
+    // For code that WasmValidator accepted, run untraced: it never pops an empty
+    // stack, reserve() has made room for every push, and nothing reads the types
+    void pushUnchecked(WasmSlot val) { data[height++] = val; }
+    WasmSlot popUnchecked() { return data[--height]; }
+    WasmSlot topUnchecked() const { return data[height - 1]; }
+
     void dump();
 
     bool empty() const {
-        return data.empty();
+        return height == 0;
+    }
+
+    size_t size() const {
+        return height;
+    }
+
+    // Room for `n` values in all
+    void reserve(size_t n) {
+        if (data.size() < n) {
+            data.resize(n);
+            types.resize(n);
+        }
     }
 
+    // Slot at absolute position `i` (0 = bottom); arguments are read in place from here
+    const WasmSlot& at(size_t i) const {
+        return data[i];
+    }
+    WasmValue value(size_t i) const {
+        return WasmValue(types[i], data[i]);
+    }
+
+    // Drop everything above `height` except the top `keep` values.
+    void unwind(size_t height, size_t keep);
+
 private:
-    std::vector<WasmValue> data;
+    std::vector<WasmSlot> data;     // storage; values above `height` are dead
+    std::vector<ValueType> types;   // by slot; not kept by the unchecked operations
+    size_t height = 0;
 
+    static void trace(const char* what, const WasmValue& v);
     static void printTop(const WasmValue& v, bool newline = true);
 };
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "struct.h"
+
+// A table of references. Every mutation moves it to a fresh epoch, which is what
+// call_indirect inline caches compare against to know their entry is still valid.
+class WasmTable {
+public:
+    explicit WasmTable(uint32_t initial = 0, uint32_t max = UINT32_MAX);
+
+    uint32_t size() const { return static_cast<uint32_t>(elements.size()); }
+    uint32_t maximum() const { return max; }
+    uint64_t epoch() const { return epochValue; }
+    // Callers check bounds against size()
+    int32_t get(uint32_t index) const { return elements[index]; }
+    void set(uint32_t index, int32_t ref);
+
+    // Return false (and change nothing) when the range is out of bounds
+    bool fill(uint32_t dst, int32_t ref, uint32_t len);
+    bool copy(uint32_t dst, const WasmTable& src, uint32_t srcIndex, uint32_t len);
+    bool init(uint32_t dst, const std::vector<int32_t>& refs, uint32_t srcIndex, uint32_t len);
+    // Old size, or -1 past the maximum
+    int32_t grow(uint32_t delta, int32_t ref);
+
+private:
+    std::vector<int32_t> elements;
+    uint32_t max;
+    uint64_t epochValue = 0;
+
+    void touch();
+};
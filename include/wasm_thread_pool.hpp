@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Work-stealing pool for batch runs. Tasks are dealt round-robin to one deque per
+// worker; a worker takes its own newest task first and, once its deque is empty,
+// steals the oldest task of another worker. Workers live for one run().
+class WasmThreadPool {
+public:
+    // Gets the index of the worker running it, for per-worker state
+    using Task = std::function<void(size_t worker)>;
+
+    explicit WasmThreadPool(size_t workers);
+
+    size_t size() const { return workers; }
+
+    // Run every task and wait for all of them. With one worker they run in order on
+    // the calling thread. The first exception a task throws is rethrown here once
+    // the others have finished.
+    void run(std::vector<Task> tasks);
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    size_t workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    bool take(size_t worker, Task& task);
+    bool steal(size_t worker, Task& task);
+};
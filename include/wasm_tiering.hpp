@@ -0,0 +1,111 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "struct.h"
+#include "wasm_register.hpp"
+#include "wasm_instance.hpp"
+
+class WasmExecutor;
+class WasmRegisterExecutor;
+class WasmModule;
+
+// Tiered execution. Every function starts on the stack executor (the baseline tier,
+// with fused instructions when the build has them) and is translated to the
+// register form (the optimized tier) once it is hot: after `callThreshold` calls,
+// or `loopThreshold` loop back-edges, whichever comes first. A function made hot by
+// its loops moves over at the next back-edge of the activation that is running it
+// (on-stack replacement at the loop header); later calls start in the optimized
+// tier. Functions the register form does not cover stay in the baseline tier.
+// The executors count through the hooks below and call across tiers through them,
+// so each executor only ever runs code of its own form. A call across tiers is a
+// native call, so once MAX_NESTING of them are active the baseline tier stops
+// handing calls and loops over and runs promoted functions itself.
+class WasmTiering {
+public:
+    static constexpr size_t MAX_NESTING = 256;
+
+    struct Options {
+        uint32_t callThreshold = 200;
+        uint32_t loopThreshold = 2000;
+        bool stats = false;       // also time each tier, for report()
+    };
+
+    WasmTiering(WasmExecutor& baseline, WasmRegisterExecutor& optimized);
+
+    void setOptions(const Options& o) { options = o; }
+    const Options& getOptions() const { return options; }
+
+    // Take a loaded module; every function starts in the baseline tier
+    void attach(const WasmModule& module, WasmInstance& instance);
+
+    // Run `entry` as an outermost call, in whichever tier it is in by now
+    void execute(const FuncDef& entry);
+
+    // Promotion counts, and time per tier when Options::stats is set
+    void report(std::ostream& out) const;
+
+    // Count a call of `callee`; true once it runs in the optimized tier
+    bool hotCall(const FuncDef& callee);
+    // Whether the baseline tier may call into the optimized tier now
+    bool canNest() const { return nesting < MAX_NESTING; }
+    // Count a back-edge of `func` to the loop resumed at stack-form `pc`; returns the
+    // entry to move the running activation over with, or null to stay
+    const RegOsrEntry* hotLoop(const FuncDef& func, size_t pc);
+
+    // Calls across tiers, on top of `depth` active calls. The callee reads its
+    // arguments from `args`; the return value says whether `result` was set.
+    bool callOptimized(const FuncDef& callee, const WasmSlot* args, size_t depth, WasmSlot& result);
+    bool callBaseline(const FuncDef& callee, const WasmSlot* args, size_t depth, WasmSlot& result);
+    // Finish a running activation of `func` in the optimized tier from `entry`, given
+    // its locals and the operands below the loop
+    bool replace(const FuncDef& func, const RegOsrEntry& entry, const WasmSlot* locals,
+                 const WasmSlot* operands, size_t depth, WasmSlot& result);
+
+private:
+    enum class Tier { Baseline, Optimized, Count };
+    enum class State : uint8_t { Baseline, Optimized, Failed };
+
+    struct Counters {
+        uint32_t calls = 0;
+        uint32_t backEdges = 0;
+        State state = State::Baseline;
+    };
+
+    // Attribute the time since the last switch to the running tier, then run `tier`;
+    // counts the nesting of calls across tiers
+    class TierScope {
+    public:
+        TierScope(WasmTiering& t, Tier tier);
+        ~TierScope();
+    private:
+        WasmTiering& tiering;
+        Tier previous;
+    };
+    void switchTo(Tier tier);
+
+    bool promote(const FuncDef& func, bool byLoop);
+
+    WasmExecutor& baseline;
+    WasmRegisterExecutor& optimized;
+    Options options;
+
+    const WasmModule* module = nullptr;
+    WasmInstance* instance = nullptr;
+    std::vector<RegFunction> functions;   // by function index; code is empty until promoted
+    std::vector<Counters> counters;
+
+    size_t promotedByCalls = 0;
+    size_t promotedByLoops = 0;
+    size_t failures = 0;
+    size_t replacements = 0;
+    using Clock = std::chrono::steady_clock;
+    Tier running = Tier::Baseline;
+    size_t nesting = 0;                   // open TierScopes
+    size_t scopes = 0;                    // open TierScopes while timing; time outside them is not counted
+    Clock::time_point since;
+    Clock::duration timeIn[static_cast<size_t>(Tier::Count)] = {};
+    Clock::duration translating{};
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Tracing is compiled in when WASM_TRACE_ENABLED is 1 (CMake option WASM_TRACE).
+// Without it every WASM_TRACE(...) site folds to `if (false)` and disappears.
+#ifndef WASM_TRACE_ENABLED
+#define WASM_TRACE_ENABLED 0
+#endif
+
+enum class TraceCategory : uint8_t {
+    Parser,
+    Stack,
+    Exec,
+    Memory,
+    Count
+};
+
+enum class TraceLevel : uint8_t {
+    Off = 0,
+    Info = 1,    // one line per function / module-level event
+    Debug = 2    // one line per instruction, stack operation or memory access
+};
+
+class WasmTrace {
+public:
+    // Parse a "--trace=" spec: comma separated categories, each optionally
+    // followed by ":info" or ":debug" (default debug); "all" selects every category.
+    static bool configure(const std::string& spec);
+
+    static bool enabled(TraceCategory cat, TraceLevel level) {
+        return levels[static_cast<size_t>(cat)] >= level;
+    }
+
+    // Whether any category was turned on
+    static bool any() {
+        for (TraceLevel l : levels) if (l != TraceLevel::Off) return true;
+        return false;
+    }
+
+private:
+    static inline TraceLevel levels[static_cast<size_t>(TraceCategory::Count)] = {};
+};
+
+#if WASM_TRACE_ENABLED
+#define WASM_TRACE_ON(cat, level) (WasmTrace::enabled(TraceCategory::cat, TraceLevel::level))
+#else
+#define WASM_TRACE_ON(cat, level) false
+#endif
+
+// WASM_TRACE(Stack, Debug, "push " << value << "\n");
+#define WASM_TRACE(cat, level, msg) \
+    do { if (WASM_TRACE_ON(cat, level)) std::cout << msg; } while (0)
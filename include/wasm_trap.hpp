@@ -0,0 +1,8 @@
+#pragma once
+#include <stdexcept>
+
+// Raised when guest execution cannot continue (e.g. call stack exhausted)
+class WasmTrap : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include "struct.h"
+#include "wasm_instance.hpp"
+
+class WasmModule;
+
+// Load-time validation of function bodies. The type of every operand stack entry is
+// followed through each function: instruction operands, block and branch results,
+// call signatures, locals and globals are checked against it. A function that passes
+// gets FuncDef::maxStack, the most operands it ever has on the stack. A module whose
+// functions all pass runs on the stack executor without underflow or type checks
+// (WasmExecutor::setValidated); one that does not runs checked, or is rejected when
+// validation is strict.
+class WasmValidator {
+public:
+    // Check every function of `module` (parsed into `instance`) and record the outcome
+    // in the module and its functions
+    static void validate(WasmModule& module, const WasmInstance& instance);
+
+    // One function; false with `reason` when it is invalid
+    static bool validateFunction(FuncDef& func, const WasmModule& module, const WasmInstance& instance,
+                                 std::string& reason);
+};
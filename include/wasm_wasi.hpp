@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+class WasmHost;
+
+// Guest stdout/stderr of one instance. Unbuffered (the default), each fd_write is
+// one writev straight from linear memory. With a buffer, writes that fit are
+// gathered and go out when it fills, on flush() and on destruction.
+class WasiOutput {
+public:
+    WasiOutput() = default;
+    ~WasiOutput();
+    WasiOutput(WasiOutput&&) = default;
+    WasiOutput& operator=(WasiOutput&&) = default;
+
+    static constexpr int MAX_IOV = 64;   // iovecs passed per write()
+
+    void setBufferSize(size_t bytes);
+    size_t bufferSize() const { return capacity; }
+    // Send guest stdout to `out` and stderr to `err` instead of the process's, for
+    // runs whose output is merged later (null: write through again)
+    void capture(std::ostream* out, std::ostream* err);
+
+    // fd is 1 or 2, count at most MAX_IOV. Bytes written, or -1 with errno set
+    ssize_t write(int fd, const struct iovec* iov, int count);
+    void flush();
+
+private:
+    size_t capacity = 0;
+    std::vector<char> pending[2];   // fd 1, fd 2
+    std::ostream* captured[2] = {};
+
+    static ssize_t writeAll(int fd, struct iovec* iov, int count);
+};
+
+// Raised by proc_exit; ends the run with `code` instead of being reported as a trap
+class WasiExit : public std::runtime_error {
+public:
+    explicit WasiExit(int32_t code)
+        : std::runtime_error("proc_exit(" + std::to_string(code) + ")"), code(code) {}
+    int32_t code;
+};
+
+// wasi_snapshot_preview1 subset: fd_write to stdout/stderr, proc_exit, and empty
+// argument/environment lists
+class WasmWasi {
+public:
+    static void install(WasmHost& host);
+};
@@ -1,42 +1,104 @@
 #include "wasm_interpreter.hpp"
+#include "wasm_batch.hpp"
+#include "wasm_trace.hpp"
 #include <iostream>
-#include <climits>
 #include <algorithm>
+#include <cstdlib>
+#include <thread>
 #include <vector>
 #include <string>
 #include "struct.h"
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: wasm_interpreter <file.wat>\n";
+    std::vector<std::string> files;
+    size_t jobs = 1;
+    bool batch = false;
+    std::string cacheDirectory;
+    bool strictValidation = false;
+    size_t maxCallDepth = WasmExecutor::DEFAULT_MAX_CALL_DEPTH;
+    bool persist = false;
+    size_t outputBuffer = 0;
+    ExecutionEngine engine = ExecutionEngine::Stack;
+    WasmTiering::Options tiering;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--trace=", 0) == 0) {
+            if (!WasmTrace::configure(arg.substr(8))) return 1;
+        } else if (arg == "--persist") {
+            persist = true;
+        } else if (arg.rfind("--output-buffer=", 0) == 0) {
+            outputBuffer = std::strtoul(arg.c_str() + 16, nullptr, 10);
+        } else if (arg == "--engine=stack") {
+            engine = ExecutionEngine::Stack;
+        } else if (arg == "--engine=register") {
+            engine = ExecutionEngine::Register;
+        } else if (arg == "--engine=jit") {
+            engine = ExecutionEngine::Jit;
+        } else if (arg == "--engine=tiered") {
+            engine = ExecutionEngine::Tiered;
+        } else if (arg.rfind("--tier-calls=", 0) == 0) {
+            tiering.callThreshold = static_cast<uint32_t>(std::strtoul(arg.c_str() + 13, nullptr, 10));
+        } else if (arg.rfind("--tier-loops=", 0) == 0) {
+            tiering.loopThreshold = static_cast<uint32_t>(std::strtoul(arg.c_str() + 13, nullptr, 10));
+        } else if (arg == "--tier-stats") {
+            tiering.stats = true;
+        } else if (arg.rfind("--max-call-depth=", 0) == 0) {
+            maxCallDepth = std::strtoul(arg.c_str() + 17, nullptr, 10);
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            cacheDirectory = arg.substr(12);
+        } else if (arg == "--validate") {
+            strictValidation = true;
+        } else if (arg.rfind("--jobs=", 0) == 0 || (arg == "--jobs" && i + 1 < argc)) {
+            const char* value = arg == "--jobs" ? argv[++i] : arg.c_str() + 7;
+            jobs = std::strtoul(value, nullptr, 10);
+            if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+            batch = true;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: wasm_interpreter [--trace=<category[:info|debug]>,...] [--max-call-depth=N] [--output-buffer=BYTES] [--engine=stack|register|jit|tiered] [--tier-calls=N] [--tier-loops=N] [--tier-stats] [--persist] [--jobs=N] [--cache-dir=DIR] [--validate] <file.wat|file.wasm>...\n"
+                  << "       categories: parser, stack, exec, memory, all\n"
+                  << "       --jobs: run the exports of every file on N threads (0: one per core)\n"
+                  << "       --cache-dir: keep decoded modules in DIR and reuse them while the file is unchanged\n"
+                  << "       --validate: refuse to run a module that fails load-time validation\n";
         return 1;
     }
 
-    std::string filename = argv[1];
+    if (batch || files.size() > 1) {
+        WasmBatch::Options options;
+        options.jobs = jobs;
+        options.engine = engine;
+        options.tiering = tiering;
+        options.maxCallDepth = maxCallDepth;
+        options.outputBuffer = outputBuffer;
+        options.persist = persist;
+        options.cacheDirectory = cacheDirectory;
+        options.strictValidation = strictValidation;
+        return WasmBatch(options).run(files);
+    }
+
     try {
         WasmInterpreter interpreter;
-        interpreter.loadFile(filename);
+        interpreter.setMaxCallDepth(maxCallDepth);
+        interpreter.setOutputBuffer(outputBuffer);
+        interpreter.setEngine(engine);
+        interpreter.setTiering(tiering);
+        interpreter.setCacheDirectory(cacheDirectory);
+        interpreter.setStrictValidation(strictValidation);
+        // Exports run as independent tests unless --persist keeps state between them
+        interpreter.setIsolatedCalls(!persist);
+        interpreter.loadFile(files[0]);
         interpreter.parse();
-        std::vector<std::pair<std::string, WasmExport>> funcExports;
-
-        for (const auto& [exportName, exp] : interpreter.getExports()) {
-            if (exp.kind == "func") {
-                funcExports.emplace_back(exportName, exp);
-            }
-        }
-
-        std::sort(funcExports.begin(), funcExports.end(),
-            [](const auto& a, const auto& b) {
-                int indexA = (a.second.index >= 0 ? a.second.index : INT_MIN);
-                int indexB = (b.second.index >= 0 ? b.second.index : INT_MIN);
-                return indexA < indexB;
-            });
 
-        for (const auto& [exportName, exp] : funcExports) {
-            std::cout << "\033[1;36m[sort]\033[0m calling " 
-                    << exportName << " (index=" << exp.index << ")\n";
+        for (const auto& [exportName, exp] : interpreter.getFunctionExports()) {
+            WASM_TRACE(Exec, Info, "\033[1;36m[interpreter:main]\033[0m calling "
+                    << exportName << " (index=" << exp.index << ")\n");
             interpreter.callFunctionByExportName(exportName);
         }
+    } catch (const WasiExit& e) {
+        return e.code;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
         return 1;
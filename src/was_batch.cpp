@@ -0,0 +1,115 @@
+#include "wasm_batch.hpp"
+#include "wasm_interpreter.hpp"
+#include "wasm_thread_pool.hpp"
+#include "wasm_trace.hpp"
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+// What one run printed, and how it ended
+struct Record {
+    std::ostringstream out;
+    std::ostringstream err;   // guest stderr, errors and diagnostics, in order
+    int status = 0;
+    bool ended = false;       // by proc_exit or an error: later exports do not run
+};
+
+struct Run {
+    size_t file;
+    std::vector<std::string> exports;
+    Record record;
+};
+
+} // namespace
+
+int WasmBatch::run(const std::vector<std::string>& files) {
+    WasmThreadPool pool(WasmTrace::any() ? 1 : options.jobs);
+
+    auto configure = [this](WasmInterpreter& interpreter) {
+        interpreter.setMaxCallDepth(options.maxCallDepth);
+        interpreter.setOutputBuffer(options.outputBuffer);
+        interpreter.setEngine(options.engine);
+        interpreter.setTiering(options.tiering);
+        interpreter.setCacheDirectory(options.cacheDirectory);
+        interpreter.setStrictValidation(options.strictValidation);
+    };
+    // Calls `body` with guest output and errors going to `record`; ends the way the
+    // command line does for a single file
+    auto capture = [](WasmInterpreter& interpreter, Record& record, auto&& body) {
+        interpreter.setErrorStream(record.err);
+        interpreter.getInstance().stdio.capture(&record.out, &record.err);
+        try {
+            body();
+        } catch (const WasiExit& e) {
+            record.status = e.code;
+            record.ended = true;
+        } catch (const std::exception& e) {
+            record.err << "Error: " << e.what() << "\n";
+            record.status = 1;
+            record.ended = true;
+        }
+        interpreter.getInstance().stdio.capture(nullptr, nullptr);
+        interpreter.setErrorStream(std::cerr);
+    };
+
+    // Parse every module, running its start function once
+    std::vector<std::shared_ptr<const WasmModule>> modules(files.size());
+    std::vector<Record> loads(files.size());
+    std::vector<WasmThreadPool::Task> tasks;
+    for (size_t i = 0; i < files.size(); ++i) {
+        tasks.push_back([&, i](size_t) {
+            WasmInterpreter interpreter;
+            configure(interpreter);
+            capture(interpreter, loads[i], [&] {
+                interpreter.loadFile(files[i]);
+                interpreter.parse();
+                modules[i] = interpreter.shareModule();
+            });
+        });
+    }
+    pool.run(std::move(tasks));
+
+    std::vector<Run> runs;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (loads[i].ended || !modules[i]) continue;
+        for (const auto& [exportName, exp] : modules[i]->functionExports()) {
+            if (runs.empty() || runs.back().file != i || !options.persist) runs.push_back({i, {}, {}});
+            runs.back().exports.push_back(exportName);
+        }
+    }
+
+    // Interpreters are reused across runs on the same worker; each run instantiates
+    std::vector<std::unique_ptr<WasmInterpreter>> interpreters(pool.size());
+    tasks.clear();
+    for (Run& run : runs) {
+        tasks.push_back([&](size_t worker) {
+            if (!interpreters[worker]) {
+                interpreters[worker] = std::make_unique<WasmInterpreter>();
+                configure(*interpreters[worker]);
+            }
+            WasmInterpreter& interpreter = *interpreters[worker];
+            capture(interpreter, run.record, [&] {
+                interpreter.instantiate(modules[run.file]);
+                for (const std::string& exportName : run.exports) interpreter.callFunctionByExportName(exportName);
+            });
+        });
+    }
+    pool.run(std::move(tasks));
+
+    int status = 0;
+    auto emit = [&status](const Record& record) {
+        std::cout << record.out.str() << std::flush;
+        std::cerr << record.err.str() << std::flush;
+        if (status == 0) status = record.status;
+        return record.ended;
+    };
+    size_t next = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        bool ended = emit(loads[i]);
+        for (; next < runs.size() && runs[next].file == i; ++next)
+            if (!ended) ended = emit(runs[next].record);
+    }
+    return status;
+}
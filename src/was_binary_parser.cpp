@@ -0,0 +1,648 @@
+#include "wasm_binary_parser.hpp"
+#include "wasm_mapped_file.hpp"
+#include "wasm_trace.hpp"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+
+// Binary opcode -> text mnemonic; the mnemonic selects the Opcode the executor knows
+struct BinaryOp {
+    uint8_t code;
+    const char* name;
+};
+
+const BinaryOp kBinaryOps[] = {
+    {0x00, "unreachable"}, {0x01, "nop"}, {0x02, "block"}, {0x03, "loop"}, {0x04, "if"},
+    {0x05, "else"}, {0x0B, "end"}, {0x0C, "br"}, {0x0D, "br_if"}, {0x0E, "br_table"},
+    {0x0F, "return"}, {0x10, "call"}, {0x11, "call_indirect"}, {0x1A, "drop"}, {0x1B, "select"},
+    {0x1C, "select"},
+    {0x20, "local.get"}, {0x21, "local.set"}, {0x22, "local.tee"}, {0x23, "global.get"}, {0x24, "global.set"},
+    {0x25, "table.get"}, {0x26, "table.set"},
+    {0x28, "i32.load"}, {0x29, "i64.load"}, {0x2A, "f32.load"}, {0x2B, "f64.load"},
+    {0x2C, "i32.load8_s"}, {0x2D, "i32.load8_u"}, {0x2E, "i32.load16_s"}, {0x2F, "i32.load16_u"},
+    {0x30, "i64.load8_s"}, {0x31, "i64.load8_u"}, {0x32, "i64.load16_s"}, {0x33, "i64.load16_u"},
+    {0x34, "i64.load32_s"}, {0x35, "i64.load32_u"},
+    {0x36, "i32.store"}, {0x37, "i64.store"}, {0x38, "f32.store"}, {0x39, "f64.store"},
+    {0x3A, "i32.store8"}, {0x3B, "i32.store16"}, {0x3C, "i64.store8"}, {0x3D, "i64.store16"}, {0x3E, "i64.store32"},
+    {0x3F, "memory.size"}, {0x40, "memory.grow"},
+    {0x41, "i32.const"}, {0x42, "i64.const"}, {0x43, "f32.const"}, {0x44, "f64.const"},
+    {0x45, "i32.eqz"}, {0x46, "i32.eq"}, {0x47, "i32.ne"}, {0x48, "i32.lt_s"}, {0x49, "i32.lt_u"},
+    {0x4A, "i32.gt_s"}, {0x4B, "i32.gt_u"}, {0x4C, "i32.le_s"}, {0x4D, "i32.le_u"}, {0x4E, "i32.ge_s"}, {0x4F, "i32.ge_u"},
+    {0x50, "i64.eqz"}, {0x51, "i64.eq"}, {0x52, "i64.ne"}, {0x53, "i64.lt_s"}, {0x54, "i64.lt_u"},
+    {0x55, "i64.gt_s"}, {0x56, "i64.gt_u"}, {0x57, "i64.le_s"}, {0x58, "i64.le_u"}, {0x59, "i64.ge_s"}, {0x5A, "i64.ge_u"},
+    {0x5B, "f32.eq"}, {0x5C, "f32.ne"}, {0x5D, "f32.lt"}, {0x5E, "f32.gt"}, {0x5F, "f32.le"}, {0x60, "f32.ge"},
+    {0x61, "f64.eq"}, {0x62, "f64.ne"}, {0x63, "f64.lt"}, {0x64, "f64.gt"}, {0x65, "f64.le"}, {0x66, "f64.ge"},
+    {0x67, "i32.clz"}, {0x68, "i32.ctz"}, {0x69, "i32.popcnt"}, {0x6A, "i32.add"}, {0x6B, "i32.sub"},
+    {0x6C, "i32.mul"}, {0x6D, "i32.div_s"}, {0x6E, "i32.div_u"}, {0x6F, "i32.rem_s"}, {0x70, "i32.rem_u"},
+    {0x71, "i32.and"}, {0x72, "i32.or"}, {0x73, "i32.xor"}, {0x74, "i32.shl"}, {0x75, "i32.shr_s"},
+    {0x76, "i32.shr_u"}, {0x77, "i32.rotl"}, {0x78, "i32.rotr"},
+    {0x79, "i64.clz"}, {0x7A, "i64.ctz"}, {0x7B, "i64.popcnt"}, {0x7C, "i64.add"}, {0x7D, "i64.sub"},
+    {0x7E, "i64.mul"}, {0x7F, "i64.div_s"}, {0x80, "i64.div_u"}, {0x81, "i64.rem_s"}, {0x82, "i64.rem_u"},
+    {0x83, "i64.and"}, {0x84, "i64.or"}, {0x85, "i64.xor"}, {0x86, "i64.shl"}, {0x87, "i64.shr_s"},
+    {0x88, "i64.shr_u"}, {0x89, "i64.rotl"}, {0x8A, "i64.rotr"},
+    {0x8B, "f32.abs"}, {0x8C, "f32.neg"}, {0x8D, "f32.ceil"}, {0x8E, "f32.floor"}, {0x8F, "f32.trunc"},
+    {0x90, "f32.nearest"}, {0x91, "f32.sqrt"}, {0x92, "f32.add"}, {0x93, "f32.sub"}, {0x94, "f32.mul"},
+    {0x95, "f32.div"}, {0x96, "f32.min"}, {0x97, "f32.max"}, {0x98, "f32.copysign"},
+    {0x99, "f64.abs"}, {0x9A, "f64.neg"}, {0x9B, "f64.ceil"}, {0x9C, "f64.floor"}, {0x9D, "f64.trunc"},
+    {0x9E, "f64.nearest"}, {0x9F, "f64.sqrt"}, {0xA0, "f64.add"}, {0xA1, "f64.sub"}, {0xA2, "f64.mul"},
+    {0xA3, "f64.div"}, {0xA4, "f64.min"}, {0xA5, "f64.max"}, {0xA6, "f64.copysign"},
+    {0xA7, "i32.wrap_i64"}, {0xA8, "i32.trunc_f32_s"}, {0xA9, "i32.trunc_f32_u"}, {0xAA, "i32.trunc_f64_s"},
+    {0xAB, "i32.trunc_f64_u"}, {0xAC, "i64.extend_i32_s"}, {0xAD, "i64.extend_i32_u"},
+    {0xAE, "i64.trunc_f32_s"}, {0xAF, "i64.trunc_f32_u"}, {0xB0, "i64.trunc_f64_s"}, {0xB1, "i64.trunc_f64_u"},
+    {0xB2, "f32.convert_i32_s"}, {0xB3, "f32.convert_i32_u"}, {0xB4, "f32.convert_i64_s"}, {0xB5, "f32.convert_i64_u"},
+    {0xB6, "f32.demote_f64"}, {0xB7, "f64.convert_i32_s"}, {0xB8, "f64.convert_i32_u"},
+    {0xB9, "f64.convert_i64_s"}, {0xBA, "f64.convert_i64_u"}, {0xBB, "f64.promote_f32"},
+    {0xBC, "i32.reinterpret_f32"}, {0xBD, "i64.reinterpret_f64"}, {0xBE, "f32.reinterpret_i32"}, {0xBF, "f64.reinterpret_i64"},
+    {0xC0, "i32.extend8_s"}, {0xC1, "i32.extend16_s"}, {0xC2, "i64.extend8_s"}, {0xC3, "i64.extend16_s"},
+    {0xC4, "i64.extend32_s"},
+    {0xD0, "ref.null"}, {0xD1, "ref.is_null"}, {0xD2, "ref.func"},
+};
+
+// 0xFC prefix, indexed by the sub-opcode
+const char* const kPrefixedOps[] = {
+    "i32.trunc_sat_f32_s", "i32.trunc_sat_f32_u", "i32.trunc_sat_f64_s", "i32.trunc_sat_f64_u",
+    "i64.trunc_sat_f32_s", "i64.trunc_sat_f32_u", "i64.trunc_sat_f64_s", "i64.trunc_sat_f64_u",
+    "memory.init", "data.drop", "memory.copy", "memory.fill",
+    "table.init", "elem.drop", "table.copy", "table.grow", "table.size", "table.fill",
+};
+
+const char* binaryOpName(uint8_t code) {
+    static const char* table[256] = {};
+    static bool init = [] {
+        for (const BinaryOp& op : kBinaryOps) table[op.code] = op.name;
+        return true;
+    }();
+    (void)init;
+    return table[code];
+}
+
+const char* valueTypeName(uint8_t t) {
+    switch (t) {
+        case 0x7F: return "i32";
+        case 0x7E: return "i64";
+        case 0x7D: return "f32";
+        case 0x7C: return "f64";
+        default:   return nullptr;
+    }
+}
+
+WasmValue zeroValue(uint8_t t) {
+    switch (t) {
+        case 0x70: case 0x6F: return WasmValue(NULL_REF);
+        case 0x7E: return WasmValue(int64_t(0));
+        case 0x7D: return WasmValue(float(0));
+        case 0x7C: return WasmValue(double(0));
+        default:   return WasmValue(int32_t(0));
+    }
+}
+
+WasmValue zeroValue(const std::string& t) {
+    if (t == "i64") return WasmValue(int64_t(0));
+    if (t == "f32") return WasmValue(float(0));
+    if (t == "f64") return WasmValue(double(0));
+    return WasmValue(int32_t(0));
+}
+
+std::string globalName(uint32_t index) {
+    return "global_" + std::to_string(index);
+}
+
+} // namespace
+
+// Bounds-checked cursor over the module bytes
+class WasmBinaryParser::Reader {
+public:
+    Reader(const uint8_t* begin, const uint8_t* end) : p(begin), end(end) {}
+
+    bool atEnd() const { return p >= end; }
+
+    uint8_t byte() {
+        need(1);
+        return *p++;
+    }
+
+    uint8_t peek() {
+        need(1);
+        return *p;
+    }
+
+    const uint8_t* bytes(size_t n) {
+        need(n);
+        const uint8_t* s = p;
+        p += n;
+        return s;
+    }
+
+    uint32_t u32() {
+        uint32_t result = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = byte();
+            result |= static_cast<uint32_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return result;
+        }
+        throw std::runtime_error("\033[1;31m[binary:leb128]\033[0m u32 too long");
+    }
+
+    int32_t s32() { return static_cast<int32_t>(sleb(32)); }
+    int64_t s64() { return sleb(64); }
+
+    float f32() {
+        float v;
+        std::memcpy(&v, bytes(4), 4);
+        return v;
+    }
+
+    double f64() {
+        double v;
+        std::memcpy(&v, bytes(8), 8);
+        return v;
+    }
+
+    std::string name() {
+        uint32_t len = u32();
+        const uint8_t* s = bytes(len);
+        return std::string(reinterpret_cast<const char*>(s), len);
+    }
+
+    void skip(size_t n) { bytes(n); }
+
+    // Limits: flags, min [, max]
+    uint32_t limits(uint32_t* max = nullptr) {
+        uint8_t flags = byte();
+        uint32_t min = u32();
+        uint32_t upper = (flags & 0x01) ? u32() : UINT32_MAX;
+        if (max) *max = upper;
+        return min;
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+
+    void need(size_t n) {
+        if (static_cast<size_t>(end - p) < n)
+            throw std::runtime_error("\033[1;31m[binary:read]\033[0m unexpected end of section");
+    }
+
+    int64_t sleb(int bits) {
+        int64_t result = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            if (shift >= bits + 7)
+                throw std::runtime_error("\033[1;31m[binary:leb128]\033[0m signed LEB128 too long");
+            b = byte();
+            result |= static_cast<int64_t>(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        if (shift < 64 && (b & 0x40))
+            result |= -(static_cast<int64_t>(1) << shift);
+        return result;
+    }
+};
+
+bool WasmBinaryParser::isBinaryFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {};
+    return file.read(magic, 4) && std::memcmp(magic, "\0asm", 4) == 0;
+}
+
+void WasmBinaryParser::parseFile(const std::string& path,
+                                 std::unordered_map<int, FuncType>& funcTypes,
+                                 std::unordered_map<int, FuncDef>& functionsByID,
+                                 std::unordered_map<std::string, WasmExport>& exports,
+                                 WasmInstance& instance,
+                                 WasmDecoder& decoder) {
+    WasmMappedFile file(path);
+    WASM_TRACE(Parser, Info, "\033[1;32m[binary:parseFile]\033[0m Mapped " << path
+              << " (" << file.size << " bytes)\n");
+    parse(file.data, file.size, funcTypes, functionsByID, exports, instance, decoder);
+}
+
+void WasmBinaryParser::parse(const uint8_t* data, size_t size,
+                             std::unordered_map<int, FuncType>& funcTypes,
+                             std::unordered_map<int, FuncDef>& functionsByID,
+                             std::unordered_map<std::string, WasmExport>& exports,
+                             WasmInstance& instance,
+                             WasmDecoder& decoder) {
+    static const uint8_t header[8] = {0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00};
+    if (size < 8 || std::memcmp(data, header, 8) != 0)
+        throw std::runtime_error("\033[1;31m[binary:parse]\033[0m Not a version 1 WebAssembly binary");
+
+    funcTypeIndices.clear();
+    importedFuncs = importedGlobals = globalCount = 0;
+    startIndex = -1;
+    instance.globals.clear();
+    instance.dataSegments.clear();
+    instance.tables.clear();
+    instance.elemSegments.clear();
+    instance.funcImports.clear();
+
+    Reader module(data + 8, data + size);
+    while (!module.atEnd()) {
+        uint8_t id = module.byte();
+        uint32_t len = module.u32();
+        const uint8_t* body = module.bytes(len);
+        Reader r(body, body + len);
+
+        WASM_TRACE(Parser, Debug, "\033[1;32m[binary:parse]\033[0m section " << int(id)
+                  << " at offset " << (body - data) << ", " << len << " bytes\n");
+
+        switch (id) {
+            case 0: {   // custom
+                if (r.name() == "name") readNames(r, functionsByID);
+                break;
+            }
+            case 1: readTypes(r, funcTypes); break;
+            case 2: readImports(r, funcTypes, instance, decoder); break;
+            case 3: {   // function
+                uint32_t count = r.u32();
+                funcTypeIndices.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) funcTypeIndices.push_back(r.u32());
+                break;
+            }
+            case 5: {   // memory
+                uint32_t count = r.u32();
+                if (count > 0) instance.memory = WasmMemory(r.limits());
+                WASM_TRACE(Parser, Info, "\033[1;32m[binary:memory]\033[0m " << instance.memory.sizeInPages()
+                          << " page(s)\n");
+                break;
+            }
+            case 6: readGlobals(r, instance); break;
+            case 7: readExports(r, exports); break;
+            case 8: startIndex = static_cast<int>(r.u32()); break;
+            case 10: readCode(r, funcTypes, functionsByID, decoder); break;
+            case 11: readData(r, instance); break;
+            case 4: readTables(r, instance); break;
+            case 9: readElems(r, instance); break;
+            case 12:    // data count
+                break;
+            default:
+                std::cerr << "\033[1;31m[binary:parse]\033[0m Unknown section id " << int(id) << "\n";
+                break;
+        }
+    }
+
+    instance.instantiate();
+
+    WASM_TRACE(Parser, Info, "\033[1;32m[binary:parse]\033[0m " << funcTypes.size() << " type(s), "
+              << functionsByID.size() << " function(s), " << globalCount << " global(s), "
+              << exports.size() << " export(s)\n");
+}
+
+void WasmBinaryParser::readTypes(Reader& r, std::unordered_map<int, FuncType>& funcTypes) {
+    uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (r.byte() != 0x60)
+            throw std::runtime_error("\033[1;31m[binary:type]\033[0m expected func type");
+        FuncType type;
+        uint32_t params = r.u32();
+        for (uint32_t p = 0; p < params; ++p) {
+            const char* t = valueTypeName(r.byte());
+            type.params.push_back(t ? t : "i32");
+        }
+        uint32_t results = r.u32();
+        for (uint32_t k = 0; k < results; ++k) {
+            const char* t = valueTypeName(r.byte());
+            if (k == 0) type.resultType = t ? t : "i32";
+        }
+        if (type.resultType.empty()) type.resultType = "void";
+        funcTypes[static_cast<int>(i)] = type;
+    }
+}
+
+void WasmBinaryParser::readImports(Reader& r, const std::unordered_map<int, FuncType>& funcTypes,
+                                   WasmInstance& instance, WasmDecoder& decoder) {
+    uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string moduleName = r.name();
+        std::string field = r.name();
+        uint8_t kind = r.byte();
+        switch (kind) {
+            case 0x00: {
+                auto it = funcTypes.find(static_cast<int>(r.u32()));
+                if (it == funcTypes.end())
+                    throw std::runtime_error("\033[1;31m[binary:import]\033[0m unknown type index");
+                instance.funcImports.push_back({moduleName, field, it->second, decoder.signatureId(it->second)});
+                importedFuncs++;
+                break;
+            }
+            case 0x01: {
+                r.byte();
+                uint32_t max = 0;
+                uint32_t initial = r.limits(&max);
+                instance.tables.emplace_back(initial, max);
+                break;
+            }
+            case 0x02: instance.memory = WasmMemory(r.limits()); break;
+            case 0x03: {
+                uint8_t type = r.byte();
+                bool isMutable = r.byte() != 0;
+                WasmValue v = zeroValue(type);
+                instance.globals.push_back(WasmGlobal{globalName(globalCount), v.type, isMutable, v});
+                globalCount++;
+                importedGlobals++;
+                break;
+            }
+            default:
+                throw std::runtime_error("\033[1;31m[binary:import]\033[0m unknown import kind");
+        }
+        WASM_TRACE(Parser, Info, "\033[1;32m[binary:import]\033[0m " << moduleName << "." << field
+                  << " (kind " << int(kind) << ")\n");
+    }
+}
+
+WasmValue WasmBinaryParser::readConstExpr(Reader& r, const WasmInstance& instance) {
+    WasmValue v;
+    for (;;) {
+        uint8_t op = r.byte();
+        switch (op) {
+            case 0x0B: return v;
+            case 0x41: v = WasmValue(r.s32()); break;
+            case 0x42: v = WasmValue(r.s64()); break;
+            case 0x43: v = WasmValue(r.f32()); break;
+            case 0x44: v = WasmValue(r.f64()); break;
+            case 0x23: {
+                uint32_t index = r.u32();
+                if (index < instance.globals.size())
+                    v = WasmValue(instance.globals[index].type, instance.globals[index].value);
+                break;
+            }
+            case 0xD0: r.byte(); v = WasmValue(NULL_REF); break;
+            case 0xD2: v = WasmValue(static_cast<int32_t>(r.u32())); break;
+            default:
+                throw std::runtime_error("\033[1;31m[binary:constExpr]\033[0m unsupported initializer opcode");
+        }
+    }
+}
+
+void WasmBinaryParser::readGlobals(Reader& r, WasmInstance& instance) {
+    uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t type = r.byte();
+        bool isMutable = r.byte() != 0;
+        WasmValue v = readConstExpr(r, instance);
+        v.type = zeroValue(type).type;
+        instance.globals.push_back(WasmGlobal{globalName(globalCount++), v.type, isMutable, v});
+    }
+}
+
+void WasmBinaryParser::readExports(Reader& r, std::unordered_map<std::string, WasmExport>& exports) {
+    static const char* const kinds[] = {"func", "table", "memory", "global"};
+    uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        WasmExport exp;
+        exp.name = r.name();
+        uint8_t kind = r.byte();
+        exp.kind = kind < 4 ? kinds[kind] : "unknown";
+        exp.index = static_cast<int>(r.u32());
+        exports[exp.name] = exp;
+        WASM_TRACE(Parser, Info, "\033[1;32m[binary:export]\033[0m Exported " << exp.kind << " '"
+                  << exp.name << "' (index " << exp.index << ")\n");
+    }
+}
+
+void WasmBinaryParser::readCode(Reader& r, const std::unordered_map<int, FuncType>& funcTypes,
+                                std::unordered_map<int, FuncDef>& functionsByID, WasmDecoder& decoder) {
+    uint32_t count = r.u32();
+    if (count != funcTypeIndices.size())
+        throw std::runtime_error("\033[1;31m[binary:code]\033[0m function and code section sizes differ");
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t size = r.u32();
+        const uint8_t* body = r.bytes(size);
+        Reader br(body, body + size);
+
+        int index = static_cast<int>(importedFuncs + i);
+        FuncDef& func = functionsByID[index];
+        func.index = index;
+
+        auto typeIt = funcTypes.find(static_cast<int>(funcTypeIndices[i]));
+        if (typeIt == funcTypes.end())
+            throw std::runtime_error("\033[1;31m[binary:code]\033[0m unknown type index");
+        const FuncType& type = typeIt->second;
+        int anonCounter = 1;
+        for (const auto& p : type.params)
+            func.params.emplace_back("param_" + std::to_string(anonCounter++), zeroValue(p));
+        func.hasResult = type.resultType != "void";
+        if (func.hasResult) func.result = zeroValue(type.resultType);
+        func.typeId = decoder.signatureId(type);
+
+        readBody(br, func, funcTypes, decoder);
+    }
+}
+
+void WasmBinaryParser::readBody(Reader& r, FuncDef& func, const std::unordered_map<int, FuncType>& funcTypes,
+                                WasmDecoder& decoder) {
+    func.code.clear();
+    func.symbols.clear();
+    func.locals.clear();
+    func.indirectCallSites = 0;
+    for (const auto& [name, val] : func.params) func.locals.push_back(val);
+
+    uint32_t groups = r.u32();
+    for (uint32_t g = 0; g < groups; ++g) {
+        uint32_t n = r.u32();
+        WasmValue v = zeroValue(r.byte());
+        func.locals.insert(func.locals.end(), n, v);
+    }
+
+    std::vector<std::vector<uint32_t>> depths;
+    std::unordered_map<std::string, uint32_t> symbolIds;
+    auto intern = [&](const std::string& s) {
+        auto it = symbolIds.find(s);
+        if (it != symbolIds.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(func.symbols.size());
+        func.symbols.push_back(s);
+        symbolIds.emplace(s, id);
+        return id;
+    };
+    auto blockArity = [&](ValueType& type) -> int32_t {
+        uint8_t b = r.peek();
+        if (b == 0x40) { r.byte(); return 0; }
+        if (valueTypeName(b)) { type = zeroValue(r.byte()).type; return 1; }
+        int64_t typeIndex = r.s64();
+        auto it = funcTypes.find(static_cast<int>(typeIndex));
+        if (it == funcTypes.end() || it->second.resultType == "void") return 0;
+        type = zeroValue(it->second.resultType).type;
+        return 1;
+    };
+
+    while (!r.atEnd()) {
+        uint8_t code = r.byte();
+        const char* name = binaryOpName(code);
+        std::string prefixed;
+        uint32_t sub = 0;
+        if (code == 0xFC) {
+            sub = r.u32();
+            name = sub < sizeof(kPrefixedOps) / sizeof(kPrefixedOps[0]) ? kPrefixedOps[sub] : nullptr;
+        }
+        if (!name) {
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), code == 0xFC ? "0xfc %u" : "0x%02x", code == 0xFC ? sub : code);
+            throw std::runtime_error(std::string("\033[1;31m[binary:code]\033[0m unknown opcode ") + buf);
+        }
+
+        Instr in;
+        in.op = WasmDecoder::lookup(name);
+
+        switch (code) {
+            case 0x02: case 0x03: case 0x04:
+                in.imm.i32 = blockArity(in.blockType);
+                break;
+            case 0x0C: case 0x0D:
+                in.a = static_cast<uint32_t>(depths.size());
+                depths.push_back({r.u32()});
+                break;
+            case 0x0E: {
+                uint32_t n = r.u32();
+                std::vector<uint32_t> labels(n + 1);
+                for (uint32_t k = 0; k <= n; ++k) labels[k] = r.u32();   // last one is the default
+                in.a = static_cast<uint32_t>(depths.size());
+                depths.push_back(std::move(labels));
+                break;
+            }
+            case 0x10:
+                in.a = r.u32();
+                in.b = 0;
+                break;
+            case 0x11: {
+                auto it = funcTypes.find(static_cast<int>(r.u32()));
+                if (it == funcTypes.end())
+                    throw std::runtime_error("\033[1;31m[binary:code]\033[0m unknown call_indirect type index");
+                in.a = decoder.signatureId(it->second);
+                in.b = r.u32();
+                in.imm.i32 = static_cast<int32_t>(func.indirectCallSites++);
+                break;
+            }
+            case 0x1C: {
+                uint32_t n = r.u32();
+                r.skip(n);
+                break;
+            }
+            case 0x20: case 0x21: case 0x22:
+                in.a = r.u32();
+                if (in.a >= func.locals.size())
+                    throw std::runtime_error("\033[1;31m[binary:code]\033[0m local index out of range");
+                break;
+            case 0x23: case 0x24:
+                in.a = r.u32();
+                if (in.a >= globalCount)
+                    throw std::runtime_error("\033[1;31m[binary:code]\033[0m global index out of range");
+                break;
+            case 0x25: case 0x26: case 0xD2:
+                in.a = r.u32();
+                break;
+            case 0x3F: case 0x40: case 0xD0:
+                r.byte();
+                break;
+            case 0x41: in.imm.i32 = r.s32(); break;
+            case 0x42: in.imm.i64 = r.s64(); break;
+            case 0x43: in.imm.f32 = r.f32(); break;
+            case 0x44: in.imm.f64 = r.f64(); break;
+            case 0xFC:
+                switch (sub) {
+                    case 8:  in.a = r.u32(); r.byte(); break;              // memory.init data, mem
+                    case 10: r.byte(); r.byte(); break;                     // memory.copy mem, mem
+                    case 11: r.byte(); break;                               // memory.fill mem
+                    case 12: case 14: in.a = r.u32(); in.b = r.u32(); break;
+                    case 9: case 13: case 15: case 16: case 17: in.a = r.u32(); break;
+                    default: break;
+                }
+                break;
+            default:
+                if (code >= 0x28 && code <= 0x3E) {
+                    in.b = r.u32();     // align
+                    in.a = r.u32();     // offset
+                }
+                break;
+        }
+
+        if (in.op == Opcode::Unknown) in.a = intern(name);
+        func.code.push_back(in);
+    }
+
+    decoder.link(func, depths);
+    decoder.fuse(func);
+    WASM_TRACE(Parser, Info, "\033[1;32m[binary:code]\033[0m Decoded function (index " << func.index << "): "
+              << func.code.size() << " instructions, " << func.locals.size() << " local slots\n");
+}
+
+void WasmBinaryParser::readData(Reader& r, WasmInstance& instance) {
+    uint32_t count = r.u32();
+    instance.dataSegments.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t flags = r.u32();
+        DataSegment seg;
+        seg.active = flags != 1;    // 1: passive, only reachable through memory.init
+        if (flags == 2) r.u32();   // memory index
+        if (seg.active) seg.offset = static_cast<uint32_t>(readConstExpr(r, instance).i32);
+        uint32_t len = r.u32();
+        const uint8_t* bytes = r.bytes(len);
+        seg.bytes.assign(bytes, bytes + len);
+        WASM_TRACE(Parser, Info, "\033[1;32m[binary:data]\033[0m " << (seg.active ? "active" : "passive")
+                  << " segment " << i << ": " << len << " byte(s)\n");
+        instance.dataSegments.push_back(std::move(seg));
+    }
+}
+
+void WasmBinaryParser::readTables(Reader& r, WasmInstance& instance) {
+    uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        r.byte();   // reference type
+        uint32_t max = 0;
+        uint32_t initial = r.limits(&max);
+        instance.tables.emplace_back(initial, max);
+        WASM_TRACE(Parser, Info, "\033[1;32m[binary:table]\033[0m table " << instance.tables.size() - 1
+                  << ": " << initial << " slot(s)\n");
+    }
+}
+
+// Flags: bit 0 passive/declarative, bit 1 explicit table (active) or declarative,
+// bit 2 items are constant expressions instead of function indices
+void WasmBinaryParser::readElems(Reader& r, WasmInstance& instance) {
+    uint32_t count = r.u32();
+    instance.elemSegments.reserve(instance.elemSegments.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t flags = r.u32();
+        if (flags > 7)
+            throw std::runtime_error("\033[1;31m[binary:elem]\033[0m invalid element segment flags");
+        ElemSegment seg;
+        seg.active = !(flags & 0x01);
+        seg.declarative = (flags & 0x03) == 0x03;
+        if (seg.active) {
+            if (flags & 0x02) seg.table = r.u32();
+            seg.offset = static_cast<uint32_t>(readConstExpr(r, instance).i32);
+        }
+        if (flags & 0x03) r.byte();   // element kind / reference type
+        uint32_t n = r.u32();
+        seg.refs.reserve(n);
+        for (uint32_t k = 0; k < n; ++k)
+            seg.refs.push_back((flags & 0x04) ? readConstExpr(r, instance).i32 : static_cast<int32_t>(r.u32()));
+        WASM_TRACE(Parser, Info, "\033[1;32m[binary:elem]\033[0m "
+                  << (seg.active ? "active" : seg.declarative ? "declarative" : "passive")
+                  << " segment " << i << ": " << n << " reference(s)\n");
+        instance.elemSegments.push_back(std::move(seg));
+    }
+}
+
+void WasmBinaryParser::readNames(Reader& r, std::unordered_map<int, FuncDef>& functionsByID) {
+    while (!r.atEnd()) {
+        uint8_t id = r.byte();
+        uint32_t len = r.u32();
+        const uint8_t* body = r.bytes(len);
+        if (id != 1) continue;   // only function names
+        Reader nr(body, body + len);
+        uint32_t count = nr.u32();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t index = nr.u32();
+            std::string name = nr.name();
+            if (index >= importedFuncs)
+                functionsByID[static_cast<int>(index)].name = "$" + name;
+        }
+    }
+}
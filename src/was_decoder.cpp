@@ -0,0 +1,275 @@
+#include "wasm_decoder.hpp"
+#include "wasm_trace.hpp"
+#include <iostream>
+#include <array>
+#include <iterator>
+
+static const char* const kOpcodeNames[] = {
+#define X(name, text) text,
+    WASM_OPCODES(X)
+#undef X
+};
+
+const char* WasmDecoder::opcodeName(Opcode op) {
+    size_t i = static_cast<size_t>(op);
+    return i < static_cast<size_t>(Opcode::Count) ? kOpcodeNames[i] : "<invalid>";
+}
+
+Opcode WasmDecoder::lookup(std::string_view mnemonic) {
+    static const std::unordered_map<std::string_view, Opcode> table = [] {
+        std::unordered_map<std::string_view, Opcode> t;
+        for (size_t i = 1; i < static_cast<size_t>(Opcode::Count); ++i)
+            t.emplace(kOpcodeNames[i], static_cast<Opcode>(i));
+        return t;
+    }();
+    auto it = table.find(mnemonic);
+    if (it != table.end()) return it->second;
+    return Opcode::Unknown;
+}
+
+namespace {
+
+struct FusionRule {
+    Opcode fused;
+    uint8_t length;
+    std::array<Opcode, 4> seq;
+};
+
+// Longest sequences first. Picked from dynamic pair/triple counts over tests/wat
+// and the fib, sieve, matmul, bubble sort and checksum kernels: local.get pairs,
+// constant operands and compare-then-branch account for most dispatches there.
+const std::vector<FusionRule>& fusionRules() {
+    static const std::vector<FusionRule> rules = [] {
+        using O = Opcode;
+        std::vector<FusionRule> r = {
+            {O::LocalI32AddImmSet, 4, {O::LocalGet, O::I32Const, O::I32Add, O::LocalSet}},
+            {O::LocalsI32Add,      3, {O::LocalGet, O::LocalGet, O::I32Add}},
+            {O::LocalI32AddImm,    3, {O::LocalGet, O::I32Const, O::I32Add}},
+            {O::LocalI32SubImm,    3, {O::LocalGet, O::I32Const, O::I32Sub}},
+            {O::LocalGet2,         2, {O::LocalGet, O::LocalGet}},
+            {O::LocalGetI32Const,  2, {O::LocalGet, O::I32Const}},
+            {O::LocalSetGet,       2, {O::LocalSet, O::LocalGet}},
+            {O::LocalI32Load,      2, {O::LocalGet, O::I32Load}},
+            {O::I32AddImm,         2, {O::I32Const, O::I32Add}},
+            {O::I32SubImm,         2, {O::I32Const, O::I32Sub}},
+            {O::I32ShlImm,         2, {O::I32Const, O::I32Shl}},
+        };
+        // i32 compare + br_if / if: the opcodes are declared in the same order
+        static const Opcode compares[] = {O::I32Eqz, O::I32Eq, O::I32Ne, O::I32LtS, O::I32LtU, O::I32GtS,
+                                          O::I32GtU, O::I32LeS, O::I32LeU, O::I32GeS, O::I32GeU};
+        for (size_t i = 0; i < std::size(compares); ++i) {
+            r.push_back({static_cast<O>(static_cast<size_t>(O::I32EqzBrIf) + i), 2, {compares[i], O::BrIf}});
+            r.push_back({static_cast<O>(static_cast<size_t>(O::I32EqzIf) + i), 2, {compares[i], O::If}});
+        }
+        return r;
+    }();
+    return rules;
+}
+
+#if WASM_FUSION
+const FusionRule* matchFusion(const std::vector<Instr>& code, size_t pc) {
+    for (const FusionRule& rule : fusionRules()) {
+        if (pc + rule.length > code.size()) continue;
+        size_t i = 0;
+        while (i < rule.length && code[pc + i].op == rule.seq[i]) ++i;
+        if (i == rule.length) return &rule;
+    }
+    return nullptr;
+}
+#endif
+
+} // namespace
+
+uint32_t WasmDecoder::signatureId(const FuncType& type) {
+    std::string key;
+    for (const std::string& p : type.params) key += p + ",";
+    key += "->" + type.resultType;
+    auto it = signatures.emplace(std::move(key), static_cast<uint32_t>(signatures.size()));
+    if (it.second) signatureTypes.push_back(type);
+    return it.first->second;
+}
+
+Opcode WasmDecoder::unfused(Opcode op) {
+    static const std::vector<Opcode> first = [] {
+        std::vector<Opcode> t(static_cast<size_t>(Opcode::Count));
+        for (size_t i = 0; i < t.size(); ++i) t[i] = static_cast<Opcode>(i);
+        for (const FusionRule& rule : fusionRules()) t[static_cast<size_t>(rule.fused)] = rule.seq[0];
+        // Written by WasmOptimizer rather than fuse()
+        t[static_cast<size_t>(Opcode::I32DivUImm)] = t[static_cast<size_t>(Opcode::I32RemUImm)] = Opcode::I32Const;
+        return t;
+    }();
+    size_t i = static_cast<size_t>(op);
+    return i < first.size() ? first[i] : op;
+}
+
+// Only the opcode of the first instruction changes: pcs, branch side tables and
+// the immediates of the remaining instructions stay valid, and a branch into the
+// middle of a sequence simply runs the original instructions from there.
+void WasmDecoder::fuse(FuncDef& func) {
+#if WASM_FUSION
+    std::vector<Instr>& code = func.code;
+    size_t fused = 0;
+    for (size_t pc = 0; pc < code.size();) {
+        const FusionRule* rule = matchFusion(code, pc);
+        // A pair gives way when the next instruction starts a longer sequence
+        if (rule && rule->length == 2) {
+            const FusionRule* next = matchFusion(code, pc + 1);
+            if (next && next->length > 2) rule = nullptr;
+        }
+        if (!rule) {
+            ++pc;
+            continue;
+        }
+        code[pc].op = rule->fused;
+        pc += rule->length;
+        ++fused;
+    }
+    WASM_TRACE(Parser, Debug, "\033[1;32m[decoder:fuse]\033[0m function index " << func.index << ": "
+              << fused << " superinstruction(s)\n");
+#else
+    (void)func;
+#endif
+}
+
+void WasmDecoder::link(FuncDef& func, const std::vector<std::vector<uint32_t>>& depths) {
+    struct Ctl {
+        Opcode kind;
+        uint32_t pc;
+        uint32_t arity;
+        ValueType type;
+        uint32_t elsePc;
+        std::vector<BranchTarget*> forward;   // branches waiting for this block's end
+    };
+    std::vector<Ctl> ctl;
+    std::vector<Instr>& code = func.code;
+    func.branches.clear();
+    func.brTables.clear();
+
+    // Pointers into the side table are patched when the matching `end` is seen,
+    // so reserve up front to keep them stable.
+    size_t totalTargets = 0;
+    for (const auto& labels : depths) totalTargets += labels.size();
+    func.branches.reserve(totalTargets);
+
+    auto resolve = [&](uint32_t depth, BranchTarget& t) {
+        t.depth = depth;
+        if (depth >= ctl.size()) {
+            // Branch to the function body: behaves like return
+            t.isReturn = true;
+            t.pc = static_cast<uint32_t>(code.size());
+            return;
+        }
+        Ctl& target = ctl[ctl.size() - 1 - depth];
+        if (target.kind == Opcode::Loop) {
+            t.isLoop = true;
+            t.pc = target.pc + 1;
+            t.arity = 0;
+        } else {
+            t.arity = target.arity;
+            t.type = target.type;
+            target.forward.push_back(&t);
+        }
+    };
+
+    for (uint32_t pc = 0; pc < code.size(); ++pc) {
+        Instr& in = code[pc];
+        switch (in.op) {
+            case Opcode::Block:
+            case Opcode::Loop:
+            case Opcode::If:
+                ctl.push_back({in.op, pc, static_cast<uint32_t>(in.imm.i32), in.blockType, 0, {}});
+                break;
+
+            case Opcode::Else:
+                if (ctl.empty() || ctl.back().kind != Opcode::If) {
+                    std::cerr << "\033[1;31m[decoder:sideTable]\033[0m else without matching if at pc=" << pc << "\n";
+                    in.op = Opcode::Nop;
+                    break;
+                }
+                ctl.back().elsePc = pc;
+                break;
+
+            case Opcode::End: {
+                if (ctl.empty()) {
+                    in.op = Opcode::Nop;
+                    break;
+                }
+                Ctl c = std::move(ctl.back());
+                ctl.pop_back();
+                Instr& start = code[c.pc];
+                // Block/Loop/If: a = pc taken when an `if` is false, b = pc of the matching `end`
+                start.a = c.elsePc ? c.elsePc + 1 : pc;
+                start.b = pc;
+                if (c.elsePc) code[c.elsePc].b = pc;
+                for (BranchTarget* t : c.forward) t->pc = pc + 1;
+                break;
+            }
+
+            case Opcode::Br:
+            case Opcode::BrIf: {
+                BranchTarget t;
+                func.branches.push_back(t);
+                resolve(depths[in.a].front(), func.branches.back());
+                in.a = static_cast<uint32_t>(func.branches.size() - 1);
+                break;
+            }
+
+            case Opcode::BrTable: {
+                const std::vector<uint32_t>& labels = depths[in.a];
+                in.a = static_cast<uint32_t>(func.brTables.size());
+                func.brTables.emplace_back();
+                func.brTables.back().reserve(labels.size());
+                for (uint32_t depth : labels) {
+                    func.brTables.back().emplace_back();
+                    resolve(depth, func.brTables.back().back());
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // Blocks left open by the end of the body fall through to the function exit
+    for (Ctl& c : ctl) {
+        code[c.pc].a = code[c.pc].b = static_cast<uint32_t>(code.size());
+        for (BranchTarget* t : c.forward) t->pc = static_cast<uint32_t>(code.size());
+    }
+}
+
+std::vector<Instr> WasmDecoder::unlink(const FuncDef& func, std::vector<std::vector<uint32_t>>& depths) {
+    std::vector<Instr> code;
+    code.reserve(func.code.size());
+    depths.clear();
+    for (Instr in : func.code) {
+        in.op = unfused(in.op);
+        switch (in.op) {
+            case Opcode::Br:
+            case Opcode::BrIf:
+                depths.push_back({func.branches[in.a].depth});
+                in.a = static_cast<uint32_t>(depths.size() - 1);
+                break;
+            case Opcode::BrTable: {
+                std::vector<uint32_t> labels;
+                for (const BranchTarget& t : func.brTables[in.a]) labels.push_back(t.depth);
+                depths.push_back(std::move(labels));
+                in.a = static_cast<uint32_t>(depths.size() - 1);
+                break;
+            }
+            // Pcs from link, and the divisor constants WasmOptimizer keeps in an i32.const
+            case Opcode::Block:
+            case Opcode::Loop:
+            case Opcode::If:
+            case Opcode::Else:
+            case Opcode::End:
+            case Opcode::I32Const:
+                in.a = in.b = 0;
+                break;
+            default:
+                break;
+        }
+        code.push_back(in);
+    }
+    return code;
+}
@@ -1,4 +1,8 @@
 #include "wasm_executor.hpp"
+#include "wasm_tiering.hpp"
+#include "wasm_decoder.hpp"
+#include "wasm_numeric.hpp"
+#include "wasm_trace.hpp"
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
@@ -8,30 +12,138 @@
 #include <algorithm>
 #include <cctype>
 #include <cmath>
-
-static inline int countl_zero32(uint32_t x) { return x == 0 ? 32 : __builtin_clz(x); }
-static inline int countr_zero32(uint32_t x) { return x == 0 ? 32 : __builtin_ctz(x); }
-static inline int popcount32(uint32_t x) { return __builtin_popcount(x); }
-static inline int countl_zero64(uint64_t x) { return x == 0 ? 64 : __builtin_clzll(x); }
-static inline int countr_zero64(uint64_t x) { return x == 0 ? 64 : __builtin_ctzll(x); }
-static inline int popcount64(uint64_t x) { return __builtin_popcountll(x); }
+#include <cstring>
+#include <utility>
+
+static inline int32_t add32(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+static inline int32_t sub32(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+
+// Dispatch backend, chosen at build time (see WASM_DISPATCH in CMakeLists.txt).
+// Threaded: every handler ends with its own indirect jump through a label table.
+// Switch: one central `switch` inside a loop.
+#if defined(WASM_DISPATCH_THREADED) && (defined(__GNUC__) || defined(__clang__))
+#define WASM_THREADED_DISPATCH 1
+#else
+#define WASM_THREADED_DISPATCH 0
+#endif
+
+#define FETCH() \
+    do { \
+        while (pc >= code->size()) \
+            if (!returnToCaller()) return; \
+        ip = &(*code)[pc++]; \
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:instr]\033[0m " << opName() << "\n"); \
+    } while (0)
+
+#if WASM_THREADED_DISPATCH
+#define CASE(name) op_##name:
+#define DISPATCH() do { FETCH(); goto *dispatchTable[static_cast<size_t>(ip->op)]; } while (0)
+#define NEXT() DISPATCH()
+#else
+#define CASE(name) case Opcode::name:
+#define DISPATCH() FETCH()
+#define NEXT() continue
+#endif
+
+WasmExecutor::WasmExecutor() {
+    stack.reserve(1 << 16);
+    locals.reserve(1 << 14);
+    labels.reserve(1 << 12);
+    frames.reserve(1 << 10);
+}
 
 void WasmExecutor::execute(
-    const FuncDef& func,
-    std::unordered_map<int, FuncDef>& functionsByID,
-    std::unordered_map<std::string, FuncDef>& functionByName,
-    WasmMemory& memory,
-    std::unordered_map<std::string, WasmGlobal>& globals
+    const FuncDef& entry,
+    const std::vector<WasmValue>& args,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance
 ) {
-    WasmStack stack;
+    // Out-of-bounds accesses arrive either as a guard-page fault (guard memory)
+    // or as std::out_of_range (checked memory); both end the call with a trap.
+    // Nothing in run() needs unwinding, so jumping over it is safe. `slots` is
+    // built before the jump point, so the trap thrown from there still frees it.
+    std::vector<WasmSlot> slots(args.begin(), args.end());
+#if WASM_GUARD_PAGES
+    WasmMemory::FaultScope scope;
+    if (sigsetjmp(scope.env, 0))
+        throw WasmTrap("out of bounds memory access");
+#endif
     stack.clear();
-    std::unordered_map<std::string, WasmValue> locals;
-    for (const auto& [pname, pval] : func.params) {
-        locals[pname] = pval;
+    labels.clear();
+    frames.clear();
+    locals.clear();
+    try {
+        if (validated && !WasmTrace::any()) run<true>(entry, slots.data(), slots.size(), 0, functions, instance);
+        else run<false>(entry, slots.data(), slots.size(), 0, functions, instance);
+    } catch (const std::out_of_range&) {
+        throw WasmTrap("out of bounds memory access");
+    }
+}
+
+bool WasmExecutor::invoke(
+    const FuncDef& func,
+    const WasmSlot* args,
+    size_t depth,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance,
+    WasmSlot& result
+) {
+    // Called from the register tier: a fault here must not jump over its frames
+#if WASM_GUARD_PAGES
+    WasmMemory::FaultScope scope;
+    if (sigsetjmp(scope.env, 0))
+        throw WasmTrap("out of bounds memory access");
+#endif
+    size_t floor = stack.size();
+    try {
+        if (validated && !WasmTrace::any()) run<true>(func, args, func.params.size(), depth, functions, instance);
+        else run<false>(func, args, func.params.size(), depth, functions, instance);
+    } catch (const std::out_of_range&) {
+        throw WasmTrap("out of bounds memory access");
     }
-    std::cout << "\033[1;36m[executor:execute]\033[0m Executing function '" << func.name << "' (index " << func.index << ").\n";
-    std::vector<bool> skipStack;
-    std::vector<BlockInfo> blockStack;
+    if (stack.size() == floor) return false;
+    result = stack.pop();
+    return true;
+}
+
+template <bool Validated>
+void WasmExecutor::run(
+    const FuncDef& entry,
+    const WasmSlot* args,
+    size_t argCount,
+    size_t depth,
+    const std::vector<const FuncDef*>& functions,
+    WasmInstance& instance
+) {
+    WasmMemory& memory = instance.memory;
+    std::vector<WasmGlobal>& globals = instance.globals;
+    // Locals of every active call live back to back in `locals`; the running
+    // function sees its own slots (params first, laid out by the decoder) through `local`.
+    // Anything already on the shared stacks belongs to calls in another tier.
+    const size_t framesFloor = frames.size();
+    size_t localsBase = locals.size();
+    size_t labelsBase = labels.size();
+    size_t stackBase = stack.size();
+    locals.insert(locals.end(), entry.locals.begin(), entry.locals.end());
+    std::copy_n(args, std::min(argCount, entry.params.size()), locals.begin() + localsBase);
+    if constexpr (Validated) stack.reserve(stackBase + entry.maxStack);
+    const FuncDef* func = &entry;
+    WasmSlot* local = locals.data() + localsBase;
+    WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Executing function '" << func->name << "' (index " << func->index << ").\n");
+    // Validated code cannot underflow, and each call reserves its maximum height on
+    // entry. Its values go untyped: every instruction knows what it reads.
+    auto push = [&](const WasmValue& v) {
+        if constexpr (Validated) stack.pushUnchecked(v);
+        else stack.push(v);
+    };
+    auto pop = [&]() {
+        if constexpr (Validated) return WasmValue(ValueType::I64, stack.popUnchecked());
+        else return stack.pop();
+    };
+    auto top = [&]() {
+        if constexpr (Validated) return WasmValue(ValueType::I64, stack.topUnchecked());
+        else return stack.top();
+    };
     auto printValue = [](const WasmValue& v) {
         switch (v.type) {
             case ValueType::I32: std::cout << v.i32; break;
@@ -41,805 +153,689 @@ void WasmExecutor::execute(
         }
     };
 
-    auto binaryOp = [&](auto fn, const std::string& tag, ValueType t) {
-        WasmValue b = stack.pop(), a = stack.pop(), r;
+    size_t pc = 0;
+    const Instr* ip = nullptr;
+    // Only traces and diagnostics name the running instruction
+    auto opName = [&]() { return WasmDecoder::opcodeName(ip->op); };
+
+    auto binaryOp = [&](auto fn, ValueType t) {
+        WasmValue b = pop(), a = pop(), r;
         if (t == ValueType::I32) r = WasmValue(static_cast<int32_t>(fn(a.i32, b.i32)));
         else if (t == ValueType::I64) r = WasmValue(static_cast<int64_t>(fn(a.i64, b.i64)));
         else if (t == ValueType::F32) r = WasmValue(static_cast<float>(fn(a.f32, b.f32)));
         else r = WasmValue(static_cast<double>(fn(a.f64, b.f64)));
-        std::cout << "\033[1;36m[executor:" << tag << "]\033[0m ";
-        printValue(a);
-        std::cout << ", ";
-        printValue(b);
-        std::cout << " -> ";
-        printValue(r);
-        std::cout << "\n";
-        stack.push(r);
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            std::cout << "\033[1;36m[executor:" << opName() << "]\033[0m ";
+            printValue(a);
+            std::cout << ", ";
+            printValue(b);
+            std::cout << " -> ";
+            printValue(r);
+            std::cout << "\n";
+        }
+        push(r);
     };
 
-    auto cmpOp = [&](auto fn, const std::string& tag, ValueType t) {
-        WasmValue b = stack.pop(), a = stack.pop();
+    auto cmpOp = [&](auto fn, ValueType t) {
+        WasmValue b = pop(), a = pop();
         int32_t res = 0;
         if (t == ValueType::I32) res = fn(a.i32, b.i32);
         else if (t == ValueType::I64) res = fn(a.i64, b.i64);
         else if (t == ValueType::F32) res = fn(a.f32, b.f32);
         else res = fn(a.f64, b.f64);
-        stack.push(WasmValue(static_cast<int32_t>(res ? 1 : 0)));
-        std::cout << "\033[1;36m[executor:" << tag << "]\033[0m = " << res << "\n";
+        push(WasmValue(static_cast<int32_t>(res ? 1 : 0)));
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:" << opName() << "]\033[0m = " << res << "\n");
     };
 
-    auto unaryOp = [&](auto fn, const std::string& tag, ValueType t) {
-        WasmValue a = stack.pop(), r;
+    auto unaryOp = [&](auto fn, ValueType t) {
+        WasmValue a = pop(), r;
         if (t == ValueType::I32) r = WasmValue(static_cast<int32_t>(fn(a.i32)));
         else if (t == ValueType::I64) r = WasmValue(static_cast<int64_t>(fn(a.i64)));
         else if (t == ValueType::F32) r = WasmValue(static_cast<float>(fn(a.f32)));
         else r = WasmValue(static_cast<double>(fn(a.f64)));
-        std::cout << "\033[1;36m[executor:" << tag << "]\033[0m -> ";
-        printValue(r);
-        std::cout << "\n";
-        stack.push(r);
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            std::cout << "\033[1;36m[executor:" << opName() << "]\033[0m -> ";
+            printValue(r);
+            std::cout << "\n";
+        }
+        push(r);
     };
     
-    auto doStore = [&](auto fn, const std::string& tag) {
-        WasmValue v = stack.pop(), addr = stack.pop();
-        fn(addr.i32, v);
-        std::cout << "\033[1;36m[executor:" << tag << "]\033[0m mem[" << addr.i32 << "] = ";
-        printValue(v);
-        std::cout << "\n";
+    auto doStore = [&](auto fn, uint32_t offset) {
+        WasmValue v = pop(), addr = pop();
+        uint64_t ea = static_cast<uint64_t>(static_cast<uint32_t>(addr.i32)) + offset;
+        fn(ea, v);
+        if (WASM_TRACE_ON(Memory, Debug)) {
+            std::cout << "\033[1;35m[memory:" << opName() << "]\033[0m mem[" << ea << "] = ";
+            printValue(v);
+            std::cout << "\n";
+        }
     };
 
-    auto doLoad = [&](auto fn, auto castFn, const std::string& tag, ValueType t) {
-        WasmValue addr = stack.pop();
-        auto val = castFn(fn(addr.i32));
-        if (t == ValueType::I32) stack.push(WasmValue(static_cast<int32_t>(val)));
-        else if (t == ValueType::I64) stack.push(WasmValue(static_cast<int64_t>(val)));
-        else if (t == ValueType::F32) stack.push(WasmValue(static_cast<float>(val)));
-        else stack.push(WasmValue(static_cast<double>(val)));
-        std::cout << "\033[1;36m[executor:" << tag << "]\033[0m mem[" << addr.i32 << "] → " << static_cast<double>(val) << "\n";
+    auto doLoad = [&](auto fn, auto castFn, ValueType t, uint32_t offset) {
+        WasmValue addr = pop();
+        uint64_t ea = static_cast<uint64_t>(static_cast<uint32_t>(addr.i32)) + offset;
+        auto val = castFn(fn(ea));
+        if (t == ValueType::I32) push(WasmValue(static_cast<int32_t>(val)));
+        else if (t == ValueType::I64) push(WasmValue(static_cast<int64_t>(val)));
+        else if (t == ValueType::F32) push(WasmValue(static_cast<float>(val)));
+        else push(WasmValue(static_cast<double>(val)));
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:" << opName() << "]\033[0m mem[" << ea << "] → " << static_cast<double>(val) << "\n");
     };
     
-    auto resolveDepth = [&](const std::string& tok) -> int {
-        if (!tok.empty() && tok[0] == '$') {
-            for (int i = (int)blockStack.size()-1, d = 0; i >= 0; --i, ++d) {
-                if (blockStack[i].label == tok) return d;
-            }
-            std::cerr << "\033[1;31m[executor]\033[0m unknown label " << tok << " -> depth=0\n";
-            return 0;
-        }
-        try { return std::stoi(tok); }
-        catch (...) { return 0; }
+    const std::vector<Instr>* code = &func->code;
+    auto sym = [&](uint32_t id) -> const std::string& { return func->symbols[id]; };
+    // Locals hold the type they are declared with
+    auto localValue = [&](uint32_t i) {
+        if constexpr (Validated) return WasmValue(ValueType::I64, local[i]);
+        else return WasmValue(func->locals[i].type, local[i]);
     };
 
-    auto firstTok = [](const std::string& s) {
-        std::istringstream is(s);
-        std::string t; 
-        is >> t;
-        return t;
+    // Calls active below the running function, counting those in another tier
+    auto activeCalls = [&]() { return depth + frames.size() - framesFloor; };
+    auto checkDepth = [&]() {
+        if (activeCalls() >= maxCallDepth) {
+            throw WasmTrap("call stack exhausted (depth " + std::to_string(activeCalls())
+                           + ", limit " + std::to_string(maxCallDepth) + ")");
+        }
     };
 
+    // Tiered execution: once the running function is hot, its activation continues in
+    // the register tier from the loop header just branched to, and returns from there
+    bool replaced = false;   // the register tier has already reported the return
+    auto tierUp = [&](size_t& pc) {
+        const RegOsrEntry* entry = tiering->hotLoop(*func, pc);
+        size_t height = stack.size() - stackBase;
+        if (!entry || entry->stack.size() != height) return;
+        WasmSlot result;
+        bool hasResult = tiering->replace(*func, *entry, local, height ? &stack.at(stackBase) : nullptr,
+                                          activeCalls(), result);
+        stack.unwind(stackBase, 0);
+        if (hasResult) push(WasmValue(func->result.type, result));
+        local = locals.data() + localsBase;
+        pc = code->size();
+        replaced = true;
+    };
 
-    auto safeDiv32 = [](int32_t a, int32_t b) { return b == 0 ? 0 : a / b; };
-    auto safeDiv64 = [](int64_t a, int64_t b) { return b == 0 ? 0 : a / b; };
-    auto safeRem32 = [](int32_t a, int32_t b) { return b == 0 ? 0 : a % b; };
-    auto safeRem64 = [](int64_t a, int64_t b) { return b == 0 ? 0 : a % b; };
-
-    for (size_t pc = 0; pc < func.body.size(); ++pc) {
-        const std::string& line = func.body[pc];
-        std::istringstream iss(line);
-        std::string op; iss >> op;
-        if (op.empty()) continue;
-        std::cout << "\033[1;36m[executor:instr]\033[0m " << op << "\n";
-
-        if (op == "i32.const" || op == "i64.const" || op == "f32.const" || op == "f64.const") {
-            std::string v; iss >> v;
-            if (op == "i32.const") {
-                int32_t val = 0;
-                if (v.rfind("0x", 0) == 0 || v.rfind("0X", 0) == 0) {
-                    val = static_cast<int32_t>(std::stoul(v, nullptr, 16));
-                } else {
-                    val = static_cast<int32_t>(std::stol(v));
-                }
-                stack.push(WasmValue(val));
-            } else if (op == "i64.const") {
-                int64_t val = 0;
-                if (v.rfind("0x", 0) == 0 || v.rfind("0X", 0) == 0) {
-                    val = static_cast<int64_t>(std::stoull(v, nullptr, 16));
-                } else {
-                    val = static_cast<int64_t>(std::stoll(v));
-                }
-                stack.push(WasmValue(val));
-            } else if (op == "f32.const") {
-                stack.push(WasmValue(static_cast<float>(std::stof(v))));
-            } else if (op == "f64.const") {
-                stack.push(WasmValue(static_cast<double>(std::stod(v))));
-            }
-            continue;
-        } else if (op == "select") {
-            WasmValue cond = stack.pop();
-            WasmValue b = stack.pop();
-            WasmValue a = stack.pop();
-            WasmValue result = (cond.i32 != 0) ? a : b;
-            std::cout << "\033[1;36m[select]\033[0m cond=" << cond.i32
-                    << " → selected=";
-            switch (result.type) {
-                case ValueType::I32: std::cout << result.i32; break;
-                case ValueType::I64: std::cout << result.i64; break;
-                case ValueType::F32: std::cout << result.f32; break;
-                case ValueType::F64: std::cout << result.f64; break;
-            }
-            std::cout << "\n";
-            stack.push(result);
-            continue;
-        } else if (op == "return") {
-            std::cout << "\033[1;36m[executor:return]\033[0m returning from function "
-                    << (func.name.empty() ? "[anon]" : func.name) << "\n";
-            return;
-        }else if (op == "call") {
-            std::string target;
-            iss >> target;
-
-            bool isNumeric = !target.empty() && std::all_of(target.begin(), target.end(), ::isdigit);
-            FuncDef* callee = nullptr;
-
-            if (isNumeric) {
-                int funcIndex = std::stoi(target);
-                auto it = functionsByID.find(funcIndex);
-                if (it == functionsByID.end()) {
-                    std::cerr << "\033[1;31m[executor:call]\033[0m Error: function index "
-                            << funcIndex << " not found!\n";
-                    continue;
-                }
-                callee = &it->second;
-                std::cout << "\033[1;36m[executor:call]\033[0m Calling function index "
-                        << funcIndex << " (" << (callee->name.empty() ? "[anon]" : callee->name) << ")\n";
-            } else {
-                auto it = functionByName.find(target);
-                if (it == functionByName.end()) {
-                    std::cerr << "\033[1;31m[executor:call]\033[0m Error: function name '"
-                            << target << "' not found!\n";
-                    continue;
-                }
-                callee = &it->second;
-                std::cout << "\033[1;36m[executor:call]\033[0m Calling function name '"
-                        << target << "' (index " << callee->index << ")\n";
+    // Take a precomputed branch: keep `arity` results, drop the operands of the
+    // blocks being left and continue at the target pc. Validated code knows the
+    // height of every label (BranchTarget::height) and keeps no label stack.
+    auto branch = [&](size_t& pc, const BranchTarget& t, const char* tag) {
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:" << tag << "]\033[0m → "
+                  << (t.isReturn ? "return" : t.isLoop ? "continue loop" : "break to end of block")
+                  << " (pc=" << t.pc << ")\n");
+        pc = t.pc;
+        if constexpr (Validated) {
+            if (t.isReturn) return;
+            stack.unwind(stackBase + t.height, t.arity);
+        } else {
+            if (t.isReturn || t.depth >= labels.size() - labelsBase) {
+                pc = t.isReturn ? t.pc : code->size();
+                return;
             }
+            size_t idx = labels.size() - 1 - t.depth;
+            stack.unwind(labels[idx], t.arity);
+            labels.resize(t.isLoop ? idx + 1 : idx);
+        }
+        if (t.isLoop && tiering) tierUp(pc);
+    };
 
-            size_t paramCount = callee->params.size();
-            std::vector<WasmValue> args;
-            args.reserve(paramCount);
-
-            for (size_t i = 0; i < paramCount; ++i) {
-                if (stack.empty()) {
-                    std::cerr << "\033[1;31m[executor:call]\033[0m Error: stack underflow while reading args!\n";
-                    break;
-                }
-                args.push_back(stack.pop());
+    // Conversions: pop a value of type `from`, push fn(value)
+    auto convert = [&](ValueType from, auto fn) {
+        if constexpr (!Validated) {
+            if (stack.empty()) {
+                *errors << "\033[1;31m[executor:" << opName() << "]\033[0m Error: stack underflow\n";
+                return;
             }
-            std::reverse(args.begin(), args.end());
-
-            size_t i = 0;
-            for (auto& [paramName, paramVal] : callee->params) {
-                if (i < args.size()) {
-                    paramVal = args[i];
-                    std::cout << "\033[1;36m[executor:call]\033[0m arg "
-                            << (paramName.empty() ? "_" : paramName) << " = ";
-                    switch (args[i].type) {
-                        case ValueType::I32: std::cout << args[i].i32; break;
-                        case ValueType::I64: std::cout << args[i].i64; break;
-                        case ValueType::F32: std::cout << args[i].f32; break;
-                        case ValueType::F64: std::cout << args[i].f64; break;
-                    }
-                    std::cout << "\n";
-                }
-                ++i;
+        }
+        WasmValue val = pop();
+        if constexpr (!Validated) {
+            if (val.type != from) {
+                *errors << "\033[1;31m[executor:" << opName() << "]\033[0m Error: unexpected operand type\n";
+                return;
             }
-            
-            std::cout << "\033[1;34m[debug:parseFunction]\033[0m Params detected: ";
-            for (auto& [pname, _] : callee->params) std::cout << pname << " ";
+        }
+        WasmValue r = fn(val);
+        push(r);
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            std::cout << "\033[1;36m[executor:" << opName() << "]\033[0m ";
+            printValue(val);
+            std::cout << " → ";
+            printValue(r);
             std::cout << "\n";
+        }
+    };
 
 
-            WasmExecutor nestedExec;
-            nestedExec.execute(*callee, functionsByID, functionByName, memory, globals);
-
-            if (!nestedExec.lastStack.empty()) {
-                WasmValue retVal = nestedExec.lastStack.top();
-                stack.push(retVal);
+    // Function exit: keep the top value as the result if the signature has one,
+    // drop any other operands and resume the caller's frame. Returns false once
+    // the entry function itself has finished.
+    auto returnToCaller = [&]() {
+        if (!std::exchange(replaced, false)) {
+            WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Function completed.\n");
+        }
+        size_t keep = func->hasResult && stack.size() > stackBase ? 1 : 0;
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            if (keep) {
                 std::cout << "\033[1;36m[executor:call]\033[0m returned value pushed to caller stack: ";
-                switch (retVal.type) {
-                    case ValueType::I32: std::cout << retVal.i32; break;
-                    case ValueType::I64: std::cout << retVal.i64; break;
-                    case ValueType::F32: std::cout << retVal.f32; break;
-                    case ValueType::F64: std::cout << retVal.f64; break;
-                    default: std::cout << "(none)"; break;
-                }
+                printValue(stack.value(stack.size() - 1));
                 std::cout << "\n";
             } else {
-                std::cerr << "\033[1;31m[executor:call]\033[0m Warning: callee returned no value!\n";
+                std::cout << "\033[1;36m[executor:call]\033[0m callee returned no value\n";
             }
+        }
+        stack.unwind(stackBase, keep);
+        locals.resize(localsBase);
+        labels.resize(labelsBase);
+        if (frames.size() == framesFloor) return false;
+
+        const Frame& caller = frames.back();
+        func = caller.func;
+        code = &func->code;
+        pc = caller.pc;
+        localsBase = caller.localsBase;
+        labelsBase = caller.labelsBase;
+        stackBase = caller.stackBase;
+        local = locals.data() + localsBase;
+        frames.pop_back();
+        return true;
+    };
 
+    // Push the caller's frame and move the arguments straight into the callee's slots
+    auto enterFunction = [&](const FuncDef* callee) {
+        checkDepth();
 
-            continue;
-        } else if (op == "memory.size") {
-            int32_t pages = memory.size();
-            stack.push(WasmValue(pages));
-            std::cout << "\033[1;36m[executor:memory.size]\033[0m → pages=" << pages << "\n";
-            continue;
-        }
-        else if (op == "memory.grow") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:memory.grow]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue pages = stack.pop();
-            if (pages.type != ValueType::I32) {
-                std::cerr << "\033[1;31m[executor:memory.grow]\033[0m Error: expected i32 argument\n";
-                continue;
-            }
-            int32_t oldPages = memory.grow(pages.i32);
-            stack.push(WasmValue(oldPages));
-            continue;
-        } else if (op.find("store") != std::string::npos) {
-            if (op == "i32.store8") doStore([&](int32_t a, WasmValue v){ memory.store8(a, static_cast<uint8_t>(v.i32)); }, "executor:" + op);
-            else if (op == "i32.store16") doStore([&](int32_t a, WasmValue v){ memory.store16(a, static_cast<uint16_t>(v.i32)); }, "executor:" + op);
-            else if (op == "i32.store") doStore([&](int32_t a, WasmValue v){ memory.store32(a, v.i32); }, "executor:" + op);
-            else if (op == "i64.store8") doStore([&](int32_t a, WasmValue v){ memory.store8(a, static_cast<uint8_t>(v.i64)); }, "executor:" + op);
-            else if (op == "i64.store16") doStore([&](int32_t a, WasmValue v){ memory.store16(a, static_cast<uint16_t>(v.i64)); }, "executor:" + op);
-            else if (op == "i64.store32") doStore([&](int32_t a, WasmValue v){ memory.store32(a, static_cast<int32_t>(v.i64)); }, "executor:" + op);
-            else if (op == "i64.store") doStore([&](int32_t a, WasmValue v){ memory.store64(a, v.i64); }, "executor:" + op);
-            else if (op == "f32.store") doStore([&](int32_t a, WasmValue v){ memory.storeF32(a, v.f32); }, "executor:" + op);
-            else if (op == "f64.store") doStore([&](int32_t a, WasmValue v){ memory.storeF64(a, v.f64); }, "executor:" + op);
-            continue;
-        } else if (op.find("load") != std::string::npos) {
-            if (op == "i32.load8_s") doLoad([&](int32_t a){ return static_cast<int8_t>(memory.load8(a)); }, [](int8_t x){return static_cast<int32_t>(x);}, "executor:" + op, ValueType::I32);
-            else if (op == "i32.load8_u") doLoad([&](int32_t a){ return memory.load8(a); }, [](uint8_t x){return static_cast<int32_t>(x);}, "executor:" + op, ValueType::I32);
-            else if (op == "i32.load16_s") doLoad([&](int32_t a){ return static_cast<int16_t>(memory.load16(a)); }, [](int16_t x){return static_cast<int32_t>(x);}, "executor:" + op, ValueType::I32);
-            else if (op == "i32.load16_u") doLoad([&](int32_t a){ return memory.load16(a); }, [](uint16_t x){return static_cast<int32_t>(x);}, "executor:" + op, ValueType::I32);
-            else if (op == "i32.load") doLoad([&](int32_t a){ return memory.load32(a); }, [](int32_t x){return x;}, "executor:" + op, ValueType::I32);
-            else if (op == "i64.load8_s") doLoad([&](int32_t a){ return static_cast<int8_t>(memory.load8(a)); }, [](int8_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load8_u") doLoad([&](int32_t a){ return memory.load8(a); }, [](uint8_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load16_s") doLoad([&](int32_t a){ return static_cast<int16_t>(memory.load16(a)); }, [](int16_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load16_u") doLoad([&](int32_t a){ return memory.load16(a); }, [](uint16_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load32_s") doLoad([&](int32_t a){ return memory.load32(a); }, [](int32_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load32_u") doLoad([&](int32_t a){ return static_cast<uint32_t>(memory.load32(a)); }, [](uint32_t x){return static_cast<int64_t>(x);}, "executor:" + op, ValueType::I64);
-            else if (op == "i64.load") doLoad([&](int32_t a){ return memory.load64(a); }, [](int64_t x){return x;}, "executor:" + op, ValueType::I64);
-            else if (op == "f32.load") doLoad([&](int32_t a){ return memory.loadF32(a); }, [](float x){return x;}, "executor:" + op, ValueType::F32);
-            else if (op == "f64.load") doLoad([&](int32_t a){ return memory.loadF64(a); }, [](double x){return x;}, op, ValueType::F64);
-            continue;
-        } else if (op == "(local") {
-            std::string name, type; iss >> name >> type;
-            if (!type.empty() && type.back() == ')') type.pop_back();
-            locals[name] = {};
-            std::cout << "\033[1;36m[local]\033[0m Declared " << name << " (" << type << ")\n";
-            continue;
-        } else if (op == "local.set" || op == "local.get" || op == "local.tee") {
-            std::string name; iss >> name;
-            if (op == "local.set") locals[name] = stack.pop();
-            else if (op == "local.get") stack.push(locals[name]);
-            else locals[name] = stack.top();
-            continue;
-        } else if (op == "global.get" || op == "global.set") {
-            std::string name; iss >> name;
-            WasmGlobal& g = globals[name];
-            if (op == "global.get") stack.push(g.value);
-            else g.value = stack.pop();
-            continue;
-        } else if (op == "if" || op.rfind("if", 0) == 0) {
-            WasmValue cond = stack.pop();
-            bool condition = (cond.i32 != 0);
-            std::cout << "\033[1;36m[executor:if]\033[0m condition=" << cond.i32
-                    << " (" << (condition ? "true" : "false") << ")\n";
-            if (!condition) {
-                int depth = 0;
-                for (++pc; pc < func.body.size(); ++pc) {
-                    const std::string& next = func.body[pc];
-                    if (next.rfind("if", 0) == 0) depth++;
-                    else if (next == "else" && depth == 0) break;
-                    else if (next == "end") {
-                        if (depth == 0) break;
-                        depth--;
-                    }
-                }
-                skipStack.push_back(true);
-            } else {
-                skipStack.push_back(false);
-            }
-            continue;
-        } else if (op == "else") {
-            if (skipStack.empty()) {
-                std::cerr << "[executor:else] Error: else without matching if!\n";
-                continue;
+        size_t paramCount = callee->params.size();
+        if constexpr (!Validated) {
+            if (stack.size() - stackBase < paramCount) {
+                *errors << "\033[1;31m[executor:call]\033[0m Error: stack underflow while reading args!\n";
+                paramCount = stack.size() - stackBase;
             }
+        }
 
-            bool parentSkipped = skipStack.back();
-            skipStack.pop_back();
-
-            if (!parentSkipped) {
-                int depth = 0;
-                for (++pc; pc < func.body.size(); ++pc) {
-                    const std::string& next = func.body[pc];
-                    if (next.rfind("if", 0) == 0) depth++;
-                    else if (next == "end") {
-                        if (depth == 0) break;
-                        depth--;
-                    }
-                }
-                std::cout << "\033[1;36m[executor:else]\033[0m skipped\n";
-            } else {
-                std::cout << "\033[1;36m[executor:else]\033[0m executing\n";
-            }
-            continue;
-        } else if (op == "block") {
-            std::string lbl;
-            if (iss >> lbl && !lbl.empty() && lbl[0] == '$') {
-                std::cout << "\033[1;36m[executor:block]\033[0m begin block " << lbl << " (pc=" << pc << ")\n";
-                blockStack.push_back({pc, false, lbl});
-            } else {
-                std::cout << "\033[1;36m[executor:block]\033[0m begin block (pc=" << pc << ")\n";
-                blockStack.push_back({pc, false, ""});
-            }
-            continue;
-        } else if (op == "br_if") {
-            std::string tok; iss >> tok; 
-            int32_t depth = tok.empty() ? 0 : resolveDepth(tok);
-            WasmValue cond = stack.pop();
-            bool condition = (cond.i32 != 0);
-
-            std::cout << "\033[1;36m[executor:br_if]\033[0m depth=" << depth
-                    << " condition=" << cond.i32
-                    << " (" << (condition ? "true" : "false") << ")\n";
-
-            if (!condition) continue;
-
-            if (depth < 0 || depth >= static_cast<int32_t>(blockStack.size())) {
-                std::cerr << "\033[1;31m[executor:br_if]\033[0m invalid depth!\n";
-                continue;
+        frames.push_back({func, pc, localsBase, labelsBase, stackBase});
+        localsBase = locals.size();
+        labelsBase = labels.size();
+        locals.insert(locals.end(), callee->locals.begin(), callee->locals.end());
+        size_t argBase = stack.size() - paramCount;
+        if (paramCount) std::copy_n(&stack.at(argBase), paramCount, locals.begin() + localsBase);
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            for (size_t i = 0; i < paramCount; ++i) {
+                std::cout << "\033[1;36m[executor:call]\033[0m arg "
+                          << callee->params[i].first << " = ";
+                printValue(WasmValue(callee->locals[i].type, locals[localsBase + i]));
+                std::cout << "\n";
             }
+        }
+        stack.unwind(argBase, 0);
+        stackBase = argBase;
+        if constexpr (Validated) stack.reserve(stackBase + callee->maxStack);
+
+        func = callee;
+        code = &func->code;
+        local = locals.data() + localsBase;
+        pc = 0;
+        WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Executing function '" << func->name << "' (index " << func->index << ").\n");
+    };
 
-            BlockInfo target = blockStack[blockStack.size() - 1 - depth];
-            std::cout << "\033[1;36m[executor:br_if]\033[0m → target "
-                    << (target.isLoop ? "loop" : "block")
-                    << " (pc=" << target.startPC << ")\n";
+    // Imported function: the host reads its arguments in place, and its result
+    // (if the import has one) replaces them on the stack
+    auto callHost = [&](const FuncImport& imp) {
+        if (!imp.fn) throw WasmTrap("unresolved import " + imp.module + "." + imp.field);
+        size_t paramCount = imp.type.params.size();
+        if (!Validated && stack.size() - stackBase < paramCount)
+            throw WasmTrap("stack underflow calling import " + imp.module + "." + imp.field);
+        size_t argBase = stack.size() - paramCount;
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:call]\033[0m Calling host function "
+                  << imp.module << "." << imp.field << "\n");
+        WasmValue result = imp.fn(instance, paramCount ? &stack.at(argBase) : nullptr);
+        stack.unwind(argBase, 0);
+        if (imp.type.resultType != "void") push(result);
+    };
 
-            if (target.isLoop) {
-                std::cout << "\033[1;36m[executor:br_if]\033[0m → continue loop\n";
-                pc = target.startPC;
-            } else {
-                int open = 0;
-                int toClose = depth + 1;
-
-                for (++pc; pc < func.body.size(); ++pc) {
-                    std::string t = firstTok(func.body[pc]);
-                    if (t == "block" || t == "loop") {
-                        ++open;
-                    } else if (t == "end") {
-                        if (open == 0) {
-                            --toClose;
-                            if (toClose == 0) break;
-                        } else {
-                            --open;
-                        }
-                    }
-                }
-                int pops = depth + 1;
-                while (pops-- > 0 && !blockStack.empty())
-                    blockStack.pop_back();
-                continue;
-            }
-            continue;
-        } else if (op == "br") {
-            std::string tok; iss >> tok; 
-            int32_t depth = tok.empty() ? 0 : resolveDepth(tok);
-            std::cout << "\033[1;36m[executor:br]\033[0m depth=" << depth << "\n";
-
-            if (depth < 0 || depth >= static_cast<int32_t>(blockStack.size())) {
-                std::cerr << "\033[1;31m[executor:br]\033[0m invalid depth!\n";
-                continue;
-            }
+    // Tiered execution: a callee promoted to the register tier runs there to completion,
+    // reading its arguments in place like a host function. False if it is not promoted,
+    // or if the tiers are nested too deep to switch again; it then runs here.
+    auto callOptimized = [&](const FuncDef* callee) {
+        if (!tiering || !tiering->hotCall(*callee) || !tiering->canNest()) return false;
+        checkDepth();
+        size_t paramCount = callee->params.size();
+        if (!Validated && stack.size() - stackBase < paramCount)
+            throw WasmTrap("stack underflow calling function " + std::to_string(callee->index));
+        size_t argBase = stack.size() - paramCount;
+        WasmSlot result;
+        bool hasResult = tiering->callOptimized(*callee, paramCount ? &stack.at(argBase) : nullptr,
+                                                activeCalls() + 1, result);
+        stack.unwind(argBase, 0);
+        if (hasResult) push(WasmValue(callee->result.type, result));
+        local = locals.data() + localsBase;
+        return true;
+    };
 
-            BlockInfo target = blockStack[blockStack.size() - 1 - depth];
-            std::cout << "\033[1;36m[executor:br]\033[0m → target "
-                    << (target.isLoop ? "loop" : "block")
-                    << " (pc=" << target.startPC << ")\n";
+#if WASM_THREADED_DISPATCH
+    static void* const dispatchTable[] = {
+#define X(name, text) &&op_##name,
+        WASM_OPCODES(X)
+#undef X
+    };
+    DISPATCH();
+#else
+    for (;;) {
+    DISPATCH();
+    switch (ip->op) {
+#endif
+
+    CASE(I32Const) push(WasmValue(ip->imm.i32)); NEXT();
+    CASE(I64Const) push(WasmValue(ip->imm.i64)); NEXT();
+    CASE(F32Const) push(WasmValue(ip->imm.f32)); NEXT();
+    CASE(F64Const) push(WasmValue(ip->imm.f64)); NEXT();
+
+    CASE(Select) {
+        WasmValue cond = pop();
+        WasmValue b = pop();
+        WasmValue a = pop();
+        WasmValue result = (cond.i32 != 0) ? a : b;
+        if (WASM_TRACE_ON(Exec, Debug)) {
+            std::cout << "\033[1;36m[select]\033[0m cond=" << cond.i32 << " → selected=";
+            printValue(result);
+            std::cout << "\n";
+        }
+        push(result);
+        NEXT();
+    }
 
-            if (target.isLoop) {
-                std::cout << "\033[1;36m[executor:br]\033[0m → continue loop\n";
-                pc = target.startPC;
-            } else {
-                int open = 0;
-                int toClose = depth + 1;
-
-                for (++pc; pc < func.body.size(); ++pc) {
-                    std::string t = firstTok(func.body[pc]);
-                    if (t == "block" || t == "loop") {
-                        ++open;
-                    } else if (t == "end") {
-                        if (open == 0) {
-                            --toClose;
-                            if (toClose == 0) break;
-                        } else {
-                            --open;
-                        }
-                    }
-                }
-                std::cout << "\033[1;36m[executor:br]\033[0m → break to end of block\n";
-                int pops = depth + 1;
-                while (pops-- > 0 && !blockStack.empty())
-                    blockStack.pop_back();
-                continue;
-            }
-            continue;
-        } else if (op == "end") {
-            if (!blockStack.empty()) blockStack.pop_back();
-            if (!skipStack.empty()) skipStack.pop_back();
-            std::cout << "\033[1;36m[executor:end]\033[0m block end\n";
-            continue;
-        } else if (op == "drop") {
-            if (!stack.empty()) {
-                WasmValue dropped = stack.pop();
-                std::cout << "\033[1;36m[executor:drop]\033[0m dropped value \n";
-            } else {
-                std::cerr << "\033[1;31m[executor:drop]\033[0m Error: stack underflow!\n";
-            }
-            continue;
-        } else if (op == "nop") {
-            std::cout << "\033[1;36m[executor:nop]\033[0m (no operation)\n";
-            continue;
-        } else if (op == "loop") {
-            std::string lbl;
-            if (iss >> lbl && !lbl.empty() && lbl[0] == '$') {
-                std::cout << "\033[1;36m[executor:loop]\033[0m begin loop " << lbl << " (pc=" << pc << ")\n";
-                blockStack.push_back({pc, true, lbl});
-            } else {
-                std::cout << "\033[1;36m[executor:loop]\033[0m begin loop (pc=" << pc << ")\n";
-                blockStack.push_back({pc, true, ""});
-            }
-            continue;
-        } else if (op == "br_table") {
-            std::vector<std::string> labels;
-            std::string tok;
-            while (iss >> tok)
-                labels.push_back(tok);
-            if (labels.empty()) {
-                std::cerr << "\033[1;31m[executor:br_table]\033[0m no labels found!\n";
-                continue;
-            }
-            WasmValue indexVal = stack.pop();
-            uint32_t index = static_cast<uint32_t>(indexVal.i32);
-            std::cout << "\033[1;36m[executor:br_table]\033[0m index=" << index << " → ";
-            std::string targetLabel = (index < labels.size() - 1) 
-                ? labels[index] 
-                : labels.back();
-            std::cout << "target=" << targetLabel << "\n";
-            int depth = resolveDepth(targetLabel);
-            if (depth < 0 || depth >= static_cast<int32_t>(blockStack.size())) {
-                std::cerr << "\033[1;31m[executor:br_table]\033[0m invalid depth for label "
-                          << targetLabel << "!\n";
-                continue;
-            }
-            BlockInfo target = blockStack[blockStack.size() - 1 - depth];
-            std::cout << "\033[1;36m[executor:br_table]\033[0m → target "
-                      << (target.isLoop ? "loop" : "block")
-                      << " (pc=" << target.startPC << ")\n";
-
-            if (target.isLoop) {
-                std::cout << "\033[1;36m[executor:br_table]\033[0m → continue loop\n";
-                pc = target.startPC;
-            } else {
-                int open = 0;
-                int toClose = depth + 1;
-                for (++pc; pc < func.body.size(); ++pc) {
-                    std::string t = firstTok(func.body[pc]);
-                    if (t == "block" || t == "loop") {
-                        ++open;
-                    } else if (t == "end") {
-                        if (open == 0) {
-                            --toClose;
-                            if (toClose == 0) break;
-                        } else {
-                            --open;
-                        }
-                    }
-                }
-                std::cout << "\033[1;36m[executor:br_table]\033[0m → break to end of block\n";
-                int pops = depth + 1;
-                while (pops-- > 0 && !blockStack.empty())
-                    blockStack.pop_back();
-
-                continue;
-            }
-            continue;
-        } else if (op == "i32.reinterpret_f32") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i32.reinterpret_f32]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F32) {
-                std::cerr << "\033[1;31m[executor:i32.reinterpret_f32]\033[0m Error: expected f32 on stack, got different type\n";
-                continue;
-            }
-            int32_t bits;
-            std::memcpy(&bits, &val.f32, sizeof(bits));
-            WasmValue reinterpreted(bits);
-            stack.push(reinterpreted);
-            union {
-                int32_t i;
-                float f;
-            } u;
-            u.i = bits;
-            std::cout << "\033[1;36m[executor:i32.reinterpret_f32]\033[0m "
-                    << "f32=" << val.f32
-                    << " → bit pattern 0x" << std::hex << bits
-                    << std::dec << " (interpreted f32=" << u.f << ")\n";
-        } else if (op == "f32.convert_i32_s") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f32.convert_i32_s]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::I32) {
-                std::cerr << "\033[1;31m[executor:f32.convert_i32_s]\033[0m Error: expected i32 on stack, got different type\n";
-                continue;
-            }
-            float f = static_cast<float>(val.i32);
-            WasmValue result(f);
-            stack.push(result);
-            std::cout << "\033[1;36m[executor:f32.convert_i32_s]\033[0m "
-                    << "i32=" << val.i32 << " → f32=" << f << "\n";
-        } else if (op == "f32.convert_i32_u") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f32.convert_i32_u]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::I32) {
-                std::cerr << "\033[1;31m[executor:f32.convert_i32_u]\033[0m Error: expected i32\n";
-                continue;
-            }
-            float f = static_cast<float>(static_cast<uint32_t>(val.i32));
-            stack.push(WasmValue(f));
-            std::cout << "\033[1;36m[executor:f32.convert_i32_u]\033[0m i32=" << val.i32 << " → f32=" << f << "\n";
-        } else if (op == "i32.trunc_f32_s") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f32_s]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F32) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f32_s]\033[0m Error: expected f32\n";
-                continue;
-            }
-            int32_t i = static_cast<int32_t>(std::trunc(val.f32));
-            stack.push(WasmValue(i));
-            std::cout << "\033[1;36m[executor:i32.trunc_f32_s]\033[0m f32=" << val.f32 << " → i32=" << i << "\n";
-        } else if (op == "i32.trunc_f32_u") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f32_u]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F32) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f32_u]\033[0m Error: expected f32\n";
-                continue;
-            }
-            uint32_t i = static_cast<uint32_t>(std::trunc(val.f32));
-            stack.push(WasmValue(static_cast<int32_t>(i)));
-            std::cout << "\033[1;36m[executor:i32.trunc_f32_u]\033[0m f32=" << val.f32 << " → u32=" << i << "\n";
-        } else if (op == "f64.convert_i32_s") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f64.convert_i32_s]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::I32) {
-                std::cerr << "\033[1;31m[executor:f64.convert_i32_s]\033[0m Error: expected i32\n";
-                continue;
-            }
-            double d = static_cast<double>(val.i32);
-            stack.push(WasmValue(d));
-            std::cout << "\033[1;36m[executor:f64.convert_i32_s]\033[0m i32=" << val.i32 << " → f64=" << d << "\n";
-        } else if (op == "i32.trunc_f64_s") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f64_s]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F64) {
-                std::cerr << "\033[1;31m[executor:i32.trunc_f64_s]\033[0m Error: expected f64\n";
-                continue;
-            }
-            int32_t i = static_cast<int32_t>(std::trunc(val.f64));
-            stack.push(WasmValue(i));
-            std::cout << "\033[1;36m[executor:i32.trunc_f64_s]\033[0m f64=" << val.f64 << " → i32=" << i << "\n";
-        } else if (op == "f64.promote_f32") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f64.promote_f32]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F32) {
-                std::cerr << "\033[1;31m[executor:f64.promote_f32]\033[0m Error: expected f32\n";
-                continue;
-            }
-            double d = static_cast<double>(val.f32);
-            stack.push(WasmValue(d));
-            std::cout << "\033[1;36m[executor:f64.promote_f32]\033[0m f32=" << val.f32 << " → f64=" << d << "\n";
-        } else if (op == "f32.demote_f64") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f32.demote_f64]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F64) {
-                std::cerr << "\033[1;31m[executor:f32.demote_f64]\033[0m Error: expected f64\n";
-                continue;
-            }
-            float f = static_cast<float>(val.f64);
-            stack.push(WasmValue(f));
-            std::cout << "\033[1;36m[executor:f32.demote_f64]\033[0m f64=" << val.f64 << " → f32=" << f << "\n";
-        } else if (op == "f32.reinterpret_i32") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:f32.reinterpret_i32]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::I32) {
-                std::cerr << "\033[1;31m[executor:f32.reinterpret_i32]\033[0m Error: expected i32\n";
-                continue;
-            }
-            float f;
-            std::memcpy(&f, &val.i32, sizeof(f));
-            stack.push(WasmValue(f));
-            std::cout << "\033[1;36m[executor:f32.reinterpret_i32]\033[0m i32=0x" << std::hex << val.i32
-                    << std::dec << " → f32=" << f << "\n";
-        } else if (op == "i64.reinterpret_f64") {
-            if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i64.reinterpret_f64]\033[0m Error: stack underflow\n";
-                continue;
-            }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::F64) {
-                std::cerr << "\033[1;31m[executor:i64.reinterpret_f64]\033[0m Error: expected f64\n";
-                continue;
-            }
-            int64_t bits;
-            std::memcpy(&bits, &val.f64, sizeof(bits));
-            stack.push(WasmValue(bits));
-            std::cout << "\033[1;36m[executor:i64.reinterpret_f64]\033[0m f64=" << val.f64
-                    << " → bits=0x" << std::hex << bits << std::dec << "\n";
-        } else if (op == "i32.wrap_i64") {
+    CASE(Return)
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:return]\033[0m returning from function "
+                  << (func->name.empty() ? "[anon]" : func->name) << "\n");
+        pc = code->size();
+        NEXT();
+
+    CASE(Call) {
+        // WasmModule has turned every call by a known name into one by index
+        if (ip->b) {
+            *errors << "\033[1;31m[executor:call]\033[0m Error: function name '"
+                      << sym(ip->a) << "' not found!\n";
+            NEXT();
+        }
+        if (ip->a < instance.funcImports.size()) {
+            callHost(instance.funcImports[ip->a]);
+            NEXT();
+        }
+        const FuncDef* callee = ip->a < functions.size() ? functions[ip->a] : nullptr;
+        if (!callee) {
+            *errors << "\033[1;31m[executor:call]\033[0m Error: function index "
+                      << ip->a << " not found!\n";
+            NEXT();
+        }
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:call]\033[0m Calling function index "
+                  << ip->a << " (" << (callee->name.empty() ? "[anon]" : callee->name) << ")\n");
+        if (!callOptimized(callee)) enterFunction(callee);
+        NEXT();
+    }
+
+    CASE(CallIndirect) {
+        uint32_t slot = static_cast<uint32_t>(pop().i32);
+        WasmTable& table = instance.tables.at(ip->b);
+        // Per-site cache: valid while the same slot is hit and the table is unchanged
+        if (callCaches.size() <= static_cast<size_t>(func->index)) callCaches.resize(func->index + 1);
+        std::vector<IndirectCallCache>& sites = callCaches[func->index];
+        if (sites.size() < func->indirectCallSites) sites.resize(func->indirectCallSites);
+        IndirectCallCache& cache = sites[ip->imm.i32];
+        if (cache.slot != slot || cache.epoch != table.epoch()) {
+            if (slot >= table.size()) throw WasmTrap("undefined element");
+            int32_t ref = table.get(slot);
+            if (ref == NULL_REF) throw WasmTrap("uninitialized element");
+            if (static_cast<uint32_t>(ref) < instance.funcImports.size()) {
+                // Host functions have no FuncDef to cache; they are checked on every call
+                const FuncImport& imp = instance.funcImports[ref];
+                if (imp.typeId != ip->a) throw WasmTrap("indirect call type mismatch");
+                callHost(imp);
+                NEXT();
+            }
+            const FuncDef* target = static_cast<size_t>(ref) < functions.size() ? functions[ref] : nullptr;
+            if (!target) throw WasmTrap("uninitialized element");
+            if (target->typeId != ip->a) throw WasmTrap("indirect call type mismatch");
+            cache.slot = slot;
+            cache.epoch = table.epoch();
+            cache.target = target;
+        }
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:call_indirect]\033[0m table[" << slot << "] → function index "
+                  << cache.target->index << "\n");
+        if (!callOptimized(cache.target)) enterFunction(cache.target);
+        NEXT();
+    }
+
+    CASE(RefNull) push(WasmValue(NULL_REF)); NEXT();
+    CASE(RefIsNull) push(WasmValue(static_cast<int32_t>(pop().i32 == NULL_REF))); NEXT();
+    CASE(RefFunc) push(WasmValue(static_cast<int32_t>(ip->a))); NEXT();
+
+    CASE(TableGet) {
+        uint32_t i = static_cast<uint32_t>(pop().i32);
+        const WasmTable& table = instance.tables.at(ip->a);
+        if (i >= table.size()) throw WasmTrap("out of bounds table access");
+        push(WasmValue(table.get(i)));
+        NEXT();
+    }
+    CASE(TableSet) {
+        int32_t ref = pop().i32;
+        uint32_t i = static_cast<uint32_t>(pop().i32);
+        WasmTable& table = instance.tables.at(ip->a);
+        if (i >= table.size()) throw WasmTrap("out of bounds table access");
+        table.set(i, ref);
+        NEXT();
+    }
+    CASE(TableSize) push(WasmValue(static_cast<int32_t>(instance.tables.at(ip->a).size()))); NEXT();
+    CASE(TableGrow) {
+        uint32_t delta = static_cast<uint32_t>(pop().i32);
+        int32_t ref = pop().i32;
+        push(WasmValue(instance.tables.at(ip->a).grow(delta, ref)));
+        NEXT();
+    }
+    CASE(TableFill) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        int32_t ref = pop().i32;
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        if (!instance.tables.at(ip->a).fill(dst, ref, n)) throw WasmTrap("out of bounds table access");
+        NEXT();
+    }
+    CASE(TableCopy) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        uint32_t src = static_cast<uint32_t>(pop().i32);
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        if (!instance.tables.at(ip->a).copy(dst, instance.tables.at(ip->b), src, n))
+            throw WasmTrap("out of bounds table access");
+        NEXT();
+    }
+    CASE(TableInit) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        uint32_t src = static_cast<uint32_t>(pop().i32);
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        if (ip->a >= instance.elemSegments.size())
+            throw WasmTrap("table.init: unknown element segment " + std::to_string(ip->a));
+        // A dropped segment behaves as if it were empty
+        static const std::vector<int32_t> empty;
+        const std::vector<int32_t>& refs = instance.droppedElems[ip->a] ? empty : instance.elemSegments[ip->a].refs;
+        if (!instance.tables.at(ip->b).init(dst, refs, src, n)) throw WasmTrap("out of bounds table access");
+        NEXT();
+    }
+    CASE(ElemDrop)
+        if (ip->a < instance.droppedElems.size()) instance.droppedElems[ip->a] = true;
+        NEXT();
+
+    CASE(MemorySize) {
+        int32_t pages = memory.size();
+        push(WasmValue(pages));
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:memory.size]\033[0m → pages=" << pages << "\n");
+        NEXT();
+    }
+    CASE(MemoryGrow) {
+        if constexpr (!Validated) {
             if (stack.empty()) {
-                std::cerr << "\033[1;31m[executor:i32.wrap_i64]\033[0m Error: stack underflow\n";
-                continue;
+                *errors << "\033[1;31m[executor:memory.grow]\033[0m Error: stack underflow\n";
+                NEXT();
             }
-            WasmValue val = stack.pop();
-            if (val.type != ValueType::I64) {
-                std::cerr << "\033[1;31m[executor:i32.wrap_i64]\033[0m Error: expected i64\n";
-                continue;
+        }
+        WasmValue pages = pop();
+        if constexpr (!Validated) {
+            if (pages.type != ValueType::I32) {
+                *errors << "\033[1;31m[executor:memory.grow]\033[0m Error: expected i32 argument\n";
+                NEXT();
             }
-            int32_t truncated = static_cast<int32_t>(val.i64);
-            stack.push(WasmValue(truncated));
-            std::cout << "\033[1;36m[executor:i32.wrap_i64]\033[0m i64=" << val.i64
-                    << " → i32=" << truncated << "\n";
-        } else if (op.rfind("i32.", 0) == 0) {
-            if (op == "i32.add") binaryOp([](int32_t a, int32_t b){ return a + b; }, op, ValueType::I32);
-            else if (op == "i32.sub") binaryOp([](int32_t a, int32_t b){ return a - b; }, op, ValueType::I32);
-            else if (op == "i32.mul") binaryOp([](int32_t a, int32_t b){ return a * b; }, op, ValueType::I32);
-            else if (op == "i32.and") binaryOp([](int32_t a, int32_t b){ return a & b; }, op, ValueType::I32);
-            else if (op == "i32.or") binaryOp([](int32_t a, int32_t b){ return a | b; }, op, ValueType::I32);
-            else if (op == "i32.xor") binaryOp([](int32_t a, int32_t b){ return a ^ b; }, op, ValueType::I32);
-            else if (op == "i32.min") binaryOp([](int32_t a, int32_t b){ return a < b ? a : b; }, op, ValueType::I32);
-            else if (op == "i32.max") binaryOp([](int32_t a, int32_t b){ return a > b ? a : b; }, op, ValueType::I32);
-            else if (op == "i32.abs") unaryOp([](int32_t a){ return a < 0 ? -a : a; }, op, ValueType::I32);
-            else if (op == "i32.neg") unaryOp([](int32_t a){ return -a; }, op, ValueType::I32);
-            else if (op == "i32.shl") binaryOp([](int32_t a, int32_t b){ return a << (b & 31); }, op, ValueType::I32);
-            else if (op == "i32.shr_s") binaryOp([](int32_t a, int32_t b){ return a >> (b & 31); }, op, ValueType::I32);
-            else if (op == "i32.shr_u") binaryOp([](int32_t a, int32_t b){ return static_cast<int32_t>(static_cast<uint32_t>(a) >> (b & 31)); }, op, ValueType::I32);
-            else if (op == "i32.rotl") binaryOp([](uint32_t a, uint32_t b){ return (a << (b & 31)) | (a >> ((32 - b) & 31)); }, op, ValueType::I32);
-            else if (op == "i32.rotr") binaryOp([](uint32_t a, uint32_t b){ return (a >> (b & 31)) | (a << ((32 - b) & 31)); }, op, ValueType::I32);
-            else if (op == "i32.div_s") binaryOp(safeDiv32, op, ValueType::I32);
-            else if (op == "i32.div_u") binaryOp([](int32_t a, int32_t b){ return b==0?0:static_cast<int32_t>(static_cast<uint32_t>(a)/static_cast<uint32_t>(b)); }, op, ValueType::I32);
-            else if (op == "i32.rem_s") binaryOp(safeRem32, op, ValueType::I32);
-            else if (op == "i32.rem_u") binaryOp([](int32_t a, int32_t b){ return b==0?0:static_cast<int32_t>(static_cast<uint32_t>(a)%static_cast<uint32_t>(b)); }, op, ValueType::I32);
-            else if (op == "i32.eq") cmpOp([](int32_t a, int32_t b){return a==b;}, op, ValueType::I32);
-            else if (op == "i32.ne") cmpOp([](int32_t a, int32_t b){return a!=b;}, op, ValueType::I32);
-            else if (op == "i32.lt_s") cmpOp([](int32_t a, int32_t b){return a<b;}, op, ValueType::I32);
-            else if (op == "i32.lt_u") cmpOp([](uint32_t a, uint32_t b){return a<b;}, op, ValueType::I32);
-            else if (op == "i32.gt_s") cmpOp([](int32_t a, int32_t b){return a>b;}, op, ValueType::I32);
-            else if (op == "i32.gt_u") cmpOp([](uint32_t a, uint32_t b){return a>b;}, op, ValueType::I32);
-            else if (op == "i32.le_s") cmpOp([](int32_t a, int32_t b){return a<=b;}, op, ValueType::I32);
-            else if (op == "i32.le_u") cmpOp([](uint32_t a, uint32_t b){return a<=b;}, op, ValueType::I32);
-            else if (op == "i32.ge_s") cmpOp([](int32_t a, int32_t b){return a>=b;}, op, ValueType::I32);
-            else if (op == "i32.ge_u") cmpOp([](uint32_t a, uint32_t b){return a>=b;}, op, ValueType::I32);
-            else if (op == "i32.eqz") unaryOp([](int32_t a){return a==0?1:0;}, op, ValueType::I32);
-            else if (op == "i32.clz") unaryOp([](uint32_t a){return a==0?32:countl_zero32(a);}, op, ValueType::I32);
-            else if (op == "i32.ctz") unaryOp([](uint32_t a){return a==0?32:countr_zero32(a);}, op, ValueType::I32);
-            else if (op == "i32.popcnt") unaryOp([](uint32_t a){return popcount32(a);}, op, ValueType::I32);
-            continue;
-        } else if (op.rfind("i64.", 0) == 0) {
-            if (op == "i64.add") binaryOp([](int64_t a, int64_t b){ return a + b; }, op, ValueType::I64);
-            else if (op == "i64.sub") binaryOp([](int64_t a, int64_t b){ return a - b; }, op, ValueType::I64);
-            else if (op == "i64.mul") binaryOp([](int64_t a, int64_t b){ return a * b; }, op, ValueType::I64);
-            else if (op == "i64.and") binaryOp([](int64_t a, int64_t b){ return a & b; }, op, ValueType::I64);
-            else if (op == "i64.or") binaryOp([](int64_t a, int64_t b){ return a | b; }, op, ValueType::I64);
-            else if (op == "i64.xor") binaryOp([](int64_t a, int64_t b){ return a ^ b; }, op, ValueType::I64);
-            else if (op == "i64.min") binaryOp([](int64_t a, int64_t b){ return a < b ? a : b; }, op, ValueType::I64);
-            else if (op == "i64.max") binaryOp([](int64_t a, int64_t b){ return a > b ? a : b; }, op, ValueType::I64);
-            else if (op == "i64.abs") unaryOp([](int64_t a){ return a < 0 ? -a : a; }, op, ValueType::I64);
-            else if (op == "i64.neg") unaryOp([](int64_t a){ return -a; }, op, ValueType::I64);
-            else if (op == "i64.shl") binaryOp([](int64_t a, int64_t b){ return a << (b & 63); }, op, ValueType::I64);
-            else if (op == "i64.shr_s") binaryOp([](int64_t a, int64_t b){ return a >> (b & 63); }, op, ValueType::I64);
-            else if (op == "i64.shr_u") binaryOp([](int64_t a, int64_t b){ return static_cast<int64_t>(static_cast<uint64_t>(a) >> (b & 63)); }, op, ValueType::I64);
-            else if (op == "i64.rotl") binaryOp([](uint64_t a, uint64_t b){ return (a << (b & 63)) | (a >> ((64 - b) & 63)); }, op, ValueType::I64);
-            else if (op == "i64.rotr") binaryOp([](uint64_t a, uint64_t b){ return (a >> (b & 63)) | (a << ((64 - b) & 63)); }, op, ValueType::I64);
-            else if (op == "i64.div_s") binaryOp(safeDiv64, op, ValueType::I64);
-            else if (op == "i64.div_u") binaryOp([](int64_t a, int64_t b){ return b==0?0:static_cast<int64_t>(static_cast<uint64_t>(a)/static_cast<uint64_t>(b)); }, op, ValueType::I64);
-            else if (op == "i64.rem_s") binaryOp(safeRem64, op, ValueType::I64);
-            else if (op == "i64.rem_u") binaryOp([](int64_t a, int64_t b){ return b==0?0:static_cast<int64_t>(static_cast<uint64_t>(a)%static_cast<uint64_t>(b)); }, op, ValueType::I64);
-            else if (op == "i64.eq") cmpOp([](int64_t a, int64_t b){return a==b;}, op, ValueType::I64);
-            else if (op == "i64.ne") cmpOp([](int64_t a, int64_t b){return a!=b;}, op, ValueType::I64);
-            else if (op == "i64.lt_s") cmpOp([](int64_t a, int64_t b){return a<b;}, op, ValueType::I64);
-            else if (op == "i64.lt_u") cmpOp([](uint64_t a, uint64_t b){return a<b;}, op, ValueType::I64);
-            else if (op == "i64.gt_s") cmpOp([](int64_t a, int64_t b){return a>b;}, op, ValueType::I64);
-            else if (op == "i64.gt_u") cmpOp([](uint64_t a, uint64_t b){return a>b;}, op, ValueType::I64);
-            else if (op == "i64.le_s") cmpOp([](int64_t a, int64_t b){return a<=b;}, op, ValueType::I64);
-            else if (op == "i64.le_u") cmpOp([](uint64_t a, uint64_t b){return a<=b;}, op, ValueType::I64);
-            else if (op == "i64.ge_s") cmpOp([](int64_t a, int64_t b){return a>=b;}, op, ValueType::I64);
-            else if (op == "i64.ge_u") cmpOp([](uint64_t a, uint64_t b){return a>=b;}, op, ValueType::I64);
-            else if (op == "i64.eqz") unaryOp([](int64_t a){return a==0?1:0;}, op, ValueType::I64);
-            else if (op == "i64.clz") unaryOp([](uint64_t a){return a==0?64:countl_zero64(a);}, op, ValueType::I64);
-            else if (op == "i64.ctz") unaryOp([](uint64_t a){return a==0?64:countr_zero64(a);}, op, ValueType::I64);
-            else if (op == "i64.popcnt") unaryOp([](uint64_t a){return popcount64(a);}, op, ValueType::I64);
-            continue;
-        } else if (op.rfind("f32.", 0) == 0) {
-            if (op == "f32.add") binaryOp([](float a, float b){ return a + b; }, op, ValueType::F32);
-            else if (op == "f32.sub") binaryOp([](float a, float b){ return a - b; }, op, ValueType::F32);
-            else if (op == "f32.mul") binaryOp([](float a, float b){ return a * b; }, op, ValueType::F32);
-            else if (op == "f32.div") binaryOp([](float a, float b){ return a / b; }, op, ValueType::F32);
-            else if (op == "f32.min") binaryOp([](float a, float b){ return a < b ? a : b; }, op, ValueType::F32);
-            else if (op == "f32.max") binaryOp([](float a, float b){ return a > b ? a : b; }, op, ValueType::F32);
-            else if (op == "f32.abs") unaryOp([](float a){ return a < 0 ? -a : a; }, op, ValueType::F32);
-            else if (op == "f32.neg") unaryOp([](float a){ return -a; }, op, ValueType::F32);
-            else if (op == "f32.sqrt") unaryOp([](float a){ return std::sqrt(a); }, op, ValueType::F32);
-            else if (op == "f32.ceil") unaryOp([](float a){ return std::ceil(a); }, op, ValueType::F32);
-            else if (op == "f32.floor") unaryOp([](float a){ return std::floor(a); }, op, ValueType::F32);
-            else if (op == "f32.trunc") unaryOp([](float a){ return std::trunc(a); }, op, ValueType::F32);
-            else if (op == "f32.nearest") unaryOp([](float a){ return std::nearbyint(a); }, op, ValueType::F32);
-            else if (op == "f32.eq") cmpOp([](float a, float b){return a==b;}, op, ValueType::F32);
-            else if (op == "f32.ne") cmpOp([](float a, float b){return a!=b;}, op, ValueType::F32);
-            else if (op == "f32.lt") cmpOp([](float a, float b){return a<b;}, op, ValueType::F32);
-            else if (op == "f32.gt") cmpOp([](float a, float b){return a>b;}, op, ValueType::F32);
-            else if (op == "f32.le") cmpOp([](float a, float b){return a<=b;}, op, ValueType::F32);
-            else if (op == "f32.ge") cmpOp([](float a, float b){return a>=b;}, op, ValueType::F32);
-            continue;
-        } else if (op.rfind("f64.", 0) == 0) {
-            if (op == "f64.add") binaryOp([](double a, double b){ return a + b; }, op, ValueType::F64);
-            else if (op == "f64.sub") binaryOp([](double a, double b){ return a - b; }, op, ValueType::F64);
-            else if (op == "f64.mul") binaryOp([](double a, double b){ return a * b; }, op, ValueType::F64);
-            else if (op == "f64.div") binaryOp([](double a, double b){ return a / b; }, op, ValueType::F64);
-            else if (op == "f64.min") binaryOp([](double a, double b){ return a < b ? a : b; }, op, ValueType::F64);
-            else if (op == "f64.max") binaryOp([](double a, double b){ return a > b ? a : b; }, op, ValueType::F64);
-            else if (op == "f64.abs") unaryOp([](double a){ return a < 0 ? -a : a; }, op, ValueType::F64);
-            else if (op == "f64.neg") unaryOp([](double a){ return -a; }, op, ValueType::F64);
-            else if (op == "f64.sqrt") unaryOp([](double a){ return std::sqrt(a); }, op, ValueType::F64);
-            else if (op == "f64.ceil") unaryOp([](double a){ return std::ceil(a); }, op, ValueType::F64);
-            else if (op == "f64.floor") unaryOp([](double a){ return std::floor(a); }, op, ValueType::F64);
-            else if (op == "f64.trunc") unaryOp([](double a){ return std::trunc(a); }, op, ValueType::F64);
-            else if (op == "f64.nearest") unaryOp([](double a){ return std::nearbyint(a); }, op, ValueType::F64);
-            else if (op == "f64.eq") cmpOp([](double a, double b){return a==b;}, op, ValueType::F64);
-            else if (op == "f64.ne") cmpOp([](double a, double b){return a!=b;}, op, ValueType::F64);
-            else if (op == "f64.lt") cmpOp([](double a, double b){return a<b;}, op, ValueType::F64);
-            else if (op == "f64.gt") cmpOp([](double a, double b){return a>b;}, op, ValueType::F64);
-            else if (op == "f64.le") cmpOp([](double a, double b){return a<=b;}, op, ValueType::F64);
-            else if (op == "f64.ge") cmpOp([](double a, double b){return a>=b;}, op, ValueType::F64);
-            continue;
+        }
+        int32_t oldPages = memory.grow(pages.i32);
+        push(WasmValue(oldPages));
+        NEXT();
+    }
+    CASE(MemoryCopy) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        uint32_t src = static_cast<uint32_t>(pop().i32);
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        memory.copy(dst, src, n);
+        NEXT();
+    }
+    CASE(MemoryFill) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        uint8_t value = static_cast<uint8_t>(pop().i32);
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        memory.fill(dst, value, n);
+        NEXT();
+    }
+    CASE(MemoryInit) {
+        uint32_t n = static_cast<uint32_t>(pop().i32);
+        uint32_t src = static_cast<uint32_t>(pop().i32);
+        uint32_t dst = static_cast<uint32_t>(pop().i32);
+        if (ip->a >= instance.dataSegments.size())
+            throw WasmTrap("memory.init: unknown data segment " + std::to_string(ip->a));
+        // A dropped segment behaves as if it were empty
+        const std::vector<uint8_t>& bytes = instance.dataSegments[ip->a].bytes;
+        uint64_t available = instance.droppedData[ip->a] ? 0 : bytes.size();
+        if (static_cast<uint64_t>(src) + n > available)
+            throw WasmTrap("memory.init: out of bounds data segment access");
+        memory.write(dst, bytes.data() + src, n);
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:memory.init]\033[0m segment " << ip->a << "[" << src
+                  << ".." << src + n << ") → " << dst << "\n");
+        NEXT();
+    }
+    CASE(DataDrop)
+        if (ip->a < instance.droppedData.size()) instance.droppedData[ip->a] = true;
+        NEXT();
+
+    CASE(I32Store8)  doStore([&](uint64_t a, WasmValue v){ memory.store8(a, static_cast<uint8_t>(v.i32)); }, ip->a); NEXT();
+    CASE(I32Store16) doStore([&](uint64_t a, WasmValue v){ memory.store16(a, static_cast<uint16_t>(v.i32)); }, ip->a); NEXT();
+    CASE(I32Store)   doStore([&](uint64_t a, WasmValue v){ memory.store32(a, v.i32); }, ip->a); NEXT();
+    CASE(I64Store8)  doStore([&](uint64_t a, WasmValue v){ memory.store8(a, static_cast<uint8_t>(v.i64)); }, ip->a); NEXT();
+    CASE(I64Store16) doStore([&](uint64_t a, WasmValue v){ memory.store16(a, static_cast<uint16_t>(v.i64)); }, ip->a); NEXT();
+    CASE(I64Store32) doStore([&](uint64_t a, WasmValue v){ memory.store32(a, static_cast<int32_t>(v.i64)); }, ip->a); NEXT();
+    CASE(I64Store)   doStore([&](uint64_t a, WasmValue v){ memory.store64(a, v.i64); }, ip->a); NEXT();
+    CASE(F32Store)   doStore([&](uint64_t a, WasmValue v){ memory.storeF32(a, v.f32); }, ip->a); NEXT();
+    CASE(F64Store)   doStore([&](uint64_t a, WasmValue v){ memory.storeF64(a, v.f64); }, ip->a); NEXT();
+
+    CASE(I32Load8S)  doLoad([&](uint64_t a){ return static_cast<int8_t>(memory.load8(a)); }, [](int8_t x){return static_cast<int32_t>(x);}, ValueType::I32, ip->a); NEXT();
+    CASE(I32Load8U)  doLoad([&](uint64_t a){ return memory.load8(a); }, [](uint8_t x){return static_cast<int32_t>(x);}, ValueType::I32, ip->a); NEXT();
+    CASE(I32Load16S) doLoad([&](uint64_t a){ return static_cast<int16_t>(memory.load16(a)); }, [](int16_t x){return static_cast<int32_t>(x);}, ValueType::I32, ip->a); NEXT();
+    CASE(I32Load16U) doLoad([&](uint64_t a){ return memory.load16(a); }, [](uint16_t x){return static_cast<int32_t>(x);}, ValueType::I32, ip->a); NEXT();
+    CASE(I32Load)    doLoad([&](uint64_t a){ return memory.load32(a); }, [](int32_t x){return x;}, ValueType::I32, ip->a); NEXT();
+    CASE(I64Load8S)  doLoad([&](uint64_t a){ return static_cast<int8_t>(memory.load8(a)); }, [](int8_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load8U)  doLoad([&](uint64_t a){ return memory.load8(a); }, [](uint8_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load16S) doLoad([&](uint64_t a){ return static_cast<int16_t>(memory.load16(a)); }, [](int16_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load16U) doLoad([&](uint64_t a){ return memory.load16(a); }, [](uint16_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load32S) doLoad([&](uint64_t a){ return memory.load32(a); }, [](int32_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load32U) doLoad([&](uint64_t a){ return static_cast<uint32_t>(memory.load32(a)); }, [](uint32_t x){return static_cast<int64_t>(x);}, ValueType::I64, ip->a); NEXT();
+    CASE(I64Load)    doLoad([&](uint64_t a){ return memory.load64(a); }, [](int64_t x){return x;}, ValueType::I64, ip->a); NEXT();
+    CASE(F32Load)    doLoad([&](uint64_t a){ return memory.loadF32(a); }, [](float x){return x;}, ValueType::F32, ip->a); NEXT();
+    CASE(F64Load)    doLoad([&](uint64_t a){ return memory.loadF64(a); }, [](double x){return x;}, ValueType::F64, ip->a); NEXT();
+
+    CASE(LocalSet) local[ip->a] = pop(); NEXT();
+    CASE(LocalGet) push(localValue(ip->a)); NEXT();
+    CASE(LocalTee) local[ip->a] = top(); NEXT();
+    CASE(GlobalGet) {
+        const WasmGlobal& g = globals[ip->a];
+        push(WasmValue(g.type, g.value));
+        NEXT();
+    }
+    CASE(GlobalSet) globals[ip->a].value = pop(); NEXT();
+
+    CASE(Block)
+    CASE(Loop)
+        if constexpr (!Validated) labels.push_back(stack.size());
+        NEXT();
+    CASE(If) {
+        WasmValue cond = pop();
+        bool condition = (cond.i32 != 0);
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:if]\033[0m condition=" << cond.i32
+                  << " (" << (condition ? "true" : "false") << ")\n");
+        if constexpr (!Validated) labels.push_back(stack.size());
+        if (!condition) pc = ip->a;
+        NEXT();
+    }
+    CASE(Else)
+        // end of the taken `then` arm
+        pc = ip->b;
+        NEXT();
+    CASE(End)
+        if constexpr (!Validated) {
+            if (labels.size() > labelsBase) labels.pop_back();
+        }
+        NEXT();
+    CASE(Br)
+        branch(pc, func->branches[ip->a], "br");
+        NEXT();
+    CASE(BrIf) {
+        WasmValue cond = pop();
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:br_if]\033[0m condition=" << cond.i32 << "\n");
+        if (cond.i32 != 0) branch(pc, func->branches[ip->a], "br_if");
+        NEXT();
+    }
+    CASE(BrTable) {
+        const std::vector<BranchTarget>& targets = func->brTables[ip->a];
+        if (!Validated && targets.empty()) {
+            *errors << "\033[1;31m[executor:br_table]\033[0m no labels found!\n";
+            NEXT();
+        }
+        uint32_t index = static_cast<uint32_t>(pop().i32);
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:br_table]\033[0m index=" << index << "\n");
+        branch(pc, index < targets.size() - 1 ? targets[index] : targets.back(), "br_table");
+        NEXT();
+    }
+    CASE(Drop)
+        if (Validated || !stack.empty()) {
+            pop();
+            WASM_TRACE(Exec, Debug, "\033[1;36m[executor:drop]\033[0m dropped value \n");
         } else {
-            std::cout << "\033[1;31m[executor:execute]\033[0m Error: Unknown instruction: " << op << "\n";
+            *errors << "\033[1;31m[executor:drop]\033[0m Error: stack underflow!\n";
         }
+        NEXT();
+    CASE(Nop)
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:nop]\033[0m (no operation)\n");
+        NEXT();
+
+#define BINARY(name, type, T, expr) CASE(name) binaryOp([](T a, T b) { return expr; }, ValueType::type); NEXT();
+#define COMPARE(name, type, T, expr) CASE(name) cmpOp([](T a, T b) { return expr; }, ValueType::type); NEXT();
+#define UNARY(name, type, T, expr) CASE(name) unaryOp([](T a) { return expr; }, ValueType::type); NEXT();
+#define CONVERT(name, from, expr) CASE(name) convert(ValueType::from, [](WasmValue v) { return expr; }); NEXT();
+    WASM_NUMERIC_OPS(BINARY, COMPARE, UNARY, CONVERT)
+#undef BINARY
+#undef COMPARE
+#undef UNARY
+#undef CONVERT
+
+    // ---- superinstructions (WasmDecoder::fuse) ----
+    // ip[1], ip[2], ... are the fused instructions, still in place with their immediates;
+    // each handler leaves pc after the last of them.
+    CASE(LocalGet2)
+        push(localValue(ip->a));
+        push(localValue(ip[1].a));
+        pc += 1;
+        NEXT();
+    CASE(LocalGetI32Const)
+        push(localValue(ip->a));
+        push(WasmValue(ip[1].imm.i32));
+        pc += 1;
+        NEXT();
+    CASE(LocalSetGet)
+        local[ip->a] = pop();
+        push(localValue(ip[1].a));
+        pc += 1;
+        NEXT();
+    CASE(LocalI32Load) {
+        uint64_t ea = static_cast<uint64_t>(static_cast<uint32_t>(local[ip->a].i32)) + ip[1].a;
+        int32_t v = memory.load32(ea);
+        push(WasmValue(v));
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:i32.load]\033[0m mem[" << ea << "] → " << static_cast<double>(v) << "\n");
+        pc += 1;
+        NEXT();
+    }
+    CASE(LocalsI32Add)
+        push(WasmValue(add32(local[ip->a].i32, local[ip[1].a].i32)));
+        pc += 2;
+        NEXT();
+    CASE(LocalI32AddImm)
+        push(WasmValue(add32(local[ip->a].i32, ip[1].imm.i32)));
+        pc += 2;
+        NEXT();
+    CASE(LocalI32SubImm)
+        push(WasmValue(sub32(local[ip->a].i32, ip[1].imm.i32)));
+        pc += 2;
+        NEXT();
+    CASE(LocalI32AddImmSet)
+        local[ip[3].a] = WasmValue(add32(local[ip->a].i32, ip[1].imm.i32));
+        pc += 3;
+        NEXT();
+    CASE(I32AddImm)
+        push(WasmValue(add32(pop().i32, ip->imm.i32)));
+        pc += 1;
+        NEXT();
+    CASE(I32SubImm)
+        push(WasmValue(sub32(pop().i32, ip->imm.i32)));
+        pc += 1;
+        NEXT();
+    CASE(I32ShlImm)
+        push(WasmValue(static_cast<int32_t>(static_cast<uint32_t>(pop().i32) << (ip->imm.i32 & 31))));
+        pc += 1;
+        NEXT();
+
+    // Compare, then br_if (ip[1].a: branch side table) or if (ip[1].a: pc when false)
+#define FUSED_COMPARE(name, T, test) \
+    CASE(I32##name##BrIf) { \
+        T y = static_cast<T>(pop().i32), x = static_cast<T>(pop().i32); \
+        if (test) branch(pc, func->branches[ip[1].a], "br_if"); \
+        else pc += 1; \
+        NEXT(); \
+    } \
+    CASE(I32##name##If) { \
+        T y = static_cast<T>(pop().i32), x = static_cast<T>(pop().i32); \
+        if constexpr (!Validated) labels.push_back(stack.size()); \
+        pc = (test) ? pc + 1 : ip[1].a; \
+        NEXT(); \
+    }
+    FUSED_COMPARE(Eq, int32_t, x == y)
+    FUSED_COMPARE(Ne, int32_t, x != y)
+    FUSED_COMPARE(LtS, int32_t, x < y)
+    FUSED_COMPARE(LtU, uint32_t, x < y)
+    FUSED_COMPARE(GtS, int32_t, x > y)
+    FUSED_COMPARE(GtU, uint32_t, x > y)
+    FUSED_COMPARE(LeS, int32_t, x <= y)
+    FUSED_COMPARE(LeU, uint32_t, x <= y)
+    FUSED_COMPARE(GeS, int32_t, x >= y)
+    FUSED_COMPARE(GeU, uint32_t, x >= y)
+#undef FUSED_COMPARE
+    CASE(I32EqzBrIf)
+        if (pop().i32 == 0) branch(pc, func->branches[ip[1].a], "br_if");
+        else pc += 1;
+        NEXT();
+    CASE(I32EqzIf) {
+        bool condition = pop().i32 == 0;
+        if constexpr (!Validated) labels.push_back(stack.size());
+        pc = condition ? pc + 1 : ip[1].a;
+        NEXT();
+    }
+    // i32.const d, i32.div_u / i32.rem_u (WasmOptimizer): ip->a, ip->b are the multiplier and shift
+    CASE(I32DivUImm)
+        push(WasmValue(static_cast<int32_t>(divideByConstant(static_cast<uint32_t>(pop().i32), ip->a, ip->b))));
+        pc += 1;
+        NEXT();
+    CASE(I32RemUImm) {
+        uint32_t x = static_cast<uint32_t>(pop().i32);
+        uint32_t q = divideByConstant(x, ip->a, ip->b);
+        push(WasmValue(static_cast<int32_t>(x - q * static_cast<uint32_t>(ip->imm.i32))));
+        pc += 1;
+        NEXT();
     }
 
-    std::cout << "\033[1;36m[executor:execute]\033[0m Function completed.\n";
-    this->lastStack = stack;
-
+#if !WASM_THREADED_DISPATCH
+    case Opcode::Count:   // not an instruction; only the switch has to name it
+#endif
+    CASE(Unknown)
+        *errors << "\033[1;31m[executor:execute]\033[0m Error: Unknown instruction: "
+                  << (ip->op == Opcode::Unknown ? sym(ip->a).c_str() : opName()) << "\n";
+        NEXT();
+#if !WASM_THREADED_DISPATCH
+    }
+    }
+#endif
 }
+
+#undef FETCH
+#undef CASE
+#undef DISPATCH
+#undef NEXT
@@ -0,0 +1,31 @@
+#include "wasm_host.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_trace.hpp"
+#include <iostream>
+#include <stdexcept>
+
+void WasmHost::define(const std::string& module, const std::string& field, const FuncType& type, HostFunction fn) {
+    functions[module + "." + field] = Entry{type, fn};
+}
+
+size_t WasmHost::link(WasmInstance& instance) const {
+    size_t unbound = 0;
+    for (FuncImport& imp : instance.funcImports) {
+        auto it = functions.find(imp.module + "." + imp.field);
+        if (it == functions.end()) {
+            std::cerr << "\033[1;33m[host:link]\033[0m No host function for import '"
+                      << imp.module << "." << imp.field << "'\n";
+            imp.fn = nullptr;
+            ++unbound;
+            continue;
+        }
+        const FuncType& want = it->second.type;
+        if (want.params != imp.type.params || want.resultType != imp.type.resultType)
+            throw std::runtime_error("\033[1;31m[host:link]\033[0m Import '" + imp.module + "." + imp.field
+                                     + "' does not match the host function's signature");
+        imp.fn = it->second.fn;
+        WASM_TRACE(Parser, Info, "\033[1;34m[host:link]\033[0m Bound import " << imp.module << "."
+                  << imp.field << "\n");
+    }
+    return unbound;
+}
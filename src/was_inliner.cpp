@@ -0,0 +1,282 @@
+#include "wasm_inliner.hpp"
+#include "wasm_module.hpp"
+#include "wasm_validator.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if WASM_OPTIMIZE
+namespace {
+
+using O = Opcode;
+
+struct Function {
+    FuncDef* def = nullptr;
+    bool valid = false;
+    bool recursive = false;
+    std::vector<int> callees;          // direct calls to defined functions
+    // Final body, plain (WasmDecoder::unlink), once the function's own calls are done
+    std::vector<Instr> code;
+    std::vector<std::vector<uint32_t>> depths;
+    size_t size = 0;                   // instructions, nops aside
+};
+
+class Inliner {
+public:
+    Inliner(WasmModule& module, const WasmInstance& instance) : module(module), instance(instance) {}
+
+    void run();
+
+private:
+    WasmModule& module;
+    const WasmInstance& instance;
+    std::vector<Function> functions;   // by index; imports and gaps have no def
+
+    // Tarjan's strongly connected components, which come out callees first
+    std::vector<int> order;
+    std::vector<int> sccIndex, sccLow;
+    std::vector<bool> onStack;
+    std::vector<int> sccStack;
+    int sccCounter = 0;
+
+    int calleeOf(const Instr& in, const FuncDef& caller) const;
+    void visit(int f);
+    void finish(Function& f);
+    bool inlinable(int callee, int caller) const;
+    void inlineInto(int index);
+};
+
+// Function index of a direct call to a defined function; -1 for imports and unknown names
+int Inliner::calleeOf(const Instr& in, const FuncDef& caller) const {
+    int index;
+    if (!in.b) {
+        index = static_cast<int>(in.a);
+    } else {
+        if (in.a >= caller.symbols.size()) return -1;
+        auto it = module.functionByName.find(caller.symbols[in.a]);
+        if (it == module.functionByName.end()) return -1;
+        index = static_cast<int>(it->second);
+    }
+    if (index < static_cast<int>(instance.funcImports.size()) || index >= static_cast<int>(functions.size()))
+        return -1;
+    return functions[index].def ? index : -1;
+}
+
+void Inliner::visit(int f) {
+    sccIndex[f] = sccLow[f] = sccCounter++;
+    sccStack.push_back(f);
+    onStack[f] = true;
+    for (int g : functions[f].callees) {
+        if (sccIndex[g] < 0) {
+            visit(g);
+            sccLow[f] = std::min(sccLow[f], sccLow[g]);
+        } else if (onStack[g]) {
+            sccLow[f] = std::min(sccLow[f], sccIndex[g]);
+        }
+    }
+    if (sccLow[f] != sccIndex[f]) return;
+    std::vector<int> component;
+    int g;
+    do {
+        g = sccStack.back();
+        sccStack.pop_back();
+        onStack[g] = false;
+        component.push_back(g);
+    } while (g != f);
+    const std::vector<int>& own = functions[f].callees;
+    bool cycle = component.size() > 1 || std::find(own.begin(), own.end(), f) != own.end();
+    for (int h : component) {
+        functions[h].recursive = cycle;
+        order.push_back(h);
+    }
+}
+
+void Inliner::finish(Function& f) {
+    f.code = WasmDecoder::unlink(*f.def, f.depths);
+    f.size = static_cast<size_t>(std::count_if(f.code.begin(), f.code.end(),
+                                               [](const Instr& in) { return in.op != O::Nop; }));
+}
+
+bool Inliner::inlinable(int callee, int caller) const {
+    const Function& g = functions[callee];
+    return callee != caller && g.valid && !g.recursive && g.size <= WasmInliner::MAX_CALLEE_SIZE;
+}
+
+void Inliner::inlineInto(int index) {
+    Function& f = functions[index];
+    FuncDef& caller = *f.def;
+    FuncDef original = caller;
+
+    std::vector<std::vector<uint32_t>> depths;
+    std::vector<Instr> code = WasmDecoder::unlink(caller, depths);
+    std::vector<Instr> out;
+    out.reserve(code.size());
+    std::unordered_map<std::string, uint32_t> symbolIds;
+    for (uint32_t i = 0; i < caller.symbols.size(); ++i) symbolIds.emplace(caller.symbols[i], i);
+    auto intern = [&](const std::string& s) {
+        auto it = symbolIds.emplace(s, static_cast<uint32_t>(caller.symbols.size()));
+        if (it.second) caller.symbols.push_back(s);
+        return it.first->second;
+    };
+
+    size_t added = 0, sites = 0;
+    std::vector<O> open;               // the caller's enclosing blocks
+    size_t loops = 0;
+    for (const Instr& in : code) {
+        switch (in.op) {
+            case O::Block: case O::If: open.push_back(in.op); break;
+            case O::Loop: open.push_back(in.op); ++loops; break;
+            case O::End:
+                if (!open.empty()) {
+                    if (open.back() == O::Loop) --loops;
+                    open.pop_back();
+                }
+                break;
+            default: break;
+        }
+        int target = in.op == O::Call ? calleeOf(in, caller) : -1;
+        if (target < 0 || !inlinable(target, index) || added + functions[target].size > WasmInliner::CALLER_BUDGET) {
+            out.push_back(in);
+            continue;
+        }
+        const Function& g = functions[target];
+        const FuncDef& callee = *g.def;
+        uint32_t base = static_cast<uint32_t>(caller.locals.size());
+        caller.locals.insert(caller.locals.end(), callee.locals.begin(), callee.locals.end());
+
+        // Arguments, last on top, into the callee's parameter slots
+        for (size_t i = callee.params.size(); i > 0; --i) {
+            Instr set;
+            set.op = O::LocalSet;
+            set.a = base + static_cast<uint32_t>(i - 1);
+            out.push_back(set);
+        }
+        // A fresh call starts with zeroed locals; outside a loop the slots still are
+        if (loops) {
+            for (size_t k = callee.params.size(); k < callee.locals.size(); ++k) {
+                Instr zero;
+                switch (callee.locals[k].type) {
+                    case ValueType::I32: zero.op = O::I32Const; break;
+                    case ValueType::I64: zero.op = O::I64Const; break;
+                    case ValueType::F32: zero.op = O::F32Const; break;
+                    case ValueType::F64: zero.op = O::F64Const; break;
+                }
+                Instr set;
+                set.op = O::LocalSet;
+                set.a = base + static_cast<uint32_t>(k);
+                out.push_back(zero);
+                out.push_back(set);
+            }
+        }
+        Instr block;
+        block.op = O::Block;
+        block.imm.i32 = callee.hasResult ? 1 : 0;
+        block.blockType = callee.result.type;
+        out.push_back(block);
+
+        // The body, one block deeper: branches to the function body (and returns)
+        // now leave this block
+        uint32_t depth = 0;
+        for (Instr body : g.code) {
+            switch (body.op) {
+                case O::Nop:
+                    continue;
+                case O::Block: case O::Loop: case O::If: ++depth; break;
+                case O::End: --depth; break;
+                case O::LocalGet: case O::LocalSet: case O::LocalTee: body.a += base; break;
+                case O::Return:
+                    body.op = O::Br;
+                    body.a = static_cast<uint32_t>(depths.size());
+                    depths.push_back({depth});
+                    break;
+                case O::Br: case O::BrIf: case O::BrTable: {
+                    std::vector<uint32_t> labels = g.depths[body.a];
+                    for (uint32_t& d : labels) d = std::min(d, depth);
+                    body.a = static_cast<uint32_t>(depths.size());
+                    depths.push_back(std::move(labels));
+                    break;
+                }
+                case O::Call:
+                    if (body.b) body.a = intern(callee.symbols[body.a]);
+                    break;
+                case O::Unknown:
+                    body.a = intern(callee.symbols[body.a]);
+                    break;
+                case O::CallIndirect:
+                    body.imm.i32 = static_cast<int32_t>(caller.indirectCallSites++);
+                    break;
+                default:
+                    break;
+            }
+            out.push_back(body);
+        }
+        Instr end;
+        end.op = O::End;
+        out.push_back(end);
+        added += g.size;
+        ++sites;
+    }
+    if (!sites) return;
+
+    size_t before = original.code.size();
+    caller.code = std::move(out);
+    module.decoder.link(caller, depths);
+    module.decoder.fuse(caller);
+    std::string reason;
+    if (!WasmValidator::validateFunction(caller, module, instance, reason)) {
+        WASM_TRACE(Parser, Debug, "\033[1;33m[inliner]\033[0m function " << index << " left as it was: "
+                  << reason << "\n");
+        caller = std::move(original);
+        return;
+    }
+    WASM_TRACE(Parser, Info, "\033[1;34m[inliner]\033[0m function " << index << ": " << sites
+              << " call(s) inlined, " << before << " -> " << caller.code.size() << " instruction(s)\n");
+}
+
+void Inliner::run() {
+    size_t count = 0;
+    for (const auto& [index, func] : module.functionsByID)
+        if (index >= 0) count = std::max(count, static_cast<size_t>(index) + 1);
+    functions.assign(count, {});
+    for (auto& [index, func] : module.functionsByID) {
+        if (index < 0) continue;
+        std::string reason;
+        functions[index].def = &func;
+        functions[index].valid = WasmValidator::validateFunction(func, module, instance, reason);
+    }
+    for (size_t index = 0; index < count; ++index) {
+        Function& f = functions[index];
+        if (!f.def) continue;
+        for (const Instr& in : f.def->code) {
+            int g = in.op == O::Call ? calleeOf(in, *f.def) : -1;
+            if (g >= 0) f.callees.push_back(g);
+        }
+    }
+
+    sccIndex.assign(count, -1);
+    sccLow.assign(count, 0);
+    onStack.assign(count, false);
+    for (size_t index = 0; index < count; ++index)
+        if (functions[index].def && sccIndex[index] < 0) visit(static_cast<int>(index));
+
+    for (int index : order) {
+        Function& f = functions[index];
+        if (!f.valid) continue;
+        inlineInto(index);
+        finish(f);
+    }
+}
+
+} // namespace
+#endif
+
+void WasmInliner::inlineCalls(WasmModule& module, const WasmInstance& instance) {
+#if WASM_OPTIMIZE
+    Inliner(module, instance).run();
+#else
+    (void)module;
+    (void)instance;
+#endif
+}
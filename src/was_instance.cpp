@@ -0,0 +1,75 @@
+#include "wasm_instance.hpp"
+#include "wasm_trace.hpp"
+#include <stdexcept>
+
+void WasmInstance::instantiate() {
+    droppedData.assign(dataSegments.size(), false);
+    for (size_t i = 0; i < dataSegments.size(); ++i) {
+        const DataSegment& seg = dataSegments[i];
+        if (!seg.active) continue;
+        // Unlike the spec, active segments are not implicitly dropped and stay
+        // readable by memory.init (tests/wat/07_test_bulk_memory.wat relies on it)
+        memory.write(seg.offset, seg.bytes.data(), seg.bytes.size());
+        WASM_TRACE(Parser, Info, "\033[1;34m[instance:data]\033[0m segment " << i << ": "
+                  << seg.bytes.size() << " byte(s) at " << seg.offset << "\n");
+    }
+
+    droppedElems.assign(elemSegments.size(), false);
+    for (size_t i = 0; i < elemSegments.size(); ++i) {
+        const ElemSegment& seg = elemSegments[i];
+        if (seg.declarative) droppedElems[i] = true;
+        if (!seg.active) continue;
+        uint32_t len = static_cast<uint32_t>(seg.refs.size());
+        if (seg.table >= tables.size() || !tables[seg.table].init(seg.offset, seg.refs, 0, len))
+            throw std::out_of_range("[instance] element segment " + std::to_string(i) + " out of table bounds");
+        WASM_TRACE(Parser, Info, "\033[1;34m[instance:elem]\033[0m segment " << i << ": "
+                  << len << " reference(s) at table " << seg.table << "[" << seg.offset << "]\n");
+    }
+}
+
+WasmInstance::Image WasmInstance::capture() const {
+    return Image{memory.sizeInPages(), memory.contents(), globals, dataSegments, droppedData,
+                 tables, elemSegments, droppedElems, funcImports};
+}
+
+void WasmInstance::load(const Image& image) {
+    release();
+    memory.reset(image.memoryPages, image.memory.data(), image.memory.size());
+    globals = image.globals;
+    dataSegments = image.dataSegments;
+    droppedData = image.droppedData;
+    tables = image.tables;
+    elemSegments = image.elemSegments;
+    droppedElems = image.droppedElems;
+    funcImports = image.funcImports;
+}
+
+void WasmInstance::checkpoint() {
+    memory.snapshot();
+    savedGlobals = globals;
+    savedDropped = droppedData;
+    savedTables = tables;
+    savedDroppedElems = droppedElems;
+    WASM_TRACE(Exec, Debug, "\033[1;34m[instance:checkpoint]\033[0m " << globals.size() << " global(s), "
+              << memory.sizeInPages() << " page(s)\n");
+}
+
+void WasmInstance::rollback() {
+    if (!memory.hasSnapshot()) return;
+    memory.restore();
+    globals = savedGlobals;
+    droppedData = savedDropped;
+    tables = std::move(savedTables);
+    droppedElems = savedDroppedElems;
+    savedTables.clear();
+    savedGlobals.clear();
+    WASM_TRACE(Exec, Debug, "\033[1;34m[instance:rollback]\033[0m state restored\n");
+}
+
+void WasmInstance::release() {
+    memory.discardSnapshot();
+    savedGlobals.clear();
+    savedDropped.clear();
+    savedTables.clear();
+    savedDroppedElems.clear();
+}
@@ -1,137 +1,125 @@
 #include "wasm_interpreter.hpp"
+#include "wasm_trace.hpp"
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <stdexcept>
 #include <cctype>
 #include <thread>
 #include <chrono>
 
-void WasmInterpreter::loadFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open())
-        throw std::runtime_error("\033[1;31m[interpreter:loadFile]\033[0m Cannot open file: " + path);
-
-    sourceCode.assign(
-        (std::istreambuf_iterator<char>(file)),
-        std::istreambuf_iterator<char>());
+WasmInterpreter::WasmInterpreter() : errors(&std::cerr) {
+    WasmWasi::install(host);
 }
 
-void WasmInterpreter::parse() {
-    std::cout << "\033[1;34m[interpreter:parse]\033[0m Parsing simplified WebAssembly:\n";
+WasmInterpreter::~WasmInterpreter() {
+    if (module && module->engine == ExecutionEngine::Tiered && tiering.getOptions().stats) tiering.report(std::cerr);
+}
 
-    std::istringstream stream(sourceCode);
-    std::string line;
+void WasmInterpreter::loadFile(const std::string& path) {
+    // Read (or, for binary modules, mapped) by parse()
+    this->path = path;
+}
 
-    while (std::getline(stream, line)) {
-        std::cout << "\033[1;34m[interpreter:parse]\033[0m Parsing line: " << line << "\n";
-        executeLine(line);
+void WasmInterpreter::parse() {
+    WasmModuleCache cache(cacheDirectory);
+    loaded = WasmModule::load(path, host, engine, instance, *errors, cacheDirectory.empty() ? nullptr : &cache);
+    if (strictValidation && !loaded->validated()) {
+        throw std::runtime_error("[validator] module rejected: " + loaded->invalidReason
+                                 + (loaded->invalidFunctions > 1
+                                    ? " (and " + std::to_string(loaded->invalidFunctions - 1) + " more)" : ""));
+    }
+    module = loaded;
+    prepare();
+
+    auto it = module->functionsByID.find(module->startFunction);
+    if (it != module->functionsByID.end()) {
+        WASM_TRACE(Exec, Info, "\033[1;34m[interpreter:parse]\033[0m Running start function " << module->startFunction << "\n");
+        run(it->second);
+        instance.stdio.flush();
     }
 }
 
-void WasmInterpreter::executeLine(const std::string& line) {
-    std::string trimmed = line;
-    trimmed.erase(0, trimmed.find_first_not_of(" \t"));
-
-    if (trimmed.empty() || trimmed.rfind(";;", 0) == 0 || trimmed.rfind(")", 0) == 0) {
-        std::cout << "\033[1;34m[interpreter:executeLine]\033[0m skipped\n";
-        return;
+std::shared_ptr<const WasmModule> WasmInterpreter::shareModule() {
+    if (loaded) {
+        loaded->initial = instance.capture();
+        loaded.reset();
     }
-    std::istringstream iss(trimmed);
-    std::string token;
-    iss >> token;
-
-    std::cout << "\033[1;34m[interpreter:executeLine]\033[0m Executing: " << token << "\n";
-    if (inFunction) {
-        std::cout << "\033[1;34m[interpreter:executeLine]\033[0m Current function: "
-                  << (functionName.empty() ? "[anon]" : functionName)
-                  << " (index " << functionIndex << ")\n";
-
-        std::string codePart = trimmed;
-        size_t commentPos = codePart.find(";;");
-        if (commentPos != std::string::npos)
-            codePart = codePart.substr(0, commentPos);
-
-        for (char c : codePart) {
-            if (c == '(') brakes++;
-            else if (c == ')') brakes--;
-        }
+    return module;
+}
 
-        std::cout << "\033[1;34m[interpreter:executeLine]\033[0m Braces count = " << brakes << "\n";
-        bool toRemove = false;
-        if (brakes <= 0) {
-            inFunction = false;
-            toRemove = true;
-            brakes = 0;
-            std::cout << "\033[1;34m[interpreter:executeLine]\033[0m -------- end function body --------\n";
-        }
+void WasmInterpreter::instantiate(std::shared_ptr<const WasmModule> shared) {
+    loaded.reset();
+    module = std::move(shared);
+    instance.load(module->initial);
+    prepare();
+}
 
-        if (functionName.empty())
-            parser.parseBody(trimmed, &functionsByID[functionIndex], toRemove);
-        else
-            parser.parseBody(trimmed, &functionByName[functionName], toRemove);
-    } else if (token.find("module") != std::string::npos) {
-        parser.parseModule(globals);
-    } else if (token.find("global") != std::string::npos) {
-        parser.parseGlobal(trimmed, globals);
-        //parser.print_globals(globals);
-    } else if (token.find("type") != std::string::npos) {
-        parser.parseType(trimmed, funcTypes);
-    } else if (token.find("func") != std::string::npos) {
-        FuncDef fun = parser.parseFunction(trimmed, functionsByID, functionByName, funcTypes);
-        functionName = fun.name;
-        functionIndex = fun.index;
-        //parser.print_functions(functionByName, functionsByID);
-        inFunction = true;
-        brakes = 1;
-    } else if (token.find("memory") != std::string::npos) {
-        parser.parseMemory(trimmed, memory);
-        // for (const auto& [idx, mem] : memoriesByIndex) {
-        //     mem.debugPrint(0, 64);
-        // }
-    } else if (token.find("export") != std::string::npos) {
-        parser.parseExport(trimmed, exports);
-        //parser.print_exports(exports);
-    } else {
-        std::cout << "\033[1;31m[interpreter:executeLine]\033[0m Unknown instruction: " + token + "\n";
-    }
+void WasmInterpreter::prepare() {
+    bool tiered = module->engine == ExecutionEngine::Tiered;
+    registerExecutor.setNativeFrameSize(module->engine == ExecutionEngine::Jit ? module->jit.maxFrameSize() : 0);
+    executor.setTiering(tiered ? &tiering : nullptr);
+    executor.setValidated(module->validated());
+    registerExecutor.setTiering(tiered ? &tiering : nullptr);
+    // Functions are translated one at a time, as they get hot
+    if (tiered) tiering.attach(*module, instance);
 }
 
 void WasmInterpreter::callFunctionByExportName(const std::string& exportName) {
-    auto it = exports.find(exportName);
-    if (it == exports.end()) {
-        std::cout << "\033[1;31m[interpreter:callFunctionByExportName]\033[0m Export '" 
-                  << exportName << "' not found.\n";
+    auto it = module->exports.find(exportName);
+    if (it == module->exports.end()) {
+        *errors << "\033[1;31m[interpreter:callFunctionByExportName]\033[0m Export '"
+                << exportName << "' not found.\n";
         return;
     }
 
     const WasmExport& exp = it->second;
     if (exp.kind != "func") {
-        std::cout << "\033[1;33m[interpreter:callFunctionByExportName]\033[0m '" 
-                  << exportName << "' is not a function (kind=" << exp.kind << ").\n";
+        *errors << "\033[1;33m[interpreter:callFunctionByExportName]\033[0m '"
+                << exportName << "' is not a function (kind=" << exp.kind << ").\n";
         return;
     }
 
-    std::cout << "\033[1;34m[interpreter:callFunctionByExportName]\033[0m Calling function '" 
-              << exp.name << "' (index " << exp.index << ").\n";
-    WasmMemory memoryCopy = memory;
-    std::unordered_map<std::string, WasmGlobal> globalsCopy = globals;
-    if (functionsByID.find(exp.index) != functionsByID.end()) {
-        executor.execute(functionsByID[exp.index], functionsByID, functionByName, memoryCopy, globalsCopy);
+    WASM_TRACE(Exec, Info, "\033[1;34m[interpreter:callFunctionByExportName]\033[0m Calling function '"
+              << exp.name << "' (index " << exp.index << ").\n");
+    auto func = module->functionsByID.find(exp.index);
+    if (func != module->functionsByID.end()) {
+        if (isolatedCalls) instance.checkpoint();
+        try {
+            run(func->second);
+        } catch (const WasmTrap& trap) {
+            *errors << "\033[1;31m[interpreter:callFunctionByExportName]\033[0m Trap in '"
+                    << exportName << "': " << trap.what() << "\n";
+        }
+        instance.stdio.flush();
+        if (isolatedCalls) instance.rollback();
+    }
+
+}
+
+void WasmInterpreter::run(const FuncDef& func) {
+    switch (module->engine) {
+        case ExecutionEngine::Tiered:
+            tiering.execute(func);
+            break;
+        case ExecutionEngine::Register:
+        case ExecutionEngine::Jit:
+            registerExecutor.execute(module->registerFunctions[func.index], module->registerFunctions, instance);
+            break;
+        default:
+            executor.execute(func, {}, module->functions, instance);
     }
-    
 }
 
 void WasmInterpreter::showMemory(uint32_t start, uint32_t count) {
 
     std::cout << "\033[1;34m[interpreter:showMemory]\033[0m "
-              << "pages: " << memory.sizeInPages()
-              << " | total bytes: " << (memory.sizeInPages() * WasmMemory::PAGE_SIZE)
+              << "pages: " << instance.memory.sizeInPages()
+              << " | total bytes: " << (instance.memory.sizeInPages() * WasmMemory::PAGE_SIZE)
               << "\n";
 
-    memory.debugPrint(start, count);
+    instance.memory.debugPrint(start, count);
 }
 
 std::unordered_map<std::string, WasmExport> WasmInterpreter::getExports() const {
-    return exports;
+    return module->exports;
 }
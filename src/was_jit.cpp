@@ -0,0 +1,1020 @@
+#include "wasm_jit.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#if WASM_JIT
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(WasmSlot) == 8, "generated code addresses frame slots as 8-byte words");
+
+#if WASM_JIT
+// The lowering of i64 and f64 instructions reuses that of their i32 / f32 counterparts
+static_assert(static_cast<int>(RegOp::I64Popcnt) - static_cast<int>(RegOp::I64Add)
+              == static_cast<int>(RegOp::I32Popcnt) - static_cast<int>(RegOp::I32Add)
+              && RegOp::I64Add == static_cast<RegOp>(static_cast<int>(RegOp::I32Popcnt) + 1),
+              "i32 and i64 numeric instructions must be laid out alike");
+static_assert(static_cast<int>(RegOp::F64Ge) - static_cast<int>(RegOp::F64Add)
+              == static_cast<int>(RegOp::F32Ge) - static_cast<int>(RegOp::F32Add)
+              && RegOp::F32Add == static_cast<RegOp>(static_cast<int>(RegOp::I64Popcnt) + 1)
+              && RegOp::F64Add == static_cast<RegOp>(static_cast<int>(RegOp::F32Ge) + 1),
+              "f32 and f64 numeric instructions must be laid out alike");
+
+namespace {
+
+enum Reg : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum Cond : uint8_t { O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G };
+
+// Pinned for the whole body: the frame, the context, linear memory, and the frame
+// of a call being set up. All callee-saved, so helper calls leave them alone.
+constexpr Reg FRAME = RBX, CTX = R12, MEM = R13, CALLEE = R14;
+
+struct Mem {
+    Reg base;
+    int index;        // -1: none
+    int32_t disp;
+};
+
+// Just the encodings the compiler below uses; every memory operand takes a 32-bit displacement
+class Assembler {
+public:
+    std::vector<uint8_t> bytes;
+
+    size_t pos() const { return bytes.size(); }
+    void byte(uint8_t b) { bytes.push_back(b); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+
+    // [prefix] [REX] opcode, ModRM (+ SIB) with `reg` and the memory operand `m`
+    void rm(uint8_t prefix, bool w, std::initializer_list<uint8_t> op, int reg, const Mem& m) {
+        if (prefix) byte(prefix);
+        uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0)
+                    | (m.index >= 0 && (m.index & 8) ? 2 : 0) | ((m.base & 8) ? 1 : 0);
+        if (rex != 0x40) byte(rex);
+        for (uint8_t b : op) byte(b);
+        if (m.index < 0 && (m.base & 7) != RSP) {
+            byte(0x80 | ((reg & 7) << 3) | (m.base & 7));
+        } else {
+            byte(0x80 | ((reg & 7) << 3) | 4);
+            byte(((m.index < 0 ? 4 : (m.index & 7)) << 3) | (m.base & 7));
+        }
+        u32(static_cast<uint32_t>(m.disp));
+    }
+    // Same with a register operand in ModRM.rm
+    void rr(uint8_t prefix, bool w, std::initializer_list<uint8_t> op, int reg, int rmReg) {
+        if (prefix) byte(prefix);
+        uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rmReg & 8) ? 1 : 0);
+        if (rex != 0x40) byte(rex);
+        for (uint8_t b : op) byte(b);
+        byte(0xC0 | ((reg & 7) << 3) | (rmReg & 7));
+    }
+
+    void mov(bool w, Reg dst, Reg src) { rr(0, w, {0x89}, src, dst); }
+    void movImm32(Reg r, uint32_t v) {
+        if (r & 8) byte(0x41);
+        byte(0xB8 | (r & 7));
+        u32(v);
+    }
+    void movImm64(Reg r, uint64_t v) {
+        byte(0x48 | ((r & 8) ? 1 : 0));
+        byte(0xB8 | (r & 7));
+        u64(v);
+    }
+    void lea(Reg r, const Mem& m) { rm(0, true, {0x8D}, r, m); }
+    void push(Reg r) { if (r & 8) byte(0x41); byte(0x50 | (r & 7)); }
+    void pop(Reg r) { if (r & 8) byte(0x41); byte(0x58 | (r & 7)); }
+    void setcc(Cond c, Reg r) { byte(0x0F); byte(0x90 | c); byte(0xC0 | r); }   // al .. bl only
+    void callAbsolute(const void* fn) {
+        movImm64(RAX, reinterpret_cast<uint64_t>(fn));
+        byte(0xFF);
+        byte(0xD0);
+    }
+
+    // Jumps take a rel32 patched once the target is known
+    size_t jcc(Cond c) { byte(0x0F); byte(0x80 | c); u32(0); return pos() - 4; }
+    size_t jmp() { byte(0xE9); u32(0); return pos() - 4; }
+    size_t call() { byte(0xE8); u32(0); return pos() - 4; }
+    void patch(size_t at, size_t target) {
+        uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(bytes.data() + at, &rel, 4);
+    }
+    void bindHere(size_t at) { patch(at, pos()); }
+};
+
+// ---- Runtime helpers, called from generated code ----
+// Generated frames have no unwind information, so nothing may be thrown across
+// them: traps and host exceptions are handed back to WasmRegisterExecutor::execute
+// through ctx->trapEnv.
+
+[[noreturn]] void jitTrap(JitContext* ctx, const char* message) {
+    std::snprintf(ctx->trapMessage, sizeof(ctx->trapMessage), "%s", message);
+    siglongjmp(*ctx->trapEnv, 1);
+}
+
+[[noreturn]] void jitCallStackExhausted(JitContext* ctx) {
+    if (ctx->depth < ctx->maxDepth)
+        std::snprintf(ctx->trapMessage, sizeof(ctx->trapMessage), "call stack exhausted (depth %llu, native stack)",
+                      static_cast<unsigned long long>(ctx->depth));
+    else
+        std::snprintf(ctx->trapMessage, sizeof(ctx->trapMessage), "call stack exhausted (depth %llu, limit %llu)",
+                      static_cast<unsigned long long>(ctx->depth), static_cast<unsigned long long>(ctx->maxDepth));
+    siglongjmp(*ctx->trapEnv, 1);
+}
+
+// Every guest call is a native call, so a deep enough recursion runs out of the
+// thread's stack long before --max-call-depth. Calls stop at the bottom of the
+// stack less NATIVE_STACK_RESERVE, which the helpers and host functions they call
+// out to run in.
+constexpr size_t NATIVE_STACK_RESERVE = 256 * 1024;
+
+uintptr_t nativeStackLimit() {
+    static thread_local uintptr_t limit = [] {
+        void* low = nullptr;
+        size_t size = 0;
+        pthread_attr_t attr;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            pthread_attr_getstack(&attr, &low, &size);
+            pthread_attr_destroy(&attr);
+        }
+        return low ? reinterpret_cast<uintptr_t>(low) + NATIVE_STACK_RESERVE : 0;
+    }();
+    return limit;
+}
+
+void jitCallHost(JitContext* ctx, uint32_t index, WasmSlot* args, uint32_t hasResult) {
+    const FuncImport& imp = ctx->instance->funcImports[index];
+    if (!imp.fn) {
+        std::snprintf(ctx->trapMessage, sizeof(ctx->trapMessage), "unresolved import %s.%s",
+                      imp.module.c_str(), imp.field.c_str());
+        siglongjmp(*ctx->trapEnv, 1);
+    }
+    try {
+        WasmValue result = imp.fn(*ctx->instance, args);
+        if (hasResult) *args = result;
+        return;
+    } catch (...) {
+        *ctx->error = std::current_exception();
+    }
+    siglongjmp(*ctx->trapEnv, 1);
+}
+
+void jitGlobalGet(JitContext* ctx, uint32_t index, WasmSlot* dst) {
+    *dst = ctx->instance->globals[index].value;
+}
+
+void jitGlobalSet(JitContext* ctx, uint32_t index, const WasmSlot* src) {
+    ctx->instance->globals[index].value = *src;
+}
+
+int32_t jitMemoryGrow(JitContext* ctx, int32_t pages) {
+    return ctx->instance->memory.grow(pages);
+}
+
+// Stores while a snapshot is active: WasmMemory saves the page first
+void jitStore(JitContext* ctx, uint32_t op, uint64_t ea, const WasmSlot* value) {
+    WasmMemory& memory = ctx->instance->memory;
+    const WasmSlot& v = *value;
+    try {
+        switch (static_cast<RegOp>(op)) {
+#define X(name, text, write) case RegOp::name: write; break;
+            WASM_REGISTER_STORES(X)
+#undef X
+            default: break;
+        }
+        return;
+    } catch (const std::out_of_range&) {
+    }
+    jitTrap(ctx, "out of bounds memory access");
+}
+
+// Trace lines, worded as the register executor prints them. Slots are read as the
+// type the load or store op names ("i64.store8": i64)
+ValueType accessType(uint32_t op) {
+    const char* text = WasmRegisterCompiler::opName(static_cast<RegOp>(op));
+    if (text[0] == 'i') return text[1] == '3' ? ValueType::I32 : ValueType::I64;
+    return text[1] == '3' ? ValueType::F32 : ValueType::F64;
+}
+
+double asDouble(const WasmValue& v) {
+    switch (v.type) {
+        case ValueType::I32: return static_cast<double>(v.i32);
+        case ValueType::I64: return static_cast<double>(v.i64);
+        case ValueType::F32: return static_cast<double>(v.f32);
+        case ValueType::F64: return v.f64;
+    }
+    return 0;
+}
+
+void printValue(const WasmValue& v) {
+    switch (v.type) {
+        case ValueType::I32: std::cout << v.i32; break;
+        case ValueType::I64: std::cout << v.i64; break;
+        case ValueType::F32: std::cout << v.f32; break;
+        case ValueType::F64: std::cout << v.f64; break;
+    }
+}
+
+void jitTraceEnter(JitContext*, const RegFunction* func) {
+    std::cout << "\033[1;36m[executor:execute]\033[0m Executing function '" << func->def->name
+              << "' (index " << func->def->index << ").\n";
+}
+
+void jitTraceReturn(JitContext*) {
+    std::cout << "\033[1;36m[executor:execute]\033[0m Function completed.\n";
+}
+
+void jitTraceLoad(JitContext*, uint32_t op, uint64_t ea, const WasmSlot* v) {
+    std::cout << "\033[1;35m[memory:" << WasmRegisterCompiler::opName(static_cast<RegOp>(op)) << "]\033[0m mem["
+              << ea << "] → " << asDouble(WasmValue(accessType(op), *v)) << "\n";
+}
+
+void jitTraceStore(JitContext*, uint32_t op, uint64_t ea, const WasmSlot* v) {
+    std::cout << "\033[1;35m[memory:" << WasmRegisterCompiler::opName(static_cast<RegOp>(op)) << "]\033[0m mem["
+              << ea << "] = ";
+    printValue(WasmValue(accessType(op), *v));
+    std::cout << "\n";
+}
+
+void jitTraceMemorySize(JitContext*, int32_t pages) {
+    std::cout << "\033[1;35m[memory:memory.size]\033[0m → pages=" << pages << "\n";
+}
+
+// ---- Code generation ----
+
+Mem context(size_t offset) { return {CTX, -1, static_cast<int32_t>(offset)}; }
+Mem slot(uint32_t s) { return {FRAME, -1, static_cast<int32_t>(s * sizeof(WasmSlot))}; }
+Mem value(uint32_t s) { return slot(s); }   // the slot read as a scalar
+
+struct CpuFeatures {
+    bool popcnt = __builtin_cpu_supports("popcnt");
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+};
+
+bool covered(RegOp op, const CpuFeatures& cpu) {
+    switch (op) {
+        case RegOp::I32Popcnt: case RegOp::I64Popcnt:
+            return cpu.popcnt;
+        case RegOp::F32Ceil: case RegOp::F32Floor: case RegOp::F32Trunc: case RegOp::F32Nearest:
+        case RegOp::F64Ceil: case RegOp::F64Floor: case RegOp::F64Trunc: case RegOp::F64Nearest:
+            return cpu.sse41;
+        case RegOp::CallIndirect:
+        case RegOp::MemoryCopy: case RegOp::MemoryFill: case RegOp::MemoryInit: case RegOp::DataDrop:
+        case RegOp::RefIsNull: case RegOp::TableGet: case RegOp::TableSet: case RegOp::TableSize:
+        case RegOp::TableGrow: case RegOp::TableFill: case RegOp::TableCopy: case RegOp::TableInit:
+        case RegOp::ElemDrop: case RegOp::Count:
+            return false;
+        default:
+            return true;
+    }
+}
+
+struct CallSite {
+    size_t at;          // rel32 to patch
+    uint32_t callee;    // function index
+};
+
+class FunctionCompiler {
+public:
+    FunctionCompiler(Assembler& as, const RegFunction& func, const std::vector<RegFunction>& functions,
+                     std::vector<CallSite>& calls)
+        : as(as), func(func), functions(functions), calls(calls) {}
+
+    void run();
+
+private:
+    Assembler& as;
+    const RegFunction& func;
+    const std::vector<RegFunction>& functions;
+    std::vector<CallSite>& calls;
+    std::vector<size_t> starts;                             // code offset of each instruction
+    std::vector<std::pair<size_t, uint32_t>> branches;      // rel32, target pc
+    std::vector<size_t> outOfBounds, exhausted, overflow;   // rel32s jumping to the trap stubs
+    bool traceExec = WASM_TRACE_ON(Exec, Info);
+    bool traceMemory = WASM_TRACE_ON(Memory, Debug);
+
+    void load(bool w, Reg r, uint32_t s) { as.rm(0, w, {0x8B}, r, value(s)); }
+    void result(bool w, Reg r, uint32_t s) { as.rm(0, w, {0x89}, r, value(s)); }
+    void loadFloat(bool f64, int xmm, uint32_t s) { as.rm(f64 ? 0xF2 : 0xF3, false, {0x0F, 0x10}, xmm, value(s)); }
+    void resultFloat(bool f64, int xmm, uint32_t s) { as.rm(f64 ? 0xF2 : 0xF3, false, {0x0F, 0x11}, xmm, value(s)); }
+    // Whole slot, through xmm0 (movsd)
+    void copy(const Mem& dst, const Mem& src) {
+        as.rm(0xF2, false, {0x0F, 0x10}, 0, src);
+        as.rm(0xF2, false, {0x0F, 0x11}, 0, dst);
+    }
+    void setBool(Cond c, Reg r = RAX) {
+        as.setcc(c, r);
+        as.rr(0, false, {0x0F, 0xB6}, r, r);   // movzx r32, r8
+    }
+    void reloadMemory() {
+        as.rm(0, true, {0x8B}, RAX, context(offsetof(JitContext, memoryBase)));
+        as.rm(0, true, {0x8B}, MEM, {RAX, -1, 0});
+    }
+    void branchTo(size_t at, uint32_t target) { branches.push_back({at, target}); }
+
+    void prologue();
+    void epilogue();
+    void instruction(const RegInstr& in);
+    void integer(const RegInstr& in);
+    void floating(const RegInstr& in);
+    void convert(const RegInstr& in);
+    void divide(const RegInstr& in, bool w, bool isSigned, bool remainder);
+    int32_t address(const RegInstr& in, uint32_t size);
+    void memoryLoad(const RegInstr& in);
+    void memoryStore(const RegInstr& in);
+    void callFunction(const RegInstr& in);
+};
+
+void FunctionCompiler::prologue() {
+    // Five pushes on top of the return address leave rsp 16-byte aligned for helper calls
+    as.push(RBP);
+    as.push(RBX);
+    as.push(R12);
+    as.push(R13);
+    as.push(R14);
+    as.mov(true, FRAME, RDI);
+    as.mov(true, CTX, RSI);
+    reloadMemory();
+    if (traceExec) {
+        as.mov(true, RDI, CTX);
+        as.movImm64(RSI, reinterpret_cast<uint64_t>(&func));
+        as.callAbsolute(reinterpret_cast<const void*>(&jitTraceEnter));
+    }
+}
+
+void FunctionCompiler::epilogue() {
+    as.pop(R14);
+    as.pop(R13);
+    as.pop(R12);
+    as.pop(RBX);
+    as.pop(RBP);
+    as.byte(0xC3);
+}
+
+void FunctionCompiler::run() {
+    prologue();
+    starts.resize(func.code.size());
+    for (size_t pc = 0; pc < func.code.size(); ++pc) {
+        starts[pc] = as.pos();
+        instruction(func.code[pc]);
+    }
+    for (const auto& [at, target] : branches) as.patch(at, starts[target]);
+
+    if (!outOfBounds.empty()) {
+        for (size_t at : outOfBounds) as.bindHere(at);
+        as.mov(true, RDI, CTX);
+        as.movImm64(RSI, reinterpret_cast<uint64_t>("out of bounds memory access"));
+        as.callAbsolute(reinterpret_cast<const void*>(&jitTrap));
+    }
+    if (!exhausted.empty()) {
+        for (size_t at : exhausted) as.bindHere(at);
+        as.mov(true, RDI, CTX);
+        as.callAbsolute(reinterpret_cast<const void*>(&jitCallStackExhausted));
+    }
+    if (!overflow.empty()) {
+        for (size_t at : overflow) as.bindHere(at);
+        as.mov(true, RDI, CTX);
+        as.movImm64(RSI, reinterpret_cast<uint64_t>("integer overflow"));
+        as.callAbsolute(reinterpret_cast<const void*>(&jitTrap));
+    }
+}
+
+void FunctionCompiler::instruction(const RegInstr& in) {
+    switch (in.op) {
+        case RegOp::Move:
+            copy(slot(in.d), slot(in.x));
+            return;
+
+        case RegOp::Br:
+            branchTo(as.jmp(), in.imm);
+            return;
+        case RegOp::BrIf:
+        case RegOp::BrUnless:
+            load(false, RAX, in.x);
+            as.rr(0, false, {0x85}, RAX, RAX);
+            branchTo(as.jcc(in.op == RegOp::BrIf ? NE : E), in.imm);
+            return;
+        case RegOp::BrTable: {
+            const std::vector<uint32_t>& targets = func.brTables[in.imm];
+            load(false, RAX, in.x);
+            for (size_t i = 0; i + 1 < targets.size(); ++i) {
+                as.rr(0, false, {0x81}, 7, RAX);   // cmp eax, i
+                as.u32(static_cast<uint32_t>(i));
+                branchTo(as.jcc(E), targets[i]);
+            }
+            branchTo(as.jmp(), targets.back());
+            return;
+        }
+#define X(name, text, T, test) case RegOp::name:
+        WASM_REGISTER_COMPARE_BRANCHES(X)
+#undef X
+        {
+            static const Cond taken[] = {E, NE, L, B, G, A, LE, BE, GE, AE};
+            load(false, RAX, in.x);
+            as.rm(0, false, {0x3B}, RAX, value(in.y));
+            branchTo(as.jcc(taken[static_cast<size_t>(in.op) - static_cast<size_t>(RegOp::BrI32Eq)]), in.imm);
+            return;
+        }
+
+        case RegOp::Return:
+            if (traceExec) {
+                as.mov(true, RDI, CTX);
+                as.callAbsolute(reinterpret_cast<const void*>(&jitTraceReturn));
+            }
+            if (in.imm != 0 && in.x != 0) copy(slot(0), slot(in.x));
+            epilogue();
+            return;
+        case RegOp::Call:
+            callFunction(in);
+            return;
+        case RegOp::CallHost:
+            as.mov(true, RDI, CTX);
+            as.movImm32(RSI, in.imm);
+            as.lea(RDX, slot(in.d));
+            as.movImm32(RCX, in.aux);
+            as.callAbsolute(reinterpret_cast<const void*>(&jitCallHost));
+            reloadMemory();
+            return;
+
+        case RegOp::Select: {
+            load(false, RAX, in.aux);
+            as.rr(0, false, {0x85}, RAX, RAX);
+            as.rm(0xF2, false, {0x0F, 0x10}, 0, slot(in.x));
+            size_t keep = as.jcc(NE);
+            as.rm(0xF2, false, {0x0F, 0x10}, 0, slot(in.y));
+            as.bindHere(keep);
+            as.rm(0xF2, false, {0x0F, 0x11}, 0, slot(in.d));
+            return;
+        }
+        case RegOp::GlobalGet:
+        case RegOp::GlobalSet:
+            as.mov(true, RDI, CTX);
+            as.movImm32(RSI, in.imm);
+            as.lea(RDX, slot(in.op == RegOp::GlobalGet ? in.d : in.x));
+            as.callAbsolute(in.op == RegOp::GlobalGet ? reinterpret_cast<const void*>(&jitGlobalGet)
+                                                      : reinterpret_cast<const void*>(&jitGlobalSet));
+            return;
+
+        case RegOp::MemorySize:
+            as.rm(0, true, {0x8B}, RAX, context(offsetof(JitContext, memorySize)));
+            as.rm(0, true, {0x8B}, RAX, {RAX, -1, 0});
+            as.rr(0, true, {0xC1}, 5, RAX);   // shr rax, 16
+            as.byte(16);
+            result(false, RAX, in.d);
+            if (traceMemory) {
+                as.mov(true, RDI, CTX);
+                load(false, RSI, in.d);
+                as.callAbsolute(reinterpret_cast<const void*>(&jitTraceMemorySize));
+            }
+            return;
+        case RegOp::MemoryGrow:
+            as.mov(true, RDI, CTX);
+            load(false, RSI, in.x);
+            as.callAbsolute(reinterpret_cast<const void*>(&jitMemoryGrow));
+            result(false, RAX, in.d);
+            reloadMemory();
+            return;
+
+#define X(name, ...) case RegOp::name:
+        WASM_REGISTER_LOADS(X)
+            memoryLoad(in);
+            return;
+        WASM_REGISTER_STORES(X)
+            memoryStore(in);
+            return;
+#undef X
+
+        default:
+            break;
+    }
+    if (in.op < RegOp::I32Add) convert(in);
+    else if (in.op < RegOp::F32Add) integer(in);
+    else floating(in);
+}
+
+void FunctionCompiler::integer(const RegInstr& in) {
+    bool w = in.op >= RegOp::I64Add;
+    auto alu = [&](std::initializer_list<uint8_t> op) {
+        load(w, RAX, in.x);
+        as.rm(0, w, op, RAX, value(in.y));
+        result(w, RAX, in.d);
+    };
+    auto shift = [&](int ext) {
+        load(w, RAX, in.x);
+        load(false, RCX, in.y);
+        as.rr(0, w, {0xD3}, ext, RAX);
+        result(w, RAX, in.d);
+    };
+    auto pick = [&](Cond takeSecond) {
+        load(w, RAX, in.x);
+        load(w, RCX, in.y);
+        as.rr(0, w, {0x39}, RCX, RAX);                          // cmp rax, rcx
+        as.rr(0, w, {0x0F, static_cast<uint8_t>(0x40 | takeSecond)}, RAX, RCX);   // cmovcc rax, rcx
+        result(w, RAX, in.d);
+    };
+    auto compare = [&](Cond c) {
+        load(w, RAX, in.x);
+        as.rm(0, w, {0x3B}, RAX, value(in.y));
+        setBool(c);
+        result(false, RAX, in.d);
+    };
+    // I32Add .. I32Popcnt and I64Add .. I64Popcnt are laid out alike
+    RegOp op = w ? static_cast<RegOp>(static_cast<size_t>(in.op) - static_cast<size_t>(RegOp::I64Add)
+                                      + static_cast<size_t>(RegOp::I32Add))
+                 : in.op;
+    switch (op) {
+        case RegOp::I32Add: alu({0x03}); return;
+        case RegOp::I32Sub: alu({0x2B}); return;
+        case RegOp::I32Mul: alu({0x0F, 0xAF}); return;
+        case RegOp::I32And: alu({0x23}); return;
+        case RegOp::I32Or:  alu({0x0B}); return;
+        case RegOp::I32Xor: alu({0x33}); return;
+        case RegOp::I32Min: pick(GE); return;
+        case RegOp::I32Max: pick(LE); return;
+        case RegOp::I32Abs:
+            load(w, RAX, in.x);
+            as.mov(w, RCX, RAX);
+            as.rr(0, w, {0xF7}, 3, RCX);                        // neg rcx
+            as.rr(0, w, {0x85}, RAX, RAX);
+            as.rr(0, w, {0x0F, 0x48}, RAX, RCX);                // cmovs rax, rcx
+            result(w, RAX, in.d);
+            return;
+        case RegOp::I32Neg:
+            load(w, RAX, in.x);
+            as.rr(0, w, {0xF7}, 3, RAX);
+            result(w, RAX, in.d);
+            return;
+        case RegOp::I32Shl:  shift(4); return;
+        case RegOp::I32ShrS: shift(7); return;
+        case RegOp::I32ShrU: shift(5); return;
+        case RegOp::I32Rotl: shift(0); return;
+        case RegOp::I32Rotr: shift(1); return;
+        case RegOp::I32DivS: divide(in, w, true, false); return;
+        case RegOp::I32DivU: divide(in, w, false, false); return;
+        case RegOp::I32RemS: divide(in, w, true, true); return;
+        case RegOp::I32RemU: divide(in, w, false, true); return;
+        case RegOp::I32Eq:  compare(E); return;
+        case RegOp::I32Ne:  compare(NE); return;
+        case RegOp::I32LtS: compare(L); return;
+        case RegOp::I32LtU: compare(B); return;
+        case RegOp::I32GtS: compare(G); return;
+        case RegOp::I32GtU: compare(A); return;
+        case RegOp::I32LeS: compare(LE); return;
+        case RegOp::I32LeU: compare(BE); return;
+        case RegOp::I32GeS: compare(GE); return;
+        case RegOp::I32GeU: compare(AE); return;
+        case RegOp::I32Eqz:
+            load(w, RAX, in.x);
+            as.rr(0, w, {0x85}, RAX, RAX);
+            setBool(E);
+            result(w, RAX, in.d);   // i64.eqz keeps its operand's type, as in the executors
+            return;
+        case RegOp::I32Clz:
+        case RegOp::I32Ctz: {
+            bool clz = op == RegOp::I32Clz;
+            load(w, RCX, in.x);
+            as.rr(0, w, {0x0F, static_cast<uint8_t>(clz ? 0xBD : 0xBC)}, RAX, RCX);   // bsr / bsf rax, rcx
+            size_t zero = as.jcc(E);
+            if (clz) {
+                as.rr(0, false, {0x83}, 6, RAX);   // xor eax, width - 1
+                as.byte(w ? 63 : 31);
+            }
+            size_t done = as.jmp();
+            as.bindHere(zero);
+            as.movImm32(RAX, w ? 64 : 32);
+            as.bindHere(done);
+            result(w, RAX, in.d);
+            return;
+        }
+        case RegOp::I32Popcnt:
+            as.rm(0xF3, w, {0x0F, 0xB8}, RAX, value(in.x));
+            result(w, RAX, in.d);
+            return;
+        default:
+            throw std::logic_error("jit: integer instruction without a lowering");
+    }
+}
+
+// Division by zero yields 0 as in wasm_numeric.hpp; INT_MIN / -1 traps and
+// INT_MIN % -1 is 0 instead of faulting in idiv
+void FunctionCompiler::divide(const RegInstr& in, bool w, bool isSigned, bool remainder) {
+    load(w, RAX, in.x);
+    load(w, RCX, in.y);
+    as.rr(0, w, {0x85}, RCX, RCX);
+    size_t byZero = as.jcc(E);
+    size_t byMinusOne = 0;
+    if (isSigned) {
+        as.rr(0, w, {0x83}, 7, RCX);   // cmp rcx, -1
+        as.byte(0xFF);
+        byMinusOne = as.jcc(E);
+        if (w) as.byte(0x48);
+        as.byte(0x99);                 // cdq / cqo
+        as.rr(0, w, {0xF7}, 7, RCX);   // idiv rcx
+    } else {
+        as.rr(0, false, {0x31}, RDX, RDX);
+        as.rr(0, w, {0xF7}, 6, RCX);   // div rcx
+    }
+    if (remainder) as.mov(w, RAX, RDX);
+    size_t done = as.jmp();
+    size_t minusOneDone = 0;
+    if (isSigned) {
+        as.bindHere(byMinusOne);
+        if (remainder) {
+            as.rr(0, false, {0x31}, RAX, RAX);
+        } else {
+            as.rr(0, w, {0xF7}, 3, RAX);    // neg rax: overflows for INT_MIN alone
+            overflow.push_back(as.jcc(O));
+        }
+        minusOneDone = as.jmp();
+    }
+    as.bindHere(byZero);
+    as.rr(0, false, {0x31}, RAX, RAX);
+    as.bindHere(done);
+    if (isSigned) as.bindHere(minusOneDone);
+    result(w, RAX, in.d);
+}
+
+void FunctionCompiler::floating(const RegInstr& in) {
+    bool f64 = in.op >= RegOp::F64Add;
+    uint8_t prefix = f64 ? 0xF2 : 0xF3;
+    auto arith = [&](uint8_t op) {
+        loadFloat(f64, 0, in.x);
+        as.rm(prefix, false, {0x0F, op}, 0, value(in.y));
+        resultFloat(f64, 0, in.d);
+    };
+    auto round = [&](uint8_t mode) {
+        as.rm(0x66, false, {0x0F, 0x3A, static_cast<uint8_t>(f64 ? 0x0B : 0x0A)}, 0, value(in.x));
+        as.byte(mode);
+        resultFloat(f64, 0, in.d);
+    };
+    // ucomis sets the flags of an unsigned compare; unordered sets ZF, PF and CF
+    auto compare = [&](uint32_t lhs, uint32_t rhs, Cond c) {
+        loadFloat(f64, 0, lhs);
+        as.rm(f64 ? 0x66 : 0, false, {0x0F, 0x2E}, 0, value(rhs));
+        setBool(c);
+        result(false, RAX, in.d);
+    };
+    // F32Add .. F32Ge and F64Add .. F64Ge are laid out alike
+    RegOp op = f64 ? static_cast<RegOp>(static_cast<size_t>(in.op) - static_cast<size_t>(RegOp::F64Add)
+                                        + static_cast<size_t>(RegOp::F32Add))
+                   : in.op;
+    switch (op) {
+        case RegOp::F32Add: arith(0x58); return;
+        case RegOp::F32Sub: arith(0x5C); return;
+        case RegOp::F32Mul: arith(0x59); return;
+        case RegOp::F32Div: arith(0x5E); return;
+        case RegOp::F32Min: arith(0x5D); return;   // minss: a < b ? a : b, exactly
+        case RegOp::F32Max: arith(0x5F); return;   // maxss: a > b ? a : b
+        case RegOp::F32Abs: {
+            // a < 0 ? -a : a, so -0 and NaN keep their sign
+            load(f64, RAX, in.x);
+            loadFloat(f64, 0, in.x);
+            as.rr(0, false, {0x0F, 0x57}, 1, 1);                   // xorps xmm1, xmm1
+            as.rr(f64 ? 0x66 : 0, false, {0x0F, 0x2E}, 1, 0);      // ucomis xmm1, xmm0
+            size_t keep = as.jcc(BE);
+            if (f64) { as.rr(0, true, {0x0F, 0xBA}, 7, RAX); as.byte(63); }          // btc rax, 63
+            else { as.rr(0, false, {0x81}, 6, RAX); as.u32(0x80000000u); }          // xor eax, sign
+            as.bindHere(keep);
+            result(f64, RAX, in.d);
+            return;
+        }
+        case RegOp::F32Neg:
+            load(f64, RAX, in.x);
+            if (f64) { as.rr(0, true, {0x0F, 0xBA}, 7, RAX); as.byte(63); }
+            else { as.rr(0, false, {0x81}, 6, RAX); as.u32(0x80000000u); }
+            result(f64, RAX, in.d);
+            return;
+        case RegOp::F32Sqrt:
+            as.rm(prefix, false, {0x0F, 0x51}, 0, value(in.x));
+            resultFloat(f64, 0, in.d);
+            return;
+        case RegOp::F32Ceil:    round(0x0A); return;
+        case RegOp::F32Floor:   round(0x09); return;
+        case RegOp::F32Trunc:   round(0x0B); return;
+        case RegOp::F32Nearest: round(0x0C); return;   // current rounding mode, as nearbyint
+        case RegOp::F32Eq:
+            loadFloat(f64, 0, in.x);
+            as.rm(f64 ? 0x66 : 0, false, {0x0F, 0x2E}, 0, value(in.y));
+            as.setcc(E, RAX);
+            as.setcc(NP, RCX);
+            as.byte(0x20); as.byte(0xC8);    // and al, cl
+            as.rr(0, false, {0x0F, 0xB6}, RAX, RAX);
+            result(false, RAX, in.d);
+            return;
+        case RegOp::F32Ne:
+            loadFloat(f64, 0, in.x);
+            as.rm(f64 ? 0x66 : 0, false, {0x0F, 0x2E}, 0, value(in.y));
+            as.setcc(NE, RAX);
+            as.setcc(P, RCX);
+            as.byte(0x08); as.byte(0xC8);    // or al, cl
+            as.rr(0, false, {0x0F, 0xB6}, RAX, RAX);
+            result(false, RAX, in.d);
+            return;
+        case RegOp::F32Lt: compare(in.y, in.x, A); return;
+        case RegOp::F32Gt: compare(in.x, in.y, A); return;
+        case RegOp::F32Le: compare(in.y, in.x, AE); return;
+        case RegOp::F32Ge: compare(in.x, in.y, AE); return;
+        default:
+            throw std::logic_error("jit: float instruction without a lowering");
+    }
+}
+
+void FunctionCompiler::convert(const RegInstr& in) {
+    switch (in.op) {
+        case RegOp::I32ReinterpretF32:
+        case RegOp::I32WrapI64:
+            load(false, RAX, in.x);
+            result(false, RAX, in.d);
+            return;
+        case RegOp::F32ReinterpretI32:
+            load(false, RAX, in.x);
+            result(false, RAX, in.d);
+            return;
+        case RegOp::I64ReinterpretF64:
+            load(true, RAX, in.x);
+            result(true, RAX, in.d);
+            return;
+        case RegOp::F32ConvertI32S:
+            as.rm(0xF3, false, {0x0F, 0x2A}, 0, value(in.x));   // cvtsi2ss xmm0, dword
+            resultFloat(false, 0, in.d);
+            return;
+        case RegOp::F32ConvertI32U:
+            load(false, RAX, in.x);                             // zero-extended, so exact as a signed 64-bit
+            as.rr(0xF3, true, {0x0F, 0x2A}, 0, RAX);
+            resultFloat(false, 0, in.d);
+            return;
+        case RegOp::I32TruncF32S:
+            as.rm(0xF3, false, {0x0F, 0x2C}, RAX, value(in.x));  // cvttss2si eax
+            result(false, RAX, in.d);
+            return;
+        case RegOp::I32TruncF32U:
+            as.rm(0xF3, true, {0x0F, 0x2C}, RAX, value(in.x));   // cvttss2si rax, low half
+            result(false, RAX, in.d);
+            return;
+        case RegOp::F64ConvertI32S:
+            as.rm(0xF2, false, {0x0F, 0x2A}, 0, value(in.x));
+            resultFloat(true, 0, in.d);
+            return;
+        case RegOp::I32TruncF64S:
+            as.rm(0xF2, false, {0x0F, 0x2C}, RAX, value(in.x));
+            result(false, RAX, in.d);
+            return;
+        case RegOp::F64PromoteF32:
+            as.rm(0xF3, false, {0x0F, 0x5A}, 0, value(in.x));
+            resultFloat(true, 0, in.d);
+            return;
+        case RegOp::F32DemoteF64:
+            as.rm(0xF2, false, {0x0F, 0x5A}, 0, value(in.x));
+            resultFloat(false, 0, in.d);
+            return;
+        default:
+            throw std::logic_error("jit: conversion without a lowering");
+    }
+}
+
+// Leaves the zero-extended address operand in rax and returns the displacement
+// still to add; with checked memory, jumps to the trap when [ea, ea + size) is out of range
+int32_t FunctionCompiler::address(const RegInstr& in, uint32_t size) {
+    load(false, RAX, in.x);
+    int32_t disp = static_cast<int32_t>(in.imm);
+    if (in.imm > 0x7FFFFF00u) {
+        as.movImm32(RCX, in.imm);
+        as.rr(0, true, {0x01}, RCX, RAX);   // add rax, rcx
+        disp = 0;
+    }
+#if !WASM_GUARD_PAGES
+    // The vector behind checked memory moves on grow, so its size is read every time too
+    as.lea(RDX, {RAX, -1, disp + static_cast<int32_t>(size)});
+    as.rm(0, true, {0x8B}, RCX, context(offsetof(JitContext, memorySize)));
+    as.rm(0, true, {0x3B}, RDX, {RCX, -1, 0});
+    outOfBounds.push_back(as.jcc(A));
+#else
+    (void)size;
+#endif
+    return disp;
+}
+
+void FunctionCompiler::memoryLoad(const RegInstr& in) {
+    struct Lowering {
+        uint32_t size;
+        bool w;             // REX.W on the load
+        uint8_t op;         // after 0x0F when twoByte
+        bool twoByte;
+        bool w64;           // result written as 64 bits
+    };
+    Lowering l;
+    switch (in.op) {
+        case RegOp::I32Load8S:  l = {1, false, 0xBE, true, false}; break;
+        case RegOp::I32Load8U:  l = {1, false, 0xB6, true, false}; break;
+        case RegOp::I32Load16S: l = {2, false, 0xBF, true, false}; break;
+        case RegOp::I32Load16U: l = {2, false, 0xB7, true, false}; break;
+        case RegOp::I32Load:    l = {4, false, 0x8B, false, false}; break;
+        case RegOp::I64Load8S:  l = {1, true, 0xBE, true, true}; break;
+        case RegOp::I64Load8U:  l = {1, false, 0xB6, true, true}; break;
+        case RegOp::I64Load16S: l = {2, true, 0xBF, true, true}; break;
+        case RegOp::I64Load16U: l = {2, false, 0xB7, true, true}; break;
+        case RegOp::I64Load32S: l = {4, true, 0x63, false, true}; break;   // movsxd
+        case RegOp::I64Load32U: l = {4, false, 0x8B, false, true}; break;
+        case RegOp::I64Load:    l = {8, true, 0x8B, false, true}; break;
+        case RegOp::F32Load:    l = {4, false, 0x8B, false, false}; break;
+        default:                l = {8, true, 0x8B, false, true}; break;
+    }
+    int32_t disp = address(in, l.size);
+    Mem source{MEM, RAX, disp};
+    if (l.twoByte) as.rm(0, l.w, {0x0F, l.op}, RCX, source);
+    else as.rm(0, l.w, {l.op}, RCX, source);
+    result(l.w64, RCX, in.d);
+    if (traceMemory) {
+        as.mov(true, RDI, CTX);
+        as.movImm32(RSI, static_cast<uint32_t>(in.op));
+        as.lea(RDX, {RAX, -1, disp});
+        as.lea(RCX, slot(in.d));
+        as.callAbsolute(reinterpret_cast<const void*>(&jitTraceLoad));
+    }
+}
+
+void FunctionCompiler::memoryStore(const RegInstr& in) {
+    uint32_t size;
+    switch (in.op) {
+        case RegOp::I32Store8: case RegOp::I64Store8: size = 1; break;
+        case RegOp::I32Store16: case RegOp::I64Store16: size = 2; break;
+        case RegOp::I32Store: case RegOp::I64Store32: case RegOp::F32Store: size = 4; break;
+        default: size = 8; break;
+    }
+    int32_t disp = address(in, size);
+    Mem target{MEM, RAX, disp};
+    // While a snapshot is active the first write to each page must save it first
+    as.rm(0, true, {0x8B}, RCX, context(offsetof(JitContext, memoryTracking)));
+    as.rm(0, false, {0x80}, 7, {RCX, -1, 0});   // cmp byte [rcx], 0
+    as.byte(0);
+    size_t tracked = as.jcc(NE);
+    load(size == 8, RCX, in.y);
+    switch (size) {
+        case 1: as.rm(0, false, {0x88}, RCX, target); break;
+        case 2: as.rm(0x66, false, {0x89}, RCX, target); break;
+        case 4: as.rm(0, false, {0x89}, RCX, target); break;
+        default: as.rm(0, true, {0x89}, RCX, target); break;
+    }
+    size_t done = as.jmp();
+    as.bindHere(tracked);
+    as.mov(true, RDI, CTX);
+    as.movImm32(RSI, static_cast<uint32_t>(in.op));
+    as.lea(RDX, {RAX, -1, disp});
+    as.lea(RCX, slot(in.y));
+    as.callAbsolute(reinterpret_cast<const void*>(&jitStore));
+    as.bindHere(done);
+    if (traceMemory) {
+        load(false, RAX, in.x);
+        as.mov(true, RDI, CTX);
+        as.movImm32(RSI, static_cast<uint32_t>(in.op));
+        as.movImm32(RDX, in.imm);
+        as.rr(0, true, {0x01}, RAX, RDX);   // add rdx, rax
+        as.lea(RCX, slot(in.y));
+        as.callAbsolute(reinterpret_cast<const void*>(&jitTraceStore));
+    }
+}
+
+// Same frame discipline as the register executor: the callee's frame follows ours,
+// gets its image and then the arguments, and hands the result back in its slot 0
+void FunctionCompiler::callFunction(const RegInstr& in) {
+    const RegFunction& callee = functions[in.imm];
+    as.rm(0, true, {0x8B}, RAX, context(offsetof(JitContext, depth)));
+    as.rm(0, true, {0x3B}, RAX, context(offsetof(JitContext, maxDepth)));
+    exhausted.push_back(as.jcc(AE));
+    as.rm(0, true, {0x3B}, RSP, context(offsetof(JitContext, stackLimit)));
+    exhausted.push_back(as.jcc(B));
+    as.lea(CALLEE, slot(func.frameSize));
+    as.lea(RAX, {CALLEE, -1, static_cast<int32_t>(callee.frameSize * sizeof(WasmSlot))});
+    as.rm(0, true, {0x3B}, RAX, context(offsetof(JitContext, slotsEnd)));
+    exhausted.push_back(as.jcc(A));
+    as.rm(0, true, {0x83}, 0, context(offsetof(JitContext, depth)));   // add qword [depth], 1
+    as.byte(1);
+    if (!callee.image.empty()) {
+        as.mov(true, RDI, CALLEE);
+        as.movImm64(RSI, reinterpret_cast<uint64_t>(callee.image.data()));
+        as.movImm32(RCX, static_cast<uint32_t>(callee.image.size()));
+        as.byte(0xF3); as.byte(0x48); as.byte(0xA5);   // rep movsq
+    }
+    for (uint32_t i = 0; i < callee.paramCount; ++i)
+        copy({CALLEE, -1, static_cast<int32_t>(i * sizeof(WasmSlot))}, slot(in.d + i));
+    as.mov(true, RDI, CALLEE);
+    as.mov(true, RSI, CTX);
+    calls.push_back({as.call(), in.imm});
+    as.rm(0, true, {0x83}, 5, context(offsetof(JitContext, depth)));   // sub qword [depth], 1
+    as.byte(1);
+    reloadMemory();
+    if (callee.hasResult) copy(slot(in.d), {CALLEE, -1, 0});
+}
+
+} // namespace
+#endif
+
+WasmJit::~WasmJit() {
+#if WASM_JIT
+    if (code) munmap(code, codeSize);
+#endif
+}
+
+bool WasmJit::available() {
+#if WASM_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+void WasmJit::bind(JitContext& ctx, WasmInstance& instance) {
+    ctx.memoryBase = &instance.memory.base;
+    ctx.memorySize = &instance.memory.byteSize;
+    ctx.memoryTracking = &instance.memory.tracking;
+    ctx.instance = &instance;
+#if WASM_JIT
+    ctx.stackLimit = nativeStackLimit();
+#endif
+}
+
+size_t WasmJit::compile(std::vector<RegFunction>& functions) {
+#if WASM_JIT
+    // Per-instruction traces only exist in the interpreter
+    if (WASM_TRACE_ON(Exec, Debug)) return 0;
+
+    // Covered bodies first, then drop callers of anything left out until nothing changes
+    CpuFeatures cpu;
+    std::vector<bool> compiled(functions.size(), false);
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const RegFunction& f = functions[i];
+        if (!f.def) continue;
+        compiled[i] = std::all_of(f.code.begin(), f.code.end(), [&](const RegInstr& in) {
+            return covered(in.op, cpu);
+        });
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < functions.size(); ++i) {
+            if (!compiled[i]) continue;
+            for (const RegInstr& in : functions[i].code) {
+                if (in.op == RegOp::Call && !compiled[in.imm]) {
+                    compiled[i] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    Assembler as;
+    std::vector<CallSite> calls;
+    std::vector<size_t> entry(functions.size(), 0);
+    size_t count = 0;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (!compiled[i]) continue;
+        entry[i] = as.pos();
+        FunctionCompiler(as, functions[i], functions, calls).run();
+        largestFrame = std::max(largestFrame, functions[i].frameSize);
+        ++count;
+    }
+    size_t defined = std::count_if(functions.begin(), functions.end(), [](const RegFunction& f) { return f.def; });
+    WASM_TRACE(Parser, Info, "\033[1;32m[jit:compile]\033[0m " << count << " of " << defined
+              << " function(s) compiled, " << as.bytes.size() << " bytes of code\n");
+    if (count == 0) return 0;
+    for (const CallSite& c : calls) as.patch(c.at, entry[c.callee]);
+
+    // Written while writable, then flipped to executable
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    codeSize = (as.bytes.size() + page - 1) / page * page;
+    void* mapping = mmap(nullptr, codeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "\033[1;33m[jit:compile]\033[0m Cannot map code memory; interpreting every function.\n";
+        codeSize = 0;
+        largestFrame = 0;
+        return 0;
+    }
+    code = static_cast<uint8_t*>(mapping);
+    std::memcpy(code, as.bytes.data(), as.bytes.size());
+    if (mprotect(code, codeSize, PROT_READ | PROT_EXEC) != 0) {
+        std::cerr << "\033[1;33m[jit:compile]\033[0m Cannot make code memory executable; interpreting every function.\n";
+        munmap(code, codeSize);
+        code = nullptr;
+        codeSize = 0;
+        largestFrame = 0;
+        return 0;
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (!compiled[i]) continue;
+        functions[i].native = reinterpret_cast<JitEntry>(code + entry[i]);
+        WASM_TRACE(Parser, Debug, "\033[1;32m[jit:compile]\033[0m function index " << i << ": "
+                  << functions[i].code.size() << " instruction(s) → native code at +" << entry[i] << "\n");
+    }
+    return count;
+#else
+    (void)functions;
+    return 0;
+#endif
+}
@@ -0,0 +1,32 @@
+#include "wasm_mapped_file.hpp"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+WasmMappedFile::WasmMappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("\033[1;31m[file:mmap]\033[0m Cannot open file: " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("\033[1;31m[file:mmap]\033[0m Cannot stat file: " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("\033[1;31m[file:mmap]\033[0m mmap failed: " + path);
+        }
+        ::madvise(p, size, MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(p);
+    }
+    ::close(fd);
+}
+
+WasmMappedFile::~WasmMappedFile() {
+    if (data) ::munmap(const_cast<uint8_t*>(data), size);
+}
@@ -1,46 +1,315 @@
 #include "wasm_memory.hpp"
+#include "wasm_trace.hpp"
 #include <stdexcept>
 #include <cstring>
 #include <cctype>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if WASM_GUARD_PAGES
+#include <sys/mman.h>
+#include <signal.h>
+#include <pthread.h>
+#include <atomic>
+#include <mutex>
+#endif
 
-void WasmMemory::store8(uint32_t addr, uint8_t value)     { writeBytes(addr, value); }
-void WasmMemory::store16(uint32_t addr, uint16_t value)   { writeBytes(addr, value); }
-void WasmMemory::store32(uint32_t addr, int32_t value)    { writeBytes(addr, value); }
-void WasmMemory::store64(uint32_t addr, int64_t value)    { writeBytes(addr, value); }
-void WasmMemory::storeF32(uint32_t addr, float value)     { writeBytes(addr, value); }
-void WasmMemory::storeF64(uint32_t addr, double value)    { writeBytes(addr, value); }
+#if WASM_GUARD_PAGES
+namespace {
 
-uint8_t  WasmMemory::load8(uint32_t addr) const           { return readBytes<uint8_t>(addr); }
-uint16_t WasmMemory::load16(uint32_t addr) const          { return readBytes<uint16_t>(addr); }
-int32_t  WasmMemory::load32(uint32_t addr) const          { return readBytes<int32_t>(addr); }
-int64_t  WasmMemory::load64(uint32_t addr) const          { return readBytes<int64_t>(addr); }
-float    WasmMemory::loadF32(uint32_t addr) const         { return readBytes<float>(addr); }
-double   WasmMemory::loadF64(uint32_t addr) const         { return readBytes<double>(addr); }
+// Any 32-bit address plus any 32-bit memarg offset plus the widest access
+constexpr size_t RESERVE_BYTES = (size_t(1) << 33) + WasmMemory::PAGE_SIZE;
+constexpr size_t MAX_REGIONS = 256;
 
-int32_t WasmMemory::grow(int32_t  additionalPages) {
-    if (additionalPages < 0) return -1;
+// Bases of live reservations; read from the signal handler, hence lock-free
+std::atomic<uintptr_t> regions[MAX_REGIONS];
+thread_local WasmMemory::FaultScope* activeScope = nullptr;
+struct sigaction previousSegv, previousBus;
 
-    size_t oldPages = sizeInPages();
-    size_t newSize = data.size() + (static_cast<size_t>(additionalPages) * PAGE_SIZE);
+// False when every slot is taken: faults in `base` could not be told from others
+bool registerRegion(uint8_t* base) {
+    for (auto& r : regions) {
+        uintptr_t expected = 0;
+        if (r.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(base))) return true;
+    }
+    return false;
+}
+
+void unregisterRegion(uint8_t* base) {
+    for (auto& r : regions) {
+        uintptr_t expected = reinterpret_cast<uintptr_t>(base);
+        if (r.compare_exchange_strong(expected, 0)) return;
+    }
+}
+
+bool inGuardedRegion(uintptr_t addr) {
+    for (auto& r : regions) {
+        uintptr_t base = r.load(std::memory_order_acquire);
+        if (base && addr >= base && addr - base < RESERVE_BYTES) return true;
+    }
+    return false;
+}
+
+void onFault(int sig, siginfo_t* info, void*) {
+    if (activeScope && inGuardedRegion(reinterpret_cast<uintptr_t>(info->si_addr))) {
+        // Leaving the handler by a jump: let the next fault in
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, sig);
+        pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+        siglongjmp(activeScope->env, 1);
+    }
+    // Not a guest access: reinstate the previous disposition and let the
+    // faulting instruction run again under it.
+    sigaction(sig, sig == SIGSEGV ? &previousSegv : &previousBus, nullptr);
+}
+
+void installFaultHandler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction sa {};
+        sa.sa_sigaction = onFault;
+        sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, &previousSegv);
+        sigaction(SIGBUS, &sa, &previousBus);
+    });
+}
+
+} // namespace
+
+WasmMemory::FaultScope::FaultScope() : prev(activeScope) { activeScope = this; }
+WasmMemory::FaultScope::~FaultScope() { activeScope = prev; }
+#endif
 
+WasmMemory::WasmMemory(size_t minPages) : minPages(minPages) {
+#if WASM_GUARD_PAGES
+    void* p = mmap(nullptr, RESERVE_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("[memory] cannot reserve guarded address space (build with -DWASM_MEMORY=checked)");
+    base = static_cast<uint8_t*>(p);
+    if (!registerRegion(base)) {
+        munmap(base, RESERVE_BYTES);
+        base = nullptr;
+        throw std::runtime_error("[memory] too many live memories (at most " + std::to_string(MAX_REGIONS) + ")");
+    }
+    installFaultHandler();
+#endif
+    if (minPages > MAX_PAGES || !resize(minPages * PAGE_SIZE)) {
+        release();
+        throw std::runtime_error("[memory] cannot allocate " + std::to_string(minPages) + " initial page(s)");
+    }
+}
+
+WasmMemory::~WasmMemory() {
+    release();
+}
+
+WasmMemory::WasmMemory(WasmMemory&& other) noexcept {
+    *this = std::move(other);
+}
+
+WasmMemory& WasmMemory::operator=(WasmMemory&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    minPages = other.minPages;
+    base = other.base;
+    byteSize = other.byteSize;
+#if !WASM_GUARD_PAGES
+    data = std::move(other.data);
+#endif
+    tracking = other.tracking;
+    snapshotSize = other.snapshotSize;
+    savedPages = std::move(other.savedPages);
+    dirtyList = std::move(other.dirtyList);
+    other.base = nullptr;
+    other.byteSize = 0;
+    other.discardSnapshot();
+    return *this;
+}
+
+void WasmMemory::release() {
+#if WASM_GUARD_PAGES
+    if (base) {
+        unregisterRegion(base);
+        munmap(base, RESERVE_BYTES);
+    }
+#else
+    data.clear();
+    data.shrink_to_fit();
+#endif
+    base = nullptr;
+    byteSize = 0;
+}
+
+// Make exactly `newSize` bytes accessible; new bytes read as zero
+bool WasmMemory::resize(size_t newSize) {
+#if WASM_GUARD_PAGES
+    if (newSize > byteSize) {
+        if (mprotect(base + byteSize, newSize - byteSize, PROT_READ | PROT_WRITE) != 0) return false;
+    } else if (newSize < byteSize) {
+        // Drop the pages so a later grow sees zeros again
+        mprotect(base + newSize, byteSize - newSize, PROT_NONE);
+        madvise(base + newSize, byteSize - newSize, MADV_DONTNEED);
+    }
+#else
     try {
         data.resize(newSize, 0);
-        std::cout << "\033[1;36m[memory:grow]\033[0m from " << oldPages 
-                  << " → " << sizeInPages() << " pages (+" << additionalPages << ")\n";
-        return static_cast<int32_t>(oldPages);
     } catch (const std::bad_alloc&) {
+        return false;
+    }
+    base = data.data();
+#endif
+    byteSize = newSize;
+    return true;
+}
+
+void WasmMemory::store8(uint64_t addr, uint8_t value)     { writeBytes(addr, value); }
+void WasmMemory::store16(uint64_t addr, uint16_t value)   { writeBytes(addr, value); }
+void WasmMemory::store32(uint64_t addr, int32_t value)    { writeBytes(addr, value); }
+void WasmMemory::store64(uint64_t addr, int64_t value)    { writeBytes(addr, value); }
+void WasmMemory::storeF32(uint64_t addr, float value)     { writeBytes(addr, value); }
+void WasmMemory::storeF64(uint64_t addr, double value)    { writeBytes(addr, value); }
+
+uint8_t  WasmMemory::load8(uint64_t addr) const           { return readBytes<uint8_t>(addr); }
+uint16_t WasmMemory::load16(uint64_t addr) const          { return readBytes<uint16_t>(addr); }
+int32_t  WasmMemory::load32(uint64_t addr) const          { return readBytes<int32_t>(addr); }
+int64_t  WasmMemory::load64(uint64_t addr) const          { return readBytes<int64_t>(addr); }
+float    WasmMemory::loadF32(uint64_t addr) const         { return readBytes<float>(addr); }
+double   WasmMemory::loadF64(uint64_t addr) const         { return readBytes<double>(addr); }
+
+void WasmMemory::checkRange(uint64_t addr, uint64_t len, const char* what) const {
+    if (addr + len > byteSize)
+        throw std::out_of_range(std::string("[memory] ") + what + " out of bounds");
+}
+
+const uint8_t* WasmMemory::view(uint64_t addr, uint64_t len) const {
+    checkRange(addr, len, "host access");
+    return base + addr;
+}
+
+void WasmMemory::markDirty(uint64_t addr, uint64_t len) {
+    if (!tracking || len == 0) return;
+    for (size_t p = addr / PAGE_SIZE; p <= (addr + len - 1) / PAGE_SIZE; ++p)
+        if (p < savedPages.size() && savedPages[p].empty()) savePage(p);
+}
+
+void WasmMemory::write(uint32_t addr, const uint8_t* src, size_t len) {
+    checkRange(addr, len, "write");
+    if (len == 0) return;
+    markDirty(addr, len);
+    std::memcpy(base + addr, src, len);
+}
+
+void WasmMemory::copy(uint32_t dst, uint32_t src, uint32_t len) {
+    checkRange(src, len, "memory.copy source");
+    checkRange(dst, len, "memory.copy destination");
+    if (len == 0) return;
+    markDirty(dst, len);
+    // libc memmove already picks vector and non-temporal paths by size
+    std::memmove(base + dst, base + src, len);
+    WASM_TRACE(Memory, Debug, "\033[1;35m[memory:copy]\033[0m " << len << " byte(s) "
+              << src << " → " << dst << "\n");
+}
+
+// Above this size a fill cannot stay in cache anyway; streaming stores skip the
+// read-for-ownership and about halve the time of memset.
+static constexpr size_t STREAM_FILL_THRESHOLD = 8u << 20;
+
+void WasmMemory::fill(uint32_t dst, uint8_t value, uint32_t len) {
+    checkRange(dst, len, "memory.fill");
+    if (len == 0) return;
+    markDirty(dst, len);
+    uint8_t* p = base + dst;
+    size_t n = len;
+#if defined(__SSE2__)
+    if (n >= STREAM_FILL_THRESHOLD) {
+        size_t head = (16 - (reinterpret_cast<uintptr_t>(p) & 15)) & 15;
+        std::memset(p, value, head);
+        p += head;
+        n -= head;
+        __m128i v = _mm_set1_epi8(static_cast<char>(value));
+        for (size_t blocks = n / 64; blocks; --blocks, p += 64) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(p), v);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(p + 16), v);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(p + 32), v);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(p + 48), v);
+        }
+        _mm_sfence();
+        n &= 63;
+    }
+#endif
+    std::memset(p, value, n);
+    WASM_TRACE(Memory, Debug, "\033[1;35m[memory:fill]\033[0m " << len << " byte(s) at "
+              << dst << " = " << int(value) << "\n");
+}
+
+int32_t WasmMemory::grow(int32_t  additionalPages) {
+    if (additionalPages < 0) return -1;
+
+    size_t oldPages = sizeInPages();
+    if (oldPages + static_cast<size_t>(additionalPages) > MAX_PAGES) return -1;
+
+    if (!resize(byteSize + static_cast<size_t>(additionalPages) * PAGE_SIZE)) {
         std::cerr << "\033[1;31m[memory:grow]\033[0m failed to allocate additional pages\n";
         return -1; // grow failed
     }
+    WASM_TRACE(Memory, Info, "\033[1;36m[memory:grow]\033[0m from " << oldPages
+              << " → " << sizeInPages() << " pages (+" << additionalPages << ")\n");
+    return static_cast<int32_t>(oldPages);
+}
+
+void WasmMemory::snapshot() {
+    discardSnapshot();
+    tracking = true;
+    snapshotSize = byteSize;
+    savedPages.resize(snapshotSize / PAGE_SIZE);
+}
+
+void WasmMemory::savePage(size_t page) {
+    const uint8_t* src = base + page * PAGE_SIZE;
+    savedPages[page].assign(src, src + PAGE_SIZE);
+    dirtyList.push_back(page);
+}
+
+void WasmMemory::restore() {
+    if (!tracking) return;
+    resize(snapshotSize);
+    for (size_t page : dirtyList)
+        std::memcpy(base + page * PAGE_SIZE, savedPages[page].data(), PAGE_SIZE);
+    WASM_TRACE(Memory, Info, "\033[1;36m[memory:restore]\033[0m " << dirtyList.size()
+              << " dirty page(s) restored, size " << sizeInPages() << " pages\n");
+    discardSnapshot();
+}
+
+void WasmMemory::discardSnapshot() {
+    dirtyList.clear();
+    savedPages.clear();
+    tracking = false;
+    snapshotSize = 0;
+}
+
+void WasmMemory::reset(size_t pages, const uint8_t* bytes, size_t len) {
+    discardSnapshot();
+    if (pages > MAX_PAGES || len > pages * PAGE_SIZE || !resize(0) || !resize(pages * PAGE_SIZE))
+        throw std::runtime_error("[memory] cannot allocate " + std::to_string(pages) + " page(s)");
+    minPages = pages;
+    if (len) std::memcpy(base, bytes, len);
+}
+
+std::vector<uint8_t> WasmMemory::contents() const {
+    size_t end = byteSize;
+    while (end > 0 && base[end - 1] == 0) --end;
+    return std::vector<uint8_t>(base, base + end);
 }
 
 void WasmMemory::debugPrint(uint32_t start, uint32_t count) const {
-    if (data.empty()) {
+    if (byteSize == 0) {
         std::cout << "\033[1;35m[memory]\033[0m (empty)\n";
         return;
     }
-    if (count == 0 || start + count > data.size())
-        count = data.size() - start;
+    if (count == 0 || start + count > byteSize)
+        count = byteSize - start;
 
     std::cout << "\n\033[1;35m================ MEMORY DUMP =================\033[0m\n";
     std::cout << "\033[1;35m[memory]\033[0m Pages: " << minPages
@@ -53,15 +322,15 @@ void WasmMemory::debugPrint(uint32_t start, uint32_t count) const {
         uint32_t addr = start + offset;
         printf("0x%08X  ", addr);
         for (uint32_t i = 0; i < 16; ++i) {
-            if (addr + i < data.size())
-                printf("%02X ", data[addr + i]);
+            if (addr + i < byteSize)
+                printf("%02X ", base[addr + i]);
             else
                 printf("   ");
         }
         printf(" | ");
         for (uint32_t i = 0; i < 16; ++i) {
-            if (addr + i < data.size()) {
-                unsigned char c = data[addr + i];
+            if (addr + i < byteSize) {
+                unsigned char c = base[addr + i];
                 printf("%c", std::isprint(c) ? c : '.');
             } else {
                 printf(" ");
@@ -71,6 +340,6 @@ void WasmMemory::debugPrint(uint32_t start, uint32_t count) const {
     }
 
     std::cout << "-----------------------------------------------\n";
-    std::cout << "\033[1;35m[memory]\033[0m Total bytes: " << data.size() << "\n";
+    std::cout << "\033[1;35m[memory]\033[0m Total bytes: " << byteSize << "\n";
     std::cout << "\033[1;35m===============================================\033[0m\n";
 }
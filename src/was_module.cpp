@@ -0,0 +1,109 @@
+#include "wasm_module.hpp"
+#include "wasm_parser.hpp"
+#include "wasm_binary_parser.hpp"
+#include "wasm_mapped_file.hpp"
+#include "wasm_validator.hpp"
+#include "wasm_inliner.hpp"
+#include "wasm_optimizer.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string_view>
+
+std::shared_ptr<WasmModule> WasmModule::load(
+    const std::string& path,
+    const WasmHost& host,
+    ExecutionEngine engine,
+    WasmInstance& instance,
+    std::ostream& errors,
+    const WasmModuleCache* cache
+) {
+    auto module = std::make_shared<WasmModule>();
+    WasmMappedFile file(path);
+    uint64_t key = cache ? WasmModuleCache::key(file.data, file.size) : 0;
+    if (cache && cache->load(key, *module, instance)) {
+        WASM_TRACE(Parser, Info, "\033[1;34m[module:cache]\033[0m Loaded " << path << " from "
+                  << cache->pathFor(key) << "\n");
+    } else {
+        if (file.size >= 4 && std::memcmp(file.data, "\0asm", 4) == 0) {
+            WASM_TRACE(Parser, Info, "\033[1;32m[binary:parseFile]\033[0m Mapped " << path
+                      << " (" << file.size << " bytes)\n");
+            WasmBinaryParser parser;
+            parser.parse(file.data, file.size, module->funcTypes, module->functionsByID, module->exports,
+                         instance, module->decoder);
+            module->startFunction = parser.startFunction();
+        } else {
+            std::string_view source(reinterpret_cast<const char*>(file.data), file.size);
+            WASM_TRACE(Parser, Info, "\033[1;34m[interpreter:parse]\033[0m Parsing WebAssembly text (" << source.size() << " bytes)\n");
+            WasmParser parser;
+            parser.parseModule(source, module->funcTypes, module->functionsByID, module->functionByName,
+                               module->exports, instance, module->decoder);
+            module->startFunction = parser.startFunction();
+        }
+        WasmValidator::validate(*module, instance);
+        WasmInliner::inlineCalls(*module, instance);
+        WasmOptimizer::optimize(*module, instance);
+        // Before imports are bound and the start function runs: what every later run starts from
+        if (cache && !cache->store(key, *module, instance))
+            errors << "\033[1;33m[module:cache]\033[0m Cannot write " << cache->pathFor(key) << "\n";
+    }
+    module->resolveCalls();
+    host.link(instance);
+
+    if (engine == ExecutionEngine::Register || engine == ExecutionEngine::Jit) {
+        std::string reason;
+        if (!WasmRegisterCompiler::compile(module->functions, instance, module->decoder,
+                                           module->registerFunctions, reason)) {
+            errors << "\033[1;33m[interpreter:parse]\033[0m Register engine unavailable (" << reason
+                      << "); using the stack executor.\n";
+            engine = ExecutionEngine::Stack;
+        }
+    }
+    if (engine == ExecutionEngine::Jit) {
+        if (!WasmJit::available()) {
+            errors << "\033[1;33m[interpreter:parse]\033[0m This build has no JIT; using the register executor.\n";
+            engine = ExecutionEngine::Register;
+        } else {
+            module->jit.compile(module->registerFunctions);
+        }
+    }
+    module->engine = engine;
+    return module;
+}
+
+void WasmModule::resolveCalls() {
+    for (auto& [index, func] : functionsByID) {
+        for (Instr& in : func.code) {
+            if (in.op != Opcode::Call || !in.b || in.a >= func.symbols.size()) continue;
+            auto it = functionByName.find(func.symbols[in.a]);
+            // Names no function has are left to be reported when reached
+            if (it == functionByName.end() || !functionsByID.count(static_cast<int>(it->second))) continue;
+            in.a = it->second;
+            in.b = 0;
+        }
+    }
+    size_t count = 0;
+    for (auto& [index, func] : functionsByID)
+        if (index >= 0) count = std::max(count, static_cast<size_t>(index) + 1);
+    functions.assign(count, nullptr);
+    for (auto& [index, func] : functionsByID)
+        if (index >= 0) functions[index] = &func;
+}
+
+std::vector<std::pair<std::string, WasmExport>> WasmModule::functionExports() const {
+    std::vector<std::pair<std::string, WasmExport>> funcExports;
+    for (const auto& [exportName, exp] : exports) {
+        if (exp.kind == "func") {
+            funcExports.emplace_back(exportName, exp);
+        }
+    }
+
+    std::sort(funcExports.begin(), funcExports.end(),
+        [](const auto& a, const auto& b) {
+            int indexA = (a.second.index >= 0 ? a.second.index : INT_MIN);
+            int indexB = (b.second.index >= 0 ? b.second.index : INT_MIN);
+            return indexA < indexB;
+        });
+    return funcExports;
+}
@@ -0,0 +1,419 @@
+#include "wasm_module_cache.hpp"
+#include "wasm_module.hpp"
+#include "wasm_mapped_file.hpp"
+#include "wasm_trace.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Bump when the entry layout below changes
+constexpr uint32_t FORMAT_VERSION = 7;
+
+// Everything a decoded module depends on besides its bytes
+const std::string& buildTag() {
+    static const std::string tag = "wasm-module-cache/" + std::to_string(FORMAT_VERSION)
+        + " instr=" + std::to_string(sizeof(Instr))
+        + " value=" + std::to_string(sizeof(WasmValue))
+        + " branch=" + std::to_string(sizeof(BranchTarget))
+        + " ops=" + std::to_string(static_cast<size_t>(Opcode::Count))
+#if WASM_FUSION
+        + " fusion=1"
+#else
+        + " fusion=0"
+#endif
+#if WASM_OPTIMIZE
+        + " optimize=1";
+#else
+        + " optimize=0";
+#endif
+    return tag;
+}
+
+// FNV-1a over 64-bit words (the tail byte by byte), with a shift to fold the high
+// bits back down. A cache key and checksum, not a cryptographic hash; word steps keep
+// it well ahead of the page faults that read the data in.
+uint64_t hashBytes(const void* data, size_t size, uint64_t h = 1469598103934665603ull) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ word) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    for (; size > 0; ++p, --size) h = (h ^ *p) * 1099511628211ull;
+    return h;
+}
+
+struct Header {
+    char magic[8];
+    uint64_t key;
+    uint64_t format;        // hashBytes(buildTag())
+    uint64_t payloadSize;   // bytes after the header
+    uint64_t checksum;      // hashBytes of those bytes
+};
+constexpr char MAGIC[8] = {'W', 'A', 'S', 'M', 'C', 'A', 'C', 'H'};
+
+class Writer {
+public:
+    template <typename T>
+    void pod(const T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+        out.append(reinterpret_cast<const char*>(&v), sizeof v);
+    }
+    void count(size_t n) { pod(static_cast<uint64_t>(n)); }
+    void str(const std::string& s) {
+        count(s.size());
+        out.append(s);
+    }
+    template <typename T>
+    void array(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+        count(v.size());
+        out.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+    void bools(const std::vector<bool>& v) {
+        count(v.size());
+        for (bool b : v) out.push_back(b ? 1 : 0);
+    }
+    void type(const FuncType& t) {
+        count(t.params.size());
+        for (const std::string& p : t.params) str(p);
+        str(t.resultType);
+    }
+
+    std::string out;
+};
+
+// Bounds-checked cursor over an entry; throws std::runtime_error past the end
+class Reader {
+public:
+    Reader(const uint8_t* begin, const uint8_t* end) : p(begin), end(end) {}
+
+    template <typename T>
+    T pod() {
+        T v;
+        std::memcpy(&v, bytes(sizeof v), sizeof v);
+        return v;
+    }
+    size_t count() {
+        uint64_t n = pod<uint64_t>();
+        if (n > static_cast<uint64_t>(end - p)) fail();   // every element takes at least a byte
+        return static_cast<size_t>(n);
+    }
+    std::string str() {
+        size_t n = count();
+        return std::string(reinterpret_cast<const char*>(bytes(n)), n);
+    }
+    template <typename T>
+    void array(std::vector<T>& v) {
+        size_t n = count();
+        if (n > static_cast<size_t>(end - p) / sizeof(T)) fail();
+        v.resize(n);
+        if (n) std::memcpy(v.data(), bytes(n * sizeof(T)), n * sizeof(T));
+    }
+    void bools(std::vector<bool>& v) {
+        size_t n = count();
+        const uint8_t* b = bytes(n);
+        v.assign(b, b + n);
+    }
+    FuncType type() {
+        FuncType t;
+        t.params.resize(count());
+        for (std::string& param : t.params) param = str();
+        t.resultType = str();
+        return t;
+    }
+    bool atEnd() const { return p == end; }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+
+    const uint8_t* bytes(size_t n) {
+        if (n > static_cast<size_t>(end - p)) fail();
+        const uint8_t* s = p;
+        p += n;
+        return s;
+    }
+    [[noreturn]] static void fail() { throw std::runtime_error("truncated cache entry"); }
+};
+
+void writeFunction(Writer& w, const FuncDef& f) {
+    w.pod(static_cast<int32_t>(f.index));
+    w.pod(f.typeId);
+    w.count(f.params.size());
+    for (const auto& [name, value] : f.params) {
+        w.str(name);
+        w.pod(value);
+    }
+    w.pod(f.result);
+    w.pod(f.hasResult);
+    w.str(f.name);
+    w.array(f.code);
+    w.array(f.locals);
+    w.count(f.symbols.size());
+    for (const std::string& s : f.symbols) w.str(s);
+    w.array(f.branches);
+    w.count(f.brTables.size());
+    for (const auto& table : f.brTables) w.array(table);
+    w.pod(f.indirectCallSites);
+    w.pod(f.maxStack);
+}
+
+FuncDef readFunction(Reader& r) {
+    FuncDef f;
+    f.index = r.pod<int32_t>();
+    f.typeId = r.pod<uint32_t>();
+    f.params.resize(r.count());
+    for (auto& [name, value] : f.params) {
+        name = r.str();
+        value = r.pod<WasmValue>();
+    }
+    f.result = r.pod<WasmValue>();
+    f.hasResult = r.pod<bool>();
+    f.name = r.str();
+    r.array(f.code);
+    r.array(f.locals);
+    f.symbols.resize(r.count());
+    for (std::string& s : f.symbols) s = r.str();
+    r.array(f.branches);
+    f.brTables.resize(r.count());
+    for (auto& table : f.brTables) r.array(table);
+    f.indirectCallSites = r.pod<uint32_t>();
+    f.maxStack = r.pod<uint32_t>();
+    return f;
+}
+
+void writeImage(Writer& w, const WasmInstance::Image& image) {
+    w.count(image.memoryPages);
+    w.array(image.memory);
+    w.count(image.globals.size());
+    for (const WasmGlobal& g : image.globals) {
+        w.str(g.name);
+        w.pod(g.type);
+        w.pod(g.mutableFlag);
+        w.pod(g.value);
+    }
+    w.count(image.dataSegments.size());
+    for (const DataSegment& seg : image.dataSegments) {
+        w.array(seg.bytes);
+        w.pod(seg.active);
+        w.pod(seg.offset);
+    }
+    w.bools(image.droppedData);
+    w.count(image.tables.size());
+    for (const WasmTable& table : image.tables) {
+        std::vector<int32_t> elements(table.size());
+        for (uint32_t i = 0; i < table.size(); ++i) elements[i] = table.get(i);
+        w.pod(table.maximum());
+        w.array(elements);
+    }
+    w.count(image.elemSegments.size());
+    for (const ElemSegment& seg : image.elemSegments) {
+        w.array(seg.refs);
+        w.pod(seg.active);
+        w.pod(seg.declarative);
+        w.pod(seg.table);
+        w.pod(seg.offset);
+    }
+    w.bools(image.droppedElems);
+    w.count(image.funcImports.size());
+    for (const FuncImport& import : image.funcImports) {
+        w.str(import.module);
+        w.str(import.field);
+        w.type(import.type);
+        w.pod(import.typeId);
+    }
+}
+
+WasmInstance::Image readImage(Reader& r) {
+    WasmInstance::Image image;
+    image.memoryPages = r.pod<uint64_t>();
+    if (image.memoryPages > WasmMemory::MAX_PAGES) throw std::runtime_error("bad memory size");
+    r.array(image.memory);
+    image.globals.resize(r.count());
+    for (WasmGlobal& g : image.globals) {
+        g.name = r.str();
+        g.type = r.pod<ValueType>();
+        g.mutableFlag = r.pod<bool>();
+        g.value = r.pod<WasmSlot>();
+    }
+    image.dataSegments.resize(r.count());
+    for (DataSegment& seg : image.dataSegments) {
+        r.array(seg.bytes);
+        seg.active = r.pod<bool>();
+        seg.offset = r.pod<uint32_t>();
+    }
+    r.bools(image.droppedData);
+    for (size_t n = r.count(); n > 0; --n) {
+        uint32_t max = r.pod<uint32_t>();
+        std::vector<int32_t> elements;
+        r.array(elements);
+        WasmTable table(static_cast<uint32_t>(elements.size()), max);
+        table.init(0, elements, 0, table.size());
+        image.tables.push_back(std::move(table));
+    }
+    image.elemSegments.resize(r.count());
+    for (ElemSegment& seg : image.elemSegments) {
+        r.array(seg.refs);
+        seg.active = r.pod<bool>();
+        seg.declarative = r.pod<bool>();
+        seg.table = r.pod<uint32_t>();
+        seg.offset = r.pod<uint32_t>();
+    }
+    r.bools(image.droppedElems);
+    image.funcImports.resize(r.count());
+    for (FuncImport& import : image.funcImports) {
+        import.module = r.str();
+        import.field = r.str();
+        import.type = r.type();
+        import.typeId = r.pod<uint32_t>();
+    }
+    return image;
+}
+
+} // namespace
+
+uint64_t WasmModuleCache::key(const uint8_t* data, size_t size) {
+    uint64_t h = hashBytes(data, size);
+    h = hashBytes(&size, sizeof size, h);
+    return hashBytes(buildTag().data(), buildTag().size(), h);
+}
+
+std::string WasmModuleCache::pathFor(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof name, "%016llx.wcache", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+bool WasmModuleCache::load(uint64_t key, WasmModule& module, WasmInstance& instance) const {
+    std::string path = pathFor(key);
+    if (::access(path.c_str(), R_OK) != 0) return false;
+    try {
+        WasmMappedFile file(path);
+        Header header;
+        if (file.size < sizeof header) return false;
+        std::memcpy(&header, file.data, sizeof header);
+        if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.key != key
+            || header.format != hashBytes(buildTag().data(), buildTag().size())
+            || header.payloadSize != file.size - sizeof header
+            || header.checksum != hashBytes(file.data + sizeof header, header.payloadSize))
+            return false;
+
+        Reader r(file.data + sizeof header, file.data + file.size);
+        int startFunction = r.pod<int32_t>();
+        size_t invalidFunctions = r.count();
+        std::string invalidReason = r.str();
+        std::unordered_map<int, FuncType> funcTypes;
+        for (size_t n = r.count(); n > 0; --n) {
+            int index = r.pod<int32_t>();
+            funcTypes[index] = r.type();
+        }
+        WasmDecoder decoder;
+        for (size_t n = r.count(); n > 0; --n) decoder.signatureId(r.type());
+        std::unordered_map<int, FuncDef> functionsByID;
+        for (size_t n = r.count(); n > 0; --n) {
+            FuncDef f = readFunction(r);
+            int index = f.index;
+            functionsByID[index] = std::move(f);
+        }
+        std::unordered_map<std::string, uint32_t> functionByName;
+        for (size_t n = r.count(); n > 0; --n) {
+            std::string name = r.str();
+            int32_t index = r.pod<int32_t>();
+            if (!functionsByID.count(index)) return false;
+            functionByName[name] = static_cast<uint32_t>(index);
+        }
+        std::unordered_map<std::string, WasmExport> exports;
+        for (size_t n = r.count(); n > 0; --n) {
+            std::string key = r.str();
+            WasmExport exp;
+            exp.name = r.str();
+            exp.kind = r.str();
+            exp.index = r.pod<int32_t>();
+            exports.emplace(std::move(key), std::move(exp));
+        }
+        WasmInstance::Image image = readImage(r);
+        if (!r.atEnd()) return false;
+
+        module.startFunction = startFunction;
+        module.invalidFunctions = invalidFunctions;
+        module.invalidReason = std::move(invalidReason);
+        module.funcTypes = std::move(funcTypes);
+        module.decoder = std::move(decoder);
+        module.functionsByID = std::move(functionsByID);
+        module.functionByName = std::move(functionByName);
+        module.exports = std::move(exports);
+        instance.load(image);
+        return true;
+    } catch (const std::exception& e) {
+        WASM_TRACE(Parser, Info, "\033[1;33m[module:cache]\033[0m Ignoring " << path << ": " << e.what() << "\n");
+        return false;
+    }
+}
+
+bool WasmModuleCache::store(uint64_t key, const WasmModule& module, const WasmInstance& instance) const {
+    Writer w;
+    w.pod(static_cast<int32_t>(module.startFunction));
+    w.count(module.invalidFunctions);
+    w.str(module.invalidReason);
+    w.count(module.funcTypes.size());
+    for (const auto& [index, type] : module.funcTypes) {
+        w.pod(static_cast<int32_t>(index));
+        w.type(type);
+    }
+    w.count(module.decoder.signatureCount());
+    for (uint32_t id = 0; id < module.decoder.signatureCount(); ++id) w.type(module.decoder.signature(id));
+    w.count(module.functionsByID.size());
+    for (const auto& [index, func] : module.functionsByID) writeFunction(w, func);
+    w.count(module.functionByName.size());
+    for (const auto& [name, index] : module.functionByName) {
+        w.str(name);
+        w.pod(static_cast<int32_t>(index));
+    }
+    w.count(module.exports.size());
+    for (const auto& [key, exp] : module.exports) {
+        w.str(key);
+        w.str(exp.name);
+        w.str(exp.kind);
+        w.pod(static_cast<int32_t>(exp.index));
+    }
+    writeImage(w, instance.capture());
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.key = key;
+    header.format = hashBytes(buildTag().data(), buildTag().size());
+    header.payloadSize = w.out.size();
+    header.checksum = hashBytes(w.out.data(), w.out.size());
+
+    if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    // Unique per process and per call, so concurrent writers never share a temporary
+    static std::atomic<uint64_t> serial{0};
+    std::string path = pathFor(key);
+    std::string temporary = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(serial++);
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof header);
+        file.write(w.out.data(), static_cast<std::streamsize>(w.out.size()));
+        if (!file.flush()) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    WASM_TRACE(Parser, Info, "\033[1;34m[module:cache]\033[0m Stored " << path << " ("
+              << sizeof header + w.out.size() << " bytes)\n");
+    return true;
+}
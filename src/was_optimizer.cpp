@@ -0,0 +1,432 @@
+#include "wasm_optimizer.hpp"
+#include "wasm_module.hpp"
+#include "wasm_validator.hpp"
+#include "wasm_numeric.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+using O = Opcode;
+
+constexpr uint32_t NONE = UINT32_MAX;
+
+// A function body between WasmDecoder::unlink and link
+struct Body {
+    std::vector<Instr> code;
+    std::vector<std::vector<uint32_t>> depths;
+};
+
+Opcode constOp(ValueType t) {
+    switch (t) {
+        case ValueType::I32: return O::I32Const;
+        case ValueType::I64: return O::I64Const;
+        case ValueType::F32: return O::F32Const;
+        default: return O::F64Const;
+    }
+}
+
+// The whole immediate: an i32 / f32 constant sits in its low half, as in a slot
+WasmSlot constValue(const Instr& in) { return WasmSlot(static_cast<int64_t>(in.imm.i64)); }
+
+Instr constant(ValueType t, WasmSlot v) {
+    Instr in;
+    in.op = constOp(t);
+    switch (t) {
+        case ValueType::I32: in.imm.i32 = v.i32; break;
+        case ValueType::I64: in.imm.i64 = v.i64; break;
+        case ValueType::F32: in.imm.f32 = v.f32; break;
+        case ValueType::F64: in.imm.f64 = v.f64; break;
+    }
+    return in;
+}
+
+template <ValueType T>
+using ScalarOf = typename WasmScalar<T>::type;
+
+bool isPowerOfTwo(uint64_t v) { return v != 0 && (v & (v - 1)) == 0; }
+uint32_t log2Of(uint64_t v) { return static_cast<uint32_t>(__builtin_ctzll(v)); }
+
+class Rewriter {
+public:
+    Rewriter(const std::vector<WasmGlobal>& globals, const std::vector<bool>& constantGlobals)
+        : globals(globals), constantGlobals(constantGlobals) {}
+
+    size_t folded = 0;
+    size_t reduced = 0;
+    size_t dead = 0;
+
+    // Constants, dropped values and branch / select conditions, over adjacent
+    // instructions. Structured code has no label between two plain instructions,
+    // so the one before an instruction always produced its top operand.
+    bool peephole(Body& body) {
+        size_t before = folded + reduced + dead;
+        out.clear();
+        out.reserve(body.code.size());
+        for (const Instr& in : body.code) emit(in);
+        body.code.swap(out);
+        return folded + reduced + dead != before;
+    }
+
+    // Code that cannot run: the rest of a block after an unconditional branch, and
+    // the arm of an `if` on a constant (the other arm stays, as a block)
+    bool prune(Body& body) {
+        const std::vector<Instr>& code = body.code;
+        size_t n = code.size();
+        std::vector<uint32_t> endOf(n, NONE), elseOf(n, NONE), open;
+        for (uint32_t pc = 0; pc < n; ++pc) {
+            O op = code[pc].op;
+            if (op == O::Block || op == O::Loop || op == O::If) open.push_back(pc);
+            else if (op == O::Else && !open.empty()) elseOf[open.back()] = pc;
+            else if (op == O::End && !open.empty()) {
+                endOf[open.back()] = pc;
+                open.pop_back();
+            }
+        }
+
+        size_t before = dead;
+        std::vector<uint32_t> resume(n, NONE);   // at this `else`, continue from here
+        out.clear();
+        out.reserve(n);
+        for (uint32_t pc = 0; pc < n;) {
+            if (resume[pc] != NONE) {
+                dead += resume[pc] - pc;
+                pc = resume[pc];
+                continue;
+            }
+            Instr in = code[pc];
+            if (in.op == O::If && endOf[pc] != NONE && !out.empty() && out.back().op == O::I32Const) {
+                bool taken = out.back().imm.i32 != 0;
+                out.pop_back();
+                ++dead;
+                in.op = O::Block;
+                if (taken) {
+                    out.push_back(in);
+                    if (elseOf[pc] != NONE) resume[elseOf[pc]] = endOf[pc];
+                    ++pc;
+                } else if (elseOf[pc] != NONE) {
+                    out.push_back(in);
+                    dead += elseOf[pc] - pc;
+                    pc = elseOf[pc] + 1;
+                } else {
+                    dead += endOf[pc] + 1 - pc;
+                    pc = endOf[pc] + 1;
+                }
+                continue;
+            }
+            out.push_back(in);
+            ++pc;
+            if (in.op != O::Br && in.op != O::BrTable && in.op != O::Return) continue;
+            // Up to the `else` or `end` of the enclosing block
+            uint32_t depth = 0, next = pc;
+            for (; next < n; ++next) {
+                O op = code[next].op;
+                if (op == O::Block || op == O::Loop || op == O::If) ++depth;
+                else if (op == O::Else && depth == 0) break;
+                else if (op == O::End && depth-- == 0) break;
+            }
+            dead += next - pc;
+            pc = next;
+        }
+        body.code.swap(out);
+        return dead != before;
+    }
+
+    // i32 division and remainder by a constant that is not a power of two. Last, so
+    // the plain i32.const is still there for everything above to fold.
+    void divideByMultiply(Body& body) {
+        std::vector<Instr>& code = body.code;
+        for (size_t pc = 0; pc + 1 < code.size(); ++pc) {
+            O next = code[pc + 1].op;
+            if (code[pc].op != O::I32Const || (next != O::I32DivU && next != O::I32RemU)) continue;
+            uint32_t d = static_cast<uint32_t>(code[pc].imm.i32);
+            if (d < 3 || isPowerOfTwo(d)) continue;
+            uint32_t shift = 32 - static_cast<uint32_t>(__builtin_clz(d));
+            code[pc].op = next == O::I32DivU ? O::I32DivUImm : O::I32RemUImm;
+            code[pc].a = static_cast<uint32_t>(((uint64_t{1} << 32) * ((uint64_t{1} << shift) - d)) / d + 1);
+            code[pc].b = shift;
+            ++reduced;
+        }
+    }
+
+private:
+    const std::vector<WasmGlobal>& globals;
+    const std::vector<bool>& constantGlobals;
+    std::vector<Instr> out;
+
+    bool isConst(size_t fromTop, ValueType t) const {
+        return out.size() > fromTop && out[out.size() - 1 - fromTop].op == constOp(t);
+    }
+    WasmSlot operand(size_t fromTop) const { return constValue(out[out.size() - 1 - fromTop]); }
+
+    void emit(const Instr& in) {
+        if (in.op == O::Nop) {
+            ++dead;
+            return;
+        }
+        if (in.op == O::GlobalGet && constantGlobals[in.a]) {
+            const WasmGlobal& g = globals[in.a];
+            ++folded;
+            emit(constant(g.type, g.value));
+            return;
+        }
+        if (fold(in.op)) return;
+        if (!out.empty() && reduce(in)) return;
+        out.push_back(in);
+    }
+
+    void replace(size_t operands, const Instr& result) {
+        out.resize(out.size() - operands);
+        out.push_back(result);
+        ++folded;
+    }
+
+    // Division by zero and INT_MIN / -1 are left to the executors
+    template <typename T>
+    static bool divisionFolds(O op, T a, T b) {
+        switch (op) {
+            case O::I32DivU: case O::I32RemU: case O::I64DivU: case O::I64RemU:
+                return b != 0;
+            case O::I32DivS: case O::I32RemS: case O::I64DivS: case O::I64RemS:
+                return b != 0 && !(b == -1 && a == std::numeric_limits<T>::min());
+            default:
+                return true;
+        }
+    }
+
+    static bool truncates(O op) {
+        return op == O::I32TruncF32S || op == O::I32TruncF32U || op == O::I32TruncF64S;
+    }
+
+    // `op` over constant operands, computed as the stack executor computes it
+    bool fold(O op) {
+        switch (op) {
+#define BINARY(name, type, T, expr) \
+            case O::name: { \
+                if (!isConst(0, ValueType::type) || !isConst(1, ValueType::type)) return false; \
+                using S = WasmScalar<ValueType::type>; \
+                if (!divisionFolds(op, S::get(operand(1)), S::get(operand(0)))) return false; \
+                T a = static_cast<T>(S::get(operand(1))), b = static_cast<T>(S::get(operand(0))); \
+                replace(2, constant(ValueType::type, WasmSlot(static_cast<ScalarOf<ValueType::type>>(expr)))); \
+                return true; \
+            }
+#define COMPARE(name, type, T, expr) \
+            case O::name: { \
+                if (!isConst(0, ValueType::type) || !isConst(1, ValueType::type)) return false; \
+                using S = WasmScalar<ValueType::type>; \
+                T a = static_cast<T>(S::get(operand(1))), b = static_cast<T>(S::get(operand(0))); \
+                replace(2, constant(ValueType::I32, WasmSlot(static_cast<int32_t>((expr) ? 1 : 0)))); \
+                return true; \
+            }
+// i64.eqz is a test (an i32, as WasmValidator types it)
+#define UNARY(name, type, T, expr) \
+            case O::name: { \
+                if (!isConst(0, ValueType::type)) return false; \
+                using S = WasmScalar<ValueType::type>; \
+                T a = static_cast<T>(S::get(operand(0))); \
+                replace(1, constant(op == O::I64Eqz ? ValueType::I32 : ValueType::type, \
+                                    WasmSlot(static_cast<ScalarOf<ValueType::type>>(expr)))); \
+                return true; \
+            }
+// Out of range, float-to-integer truncation is undefined in C++; the executors'
+// result is the hardware's, which folding must not guess
+#define CONVERT(name, from, expr) \
+            case O::name: { \
+                if (!isConst(0, ValueType::from) || truncates(op)) return false; \
+                WasmValue v(ValueType::from, operand(0)); \
+                WasmValue r = expr; \
+                replace(1, constant(r.type, WasmSlot(r))); \
+                return true; \
+            }
+            WASM_NUMERIC_OPS(BINARY, COMPARE, UNARY, CONVERT)
+#undef BINARY
+#undef COMPARE
+#undef UNARY
+#undef CONVERT
+            default:
+                return false;
+        }
+    }
+
+    // `in` with a constant (or a pure value) right before it
+    bool reduce(const Instr& in) {
+        Instr& last = out.back();
+        switch (in.op) {
+            case O::Drop:
+                if (last.op == O::I32Const || last.op == O::I64Const || last.op == O::F32Const
+                    || last.op == O::F64Const || last.op == O::LocalGet || last.op == O::GlobalGet) {
+                    out.pop_back();
+                    dead += 2;
+                    return true;
+                }
+                if (last.op == O::LocalTee) {
+                    last.op = O::LocalSet;
+                    ++dead;
+                    return true;
+                }
+                return false;
+            case O::BrIf:
+                if (last.op != O::I32Const) return false;
+                if (last.imm.i32 == 0) {
+                    out.pop_back();
+                    dead += 2;
+                    return true;
+                }
+                last = in;
+                last.op = O::Br;
+                ++folded;
+                return true;
+            case O::Select:
+                // A true condition keeps the first operand: drop the second
+                if (last.op != O::I32Const || last.imm.i32 == 0) return false;
+                out.pop_back();
+                ++folded;
+                emit(Instr{O::Drop});
+                return true;
+            default:
+                break;
+        }
+
+        bool wide;
+        uint64_t c;
+        if (last.op == O::I32Const) {
+            wide = false;
+            c = static_cast<uint32_t>(last.imm.i32);
+        } else if (last.op == O::I64Const) {
+            wide = true;
+            c = static_cast<uint64_t>(last.imm.i64);
+        } else {
+            return false;
+        }
+        auto is = [&](O narrow, O wideOp) { return in.op == (wide ? wideOp : narrow); };
+        auto setConst = [&](uint64_t v) {
+            if (wide) last.imm.i64 = static_cast<int64_t>(v);
+            else last.imm.i32 = static_cast<int32_t>(v);
+        };
+        auto rewrite = [&](O narrow, O wideOp) {
+            out.push_back(in);
+            out.back().op = wide ? wideOp : narrow;
+            ++reduced;
+            return true;
+        };
+
+        // x op 0, x * 1, x / 1: x
+        bool identity = (c == 0 && (is(O::I32Add, O::I64Add) || is(O::I32Sub, O::I64Sub) || is(O::I32Or, O::I64Or)
+                                    || is(O::I32Xor, O::I64Xor) || is(O::I32Shl, O::I64Shl)
+                                    || is(O::I32ShrS, O::I64ShrS) || is(O::I32ShrU, O::I64ShrU)
+                                    || is(O::I32Rotl, O::I64Rotl) || is(O::I32Rotr, O::I64Rotr)))
+                     || (c == 1 && (is(O::I32Mul, O::I64Mul) || is(O::I32DivU, O::I64DivU)
+                                    || is(O::I32DivS, O::I64DivS)));
+        if (identity) {
+            out.pop_back();
+            ++reduced;
+            return true;
+        }
+        if (!isPowerOfTwo(c)) return false;
+        if (is(O::I32Mul, O::I64Mul)) {
+            setConst(log2Of(c));
+            return rewrite(O::I32Shl, O::I64Shl);
+        }
+        if (is(O::I32DivU, O::I64DivU)) {
+            setConst(log2Of(c));
+            return rewrite(O::I32ShrU, O::I64ShrU);
+        }
+        if (is(O::I32RemU, O::I64RemU)) {
+            setConst(c - 1);
+            return rewrite(O::I32And, O::I64And);
+        }
+        return false;
+    }
+};
+
+#if WASM_OPTIMIZE
+// Branches renumbered in order, leaving out the depths of removed ones
+void compactDepths(Body& body) {
+    std::vector<std::vector<uint32_t>> depths;
+    for (Instr& in : body.code) {
+        if (in.op != O::Br && in.op != O::BrIf && in.op != O::BrTable) continue;
+        depths.push_back(std::move(body.depths[in.a]));
+        in.a = static_cast<uint32_t>(depths.size() - 1);
+    }
+    body.depths.swap(depths);
+}
+#endif
+
+} // namespace
+
+std::vector<bool> WasmOptimizer::constantGlobals(const WasmModule& module, const WasmInstance& instance) {
+    std::vector<bool> constant(instance.globals.size());
+    for (size_t i = 0; i < constant.size(); ++i) constant[i] = !instance.globals[i].mutableFlag;
+    // The stack executor still runs functions WasmValidator rejected, global.set of
+    // an immutable global included
+    for (const auto& [index, func] : module.functionsByID)
+        for (const Instr& in : func.code)
+            if (in.op == O::GlobalSet && in.a < constant.size()) constant[in.a] = false;
+    return constant;
+}
+
+bool WasmOptimizer::optimizeFunction(FuncDef& func, WasmModule& module, const WasmInstance& instance,
+                                     const std::vector<bool>& constantGlobals) {
+#if WASM_OPTIMIZE
+    std::string reason;
+    if (!WasmValidator::validateFunction(func, module, instance, reason)) return false;
+    FuncDef original = func;
+    size_t before = func.code.size();
+
+    Body body;
+    body.code = WasmDecoder::unlink(func, body.depths);
+    Rewriter rewriter(instance.globals, constantGlobals);
+    // Each pass can expose work for the other: a folded condition, a block made dead
+    for (int round = 0; round < 8; ++round) {
+        bool changed = rewriter.peephole(body);
+        if (!rewriter.prune(body) && !changed) break;
+    }
+    rewriter.divideByMultiply(body);
+    if (rewriter.folded + rewriter.reduced + rewriter.dead == 0) return false;
+
+    compactDepths(body);
+    func.code = std::move(body.code);
+    module.decoder.link(func, body.depths);
+    module.decoder.fuse(func);
+    if (!WasmValidator::validateFunction(func, module, instance, reason)) {
+        WASM_TRACE(Parser, Debug, "\033[1;33m[optimizer]\033[0m function " << func.index
+                  << " left unoptimized: " << reason << "\n");
+        func = std::move(original);
+        return false;
+    }
+    WASM_TRACE(Parser, Info, "\033[1;34m[optimizer]\033[0m function " << func.index << ": " << before
+              << " -> " << func.code.size() << " instruction(s) (" << rewriter.folded << " folded, "
+              << rewriter.reduced << " strength-reduced, " << rewriter.dead << " dead)\n");
+    return true;
+#else
+    (void)func;
+    (void)module;
+    (void)instance;
+    (void)constantGlobals;
+    return false;
+#endif
+}
+
+void WasmOptimizer::optimize(WasmModule& module, const WasmInstance& instance) {
+#if WASM_OPTIMIZE
+    size_t count = 0, optimized = 0, before = 0, after = 0;
+    for (const auto& [index, func] : module.functionsByID)
+        if (index >= 0) count = std::max(count, static_cast<size_t>(index) + 1);
+    std::vector<bool> constants = constantGlobals(module, instance);
+    // By index, so the report reads in module order
+    for (size_t index = 0; index < count; ++index) {
+        auto it = module.functionsByID.find(static_cast<int>(index));
+        if (it == module.functionsByID.end()) continue;
+        before += it->second.code.size();
+        if (optimizeFunction(it->second, module, instance, constants)) ++optimized;
+        after += it->second.code.size();
+    }
+    WASM_TRACE(Parser, Info, "\033[1;34m[optimizer]\033[0m " << optimized << " of " << module.functionsByID.size()
+              << " function(s) rewritten, " << before << " -> " << after << " instruction(s)\n");
+#else
+    (void)module;
+    (void)instance;
+#endif
+}
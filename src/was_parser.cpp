@@ -1,304 +1,1220 @@
 #include "wasm_parser.hpp"
 #include "wasm_memory.hpp"
+#include "wasm_trace.hpp"
 #include <iostream>
-#include <sstream>
-#include <algorithm> 
-#include <regex>
+#include <stdexcept>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+bool isId(std::string_view s) { return !s.empty() && s[0] == '$'; }
+
+// Numeric literal without the '_' separators the text format allows
+std::string stripUnderscores(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s)
+        if (c != '_') out += c;
+    return out;
+}
+
+bool parseInteger(std::string_view text, uint64_t& value, bool& negative) {
+    std::string s = stripUnderscores(text);
+    size_t i = 0;
+    negative = false;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) negative = s[i++] == '-';
+    int base = 10;
+    if (s.compare(i, 2, "0x") == 0 || s.compare(i, 2, "0X") == 0) { base = 16; i += 2; }
+    if (i >= s.size()) return false;
+    char* endp = nullptr;
+    errno = 0;
+    value = std::strtoull(s.c_str() + i, &endp, base);
+    return errno == 0 && *endp == '\0';
+}
+
+template <typename F>
+bool parseFloat(std::string_view text, F& value) {
+    std::string s = stripUnderscores(text);
+    bool negative = !s.empty() && s[0] == '-';
+    std::string_view body(s);
+    if (!body.empty() && (body[0] == '+' || body[0] == '-')) body.remove_prefix(1);
+    if (body == "inf") {
+        value = negative ? -std::numeric_limits<F>::infinity() : std::numeric_limits<F>::infinity();
+        return true;
+    }
+    if (body.substr(0, 3) == "nan") {
+        value = std::numeric_limits<F>::quiet_NaN();
+        if (negative) value = -value;
+        return true;
+    }
+    char* endp = nullptr;
+    if constexpr (sizeof(F) == sizeof(float)) value = std::strtof(s.c_str(), &endp);
+    else value = std::strtod(s.c_str(), &endp);
+    return *endp == '\0';
+}
 
-void WasmParser::parseModule(std::unordered_map<std::string, WasmGlobal>& globals) {
-    globals.clear();
+WasmValue zeroValue(std::string_view t) {
+    if (t == "funcref" || t == "externref") return WasmValue(NULL_REF);
+    if (t == "i64") return WasmValue(int64_t(0));
+    if (t == "f32") return WasmValue(float(0));
+    if (t == "f64") return WasmValue(double(0));
+    return WasmValue(int32_t(0));
+}
 
-    std::cout << "\033[1;32m[parser:parseModule]\033[0m New module initialized. Globals cleared.\n";
+const char* typeName(ValueType t) {
+    switch (t) {
+        case ValueType::I32: return "i32";
+        case ValueType::I64: return "i64";
+        case ValueType::F32: return "f32";
+        case ValueType::F64: return "f64";
+    }
+    return "?";
 }
 
-void WasmParser::parseGlobal(const std::string& line, std::unordered_map<std::string, WasmGlobal>& globals) {
-    std::cout << "\033[1;32m[parser:parseGlobal]\033[0m Global definition found: " << line << "\n";
+// Immediates the parser does not interpret (for instructions without an opcode yet)
+bool looksLikeImmediate(std::string_view s) {
+    return isId(s) || isDigit(s[0]) || s[0] == '-' || s[0] == '+' || s.find('=') != std::string_view::npos
+        || s == "func" || s == "extern";
+}
 
-    std::istringstream iss(line);
-    std::string token, name, typeStr, mutStr;
-    bool isMutable = false;
-    ValueType type = ValueType::I32;
-    WasmValue initValue;
+} // namespace
 
-    iss >> token;
-    iss >> name;
-    iss >> mutStr;
+// ---------------------------------------------------------------- tokenizer
 
-    if (mutStr == "(mut") {
-        isMutable = true;
-        iss >> typeStr;
-        if (!typeStr.empty() && typeStr.back() == ')')
-            typeStr.pop_back();
-    } else {
-        typeStr = mutStr;
+void WasmParser::next() {
+    for (;;) {
+        while (cur < end && std::isspace(static_cast<unsigned char>(*cur))) {
+            if (*cur == '\n') ++line;
+            ++cur;
+        }
+        if (end - cur >= 2 && cur[0] == ';' && cur[1] == ';') {
+            while (cur < end && *cur != '\n') ++cur;
+            continue;
+        }
+        if (end - cur >= 2 && cur[0] == '(' && cur[1] == ';') {
+            // Block comments nest
+            int depth = 1;
+            cur += 2;
+            while (cur < end && depth > 0) {
+                if (end - cur >= 2 && cur[0] == '(' && cur[1] == ';') { ++depth; cur += 2; }
+                else if (end - cur >= 2 && cur[0] == ';' && cur[1] == ')') { --depth; cur += 2; }
+                else { if (*cur == '\n') ++line; ++cur; }
+            }
+            continue;
+        }
+        break;
     }
 
-    if (typeStr == "i32") type = ValueType::I32;
-    else if (typeStr == "i64") type = ValueType::I64;
-    else if (typeStr == "f32") type = ValueType::F32;
-    else if (typeStr == "f64") type = ValueType::F64;
-    else {
-        std::cerr << "\033[1;31m[parser:parseGlobal]\033[0m Unknown type " << typeStr << "\n";
+    if (cur >= end) {
+        tok = {TokenKind::Eof, {}};
         return;
     }
 
-    std::string constType;
-    iss >> constType;
-
-    if (constType.find("i32.const") != std::string::npos) {
-        int32_t val; iss >> val;
-        initValue = WasmValue(val);
-    } else if (constType.find("i64.const") != std::string::npos) {
-        int64_t val; iss >> val;
-        initValue = WasmValue(val);
-    } else if (constType.find("f32.const") != std::string::npos) {
-        float val; iss >> val;
-        initValue = WasmValue(val);
-    } else if (constType.find("f64.const") != std::string::npos) {
-        double val; iss >> val;
-        initValue = WasmValue(val);
-    } else {
-        std::cerr << "\033[1;31m[parser:parseGlobal]\033[0m Unknown init constant type: " << constType << "\n";
+    const char* start = cur;
+    if (*cur == '(' || *cur == ')') {
+        tok = {*cur == '(' ? TokenKind::LParen : TokenKind::RParen, {cur, 1}};
+        ++cur;
+        return;
+    }
+    if (*cur == '"') {
+        ++cur;
+        while (cur < end && *cur != '"') {
+            if (*cur == '\\' && cur + 1 < end) ++cur;
+            if (*cur == '\n') ++line;
+            ++cur;
+        }
+        if (cur >= end) error("unterminated string");
+        ++cur;
+        tok = {TokenKind::String, {start + 1, static_cast<size_t>(cur - start - 2)}};
         return;
     }
+    while (cur < end && !std::isspace(static_cast<unsigned char>(*cur))
+           && *cur != '(' && *cur != ')' && *cur != '"' && *cur != ';')
+        ++cur;
+    tok = {TokenKind::Atom, {start, static_cast<size_t>(cur - start)}};
+}
 
-    WasmGlobal g{name, type, isMutable, initValue};
-    globals[name] = g;
+WasmParser::Token WasmParser::peek() {
+    const char* savedCur = cur;
+    size_t savedLine = line;
+    Token saved = tok;
+    next();
+    Token ahead = tok;
+    cur = savedCur;
+    line = savedLine;
+    tok = saved;
+    return ahead;
+}
 
-    std::cout << "\033[1;32m[parser:parseGlobal]\033[0m Global "
-              << name << " (type=" << typeStr
-              << ", mutable=" << (isMutable ? "true" : "false")
-              << ") = ";
+bool WasmParser::isForm(std::string_view keyword) {
+    if (tok.kind != TokenKind::LParen) return false;
+    Token ahead = peek();
+    return ahead.kind == TokenKind::Atom && ahead.text == keyword;
+}
 
-    switch (type) {
-        case ValueType::I32: std::cout << initValue.i32; break;
-        case ValueType::I64: std::cout << initValue.i64; break;
-        case ValueType::F32: std::cout << initValue.f32; break;
-        case ValueType::F64: std::cout << initValue.f64; break;
+void WasmParser::expect(TokenKind kind, const char* what) {
+    if (tok.kind != kind) error(std::string("expected ") + what);
+    next();
+}
+
+std::string_view WasmParser::atom(const char* what) {
+    if (tok.kind != TokenKind::Atom) error(std::string("expected ") + what);
+    std::string_view text = tok.text;
+    next();
+    return text;
+}
+
+void WasmParser::skipToClose() {
+    int depth = 1;
+    while (depth > 0) {
+        if (tok.kind == TokenKind::Eof) error("unbalanced parentheses");
+        if (tok.kind == TokenKind::LParen) ++depth;
+        else if (tok.kind == TokenKind::RParen) --depth;
+        next();
     }
-    std::cout << "\n";
 }
 
-void WasmParser::print_globals(const std::unordered_map<std::string, WasmGlobal>& globals) const {
-    std::cout << "\033[1;32m[parser:print_globals]\033[0m Global variables state:\n";
+void WasmParser::error(const std::string& msg) const {
+    throw std::runtime_error("\033[1;31m[parser:line " + std::to_string(line) + "]\033[0m " + msg
+                             + (tok.text.empty() ? "" : " near '" + std::string(tok.text) + "'"));
+}
 
-    if (globals.empty()) {
-        std::cout << "  (empty)\n";
+// ---------------------------------------------------------------- module
+
+void WasmParser::parseModule(std::string_view source,
+                             std::unordered_map<int, FuncType>& funcTypes,
+                             std::unordered_map<int, FuncDef>& functionsByID,
+                             std::unordered_map<std::string, uint32_t>& functionByName,
+                             std::unordered_map<std::string, WasmExport>& exports,
+                             WasmInstance& instance,
+                             WasmDecoder& dec) {
+    types = &funcTypes;
+    inst = &instance;
+    decoder = &dec;
+    typeNames.clear();
+    funcNames.clear();
+    globalNames.clear();
+    dataNames.clear();
+    tableNames.clear();
+    elemNames.clear();
+    elemFixups.clear();
+    funcs.clear();
+    importedFuncs = 0;
+    nameFixups.clear();
+    pendingExports.clear();
+    startRef = {};
+    startIndex = -1;
+    instance.globals.clear();
+    instance.dataSegments.clear();
+    instance.tables.clear();
+    instance.elemSegments.clear();
+    instance.funcImports.clear();
+
+    cur = source.data();
+    end = cur + source.size();
+    line = 1;
+    next();
+
+    bool wrapped = isForm("module");
+    if (wrapped) {
+        next();
+        next();
+        if (tok.kind == TokenKind::Atom && isId(tok.text)) next();
+    }
+    while (tok.kind == TokenKind::LParen) parseField();
+    if (wrapped) expect(TokenKind::RParen, "')' closing module");
+    if (tok.kind != TokenKind::Eof) error("unexpected token after module");
+
+    // Forward references are resolved once every name is known
+    for (const NameFixup& f : nameFixups) {
+        Instr& in = funcs[f.slot].code[f.pc];
+        if (in.op == Opcode::Call || in.op == Opcode::RefFunc) {
+            in.a = resolveIndex(f.name, funcNames, "function");
+        } else if (in.op == Opcode::GlobalGet || in.op == Opcode::GlobalSet) {
+            in.a = resolveIndex(f.name, globalNames, "global");
+            if (in.a >= inst->globals.size()) error("unknown global " + std::string(f.name));
+        } else {
+            in.a = resolveIndex(f.name, dataNames, "data segment");
+        }
+    }
+    for (const ElemFixup& f : elemFixups)
+        inst->elemSegments[f.segment].refs[f.position] =
+            static_cast<int32_t>(resolveIndex(f.name, funcNames, "function"));
+
+    for (const PendingExport& p : pendingExports) {
+        int index = p.index;
+        if (index < 0) {
+            if (p.kind == "func") index = static_cast<int>(resolveIndex(p.ref, funcNames, "function"));
+            else if (p.kind == "global") index = static_cast<int>(resolveIndex(p.ref, globalNames, "global"));
+            else if (p.kind == "table") index = static_cast<int>(resolveIndex(p.ref, tableNames, "table"));
+            else index = isId(p.ref) ? 0 : static_cast<int>(resolveIndex(p.ref, {}, std::string(p.kind).c_str()));
+        }
+        exports[p.name] = WasmExport{p.name, std::string(p.kind), index};
+        WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseExport]\033[0m Exported "
+                  << p.kind << " '" << p.name << "' (index " << index << ")\n");
+    }
+
+    // Segments are applied only now, so their position relative to (memory) does not matter
+    inst->instantiate();
+
+    if (!startRef.empty())
+        startIndex = static_cast<int>(resolveIndex(startRef, funcNames, "function"));
+
+    for (FuncDef& f : funcs) {
+        int index = f.index;
+        if (!f.name.empty()) functionByName[f.name] = static_cast<uint32_t>(index);
+        functionsByID[index] = std::move(f);
+    }
+    funcs.clear();
+}
+
+uint32_t WasmParser::resolveIndex(std::string_view ref,
+                                  const std::unordered_map<std::string_view, uint32_t>& names,
+                                  const char* what) {
+    if (isId(ref)) {
+        auto it = names.find(ref);
+        if (it == names.end()) error(std::string("unknown ") + what + " " + std::string(ref));
+        return it->second;
+    }
+    uint64_t value = 0;
+    bool negative = false;
+    if (!parseInteger(ref, value, negative) || negative || value > UINT32_MAX)
+        error(std::string("invalid ") + what + " index " + std::string(ref));
+    return static_cast<uint32_t>(value);
+}
+
+void WasmParser::parseField() {
+    expect(TokenKind::LParen, "'('");
+    std::string_view kind = atom("module field");
+
+    if (kind == "type") parseType();
+    else if (kind == "import") parseImport();
+    else if (kind == "func") parseFunc();
+    else if (kind == "memory") parseMemory();
+    else if (kind == "global") parseGlobal();
+    else if (kind == "export") parseExport();
+    else if (kind == "data") parseData();
+    else if (kind == "table") parseTable();
+    else if (kind == "elem") parseElem();
+    else if (kind == "start") {
+        startRef = atom("start function");
+        expect(TokenKind::RParen, "')' closing start");
+    } else {
+        std::cerr << "\033[1;33m[parser:parseField]\033[0m Skipping unsupported field '" << kind
+                  << "' at line " << line << "\n";
+        skipToClose();
+    }
+}
+
+void WasmParser::parseType() {
+    uint32_t index = static_cast<uint32_t>(types->size());
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) typeNames[atom("type name")] = index;
+
+    expect(TokenKind::LParen, "'(func'");
+    if (atom("'func'") != "func") error("expected 'func' in type definition");
+    FuncType type;
+    std::vector<std::string> results;
+    while (tok.kind == TokenKind::LParen) {
+        next();
+        std::string_view kw = atom("'param' or 'result'");
+        if (kw == "param") parseValueTypes(type.params, nullptr);
+        else if (kw == "result") parseValueTypes(results, nullptr);
+        else error("unexpected '" + std::string(kw) + "' in type definition");
+    }
+    expect(TokenKind::RParen, "')' closing func");
+    expect(TokenKind::RParen, "')' closing type");
+    type.resultType = results.empty() ? "void" : results.front();
+    (*types)[static_cast<int>(index)] = type;
+
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseType]\033[0m Type " << index << ": "
+              << type.params.size() << " param(s) -> " << type.resultType << "\n");
+}
+
+void WasmParser::parseValueTypes(std::vector<std::string>& out, std::vector<std::string_view>* names) {
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) {
+        std::string_view name = atom("name");
+        out.emplace_back(atom("value type"));
+        if (names) names->push_back(name);
+    } else {
+        while (tok.kind == TokenKind::Atom) {
+            out.emplace_back(atom("value type"));
+            if (names) names->emplace_back();
+        }
+    }
+    expect(TokenKind::RParen, "')'");
+}
+
+FuncType WasmParser::parseTypeUse(std::vector<std::string_view>* paramNames) {
+    FuncType type;
+    const FuncType* declared = nullptr;
+    std::vector<std::string> results;
+    bool explicitSig = false;
+
+    while (isForm("type") || isForm("param") || isForm("result")) {
+        next();
+        std::string_view kw = atom("keyword");
+        if (kw == "type") {
+            uint32_t index = resolveIndex(atom("type index"), typeNames, "type");
+            auto it = types->find(static_cast<int>(index));
+            if (it == types->end()) error("unknown type " + std::to_string(index));
+            declared = &it->second;
+            expect(TokenKind::RParen, "')' closing type");
+        } else {
+            explicitSig = true;
+            if (kw == "param") parseValueTypes(type.params, paramNames);
+            else parseValueTypes(results, nullptr);
+        }
+    }
+
+    if (declared && !explicitSig) {
+        type = *declared;
+        if (paramNames) paramNames->assign(type.params.size(), {});
+        return type;
+    }
+    type.resultType = results.empty() ? "void" : results.front();
+    return type;
+}
+
+void WasmParser::parseImport() {
+    std::string module(parseStrings(true));
+    std::string field(parseStrings(true));
+    expect(TokenKind::LParen, "import descriptor");
+    std::string_view kind = atom("import kind");
+    std::string_view name;
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) name = atom("name");
+
+    if (kind == "func") {
+        if (!funcs.empty()) error("import after function definitions");
+        if (!name.empty()) funcNames[name] = importedFuncs;
+        FuncType type = parseTypeUse(nullptr);
+        inst->funcImports.push_back({module, field, type, decoder->signatureId(type)});
+        ++importedFuncs;
+        expect(TokenKind::RParen, "')' closing import descriptor");
+    } else if (kind == "memory") {
+        uint64_t pages = 0;
+        bool negative = false;
+        if (!parseInteger(atom("memory size"), pages, negative)) error("invalid memory size");
+        inst->memory = WasmMemory(pages);
+        skipToClose();
+    } else if (kind == "global") {
+        bool isMutable = isForm("mut");
+        std::string_view type;
+        if (isMutable) {
+            next();
+            next();
+            type = atom("value type");
+            expect(TokenKind::RParen, "')' closing mut");
+        } else {
+            type = atom("value type");
+        }
+        WasmValue v = zeroValue(type);
+        addGlobal(name, v.type, isMutable, v);
+        expect(TokenKind::RParen, "')' closing import descriptor");
+    } else if (kind == "table") {
+        uint64_t initial = 0;
+        bool negative = false;
+        if (!parseInteger(atom("table size"), initial, negative)) error("invalid table size");
+        if (!name.empty()) tableNames[name] = static_cast<uint32_t>(inst->tables.size());
+        inst->tables.emplace_back(static_cast<uint32_t>(initial));
+        skipToClose();
+    } else {
+        skipToClose();
+    }
+    expect(TokenKind::RParen, "')' closing import");
+
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseImport]\033[0m Imported " << kind << " "
+              << module << "." << field << "\n");
+}
+
+void WasmParser::parseFunc() {
+    std::string_view name;
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) name = atom("function name");
+
+    uint32_t slot = static_cast<uint32_t>(funcs.size());
+    uint32_t index = importedFuncs + slot;
+    bool imported = false;
+    std::string module, field;
+    while (isForm("export") || isForm("import")) {
+        next();
+        if (atom("keyword") == "export") {
+            pendingExports.push_back({parseStrings(), "func", {}, static_cast<int>(index)});
+        } else {
+            if (!funcs.empty()) error("import after function definitions");
+            module = parseStrings(true);
+            field = parseStrings(true);
+            imported = true;
+        }
+        expect(TokenKind::RParen, "')'");
+    }
+    if (!name.empty()) funcNames[name] = index;
+
+    if (imported) {
+        FuncType type = parseTypeUse(nullptr);
+        inst->funcImports.push_back({module, field, type, decoder->signatureId(type)});
+        expect(TokenKind::RParen, "')' closing func");
+        ++importedFuncs;
         return;
     }
 
-    for (const auto& [name, g] : globals) {
-        std::cout << "  " << name << " (type=";
+    funcs.emplace_back();
+    FuncDef& func = funcs.back();
+    func.index = static_cast<int>(index);
+    func.name = std::string(name);
+
+    FuncState fs;
+    fs.func = &func;
+    fs.slot = slot;
+
+    std::vector<std::string_view> paramNames;
+    FuncType type = parseTypeUse(&paramNames);
+    for (size_t i = 0; i < type.params.size(); ++i) {
+        WasmValue v = zeroValue(type.params[i]);
+        std::string_view pname = paramNames[i];
+        func.params.emplace_back(pname.empty() ? "param_" + std::to_string(i + 1) : std::string(pname), v);
+        func.locals.push_back(v);
+        if (!pname.empty()) fs.localSlots[pname] = static_cast<uint32_t>(i);
+    }
+    func.hasResult = type.resultType != "void";
+    if (func.hasResult) func.result = zeroValue(type.resultType);
+    func.typeId = decoder->signatureId(type);
+
+    while (isForm("local")) {
+        next();
+        next();
+        if (tok.kind == TokenKind::Atom && isId(tok.text)) {
+            std::string_view lname = atom("local name");
+            fs.localSlots[lname] = static_cast<uint32_t>(func.locals.size());
+            func.locals.push_back(zeroValue(atom("value type")));
+        } else {
+            while (tok.kind == TokenKind::Atom) func.locals.push_back(zeroValue(atom("value type")));
+        }
+        expect(TokenKind::RParen, "')' closing local");
+    }
+
+    parseInstrList(fs);
+    expect(TokenKind::RParen, "')' closing func");
+    decoder->link(func, fs.depths);
+    decoder->fuse(func);
 
-        switch (g.type) {
-            case ValueType::I32: std::cout << "i32"; break;
-            case ValueType::I64: std::cout << "i64"; break;
-            case ValueType::F32: std::cout << "f32"; break;
-            case ValueType::F64: std::cout << "f64"; break;
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseFunction]\033[0m Parsed function "
+              << (func.name.empty() ? "[anon]" : func.name) << " (index " << func.index << ") params="
+              << func.params.size() << " result=" << type.resultType << ": " << func.code.size()
+              << " instruction(s), " << func.locals.size() << " local slot(s)\n");
+}
+
+void WasmParser::parseMemory() {
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) next();
+    while (isForm("export") || isForm("import")) {
+        next();
+        if (atom("keyword") == "export") pendingExports.push_back({parseStrings(), "memory", {}, 0});
+        else { parseStrings(true); parseStrings(true); }
+        expect(TokenKind::RParen, "')'");
+    }
+
+    uint64_t pages = 0;
+    bool negative = false;
+    if (!parseInteger(atom("memory size"), pages, negative) || negative)
+        error("invalid memory size");
+    if (tok.kind == TokenKind::Atom) next();   // maximum is not enforced
+    expect(TokenKind::RParen, "')' closing memory");
+
+    inst->memory = WasmMemory(pages);
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseMemory]\033[0m Memory created with "
+              << pages << " page(s)\n");
+}
+
+void WasmParser::addGlobal(std::string_view name, ValueType type, bool isMutable, WasmValue value) {
+    uint32_t index = static_cast<uint32_t>(inst->globals.size());
+    std::string symbol = name.empty() ? "global_" + std::to_string(index) : std::string(name);
+    if (!name.empty()) globalNames[name] = index;
+    value.type = type;
+    inst->globals.push_back(WasmGlobal{symbol, type, isMutable, value});
+}
+
+void WasmParser::parseGlobal() {
+    std::string_view name;
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) name = atom("global name");
+    uint32_t index = static_cast<uint32_t>(inst->globals.size());
+    bool imported = false;
+    while (isForm("export") || isForm("import")) {
+        next();
+        if (atom("keyword") == "export") {
+            pendingExports.push_back({parseStrings(), "global", {}, static_cast<int>(index)});
+        } else {
+            parseStrings(true);
+            parseStrings(true);
+            imported = true;
         }
+        expect(TokenKind::RParen, "')'");
+    }
 
-        std::cout << ", mutable=" << (g.mutableFlag ? "true" : "false")
-                  << ") = ";
+    bool isMutable = isForm("mut");
+    std::string_view typeText;
+    if (isMutable) {
+        next();
+        next();
+        typeText = atom("value type");
+        expect(TokenKind::RParen, "')' closing mut");
+    } else {
+        typeText = atom("value type");
+    }
+    WasmValue v = imported ? zeroValue(typeText) : parseConstExpr();
+    expect(TokenKind::RParen, "')' closing global");
 
-        switch (g.type) {
+    ValueType type = zeroValue(typeText).type;
+    addGlobal(name, type, isMutable, v);
+
+    if (WASM_TRACE_ON(Parser, Info)) {
+        const WasmGlobal& g = inst->globals.back();
+        std::cout << "\033[1;32m[parser:parseGlobal]\033[0m Global " << g.name << " (type=" << typeName(type)
+                  << ", mutable=" << (isMutable ? "true" : "false") << ") = ";
+        switch (type) {
             case ValueType::I32: std::cout << g.value.i32; break;
             case ValueType::I64: std::cout << g.value.i64; break;
             case ValueType::F32: std::cout << g.value.f32; break;
             case ValueType::F64: std::cout << g.value.f64; break;
         }
-
         std::cout << "\n";
     }
 }
 
-void WasmParser::parseType(const std::string& line, std::unordered_map<int, FuncType>& funcTypes) {
-    std::cout << "\033[1;32m[parser:parseType]\033[0m Type definition found: " << line << "\n";
+WasmValue WasmParser::parseConstExpr() {
+    bool folded = tok.kind == TokenKind::LParen;
+    if (folded) next();
+    std::string_view op = atom("constant expression");
+    WasmValue v;
+
+    if (op == "i32.const" || op == "i64.const") {
+        std::string_view text = atom("integer");
+        uint64_t bits = 0;
+        bool negative = false;
+        if (!parseInteger(text, bits, negative)) error("invalid integer " + std::string(text));
+        if (negative) bits = ~bits + 1;
+        if (op == "i32.const") v = WasmValue(static_cast<int32_t>(static_cast<uint32_t>(bits)));
+        else v = WasmValue(static_cast<int64_t>(bits));
+    } else if (op == "f32.const") {
+        float f = 0;
+        if (!parseFloat(atom("float"), f)) error("invalid float");
+        v = WasmValue(f);
+    } else if (op == "f64.const") {
+        double d = 0;
+        if (!parseFloat(atom("float"), d)) error("invalid float");
+        v = WasmValue(d);
+    } else if (op == "global.get") {
+        uint32_t index = resolveIndex(atom("global"), globalNames, "global");
+        if (index >= inst->globals.size()) error("unknown global " + std::to_string(index));
+        const WasmGlobal& g = inst->globals[index];
+        v = WasmValue(g.type, g.value);
+    } else if (op == "ref.null") {
+        atom("heap type");
+        v = WasmValue(NULL_REF);
+    } else if (op == "ref.func") {
+        v = WasmValue(static_cast<int32_t>(resolveIndex(atom("function"), funcNames, "function")));
+    } else {
+        error("unsupported constant expression " + std::string(op));
+    }
+
+    if (folded) expect(TokenKind::RParen, "')' closing constant expression");
+    return v;
+}
+
+void WasmParser::parseExport() {
+    std::string name = parseStrings();
+    expect(TokenKind::LParen, "export descriptor");
+    std::string_view kind = atom("export kind");
+    std::string_view ref = atom("export index");
+    expect(TokenKind::RParen, "')' closing export descriptor");
+    expect(TokenKind::RParen, "')' closing export");
+    pendingExports.push_back({name, kind, ref, -1});
+}
+
+void WasmParser::parseData() {
+    uint32_t index = static_cast<uint32_t>(inst->dataSegments.size());
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) dataNames[atom("data name")] = index;
+    if (isForm("memory")) {
+        next();
+        skipToClose();
+    }
+
+    bool active = false;
+    WasmValue offset;
+    if (isForm("offset")) {
+        next();
+        next();
+        offset = parseConstExpr();
+        expect(TokenKind::RParen, "')' closing offset");
+        active = true;
+    } else if (tok.kind == TokenKind::LParen) {
+        offset = parseConstExpr();
+        active = true;
+    }
+
+    std::string bytes = tok.kind == TokenKind::String ? parseStrings() : std::string();
+    expect(TokenKind::RParen, "')' closing data");
 
-    std::istringstream iss(line);
-    std::string temp, typeIndexStr, token;
-    FuncType funcType;
+    DataSegment seg;
+    seg.bytes.assign(bytes.begin(), bytes.end());
+    seg.active = active;
+    seg.offset = static_cast<uint32_t>(offset.i32);
+    inst->dataSegments.push_back(std::move(seg));
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseData]\033[0m " << (active ? "active" : "passive")
+              << " segment " << index << ": " << bytes.size() << " byte(s)\n");
+}
 
-    iss >> temp;
-    iss >> typeIndexStr;
+void WasmParser::parseTable() {
+    uint32_t index = static_cast<uint32_t>(inst->tables.size());
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) tableNames[atom("table name")] = index;
+    while (isForm("export") || isForm("import")) {
+        next();
+        if (atom("keyword") == "export") pendingExports.push_back({parseStrings(), "table", {}, static_cast<int>(index)});
+        else { parseStrings(true); parseStrings(true); }
+        expect(TokenKind::RParen, "')'");
+    }
 
-    std::string digitsOnly;
-    for (char c : typeIndexStr) {
-        if (std::isdigit(c) || c == '-' || c == '+')
-            digitsOnly += c;
+    if (tok.kind == TokenKind::Atom && !isDigit(tok.text[0])) {
+        // (table funcref (elem ...)): sized by its inline active segment
+        next();
+        if (!isForm("elem")) error("expected (elem ...) after table element type");
+        next();
+        next();
+        ElemSegment seg;
+        seg.active = true;
+        seg.table = index;
+        uint32_t segment = static_cast<uint32_t>(inst->elemSegments.size());
+        parseElemItems(seg, segment);
+        expect(TokenKind::RParen, "')' closing elem");
+        uint32_t size = static_cast<uint32_t>(seg.refs.size());
+        inst->tables.emplace_back(size, size);
+        inst->elemSegments.push_back(std::move(seg));
+    } else {
+        uint64_t initial = 0, max = UINT32_MAX;
+        bool negative = false;
+        if (!parseInteger(atom("table size"), initial, negative) || negative) error("invalid table size");
+        if (tok.kind == TokenKind::Atom && isDigit(tok.text[0]) && !parseInteger(atom("table maximum"), max, negative))
+            error("invalid table maximum");
+        atom("reference type");
+        inst->tables.emplace_back(static_cast<uint32_t>(initial), static_cast<uint32_t>(max));
     }
+    expect(TokenKind::RParen, "')' closing table");
 
-    int typeIndex = -1;
-    if (!digitsOnly.empty()) {
-        try {
-            typeIndex = std::stoi(digitsOnly);
-        } catch (...) {
-            typeIndex = -1;
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseTable]\033[0m Table " << index << " with "
+              << inst->tables.back().size() << " slot(s)\n");
+}
+
+void WasmParser::parseElem() {
+    uint32_t segment = static_cast<uint32_t>(inst->elemSegments.size());
+    if (tok.kind == TokenKind::Atom && isId(tok.text)) elemNames[atom("elem name")] = segment;
+
+    ElemSegment seg;
+    if (tok.kind == TokenKind::Atom && tok.text == "declare") {
+        next();
+        seg.declarative = true;
+    } else {
+        if (isForm("table")) {
+            next();
+            next();
+            seg.table = resolveIndex(atom("table"), tableNames, "table");
+            expect(TokenKind::RParen, "')' closing table");
+            seg.active = true;
+        }
+        if (isForm("offset")) {
+            next();
+            next();
+            seg.offset = static_cast<uint32_t>(parseConstExpr().i32);
+            expect(TokenKind::RParen, "')' closing offset");
+            seg.active = true;
+        } else if (tok.kind == TokenKind::LParen && !isForm("item") && !isForm("ref.func") && !isForm("ref.null")) {
+            seg.offset = static_cast<uint32_t>(parseConstExpr().i32);
+            seg.active = true;
         }
     }
-    size_t paramStart = line.find("(param");
-    if (paramStart != std::string::npos) {
-        size_t paramEnd = line.find(")", paramStart);
-        if (paramEnd != std::string::npos) {
-            std::string paramsPart = line.substr(paramStart + 6, paramEnd - (paramStart + 6));
-            std::istringstream pss(paramsPart);
-            std::string paramType;
-            while (pss >> paramType) {
-                funcType.params.push_back(paramType);
-            }
+    // Element type: "func" before an index list, or a reference type before expressions
+    if (tok.kind == TokenKind::Atom && (tok.text == "func" || tok.text == "funcref" || tok.text == "externref"))
+        next();
+    parseElemItems(seg, segment);
+    expect(TokenKind::RParen, "')' closing elem");
+
+    WASM_TRACE(Parser, Info, "\033[1;32m[parser:parseElem]\033[0m "
+              << (seg.active ? "active" : seg.declarative ? "declarative" : "passive") << " segment "
+              << segment << ": " << seg.refs.size() << " reference(s)\n");
+    inst->elemSegments.push_back(std::move(seg));
+}
+
+// Function indices/names, or (item ...) / (ref.func ...) / (ref.null ...) expressions
+void WasmParser::parseElemItems(ElemSegment& seg, uint32_t segment) {
+    auto addFunction = [&](std::string_view ref) {
+        if (isId(ref)) elemFixups.push_back({segment, static_cast<uint32_t>(seg.refs.size()), ref});
+        seg.refs.push_back(isId(ref) ? NULL_REF : static_cast<int32_t>(resolveIndex(ref, funcNames, "function")));
+    };
+
+    while (tok.kind != TokenKind::RParen) {
+        if (tok.kind == TokenKind::Atom) {
+            addFunction(atom("function"));
+            continue;
         }
+        expect(TokenKind::LParen, "element expression");
+        std::string_view kw = atom("element expression");
+        bool nested = false;
+        if (kw == "item") {
+            nested = tok.kind == TokenKind::LParen;
+            if (nested) next();
+            kw = atom("element expression");
+        }
+        if (kw == "ref.func") addFunction(atom("function"));
+        else if (kw == "ref.null") { atom("heap type"); seg.refs.push_back(NULL_REF); }
+        else error("unsupported element expression " + std::string(kw));
+        if (nested) expect(TokenKind::RParen, "')'");
+        expect(TokenKind::RParen, "')' closing element expression");
     }
+}
 
-    size_t resultStart = line.find("(result");
-    if (resultStart != std::string::npos) {
-        size_t resultEnd = line.find(")", resultStart);
-        if (resultEnd != std::string::npos) {
-            std::string resultPart = line.substr(resultStart + 7, resultEnd - (resultStart + 7));
-            resultPart.erase(0, resultPart.find_first_not_of(" \t"));
-            resultPart.erase(resultPart.find_last_not_of(" \t") + 1);
-            funcType.resultType = resultPart;
+// Concatenation of consecutive string literals with escapes decoded; `single`
+// stops after one literal, for names such as an import's module and field
+std::string WasmParser::parseStrings(bool single) {
+    if (tok.kind != TokenKind::String) error("expected string");
+    std::string out;
+    while (tok.kind == TokenKind::String) {
+        std::string_view s = tok.text;
+        for (size_t i = 0; i < s.size(); ++i) {
+            char c = s[i];
+            if (c != '\\' || i + 1 >= s.size()) {
+                out += c;
+                continue;
+            }
+            char e = s[++i];
+            switch (e) {
+                case 'n':  out += '\n'; break;
+                case 't':  out += '\t'; break;
+                case 'r':  out += '\r'; break;
+                case '"':  out += '"'; break;
+                case '\'': out += '\''; break;
+                case '\\': out += '\\'; break;
+                case 'u': {
+                    // \u{hex}: encode the code point as UTF-8
+                    size_t close = s.find('}', i);
+                    if (i + 1 >= s.size() || s[i + 1] != '{' || close == std::string_view::npos)
+                        error("invalid unicode escape");
+                    uint32_t cp = static_cast<uint32_t>(std::strtoul(std::string(s.substr(i + 2, close - i - 2)).c_str(), nullptr, 16));
+                    if (cp < 0x80) out += static_cast<char>(cp);
+                    else if (cp < 0x800) {
+                        out += static_cast<char>(0xC0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else if (cp < 0x10000) {
+                        out += static_cast<char>(0xE0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xF0 | (cp >> 18));
+                        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    i = close;
+                    break;
+                }
+                default: {
+                    if (i + 1 >= s.size() || !std::isxdigit(static_cast<unsigned char>(e))
+                        || !std::isxdigit(static_cast<unsigned char>(s[i + 1])))
+                        error("invalid string escape");
+                    char hex[3] = {e, s[i + 1], 0};
+                    out += static_cast<char>(std::strtoul(hex, nullptr, 16));
+                    ++i;
+                    break;
+                }
+            }
         }
+        next();
+        if (single) break;
     }
-    if (funcType.resultType.empty()) {
-        funcType.resultType = "void"; 
+    return out;
+}
+
+// ---------------------------------------------------------------- function bodies
+
+void WasmParser::parseInstrList(FuncState& fs) {
+    while (tok.kind != TokenKind::RParen) {
+        if (tok.kind == TokenKind::LParen) parseFolded(fs);
+        else if (tok.kind == TokenKind::Atom) parsePlain(fs);
+        else error("unexpected token in function body");
     }
-    funcTypes[typeIndex] = funcType;
-    std::cout << "\033[1;32m[parser:parseType]\033[0m Type parsed → Index: " << typeIndex << ", Params: [";
-    for (const auto& p : funcType.params) {
-        std::cout << p << " ";
+}
+
+void WasmParser::parsePlain(FuncState& fs) {
+    std::string_view mnemonic = atom("instruction");
+    Opcode op = WasmDecoder::lookup(mnemonic);
+
+    switch (op) {
+        case Opcode::Block:
+        case Opcode::Loop:
+        case Opcode::If: {
+            std::string_view label;
+            if (tok.kind == TokenKind::Atom && isId(tok.text)) label = atom("label");
+            Instr in;
+            in.op = op;
+            in.imm.i32 = parseBlockType(in.blockType);
+            emit(fs, in);
+            fs.labels.push_back(label);
+            return;
+        }
+        case Opcode::Else:
+        case Opcode::End: {
+            if (tok.kind == TokenKind::Atom && isId(tok.text)) next();
+            Instr in;
+            in.op = op;
+            emit(fs, in);
+            if (op == Opcode::End && !fs.labels.empty()) fs.labels.pop_back();
+            return;
+        }
+        default: {
+            std::string_view forwardName;
+            Instr in = parseOperator(fs, mnemonic, forwardName);
+            emit(fs, in, forwardName);
+            return;
+        }
     }
-    std::cout << "], Results: " << funcType.resultType << "\n";
 }
 
-FuncDef WasmParser::parseFunction(
-    const std::string& line,
-    std::unordered_map<int, FuncDef>& functionsByID,
-    std::unordered_map<std::string, FuncDef>& functionByName,
-    const std::unordered_map<int, FuncType>& funcTypes)
-{
-    std::cout << "\033[1;32m[parser:parseFunction]\033[0m Function definition found: " << line << "\n";
-    FuncDef func;
-    std::string token;
-    std::istringstream iss(line);
-    int anonCounter = 1; 
-
-    // ✅ PRE-SCAN: se la riga contiene (param ...), NON importiamo i param dal (type N)
-    const bool hasExplicitParams = (line.find("(param") != std::string::npos);
-
-    while (iss >> token) {
-        if (token == "(func") continue;
-
-        if (token.rfind("(;", 0) == 0 && token.find(';') != std::string::npos) {
-            try {
-                size_t start = token.find(';') + 1;
-                size_t end = token.find(';', start);
-                func.index = std::stoi(token.substr(start, end - start));
-            } catch (...) {
-                func.index = -1;
+void WasmParser::parseFolded(FuncState& fs) {
+    expect(TokenKind::LParen, "'('");
+    std::string_view mnemonic = atom("instruction");
+    Opcode op = WasmDecoder::lookup(mnemonic);
+
+    if (op == Opcode::Block || op == Opcode::Loop || op == Opcode::If) {
+        std::string_view label;
+        if (tok.kind == TokenKind::Atom && isId(tok.text)) label = atom("label");
+        Instr in;
+        in.op = op;
+        in.imm.i32 = parseBlockType(in.blockType);
+
+        if (op == Opcode::If) {
+            // Condition operands come before (then ...)
+            while (tok.kind == TokenKind::LParen && !isForm("then") && !isForm("else")) parseFolded(fs);
+            emit(fs, in);
+            fs.labels.push_back(label);
+            if (isForm("then")) {
+                next();
+                next();
+                parseInstrList(fs);
+                expect(TokenKind::RParen, "')' closing then");
+            }
+            if (isForm("else")) {
+                next();
+                next();
+                Instr els;
+                els.op = Opcode::Else;
+                emit(fs, els);
+                parseInstrList(fs);
+                expect(TokenKind::RParen, "')' closing else");
             }
+        } else {
+            emit(fs, in);
+            fs.labels.push_back(label);
+            parseInstrList(fs);
         }
 
-        else if (!token.empty() && token[0] == '$') {
-            func.name = token;
+        Instr endIn;
+        endIn.op = Opcode::End;
+        emit(fs, endIn);
+        fs.labels.pop_back();
+        expect(TokenKind::RParen, "')' closing block");
+        return;
+    }
+
+    std::string_view forwardName;
+    Instr in = parseOperator(fs, mnemonic, forwardName);
+    while (tok.kind == TokenKind::LParen) parseFolded(fs);
+    emit(fs, in, forwardName);
+    expect(TokenKind::RParen, "')' closing instruction");
+}
+
+Instr WasmParser::parseOperator(FuncState& fs, std::string_view mnemonic, std::string_view& forwardName) {
+    Instr in;
+    in.op = WasmDecoder::lookup(mnemonic);
+
+    auto integer = [&](const char* what) {
+        std::string_view text = atom(what);
+        uint64_t bits = 0;
+        bool negative = false;
+        if (!parseInteger(text, bits, negative)) error("invalid integer " + std::string(text));
+        return negative ? ~bits + 1 : bits;
+    };
+
+    switch (in.op) {
+        case Opcode::Br:
+        case Opcode::BrIf:
+            in.a = static_cast<uint32_t>(fs.depths.size());
+            fs.depths.push_back({labelDepth(fs, atom("label"))});
+            break;
+
+        case Opcode::BrTable: {
+            std::vector<uint32_t> targets;
+            while (tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0])))
+                targets.push_back(labelDepth(fs, atom("label")));
+            if (targets.empty()) error("br_table needs at least a default label");
+            in.a = static_cast<uint32_t>(fs.depths.size());
+            fs.depths.push_back(std::move(targets));
+            break;
         }
 
-        else if (token == "(type") {
-            std::string typeIndex;
-            if (iss >> typeIndex) {
-                typeIndex.erase(remove(typeIndex.begin(), typeIndex.end(), ')'), typeIndex.end());
-                int t = std::stoi(typeIndex);
+        case Opcode::Call: {
+            std::string_view ref = atom("function");
+            auto it = isId(ref) ? funcNames.find(ref) : funcNames.end();
+            if (it != funcNames.end()) in.a = it->second;
+            else if (isId(ref)) forwardName = ref;   // defined further down
+            else in.a = resolveIndex(ref, funcNames, "function");
+            break;
+        }
 
-                auto it = funcTypes.find(t);
-                if (it != funcTypes.end()) {
-                    const FuncType& ftype = it->second;
+        case Opcode::CallIndirect: {
+            if (tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0])))
+                in.b = resolveIndex(atom("table"), tableNames, "table");
+            in.a = decoder->signatureId(parseTypeUse(nullptr));
+            in.imm.i32 = static_cast<int32_t>(fs.func->indirectCallSites++);
+            break;
+        }
 
-                    // ⛔️ PRIMA importavi sempre: ora lo fai SOLO se non ci sono (param ...)
-                    if (!hasExplicitParams && func.params.empty()) {
-                        for (const auto& ptype : ftype.params) {
-                            WasmValue val;
-                            if (ptype == "i32") val = WasmValue(int32_t(0));
-                            else if (ptype == "i64") val = WasmValue(int64_t(0));
-                            else if (ptype == "f32") val = WasmValue(float(0));
-                            else if (ptype == "f64") val = WasmValue(double(0));
+        case Opcode::RefFunc: {
+            std::string_view ref = atom("function");
+            auto it = isId(ref) ? funcNames.find(ref) : funcNames.end();
+            if (it != funcNames.end()) in.a = it->second;
+            else if (isId(ref)) forwardName = ref;
+            else in.a = resolveIndex(ref, funcNames, "function");
+            break;
+        }
 
-                            std::string anonName = "param_" + std::to_string(anonCounter++);
-                            func.params[anonName] = val;
-                        }
-                    }
+        case Opcode::RefNull:
+            atom("heap type");
+            break;
+
+        case Opcode::TableGet:
+        case Opcode::TableSet:
+        case Opcode::TableSize:
+        case Opcode::TableGrow:
+        case Opcode::TableFill:
+        case Opcode::TableCopy:
+        case Opcode::TableInit:
+        case Opcode::ElemDrop: {
+            // table.copy: dst src; table.init: [table] elem; others: [table]
+            std::vector<std::string_view> refs;
+            while (tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0])))
+                refs.push_back(atom("index"));
+            if (in.op == Opcode::TableInit || in.op == Opcode::ElemDrop) {
+                if (refs.empty()) error("missing element segment");
+                in.a = resolveIndex(refs.back(), elemNames, "element segment");
+                if (refs.size() > 1) in.b = resolveIndex(refs.front(), tableNames, "table");
+            } else if (!refs.empty()) {
+                in.a = resolveIndex(refs[0], tableNames, "table");
+                in.b = refs.size() > 1 ? resolveIndex(refs[1], tableNames, "table") : in.a;
+            }
+            break;
+        }
 
-                    // Il result del type lo importiamo comunque se presente
-                    if (!ftype.resultType.empty() && ftype.resultType != "void") {
-                        if (ftype.resultType == "i32") func.result = WasmValue(int32_t(0));
-                        else if (ftype.resultType == "i64") func.result = WasmValue(int64_t(0));
-                        else if (ftype.resultType == "f32") func.result = WasmValue(float(0));
-                        else if (ftype.resultType == "f64") func.result = WasmValue(double(0));
-                    }
-                }
+        case Opcode::LocalGet:
+        case Opcode::LocalSet:
+        case Opcode::LocalTee: {
+            std::string_view ref = atom("local");
+            if (isId(ref)) {
+                auto it = fs.localSlots.find(ref);
+                if (it == fs.localSlots.end()) error("unknown local " + std::string(ref));
+                in.a = it->second;
+            } else {
+                in.a = resolveIndex(ref, fs.localSlots, "local");
+                if (in.a >= fs.func->locals.size()) error("local index out of range");
             }
+            break;
+        }
+
+        case Opcode::GlobalGet:
+        case Opcode::GlobalSet: {
+            std::string_view ref = atom("global");
+            auto it = isId(ref) ? globalNames.find(ref) : globalNames.end();
+            if (it != globalNames.end()) in.a = it->second;
+            else if (isId(ref)) forwardName = ref;   // declared further down
+            else in.a = resolveIndex(ref, globalNames, "global");
+            if (!isId(ref) && in.a >= inst->globals.size()) forwardName = ref;
+            break;
         }
 
-        else if (token == "(param") {
-            std::string maybeName, maybeType;
-            if (iss >> maybeName) {
-                if (!maybeName.empty() && maybeName[0] == '$') {
-                    iss >> maybeType;        // (param $a i32)
-                } else {
-                    maybeType = maybeName;   // (param i32)
-                    maybeName = "";
+        case Opcode::I32Load: case Opcode::I64Load: case Opcode::F32Load: case Opcode::F64Load:
+        case Opcode::I32Load8S: case Opcode::I32Load8U: case Opcode::I32Load16S: case Opcode::I32Load16U:
+        case Opcode::I64Load8S: case Opcode::I64Load8U: case Opcode::I64Load16S: case Opcode::I64Load16U:
+        case Opcode::I64Load32S: case Opcode::I64Load32U:
+        case Opcode::I32Store: case Opcode::I64Store: case Opcode::F32Store: case Opcode::F64Store:
+        case Opcode::I32Store8: case Opcode::I32Store16:
+        case Opcode::I64Store8: case Opcode::I64Store16: case Opcode::I64Store32:
+            // memarg: a = offset, b = log2(align), as in the binary format
+            while (tok.kind == TokenKind::Atom
+                   && (tok.text.substr(0, 7) == "offset=" || tok.text.substr(0, 6) == "align=")) {
+                std::string_view text = atom("memarg");
+                bool isOffset = text[0] == 'o';
+                uint64_t value = 0;
+                bool negative = false;
+                if (!parseInteger(text.substr(isOffset ? 7 : 6), value, negative) || negative || value > UINT32_MAX)
+                    error("invalid memarg " + std::string(text));
+                if (isOffset) in.a = static_cast<uint32_t>(value);
+                else {
+                    uint32_t log2 = 0;
+                    while ((uint64_t(1) << log2) < value) ++log2;
+                    in.b = log2;
                 }
+            }
+            break;
+
+        case Opcode::MemoryInit:
+        case Opcode::DataDrop: {
+            std::string_view ref = atom("data segment");
+            // memory.init may name the memory first
+            if (in.op == Opcode::MemoryInit && tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0])))
+                ref = atom("data segment");
+            auto it = isId(ref) ? dataNames.find(ref) : dataNames.end();
+            if (it != dataNames.end()) in.a = it->second;
+            else if (isId(ref)) forwardName = ref;
+            else in.a = resolveIndex(ref, dataNames, "data segment");
+            break;
+        }
 
-                maybeType.erase(remove(maybeType.begin(), maybeType.end(), ')'), maybeType.end());
+        case Opcode::MemoryCopy:
+        case Opcode::MemoryFill:
+            while (tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0]))) next();
+            break;
+
+        case Opcode::MemorySize:
+        case Opcode::MemoryGrow:
+            if (tok.kind == TokenKind::Atom && (isId(tok.text) || isDigit(tok.text[0]))) next();
+            break;
+
+        case Opcode::I32Const:
+            in.imm.i32 = static_cast<int32_t>(static_cast<uint32_t>(integer("i32 constant")));
+            break;
+        case Opcode::I64Const:
+            in.imm.i64 = static_cast<int64_t>(integer("i64 constant"));
+            break;
+        case Opcode::F32Const:
+            if (!parseFloat(atom("f32 constant"), in.imm.f32)) error("invalid f32 constant");
+            break;
+        case Opcode::F64Const:
+            if (!parseFloat(atom("f64 constant"), in.imm.f64)) error("invalid f64 constant");
+            break;
+
+        case Opcode::Select:
+            while (isForm("result")) {
+                next();
+                next();
+                skipToClose();
+            }
+            break;
+
+        case Opcode::Unknown:
+            // Kept for a runtime diagnostic; swallow whatever immediates it has
+            in.a = intern(fs, mnemonic, std::string(mnemonic));
+            while (tok.kind == TokenKind::Atom && looksLikeImmediate(tok.text)) next();
+            while (isForm("type") || isForm("param") || isForm("result")) {
+                next();
+                next();
+                skipToClose();
+            }
+            break;
 
-                WasmValue val;
-                if (maybeType == "i32") val = WasmValue(int32_t(0));
-                else if (maybeType == "i64") val = WasmValue(int64_t(0));
-                else if (maybeType == "f32") val = WasmValue(float(0));
-                else if (maybeType == "f64") val = WasmValue(double(0));
+        default:
+            break;
+    }
+    return in;
+}
 
-                if (maybeName.empty()) {
-                    maybeName = "param_" + std::to_string(anonCounter++);
-                }
+void WasmParser::emit(FuncState& fs, const Instr& in, std::string_view forwardName) {
+    if (!forwardName.empty())
+        nameFixups.push_back({fs.slot, static_cast<uint32_t>(fs.func->code.size()), forwardName});
+    fs.func->code.push_back(in);
+    WASM_TRACE(Parser, Debug, "\033[1;32m[parser:emit]\033[0m " << WasmDecoder::opcodeName(in.op)
+              << " a=" << in.a << " b=" << in.b << "\n");
+}
 
-                func.params[maybeName] = val;
+// Number of values a block leaves on the stack, and the type of the first
+int32_t WasmParser::parseBlockType(ValueType& type) {
+    int32_t arity = 0;
+    while (isForm("type") || isForm("param") || isForm("result")) {
+        next();
+        std::string_view kw = atom("keyword");
+        if (kw == "type") {
+            uint32_t index = resolveIndex(atom("type index"), typeNames, "type");
+            auto it = types->find(static_cast<int>(index));
+            if (it != types->end() && it->second.resultType != "void") {
+                arity = 1;
+                type = zeroValue(it->second.resultType).type;
             }
+            expect(TokenKind::RParen, "')' closing type");
+        } else {
+            std::vector<std::string> list;
+            parseValueTypes(list, nullptr);
+            if (kw != "result" || list.empty()) continue;
+            if (!arity) type = zeroValue(list.front()).type;
+            arity += static_cast<int32_t>(list.size());
         }
     }
+    return arity;
+}
 
-    if (func.index >= 0) functionsByID[func.index] = func;
-    if (!func.name.empty()) functionByName[func.name] = func;
+uint32_t WasmParser::labelDepth(FuncState& fs, std::string_view ref) {
+    if (!isId(ref)) return resolveIndex(ref, {}, "label");
+    for (size_t i = fs.labels.size(); i-- > 0;)
+        if (fs.labels[i] == ref) return static_cast<uint32_t>(fs.labels.size() - 1 - i);
+    error("unknown label " + std::string(ref));
+}
 
-    std::cout << "\033[1;32m[parser:parseFunction]\033[0m Parsed function "
-              << (func.name.empty() ? "[anon]" : func.name)
-              << " (index " << func.index << ") "
-              << "params=" << func.params.size()
-              << " result=";
-    switch (func.result.type) {
-        case ValueType::I32: std::cout << "i32"; break;
-        case ValueType::I64: std::cout << "i64"; break;
-        case ValueType::F32: std::cout << "f32"; break;
-        case ValueType::F64: std::cout << "f64"; break;
-        default: std::cout << "(none)"; break;
-    }
-    std::cout << "\n";
-
-    if (!func.params.empty()) {
-        std::cout << "\033[1;32m[parser:parseFunction]\033[0m Params: ";
-        for (const auto& [name, val] : func.params) {
-            const char* t = (val.type == ValueType::I32) ? "i32" :
-                            (val.type == ValueType::I64) ? "i64" :
-                            (val.type == ValueType::F32) ? "f32" : "f64";
-            std::cout << name << ":" << t << " ";
+uint32_t WasmParser::intern(FuncState& fs, std::string_view key, const std::string& symbol) {
+    auto it = fs.symbolIds.find(key);
+    if (it != fs.symbolIds.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(fs.func->symbols.size());
+    fs.func->symbols.push_back(symbol);
+    fs.symbolIds.emplace(key, id);
+    return id;
+}
+
+// ---------------------------------------------------------------- dumps
+
+void WasmParser::print_globals(const std::vector<WasmGlobal>& globals) const {
+    std::cout << "\033[1;32m[parser:print_globals]\033[0m Global variables state:\n";
+
+    if (globals.empty()) {
+        std::cout << "  (empty)\n";
+        return;
+    }
+
+    for (const WasmGlobal& g : globals) {
+        std::cout << "  " << g.name << " (type=";
+
+        switch (g.type) {
+            case ValueType::I32: std::cout << "i32"; break;
+            case ValueType::I64: std::cout << "i64"; break;
+            case ValueType::F32: std::cout << "f32"; break;
+            case ValueType::F64: std::cout << "f64"; break;
+        }
+
+        std::cout << ", mutable=" << (g.mutableFlag ? "true" : "false")
+                  << ") = ";
+
+        switch (g.type) {
+            case ValueType::I32: std::cout << g.value.i32; break;
+            case ValueType::I64: std::cout << g.value.i64; break;
+            case ValueType::F32: std::cout << g.value.f32; break;
+            case ValueType::F64: std::cout << g.value.f64; break;
         }
+
         std::cout << "\n";
     }
-
-    return func;
 }
 
 void WasmParser::print_functions(
-    const std::unordered_map<std::string, FuncDef>& functionByName,
+    const std::unordered_map<std::string, uint32_t>& functionByName,
     const std::unordered_map<int, FuncDef>& functionsByID) const
 {
-    auto printParams = [](const std::unordered_map<std::string, WasmValue>& params) {
+    auto printParams = [](const std::vector<std::pair<std::string, WasmValue>>& params) {
         if (params.empty()) {
             std::cout << "    Params: (none)\n";
             return;
@@ -327,11 +1243,26 @@ void WasmParser::print_functions(
         }
     };
 
+    auto printCode = [](const std::vector<Instr>& code) {
+        if (code.empty()) {
+            std::cout << "    Code: (empty)\n";
+            return;
+        }
+
+        std::cout << "    Code:\n";
+        for (size_t pc = 0; pc < code.size(); ++pc)
+            std::cout << "      " << pc << ": " << WasmDecoder::opcodeName(code[pc].op)
+                      << " a=" << code[pc].a << " b=" << code[pc].b << "\n";
+    };
+
     std::cout << "\033[1;32m[parser:print_functions]\033[0m Functions by Name:\n";
     if (functionByName.empty()) {
         std::cout << "  (empty)\n";
     } else {
-        for (const auto& [name, func] : functionByName) {
+        for (const auto& [name, index] : functionByName) {
+            auto it = functionsByID.find(static_cast<int>(index));
+            if (it == functionsByID.end()) continue;
+            const FuncDef& func = it->second;
             std::cout << "\033[1;32m[parser:parseFunction]\033[0m Parsed function "
               << (func.name.empty() ? "[anon]" : func.name)
               << " (index " << func.index << ") "
@@ -348,13 +1279,7 @@ void WasmParser::print_functions(
 
             printParams(func.params);
 
-            if (!func.body.empty()) {
-                std::cout << "    Body:\n";
-                for (const auto& line : func.body)
-                    std::cout << "      " << line << "\n";
-            } else {
-                std::cout << "    Body: (empty)\n";
-            }
+            printCode(func.code);
 
             std::cout << "\n";
         }
@@ -380,107 +1305,13 @@ void WasmParser::print_functions(
 
             printParams(func.params);
 
-            if (!func.body.empty()) {
-                std::cout << "    Body:\n";
-                for (const auto& line : func.body)
-                    std::cout << "      " << line << "\n";
-            } else {
-                std::cout << "    Body: (empty)\n";
-            }
+            printCode(func.code);
 
             std::cout << "\n";
         }
     }
 }
 
-void WasmParser::parseBody(const std::string& line, FuncDef* func, bool toRemove) {
-    if (!func) {
-        std::cout << "\033[1;31m[parser:parseBody]\033[0m Error: Function definition is null.\n";
-        return;
-    }
-    std::string cleaned = line;
-    size_t commentPos = cleaned.find(";;");
-    if (commentPos != std::string::npos)
-        cleaned = cleaned.substr(0, commentPos);
-    while (!cleaned.empty() && std::isspace(static_cast<unsigned char>(cleaned.back())))
-        cleaned.pop_back();
-    if (toRemove) {
-        if (!cleaned.empty() && cleaned.back() == ')') {
-            cleaned.pop_back();
-            while (!cleaned.empty() && std::isspace(static_cast<unsigned char>(cleaned.back())))
-                cleaned.pop_back();
-        }
-    }
-    if (!cleaned.empty()) {
-        func->body.push_back(cleaned);
-        std::cout << "\033[1;32m[parser:parseBody]\033[0m Added line to function "
-                  << (func->name.empty() ? "[anon]" : func->name)
-                  << ": " << cleaned << "\n";
-    } else {
-        std::cout << "\033[1;33m[parser:parseBody]\033[0m Skipped empty/comment-only line.\n";
-    }
-}
-
-void WasmParser::parseMemory(const std::string& line, WasmMemory& memory) {
-    std::cout << "\033[1;32m[parser:parseMemory]\033[0m Parsing memory line: " << line << "\n";
-
-    std::istringstream iss(line);
-    std::string token;
-    size_t initialPages = 1;
-
-    while (iss >> token) {
-        if (token.rfind("(;", 0) == 0)
-            continue;
-
-        if (std::isdigit(token[0])) {
-            try {
-                initialPages = std::stoul(token);
-            } catch (...) {
-                initialPages = 1;
-            }
-        }
-    }
-    memory = WasmMemory(initialPages);
-
-    std::cout << "\033[1;32m[parser:parseMemory]\033[0m Initialized single memory with "
-              << initialPages << " page(s) = "
-              << (initialPages * WasmMemory::PAGE_SIZE) << " bytes.\n";
-}
-
-
-void WasmParser::parseExport(const std::string& line,
-                             std::unordered_map<std::string, WasmExport>& exports)
-{
-    std::istringstream iss(line);
-    std::string token;
-    WasmExport exp;
-
-    iss >> token;
-    iss >> exp.name;
-
-    if (!exp.name.empty() && exp.name.front() == '"')
-        exp.name = exp.name.substr(1, exp.name.size() - 2);
-
-    std::string kind, indexStr;
-    iss >> token;
-    if (token[0] == '(') token.erase(0, 1);
-    kind = token;
-
-    iss >> indexStr;
-    try {
-        exp.index = std::stoi(indexStr);
-    } catch (...) {
-        exp.index = -1;
-    }
-
-    exp.kind = kind;
-    exports[exp.name] = exp;
-
-    std::cout << "\033[1;32m[parser:parseExport]\033[0m Exported "
-              << exp.kind << " '" << exp.name
-              << "' (index " << exp.index << ")\n";
-}
-
 void WasmParser::print_exports(const std::unordered_map<std::string, WasmExport>& exports) const {
     std::cout << "\033[1;32m[parser:print_exports]\033[0m Exported items:\n";
     if (exports.empty()) {
@@ -492,4 +1323,4 @@ void WasmParser::print_exports(const std::unordered_map<std::string, WasmExport>
         std::cout << "  " << exp.kind << " '" << name
                   << "' (index " << exp.index << ")\n";
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,624 @@
+#include "wasm_register.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+const char* WasmRegisterCompiler::opName(RegOp op) {
+    static const char* const names[] = {
+#define N(name, ...) WasmDecoder::opcodeName(Opcode::name),
+        WASM_NUMERIC_OPS(N, N, N, N)
+#undef N
+#define X(name, text, ...) text,
+        WASM_REGISTER_LOADS(X)
+        WASM_REGISTER_STORES(X)
+        WASM_REGISTER_COMPARE_BRANCHES(X)
+        WASM_REGISTER_OPS(X)
+#undef X
+    };
+    size_t i = static_cast<size_t>(op);
+    return i < static_cast<size_t>(RegOp::Count) ? names[i] : "<invalid>";
+}
+
+namespace {
+
+// While a body is translated, temporaries and constants are numbered apart from
+// the locals; their final slots are known once the whole body has been seen.
+constexpr uint32_t TEMP = 0x80000000u;
+constexpr uint32_t CONST = 0x40000000u;
+constexpr uint32_t NO_COND = UINT32_MAX;
+
+struct CompareBranch { RegOp compare, taken, notTaken; };
+const CompareBranch kCompareBranches[] = {
+    {RegOp::I32Eq, RegOp::BrI32Eq, RegOp::BrI32Ne},
+    {RegOp::I32Ne, RegOp::BrI32Ne, RegOp::BrI32Eq},
+    {RegOp::I32LtS, RegOp::BrI32LtS, RegOp::BrI32GeS},
+    {RegOp::I32LtU, RegOp::BrI32LtU, RegOp::BrI32GeU},
+    {RegOp::I32GtS, RegOp::BrI32GtS, RegOp::BrI32LeS},
+    {RegOp::I32GtU, RegOp::BrI32GtU, RegOp::BrI32LeU},
+    {RegOp::I32LeS, RegOp::BrI32LeS, RegOp::BrI32GtS},
+    {RegOp::I32LeU, RegOp::BrI32LeU, RegOp::BrI32GtU},
+    {RegOp::I32GeS, RegOp::BrI32GeS, RegOp::BrI32LtS},
+    {RegOp::I32GeU, RegOp::BrI32GeU, RegOp::BrI32LtU},
+};
+
+// Operations that only write slot d (after reading their operands), so d can be renamed
+bool writesOnlyResult(RegOp op) {
+    if (op < RegOp::I32Store8) return true;   // numeric operations and loads
+    switch (op) {
+        case RegOp::Move:
+        case RegOp::Select:
+        case RegOp::GlobalGet:
+        case RegOp::MemorySize:
+        case RegOp::MemoryGrow:
+        case RegOp::RefIsNull:
+        case RegOp::TableGet:
+        case RegOp::TableSize:
+        case RegOp::TableGrow:
+            return true;
+        default:
+            return false;
+    }
+}
+
+class Translator {
+public:
+    struct Module {
+        const std::vector<const FuncDef*>& functions;   // WasmModule::functions
+        const WasmInstance& instance;
+        const WasmDecoder& decoder;
+    };
+
+    Translator(const FuncDef& func, const Module& module, RegFunction& out)
+        : func(func), module(module), out(out), code(out.code) {}
+
+    void run();
+
+private:
+    // A jump waiting for the end of its block: code[instr].imm, or entry `entry`
+    // of the br_table code[instr] refers to
+    struct Patch { uint32_t instr; int32_t entry; };
+
+    struct Ctl {
+        Opcode kind;
+        uint32_t arity;
+        std::vector<uint32_t> stack;     // operands below the block, as they were on entry
+        uint32_t loopStart = 0;
+        int64_t elseJump = -1;           // if: the jump to the else arm, until the else is seen
+        std::vector<Patch> patches = {};
+    };
+
+    const FuncDef& func;
+    const Module& module;
+    RegFunction& out;
+    std::vector<RegInstr>& code;
+
+    std::vector<uint32_t> stack;         // slot holding each operand stack entry
+    std::vector<Ctl> ctl;
+    std::vector<WasmValue> constants;
+    std::map<std::pair<int, uint64_t>, uint32_t> constantIds;
+    size_t maxHeight = 0;
+    size_t barrier = 0;                  // no instruction before this pc may be rewritten
+    bool reachable = true;
+
+    [[noreturn]] void fail(const std::string& why) const {
+        throw std::runtime_error("function " + std::to_string(func.index) + ": " + why);
+    }
+
+    static uint32_t temp(size_t height) { return TEMP | static_cast<uint32_t>(height); }
+    bool isLocal(uint32_t slot) const { return !(slot & (TEMP | CONST)); }
+
+    void push(uint32_t slot) {
+        stack.push_back(slot);
+        maxHeight = std::max(maxHeight, stack.size());
+    }
+    uint32_t pop() {
+        size_t floor = ctl.empty() ? 0 : ctl.back().stack.size();
+        if (stack.size() <= floor) fail("operand stack underflow");
+        uint32_t slot = stack.back();
+        stack.pop_back();
+        return slot;
+    }
+    uint32_t constant(const WasmValue& v) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &v.i64, v.type == ValueType::I32 || v.type == ValueType::F32 ? 4 : 8);
+        auto it = constantIds.emplace(std::make_pair(static_cast<int>(v.type), bits),
+                                      static_cast<uint32_t>(constants.size()));
+        if (it.second) constants.push_back(v);
+        return CONST | it.first->second;
+    }
+
+    size_t emit(RegOp op, uint32_t d = 0, uint32_t x = 0, uint32_t y = 0, uint32_t imm = 0, uint32_t aux = 0) {
+        code.push_back({op, d, x, y, imm, aux});
+        return code.size() - 1;
+    }
+    void move(uint32_t dst, uint32_t src) {
+        if (dst != src) emit(RegOp::Move, dst, src);
+    }
+    // A jump may land here: the instructions before can no longer be rewritten
+    void bind() { barrier = code.size(); }
+    // The last instruction computes `slot` and nothing else, and no jump lands after it
+    bool lastComputes(uint32_t slot) const {
+        return code.size() > barrier && code.back().d == slot && writesOnlyResult(code.back().op);
+    }
+
+    // Operands that still name a local are copied out before the local changes
+    void materialize(uint32_t local) {
+        for (size_t i = 0; i < stack.size(); ++i) {
+            if (stack[i] != local) continue;
+            move(temp(i), local);
+            stack[i] = temp(i);
+        }
+    }
+    void materializeAll() {
+        for (size_t i = 0; i < stack.size(); ++i) {
+            if (!isLocal(stack[i])) continue;
+            move(temp(i), stack[i]);
+            stack[i] = temp(i);
+        }
+    }
+
+    void setLocal(uint32_t local, uint32_t value, bool tee);
+    size_t conditionalJump(uint32_t cond, bool whenTrue);
+    void jumpTo(Ctl& target, size_t instr, int32_t entry = -1);
+    void branch(uint32_t depth, uint32_t cond);
+    void returnFromFunction();
+    void call(const FuncType& type, RegOp op, uint32_t index, uint32_t tableSlot = 0, uint32_t table = 0);
+    void endBlock();
+    void finish();
+
+    void unary(RegOp op) {
+        uint32_t a = pop();
+        emit(op, temp(stack.size()), a);
+        push(temp(stack.size()));
+    }
+    void binary(RegOp op) {
+        uint32_t b = pop(), a = pop();
+        emit(op, temp(stack.size()), a, b);
+        push(temp(stack.size()));
+    }
+};
+
+void Translator::setLocal(uint32_t local, uint32_t value, bool tee) {
+    if (local >= func.locals.size()) fail("local index out of range");
+    if (value == local) return;
+    bool pending = std::count(stack.begin(), stack.end(), local) > 0;
+    // Rename the result of the previous instruction instead of copying it
+    if (!pending && lastComputes(value) && (value & TEMP)) {
+        code.back().d = local;
+        if (tee) stack.back() = local;
+        return;
+    }
+    materialize(local);
+    move(local, value);
+}
+
+// Jump on `cond` (non-zero when whenTrue, zero otherwise). An i32 compare that
+// just produced `cond` is folded into the jump.
+size_t Translator::conditionalJump(uint32_t cond, bool whenTrue) {
+    if ((cond & TEMP) && lastComputes(cond)) {
+        RegInstr& last = code.back();
+        if (last.op == RegOp::I32Eqz) {
+            last.op = whenTrue ? RegOp::BrUnless : RegOp::BrIf;
+            last.d = 0;
+            return code.size() - 1;
+        }
+        for (const CompareBranch& cb : kCompareBranches) {
+            if (last.op != cb.compare) continue;
+            last.op = whenTrue ? cb.taken : cb.notTaken;
+            last.d = 0;
+            return code.size() - 1;
+        }
+    }
+    return emit(whenTrue ? RegOp::BrIf : RegOp::BrUnless, 0, cond);
+}
+
+void Translator::jumpTo(Ctl& target, size_t instr, int32_t entry) {
+    uint32_t& slot = entry < 0 ? code[instr].imm : out.brTables[code[instr].imm][entry];
+    if (target.kind == Opcode::Loop) slot = target.loopStart;
+    else target.patches.push_back({static_cast<uint32_t>(instr), entry});
+}
+
+void Translator::returnFromFunction() {
+    if (stack.empty()) emit(RegOp::Return);
+    else emit(RegOp::Return, 0, stack.back(), 0, 1);
+}
+
+// br / br_if to the label `depth` blocks out; cond is NO_COND for br
+void Translator::branch(uint32_t depth, uint32_t cond) {
+    if (depth >= ctl.size()) {
+        if (cond == NO_COND) {
+            returnFromFunction();
+            return;
+        }
+        size_t skip = conditionalJump(cond, false);
+        returnFromFunction();
+        code[skip].imm = static_cast<uint32_t>(code.size());
+        bind();
+        return;
+    }
+    Ctl& target = ctl[ctl.size() - 1 - depth];
+    uint32_t carry = NO_COND;
+    if (target.kind != Opcode::Loop && target.arity) {
+        if (stack.size() <= target.stack.size()) fail("branch without its result");
+        if (stack.back() != temp(target.stack.size())) carry = stack.back();
+    }
+    if (cond == NO_COND) {
+        if (carry != NO_COND) move(temp(target.stack.size()), carry);
+        jumpTo(target, emit(RegOp::Br));
+        return;
+    }
+    if (carry == NO_COND) {
+        jumpTo(target, conditionalJump(cond, true));
+        return;
+    }
+    size_t skip = conditionalJump(cond, false);
+    move(temp(target.stack.size()), carry);
+    jumpTo(target, emit(RegOp::Br));
+    code[skip].imm = static_cast<uint32_t>(code.size());
+    bind();
+}
+
+// Arguments are gathered in consecutive temporaries; the callee's frame is
+// filled from there and its result comes back in the first of them
+void Translator::call(const FuncType& type, RegOp op, uint32_t index, uint32_t tableSlot, uint32_t table) {
+    size_t count = type.params.size();
+    size_t floor = ctl.empty() ? 0 : ctl.back().stack.size();
+    if (stack.size() < floor + count) fail("operand stack underflow at call");
+    size_t first = stack.size() - count;
+    for (size_t i = first; i < stack.size(); ++i) {
+        move(temp(i), stack[i]);
+        stack[i] = temp(i);
+    }
+    stack.resize(first);
+    bool hasResult = type.resultType != "void";
+    emit(op, temp(first), tableSlot, 0, index, op == RegOp::CallHost ? hasResult : table);
+    if (hasResult) push(temp(first));
+}
+
+void Translator::endBlock() {
+    Ctl c = std::move(ctl.back());
+    ctl.pop_back();
+    uint32_t result = temp(c.stack.size());
+    if (reachable && c.arity) {
+        if (stack.size() <= c.stack.size()) fail("block without its result");
+        move(result, stack.back());
+    }
+    uint32_t here = static_cast<uint32_t>(code.size());
+    bool joined = !c.patches.empty() || c.elseJump >= 0;
+    if (c.elseJump >= 0) code[c.elseJump].imm = here;
+    for (const Patch& p : c.patches) {
+        if (p.entry < 0) code[p.instr].imm = here;
+        else out.brTables[code[p.instr].imm][p.entry] = here;
+    }
+    if (joined) bind();
+    reachable = reachable || joined;
+    stack = std::move(c.stack);
+    if (c.arity) push(result);
+}
+
+void Translator::run() {
+    const std::vector<Instr>& body = func.code;
+    size_t dead = 0;   // blocks opened inside unreachable code
+    for (size_t pc = 0; pc < body.size(); ++pc) {
+        const Instr& in = body[pc];
+        Opcode op = WasmDecoder::unfused(in.op);
+        if (!reachable) {
+            if (op == Opcode::Block || op == Opcode::Loop || op == Opcode::If) {
+                ++dead;
+                continue;
+            }
+            if (op == Opcode::End && dead) {
+                --dead;
+                continue;
+            }
+            if ((op != Opcode::End && op != Opcode::Else) || dead || ctl.empty()) continue;
+        }
+
+        switch (op) {
+            case Opcode::Nop:
+                break;
+
+            case Opcode::Block:
+            case Opcode::Loop:
+            case Opcode::If: {
+                uint32_t cond = op == Opcode::If ? pop() : 0;
+                if (in.imm.i32 < 0 || in.imm.i32 > 1) fail("multi-value block");
+                // Paths through the block must agree on where every operand below it lives
+                materializeAll();
+                ctl.push_back({op, static_cast<uint32_t>(in.imm.i32), stack});
+                if (op == Opcode::Loop) {
+                    bind();
+                    ctl.back().loopStart = static_cast<uint32_t>(code.size());
+                    out.osr.push_back({static_cast<uint32_t>(pc + 1), ctl.back().loopStart, stack});
+                }
+                if (op == Opcode::If) ctl.back().elseJump = static_cast<int64_t>(conditionalJump(cond, false));
+                break;
+            }
+            case Opcode::Else: {
+                if (ctl.empty() || ctl.back().kind != Opcode::If || ctl.back().elseJump < 0) fail("else without if");
+                Ctl& c = ctl.back();
+                if (reachable) {
+                    if (c.arity) {
+                        if (stack.size() <= c.stack.size()) fail("if arm without its result");
+                        move(temp(c.stack.size()), stack.back());
+                    }
+                    c.patches.push_back({static_cast<uint32_t>(emit(RegOp::Br)), -1});
+                }
+                code[c.elseJump].imm = static_cast<uint32_t>(code.size());
+                c.elseJump = -1;
+                bind();
+                stack = c.stack;
+                reachable = true;
+                break;
+            }
+            case Opcode::End:
+                if (!ctl.empty()) endBlock();
+                break;
+
+            case Opcode::Br:
+                branch(func.branches[in.a].depth, NO_COND);
+                reachable = false;
+                break;
+            case Opcode::BrIf: {
+                uint32_t cond = pop();
+                branch(func.branches[in.a].depth, cond);
+                break;
+            }
+            case Opcode::BrTable: {
+                const std::vector<BranchTarget>& targets = func.brTables[in.a];
+                if (targets.empty()) fail("br_table without labels");
+                uint32_t index = pop();
+                uint32_t table = static_cast<uint32_t>(out.brTables.size());
+                out.brTables.emplace_back(targets.size());
+                size_t instr = emit(RegOp::BrTable, 0, index, 0, table);
+                // Targets that need their result moved first get a stub after the table
+                for (size_t i = 0; i < targets.size(); ++i) {
+                    uint32_t depth = targets[i].depth;
+                    if (depth >= ctl.size()) {
+                        out.brTables[table][i] = static_cast<uint32_t>(code.size());
+                        bind();
+                        returnFromFunction();
+                        continue;
+                    }
+                    Ctl& target = ctl[ctl.size() - 1 - depth];
+                    bool carry = target.kind != Opcode::Loop && target.arity;
+                    if (carry && stack.size() <= target.stack.size()) fail("branch without its result");
+                    if (!carry || stack.back() == temp(target.stack.size())) {
+                        jumpTo(target, instr, static_cast<int32_t>(i));
+                        continue;
+                    }
+                    out.brTables[table][i] = static_cast<uint32_t>(code.size());
+                    bind();
+                    move(temp(target.stack.size()), stack.back());
+                    jumpTo(target, emit(RegOp::Br));
+                }
+                reachable = false;
+                break;
+            }
+            case Opcode::Return:
+                returnFromFunction();
+                reachable = false;
+                break;
+
+            case Opcode::Call: {
+                uint32_t index = in.a;
+                // WasmModule::resolveCalls has turned every name some function has into its index
+                if (in.b) fail("unknown function " + func.symbols[in.a]);
+                if (index < module.instance.funcImports.size()) {
+                    call(module.instance.funcImports[index].type, RegOp::CallHost, index);
+                    break;
+                }
+                if (index >= module.functions.size() || !module.functions[index])
+                    fail("unknown function index " + std::to_string(index));
+                call(module.decoder.signature(module.functions[index]->typeId), RegOp::Call, index);
+                break;
+            }
+            case Opcode::CallIndirect: {
+                uint32_t slot = pop();
+                call(module.decoder.signature(in.a), RegOp::CallIndirect, in.a, slot, in.b);
+                break;
+            }
+
+            case Opcode::Drop:
+                pop();
+                break;
+            case Opcode::Select: {
+                uint32_t cond = pop(), b = pop(), a = pop();
+                emit(RegOp::Select, temp(stack.size()), a, b, 0, cond);
+                push(temp(stack.size()));
+                break;
+            }
+
+            case Opcode::LocalGet:
+                if (in.a >= func.locals.size()) fail("local index out of range");
+                push(in.a);
+                break;
+            case Opcode::LocalSet: {
+                uint32_t value = pop();
+                setLocal(in.a, value, false);
+                break;
+            }
+            case Opcode::LocalTee:
+                if (stack.empty()) fail("operand stack underflow");
+                setLocal(in.a, stack.back(), true);
+                break;
+            case Opcode::GlobalGet:
+                emit(RegOp::GlobalGet, temp(stack.size()), 0, 0, in.a);
+                push(temp(stack.size()));
+                break;
+            case Opcode::GlobalSet: {
+                uint32_t value = pop();
+                emit(RegOp::GlobalSet, 0, value, 0, in.a);
+                break;
+            }
+
+            case Opcode::I32Const: push(constant(WasmValue(in.imm.i32))); break;
+            case Opcode::I64Const: push(constant(WasmValue(in.imm.i64))); break;
+            case Opcode::F32Const: push(constant(WasmValue(in.imm.f32))); break;
+            case Opcode::F64Const: push(constant(WasmValue(in.imm.f64))); break;
+            case Opcode::RefNull: push(constant(WasmValue(NULL_REF))); break;
+            case Opcode::RefFunc: push(constant(WasmValue(static_cast<int32_t>(in.a)))); break;
+            case Opcode::RefIsNull: unary(RegOp::RefIsNull); break;
+
+#define X(name, ...) \
+            case Opcode::name: { \
+                uint32_t addr = pop(); \
+                emit(RegOp::name, temp(stack.size()), addr, 0, in.a); \
+                push(temp(stack.size())); \
+                break; \
+            }
+            WASM_REGISTER_LOADS(X)
+#undef X
+#define X(name, ...) \
+            case Opcode::name: { \
+                uint32_t value = pop(), addr = pop(); \
+                emit(RegOp::name, 0, addr, value, in.a); \
+                break; \
+            }
+            WASM_REGISTER_STORES(X)
+#undef X
+#define BINARY(name, ...) case Opcode::name: binary(RegOp::name); break;
+#define UNARY(name, ...) case Opcode::name: unary(RegOp::name); break;
+            WASM_NUMERIC_OPS(BINARY, BINARY, UNARY, UNARY)
+#undef BINARY
+#undef UNARY
+
+            case Opcode::MemorySize:
+                emit(RegOp::MemorySize, temp(stack.size()));
+                push(temp(stack.size()));
+                break;
+            case Opcode::MemoryGrow:
+                unary(RegOp::MemoryGrow);
+                break;
+            case Opcode::MemoryCopy:
+            case Opcode::MemoryFill:
+            case Opcode::MemoryInit: {
+                uint32_t n = pop(), src = pop(), dst = pop();
+                RegOp rop = op == Opcode::MemoryCopy ? RegOp::MemoryCopy
+                          : op == Opcode::MemoryFill ? RegOp::MemoryFill : RegOp::MemoryInit;
+                emit(rop, dst, src, n, in.a);
+                break;
+            }
+            case Opcode::DataDrop:
+                emit(RegOp::DataDrop, 0, 0, 0, in.a);
+                break;
+
+            case Opcode::TableGet: {
+                uint32_t i = pop();
+                emit(RegOp::TableGet, temp(stack.size()), i, 0, in.a);
+                push(temp(stack.size()));
+                break;
+            }
+            case Opcode::TableSet: {
+                uint32_t ref = pop(), i = pop();
+                emit(RegOp::TableSet, 0, i, ref, in.a);
+                break;
+            }
+            case Opcode::TableSize:
+                emit(RegOp::TableSize, temp(stack.size()), 0, 0, in.a);
+                push(temp(stack.size()));
+                break;
+            case Opcode::TableGrow: {
+                uint32_t delta = pop(), ref = pop();
+                emit(RegOp::TableGrow, temp(stack.size()), ref, delta, in.a);
+                push(temp(stack.size()));
+                break;
+            }
+            case Opcode::TableFill: {
+                uint32_t n = pop(), ref = pop(), dst = pop();
+                emit(RegOp::TableFill, dst, ref, n, in.a);
+                break;
+            }
+            case Opcode::TableCopy:
+            case Opcode::TableInit: {
+                uint32_t n = pop(), src = pop(), dst = pop();
+                emit(op == Opcode::TableCopy ? RegOp::TableCopy : RegOp::TableInit, dst, src, n, in.a, in.b);
+                break;
+            }
+            case Opcode::ElemDrop:
+                emit(RegOp::ElemDrop, 0, 0, 0, in.a);
+                break;
+
+            default:
+                fail(std::string("no register form for ")
+                     + (op == Opcode::Unknown ? func.symbols[in.a].c_str() : WasmDecoder::opcodeName(op)));
+        }
+    }
+    finish();
+}
+
+void Translator::finish() {
+    if (!ctl.empty()) fail("unterminated block");
+    if (reachable) returnFromFunction();
+
+    uint32_t locals = static_cast<uint32_t>(func.locals.size());
+    uint32_t consts = static_cast<uint32_t>(constants.size());
+    auto place = [&](uint32_t& slot) {
+        if (slot & TEMP) slot = locals + consts + (slot & ~TEMP);
+        else if (slot & CONST) slot = locals + (slot & ~CONST);
+    };
+    for (RegInstr& in : code) {
+        place(in.d);
+        place(in.x);
+        place(in.y);
+        if (in.op == RegOp::Select) place(in.aux);
+    }
+    for (RegOsrEntry& entry : out.osr)
+        for (uint32_t& slot : entry.stack) place(slot);
+    out.def = &func;
+    out.image.assign(func.locals.begin(), func.locals.end());
+    out.image.insert(out.image.end(), constants.begin(), constants.end());
+    out.paramCount = static_cast<uint32_t>(func.params.size());
+    out.frameSize = locals + consts + static_cast<uint32_t>(maxHeight);
+    out.hasResult = module.decoder.signature(func.typeId).resultType != "void";
+}
+
+} // namespace
+
+bool WasmRegisterCompiler::compile(
+    const std::vector<const FuncDef*>& functions,
+    const WasmInstance& instance,
+    const WasmDecoder& decoder,
+    std::vector<RegFunction>& out,
+    std::string& reason
+) {
+    size_t count = std::max(instance.funcImports.size(), functions.size());
+    out.assign(count, RegFunction{});
+
+    // By index, so the function named in `reason` is the first that fails
+    for (size_t index = 0; index < functions.size(); ++index) {
+        if (!functions[index]) continue;
+        if (!compileFunction(*functions[index], functions, instance, decoder, out[index], reason)) {
+            out.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WasmRegisterCompiler::compileFunction(
+    const FuncDef& func,
+    const std::vector<const FuncDef*>& functions,
+    const WasmInstance& instance,
+    const WasmDecoder& decoder,
+    RegFunction& out,
+    std::string& reason
+) {
+    Translator::Module module{functions, instance, decoder};
+    out = RegFunction{};
+    try {
+        Translator(func, module, out).run();
+    } catch (const std::runtime_error& e) {
+        reason = e.what();
+        out = RegFunction{};
+        out.def = &func;
+        return false;
+    }
+    WASM_TRACE(Parser, Debug, "\033[1;32m[register:compile]\033[0m function index " << func.index << ": "
+              << func.code.size() << " instruction(s) → " << out.code.size()
+              << ", frame of " << out.frameSize << " slot(s)\n");
+    return true;
+}
@@ -0,0 +1,460 @@
+#include "wasm_register_executor.hpp"
+#include "wasm_tiering.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "struct.h"
+
+// Dispatch backend, as in the stack executor (see WASM_DISPATCH in CMakeLists.txt)
+#if defined(WASM_DISPATCH_THREADED) && (defined(__GNUC__) || defined(__clang__))
+#define WASM_THREADED_DISPATCH 1
+#else
+#define WASM_THREADED_DISPATCH 0
+#endif
+
+#define TRACE_INSTR() \
+    WASM_TRACE(Exec, Debug, "\033[1;36m[register:instr]\033[0m " << WasmRegisterCompiler::opName(ip->op) \
+              << " d=" << ip->d << " x=" << ip->x << " y=" << ip->y << " imm=" << ip->imm << "\n")
+
+// NEXT: fall through to the following instruction. JUMP: continue at a pc of the
+// running function. RESUME: continue at `ip` after a call or return moved it.
+#if WASM_THREADED_DISPATCH
+#define CASE(name) op_##name:
+#define RESUME() do { TRACE_INSTR(); goto *dispatchTable[static_cast<size_t>(ip->op)]; } while (0)
+#define NEXT() do { ++ip; RESUME(); } while (0)
+#define JUMP(target) do { ip = code + (target); RESUME(); } while (0)
+#else
+#define CASE(name) case RegOp::name:
+#define RESUME() continue
+#define NEXT() { ++ip; continue; }
+#define JUMP(target) { ip = code + (target); continue; }
+#endif
+
+// Type of the operand a store named `text` writes ("i32.store8" → i32)
+static ValueType storedType(const char* text) {
+    if (text[0] == 'i') return text[1] == '3' ? ValueType::I32 : ValueType::I64;
+    return text[1] == '3' ? ValueType::F32 : ValueType::F64;
+}
+
+static void printValue(const WasmValue& v) {
+    switch (v.type) {
+        case ValueType::I32: std::cout << v.i32; break;
+        case ValueType::I64: std::cout << v.i64; break;
+        case ValueType::F32: std::cout << v.f32; break;
+        case ValueType::F64: std::cout << v.f64; break;
+    }
+}
+
+WasmRegisterExecutor::WasmRegisterExecutor() {
+    slots.resize(1 << 16);
+    frames.reserve(1 << 10);
+}
+
+void WasmRegisterExecutor::execute(
+    const RegFunction& entry,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance
+) {
+    // Same trap handling as WasmExecutor::execute
+#if WASM_GUARD_PAGES
+    WasmMemory::FaultScope scope;
+    if (sigsetjmp(scope.env, 0))
+        throw WasmTrap("out of bounds memory access");
+#endif
+    // Compiled code reports traps and host exceptions here instead of unwinding
+    if (nativeFrameSize != 0) {
+        WasmJit::bind(jit, instance);
+        jit.functions = &functions;
+        jit.maxDepth = maxCallDepth;
+        jit.trapEnv = &jitEnv;
+        jit.error = &jitError;
+        jitError = nullptr;
+        if (sigsetjmp(jitEnv, 0)) {
+            if (jitError) std::rethrow_exception(std::exchange(jitError, nullptr));
+            throw WasmTrap(jit.trapMessage);
+        }
+    }
+    frames.clear();
+    slotsTop = 0;
+    if (slots.size() < entry.frameSize) slots.resize(entry.frameSize);
+    std::copy(entry.image.begin(), entry.image.end(), slots.begin());
+    if (entry.native) {
+        runNative(entry, 0, 0);
+        return;
+    }
+    WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Executing function '" << entry.def->name
+              << "' (index " << entry.def->index << ").\n");
+    try {
+        run(entry, 0, 0, 0, functions, instance);
+    } catch (const std::out_of_range&) {
+        throw WasmTrap("out of bounds memory access");
+    }
+}
+
+WasmSlot WasmRegisterExecutor::invoke(
+    const RegFunction& func,
+    const WasmSlot* args,
+    size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance
+) {
+    WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Executing function '" << func.def->name
+              << "' (index " << func.def->index << ").\n");
+    return enter(func, 0, args, func.paramCount, {}, nullptr, depth, functions, instance);
+}
+
+WasmSlot WasmRegisterExecutor::replace(
+    const RegFunction& func,
+    const RegOsrEntry& entry,
+    const WasmSlot* locals,
+    const WasmSlot* operands,
+    size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance
+) {
+    return enter(func, entry.regPc, locals, func.def->locals.size(), entry.stack, operands, depth, functions, instance);
+}
+
+WasmSlot WasmRegisterExecutor::enter(
+    const RegFunction& func,
+    uint32_t pc,
+    const WasmSlot* locals,
+    size_t localCount,
+    const std::vector<uint32_t>& operandSlots,
+    const WasmSlot* operands,
+    size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance
+) {
+    // Called from the stack tier: a fault here must not jump over its frames
+#if WASM_GUARD_PAGES
+    WasmMemory::FaultScope scope;
+    if (sigsetjmp(scope.env, 0))
+        throw WasmTrap("out of bounds memory access");
+#endif
+    size_t base = slotsTop;
+    if (base + func.frameSize > slots.size()) slots.resize(std::max(slots.size() * 2, base + func.frameSize));
+    WasmSlot* frame = slots.data() + base;
+    std::copy(func.image.begin(), func.image.end(), frame);
+    std::copy_n(locals, localCount, frame);
+    for (size_t i = 0; i < operandSlots.size(); ++i) frame[operandSlots[i]] = operands[i];
+    try {
+        return run(func, base, pc, depth, functions, instance);
+    } catch (const std::out_of_range&) {
+        throw WasmTrap("out of bounds memory access");
+    }
+}
+
+void WasmRegisterExecutor::runNative(const RegFunction& callee, size_t base, size_t depth) {
+    size_t chain = (maxCallDepth - std::min(depth, maxCallDepth) + 1) * nativeFrameSize;
+    size_t needed = base + std::max<size_t>(std::min(chain, MAX_NATIVE_SLOTS), callee.frameSize);
+    if (needed > slots.size()) slots.resize(std::max(slots.size() * 2, needed));
+    jit.slotsEnd = slots.data() + slots.size();
+    jit.depth = depth;
+    callee.native(slots.data() + base, &jit);
+}
+
+WasmSlot WasmRegisterExecutor::run(
+    const RegFunction& entry,
+    size_t base,
+    uint32_t pc,
+    size_t depth,
+    const std::vector<RegFunction>& functions,
+    WasmInstance& instance
+) {
+    WasmMemory& memory = instance.memory;
+    std::vector<WasmGlobal>& globals = instance.globals;
+    const size_t framesFloor = frames.size();
+    const RegFunction* func = &entry;
+    const RegInstr* code = func->code.data();
+    const RegInstr* ip = code + pc;
+    WasmSlot* R = slots.data() + base;   // the running function's frame
+    // Calls active below the running function, counting those in the other tier
+    auto activeCalls = [&]() { return depth + frames.size() - framesFloor; };
+
+    // The callee's frame starts right after the caller's; arguments come from ip->d on.
+    // Returns false when the callee was compiled and has already run.
+    auto enterFunction = [&](const RegFunction& callee) {
+        if (activeCalls() >= maxCallDepth) {
+            throw WasmTrap("call stack exhausted (depth " + std::to_string(activeCalls())
+                           + ", limit " + std::to_string(maxCallDepth) + ")");
+        }
+        size_t calleeBase = base + func->frameSize;
+        // Tiered execution: a callee that is not translated yet and not hot enough to
+        // be now runs in the stack tier, with its frame above this one
+        if (callee.code.empty() && tiering && !tiering->hotCall(*callee.def)) {
+            size_t top = std::exchange(slotsTop, calleeBase);
+            WasmSlot result;
+            bool hasResult = tiering->callBaseline(*callee.def, R + ip->d, activeCalls() + 1, result);
+            slotsTop = top;
+            R = slots.data() + base;
+            if (hasResult) R[ip->d] = result;
+            return false;
+        }
+        if (calleeBase + callee.frameSize > slots.size()) {
+            slots.resize(std::max(slots.size() * 2, calleeBase + callee.frameSize));
+            R = slots.data() + base;
+        }
+        WasmSlot* frame = slots.data() + calleeBase;
+        std::copy(callee.image.begin(), callee.image.end(), frame);
+        std::copy_n(R + ip->d, callee.paramCount, frame);
+        if (callee.native) {
+            runNative(callee, calleeBase, activeCalls() + 1);
+            R = slots.data() + base;
+            if (callee.hasResult) R[ip->d] = slots[calleeBase];
+            return false;
+        }
+        frames.push_back({func, ip, base});
+        func = &callee;
+        code = func->code.data();
+        ip = code;
+        base = calleeBase;
+        R = frame;
+        WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Executing function '" << func->def->name
+                  << "' (index " << func->def->index << ").\n");
+        return true;
+    };
+
+    // Host functions read their arguments in place and leave the result in the first slot
+    auto callHost = [&](const FuncImport& imp, bool hasResult) {
+        if (!imp.fn) throw WasmTrap("unresolved import " + imp.module + "." + imp.field);
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:call]\033[0m Calling host function "
+                  << imp.module << "." << imp.field << "\n");
+        WasmSlot result = imp.fn(instance, R + ip->d);
+        if (hasResult) R[ip->d] = result;
+    };
+
+#if WASM_THREADED_DISPATCH
+    static void* const dispatchTable[] = {
+#define N(name, ...) &&op_##name,
+        WASM_NUMERIC_OPS(N, N, N, N)
+        WASM_REGISTER_LOADS(N)
+        WASM_REGISTER_STORES(N)
+        WASM_REGISTER_COMPARE_BRANCHES(N)
+        WASM_REGISTER_OPS(N)
+#undef N
+    };
+    RESUME();
+#else
+    for (;;) {
+    TRACE_INSTR();
+    switch (ip->op) {
+#endif
+
+    CASE(Move) R[ip->d] = R[ip->x]; NEXT();
+
+    CASE(Br) JUMP(ip->imm);
+    CASE(BrIf) if (R[ip->x].i32 != 0) JUMP(ip->imm); NEXT();
+    CASE(BrUnless) if (R[ip->x].i32 == 0) JUMP(ip->imm); NEXT();
+    CASE(BrTable) {
+        const std::vector<uint32_t>& targets = func->brTables[ip->imm];
+        uint32_t index = static_cast<uint32_t>(R[ip->x].i32);
+        JUMP(index < targets.size() - 1 ? targets[index] : targets.back());
+    }
+#define X(name, text, T, test) \
+    CASE(name) { \
+        T a = static_cast<T>(R[ip->x].i32), b = static_cast<T>(R[ip->y].i32); \
+        if (test) JUMP(ip->imm); \
+        NEXT(); \
+    }
+    WASM_REGISTER_COMPARE_BRANCHES(X)
+#undef X
+
+    CASE(Return) {
+        WASM_TRACE(Exec, Info, "\033[1;36m[executor:execute]\033[0m Function completed.\n");
+        bool hasResult = ip->imm != 0;
+        WasmSlot result = hasResult ? R[ip->x] : WasmSlot();
+        if (frames.size() == framesFloor) return result;
+        const Frame& caller = frames.back();
+        func = caller.func;
+        code = func->code.data();
+        ip = caller.ip;
+        base = caller.base;
+        R = slots.data() + base;
+        frames.pop_back();
+        if (hasResult) R[ip->d] = result;
+        NEXT();
+    }
+    CASE(Call)
+        if (enterFunction(functions[ip->imm])) RESUME();
+        NEXT();
+    CASE(CallHost)
+        callHost(instance.funcImports[ip->imm], ip->aux != 0);
+        NEXT();
+    CASE(CallIndirect) {
+        uint32_t slot = static_cast<uint32_t>(R[ip->x].i32);
+        const WasmTable& table = instance.tables.at(ip->aux);
+        if (slot >= table.size()) throw WasmTrap("undefined element");
+        int32_t ref = table.get(slot);
+        if (ref == NULL_REF) throw WasmTrap("uninitialized element");
+        if (static_cast<uint32_t>(ref) < instance.funcImports.size()) {
+            const FuncImport& imp = instance.funcImports[ref];
+            if (imp.typeId != ip->imm) throw WasmTrap("indirect call type mismatch");
+            callHost(imp, imp.type.resultType != "void");
+            NEXT();
+        }
+        // Function indices map straight to translated bodies, so no per-site cache is needed
+        if (static_cast<uint32_t>(ref) >= functions.size() || !functions[ref].def)
+            throw WasmTrap("uninitialized element");
+        const RegFunction& callee = functions[ref];
+        if (callee.def->typeId != ip->imm) throw WasmTrap("indirect call type mismatch");
+        WASM_TRACE(Exec, Debug, "\033[1;36m[executor:call_indirect]\033[0m table[" << slot << "] → function index "
+                  << ref << "\n");
+        if (enterFunction(callee)) RESUME();
+        NEXT();
+    }
+
+    CASE(Select) R[ip->d] = R[ip->aux].i32 != 0 ? R[ip->x] : R[ip->y]; NEXT();
+    CASE(GlobalGet) R[ip->d] = globals[ip->imm].value; NEXT();
+    CASE(GlobalSet) globals[ip->imm].value = R[ip->x]; NEXT();
+
+#define X(name, text, type, read) \
+    CASE(name) { \
+        uint64_t ea = static_cast<uint64_t>(static_cast<uint32_t>(R[ip->x].i32)) + ip->imm; \
+        type v = static_cast<type>(read); \
+        R[ip->d] = WasmSlot(v); \
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:" text "]\033[0m mem[" << ea << "] → " << static_cast<double>(v) << "\n"); \
+        NEXT(); \
+    }
+    WASM_REGISTER_LOADS(X)
+#undef X
+#define X(name, text, write) \
+    CASE(name) { \
+        uint64_t ea = static_cast<uint64_t>(static_cast<uint32_t>(R[ip->x].i32)) + ip->imm; \
+        const WasmSlot& v = R[ip->y]; \
+        write; \
+        if (WASM_TRACE_ON(Memory, Debug)) { \
+            std::cout << "\033[1;35m[memory:" text "]\033[0m mem[" << ea << "] = "; \
+            printValue(WasmValue(storedType(text), v)); \
+            std::cout << "\n"; \
+        } \
+        NEXT(); \
+    }
+    WASM_REGISTER_STORES(X)
+#undef X
+
+    CASE(MemorySize) {
+        int32_t pages = memory.size();
+        R[ip->d] = WasmSlot(pages);
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:memory.size]\033[0m → pages=" << pages << "\n");
+        NEXT();
+    }
+    CASE(MemoryGrow) R[ip->d] = WasmSlot(memory.grow(R[ip->x].i32)); NEXT();
+    CASE(MemoryCopy)
+        memory.copy(static_cast<uint32_t>(R[ip->d].i32), static_cast<uint32_t>(R[ip->x].i32),
+                    static_cast<uint32_t>(R[ip->y].i32));
+        NEXT();
+    CASE(MemoryFill)
+        memory.fill(static_cast<uint32_t>(R[ip->d].i32), static_cast<uint8_t>(R[ip->x].i32),
+                    static_cast<uint32_t>(R[ip->y].i32));
+        NEXT();
+    CASE(MemoryInit) {
+        uint32_t dst = static_cast<uint32_t>(R[ip->d].i32);
+        uint32_t src = static_cast<uint32_t>(R[ip->x].i32);
+        uint32_t n = static_cast<uint32_t>(R[ip->y].i32);
+        if (ip->imm >= instance.dataSegments.size())
+            throw WasmTrap("memory.init: unknown data segment " + std::to_string(ip->imm));
+        // A dropped segment behaves as if it were empty
+        const std::vector<uint8_t>& bytes = instance.dataSegments[ip->imm].bytes;
+        uint64_t available = instance.droppedData[ip->imm] ? 0 : bytes.size();
+        if (static_cast<uint64_t>(src) + n > available)
+            throw WasmTrap("memory.init: out of bounds data segment access");
+        memory.write(dst, bytes.data() + src, n);
+        WASM_TRACE(Memory, Debug, "\033[1;35m[memory:memory.init]\033[0m segment " << ip->imm << "[" << src
+                  << ".." << src + n << ") → " << dst << "\n");
+        NEXT();
+    }
+    CASE(DataDrop)
+        if (ip->imm < instance.droppedData.size()) instance.droppedData[ip->imm] = true;
+        NEXT();
+
+    CASE(RefIsNull) R[ip->d] = WasmSlot(static_cast<int32_t>(R[ip->x].i32 == NULL_REF)); NEXT();
+    CASE(TableGet) {
+        uint32_t i = static_cast<uint32_t>(R[ip->x].i32);
+        const WasmTable& table = instance.tables.at(ip->imm);
+        if (i >= table.size()) throw WasmTrap("out of bounds table access");
+        R[ip->d] = WasmSlot(table.get(i));
+        NEXT();
+    }
+    CASE(TableSet) {
+        uint32_t i = static_cast<uint32_t>(R[ip->x].i32);
+        WasmTable& table = instance.tables.at(ip->imm);
+        if (i >= table.size()) throw WasmTrap("out of bounds table access");
+        table.set(i, R[ip->y].i32);
+        NEXT();
+    }
+    CASE(TableSize) R[ip->d] = WasmSlot(static_cast<int32_t>(instance.tables.at(ip->imm).size())); NEXT();
+    CASE(TableGrow)
+        R[ip->d] = WasmSlot(instance.tables.at(ip->imm).grow(static_cast<uint32_t>(R[ip->y].i32), R[ip->x].i32));
+        NEXT();
+    CASE(TableFill)
+        if (!instance.tables.at(ip->imm).fill(static_cast<uint32_t>(R[ip->d].i32), R[ip->x].i32,
+                                               static_cast<uint32_t>(R[ip->y].i32)))
+            throw WasmTrap("out of bounds table access");
+        NEXT();
+    CASE(TableCopy)
+        if (!instance.tables.at(ip->imm).copy(static_cast<uint32_t>(R[ip->d].i32), instance.tables.at(ip->aux),
+                                               static_cast<uint32_t>(R[ip->x].i32), static_cast<uint32_t>(R[ip->y].i32)))
+            throw WasmTrap("out of bounds table access");
+        NEXT();
+    CASE(TableInit) {
+        if (ip->imm >= instance.elemSegments.size())
+            throw WasmTrap("table.init: unknown element segment " + std::to_string(ip->imm));
+        static const std::vector<int32_t> empty;
+        const std::vector<int32_t>& refs = instance.droppedElems[ip->imm] ? empty : instance.elemSegments[ip->imm].refs;
+        if (!instance.tables.at(ip->aux).init(static_cast<uint32_t>(R[ip->d].i32), refs,
+                                               static_cast<uint32_t>(R[ip->x].i32), static_cast<uint32_t>(R[ip->y].i32)))
+            throw WasmTrap("out of bounds table access");
+        NEXT();
+    }
+    CASE(ElemDrop)
+        if (ip->imm < instance.droppedElems.size()) instance.droppedElems[ip->imm] = true;
+        NEXT();
+
+#define BINARY(name, vt, T, expr) \
+    CASE(name) { \
+        T a = WasmScalar<ValueType::vt>::get(R[ip->x]); \
+        T b = WasmScalar<ValueType::vt>::get(R[ip->y]); \
+        R[ip->d] = WasmSlot(static_cast<WasmScalar<ValueType::vt>::type>(expr)); \
+        NEXT(); \
+    }
+#define COMPARE(name, vt, T, expr) \
+    CASE(name) { \
+        T a = WasmScalar<ValueType::vt>::get(R[ip->x]); \
+        T b = WasmScalar<ValueType::vt>::get(R[ip->y]); \
+        R[ip->d] = WasmSlot(static_cast<int32_t>((expr) ? 1 : 0)); \
+        NEXT(); \
+    }
+#define UNARY(name, vt, T, expr) \
+    CASE(name) { \
+        T a = WasmScalar<ValueType::vt>::get(R[ip->x]); \
+        R[ip->d] = WasmSlot(static_cast<WasmScalar<ValueType::vt>::type>(expr)); \
+        NEXT(); \
+    }
+#define CONVERT(name, from, expr) \
+    CASE(name) { \
+        const WasmSlot v = R[ip->x]; \
+        R[ip->d] = expr; \
+        NEXT(); \
+    }
+    WASM_NUMERIC_OPS(BINARY, COMPARE, UNARY, CONVERT)
+#undef BINARY
+#undef COMPARE
+#undef UNARY
+#undef CONVERT
+
+#if !WASM_THREADED_DISPATCH
+        case RegOp::Count:
+            throw WasmTrap("invalid register instruction");
+    }
+    }
+#endif
+}
+
+#undef TRACE_INSTR
+#undef CASE
+#undef RESUME
+#undef NEXT
+#undef JUMP
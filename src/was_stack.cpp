@@ -1,39 +1,53 @@
 #include "wasm_stack.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
 
 void WasmStack::clear() {
-    data.clear();
+    height = 0;
 }
 
 void WasmStack::push(const WasmValue& val) {
-    data.push_back(val);
-    std::cout << "\033[1;33m[stack]\033[0m push ";
-    printTop(val);
+    if (height == data.size()) reserve(data.empty() ? 64 : data.size() * 2);
+    data[height] = val;
+    types[height++] = val.type;
+    if (WASM_TRACE_ON(Stack, Debug)) trace("push", val);
 }
 
 WasmValue WasmStack::pop() {
-    if (data.empty()) throw std::runtime_error("Stack underflow");
-    WasmValue val = data.back();
-    data.pop_back();
-    std::cout << "\033[1;33m[stack]\033[0m pop ";
-    printTop(val);
+    if (height == 0) throw std::runtime_error("Stack underflow");
+    --height;
+    WasmValue val(types[height], data[height]);
+    if (WASM_TRACE_ON(Stack, Debug)) trace("pop", val);
     return val;
 }
 
 WasmValue WasmStack::top() {
-    if (data.empty()) throw std::runtime_error("Stack underflow");
-    WasmValue val = data.back();
-    std::cout << "\033[1;33m[stack]\033[0m pop ";
-    printTop(val);
+    if (height == 0) throw std::runtime_error("Stack underflow");
+    WasmValue val(types[height - 1], data[height - 1]);
+    if (WASM_TRACE_ON(Stack, Debug)) trace("top", val);
     return val;
 }
 
+void WasmStack::unwind(size_t base, size_t keep) {
+    if (base + keep > height) return;
+    std::move(data.begin() + (height - keep), data.begin() + height, data.begin() + base);
+    std::move(types.begin() + (height - keep), types.begin() + height, types.begin() + base);
+    height = base + keep;
+    WASM_TRACE(Stack, Debug, "\033[1;33m[stack]\033[0m unwind to " << base << " keeping " << keep << "\n");
+}
+
 void WasmStack::dump() {
     std::cout << "\033[1;33m[stack dump]\033[0m ";
-    for (auto& v : data)
-        printTop(v, false);
+    for (size_t i = 0; i < height; ++i)
+        printTop(value(i), false);
     std::cout << "\n";
 }
 
+void WasmStack::trace(const char* what, const WasmValue& v) {
+    std::cout << "\033[1;33m[stack]\033[0m " << what << " ";
+    printTop(v);
+}
+
 void WasmStack::printTop(const WasmValue& v, bool newline) {
     switch (v.type) {
         case ValueType::I32: std::cout << "i32=" << v.i32; break;
@@ -0,0 +1,61 @@
+#include "wasm_table.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <atomic>
+
+// Epochs are never reused, so a table restored by WasmInstance::rollback() (or copied
+// into a new instance of the same module) still only matches cache entries that were
+// verified against identical contents. Tables are created on several threads in batch runs.
+static std::atomic<uint64_t> nextEpoch{0};
+
+WasmTable::WasmTable(uint32_t initial, uint32_t max)
+    : elements(initial, NULL_REF), max(max) {
+    touch();
+}
+
+void WasmTable::touch() {
+    epochValue = ++nextEpoch;
+}
+
+void WasmTable::set(uint32_t index, int32_t ref) {
+    elements[index] = ref;
+    touch();
+}
+
+bool WasmTable::fill(uint32_t dst, int32_t ref, uint32_t len) {
+    if (static_cast<uint64_t>(dst) + len > elements.size()) return false;
+    std::fill_n(elements.begin() + dst, len, ref);
+    touch();
+    return true;
+}
+
+bool WasmTable::copy(uint32_t dst, const WasmTable& src, uint32_t srcIndex, uint32_t len) {
+    if (static_cast<uint64_t>(dst) + len > elements.size()
+        || static_cast<uint64_t>(srcIndex) + len > src.elements.size())
+        return false;
+    auto from = src.elements.begin() + srcIndex;
+    auto to = elements.begin() + dst;
+    // Overlapping ranges within one table copy like memmove
+    if (&src == this && dst > srcIndex) std::copy_backward(from, from + len, to + len);
+    else std::copy(from, from + len, to);
+    touch();
+    return true;
+}
+
+bool WasmTable::init(uint32_t dst, const std::vector<int32_t>& refs, uint32_t srcIndex, uint32_t len) {
+    if (static_cast<uint64_t>(dst) + len > elements.size()
+        || static_cast<uint64_t>(srcIndex) + len > refs.size())
+        return false;
+    std::copy_n(refs.begin() + srcIndex, len, elements.begin() + dst);
+    touch();
+    return true;
+}
+
+int32_t WasmTable::grow(uint32_t delta, int32_t ref) {
+    uint32_t old = size();
+    if (static_cast<uint64_t>(old) + delta > max) return -1;
+    elements.resize(old + delta, ref);
+    touch();
+    WASM_TRACE(Memory, Info, "\033[1;36m[table:grow]\033[0m from " << old << " → " << size() << " slots\n");
+    return static_cast<int32_t>(old);
+}
@@ -0,0 +1,59 @@
+#include "wasm_thread_pool.hpp"
+#include <exception>
+#include <thread>
+
+WasmThreadPool::WasmThreadPool(size_t workers) : workers(workers ? workers : 1) {
+    for (size_t i = 0; i < this->workers; ++i) queues.push_back(std::make_unique<Queue>());
+}
+
+void WasmThreadPool::run(std::vector<Task> tasks) {
+    if (workers == 1) {
+        for (Task& task : tasks) task(0);
+        return;
+    }
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+        queues[i % workers]->tasks.push_back(std::move(tasks[i]));
+
+    std::mutex failureLock;
+    std::exception_ptr failure;
+    auto work = [&](size_t worker) {
+        Task task;
+        // Nothing is queued once run() starts, so empty deques everywhere mean done
+        while (take(worker, task) || steal(worker, task)) {
+            try {
+                task(worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(failureLock);
+                if (!failure) failure = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; ++i) threads.emplace_back(work, i);
+    work(0);
+    for (std::thread& t : threads) t.join();
+    if (failure) std::rethrow_exception(failure);
+}
+
+bool WasmThreadPool::take(size_t worker, Task& task) {
+    Queue& q = *queues[worker];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tasks.empty()) return false;
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool WasmThreadPool::steal(size_t worker, Task& task) {
+    for (size_t i = 1; i < workers; ++i) {
+        Queue& q = *queues[(worker + i) % workers];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty()) continue;
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
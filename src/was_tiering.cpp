@@ -0,0 +1,145 @@
+#include "wasm_tiering.hpp"
+#include "wasm_executor.hpp"
+#include "wasm_module.hpp"
+#include "wasm_register_executor.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <iomanip>
+
+WasmTiering::WasmTiering(WasmExecutor& baseline, WasmRegisterExecutor& optimized)
+    : baseline(baseline), optimized(optimized) {}
+
+void WasmTiering::attach(const WasmModule& module, WasmInstance& instance) {
+    this->module = &module;
+    this->instance = &instance;
+
+    size_t count = std::max(instance.funcImports.size(), module.functions.size());
+    functions.assign(count, RegFunction{});
+    counters.assign(count, Counters{});
+    for (size_t index = 0; index < module.functions.size(); ++index)
+        functions[index].def = module.functions[index];
+}
+
+void WasmTiering::execute(const FuncDef& entry) {
+    // A trap in an earlier call may have left frames of the optimized tier behind
+    optimized.reset();
+    if (hotCall(entry)) {
+        TierScope scope(*this, Tier::Optimized);
+        optimized.execute(functions[entry.index], functions, *instance);
+    } else {
+        TierScope scope(*this, Tier::Baseline);
+        baseline.execute(entry, {}, module->functions, *instance);
+    }
+}
+
+bool WasmTiering::hotCall(const FuncDef& callee) {
+    if (callee.index < 0 || static_cast<size_t>(callee.index) >= counters.size()) return false;
+    Counters& c = counters[callee.index];
+    if (c.state != State::Baseline) return c.state == State::Optimized;
+    if (++c.calls < options.callThreshold) return false;
+    return promote(callee, false);
+}
+
+const RegOsrEntry* WasmTiering::hotLoop(const FuncDef& func, size_t pc) {
+    if (func.index < 0 || static_cast<size_t>(func.index) >= counters.size() || !canNest()) return nullptr;
+    Counters& c = counters[func.index];
+    if (c.state == State::Failed) return nullptr;
+    if (c.state == State::Baseline && (++c.backEdges < options.loopThreshold || !promote(func, true)))
+        return nullptr;
+    const std::vector<RegOsrEntry>& entries = functions[func.index].osr;
+    auto it = std::lower_bound(entries.begin(), entries.end(), pc,
+                               [](const RegOsrEntry& e, size_t p) { return e.pc < p; });
+    return it != entries.end() && it->pc == pc ? &*it : nullptr;
+}
+
+bool WasmTiering::promote(const FuncDef& func, bool byLoop) {
+    Counters& c = counters[func.index];
+    Clock::time_point start = options.stats ? Clock::now() : Clock::time_point();
+    std::string reason;
+    bool ok = WasmRegisterCompiler::compileFunction(func, module->functions, *instance, module->decoder,
+                                                    functions[func.index], reason);
+    if (options.stats) {
+        // Translation is counted on its own, not against the tier that asked for it
+        Clock::time_point now = Clock::now();
+        if (scopes) timeIn[static_cast<size_t>(running)] += start - since;
+        translating += now - start;
+        since = now;
+    }
+    if (!ok) {
+        c.state = State::Failed;
+        ++failures;
+        WASM_TRACE(Exec, Debug, "\033[1;36m[tiering:promote]\033[0m function index " << func.index
+                  << " stays in the baseline tier (" << reason << ")\n");
+        return false;
+    }
+    c.state = State::Optimized;
+    ++(byLoop ? promotedByLoops : promotedByCalls);
+    WASM_TRACE(Exec, Debug, "\033[1;36m[tiering:promote]\033[0m function index " << func.index << " promoted after "
+              << (byLoop ? c.backEdges : c.calls) << (byLoop ? " loop back-edge(s)\n" : " call(s)\n"));
+    return true;
+}
+
+bool WasmTiering::callOptimized(const FuncDef& callee, const WasmSlot* args, size_t depth, WasmSlot& result) {
+    const RegFunction& target = functions[callee.index];
+    TierScope scope(*this, Tier::Optimized);
+    result = optimized.invoke(target, args, depth, functions, *instance);
+    return target.hasResult;
+}
+
+bool WasmTiering::callBaseline(const FuncDef& callee, const WasmSlot* args, size_t depth, WasmSlot& result) {
+    TierScope scope(*this, Tier::Baseline);
+    return baseline.invoke(callee, args, depth, module->functions, *instance, result);
+}
+
+bool WasmTiering::replace(const FuncDef& func, const RegOsrEntry& entry, const WasmSlot* locals,
+                          const WasmSlot* operands, size_t depth, WasmSlot& result) {
+    const RegFunction& target = functions[func.index];
+    ++replacements;
+    WASM_TRACE(Exec, Debug, "\033[1;36m[tiering:osr]\033[0m function index " << func.index
+              << " continues in the optimized tier at pc " << entry.regPc << "\n");
+    TierScope scope(*this, Tier::Optimized);
+    result = optimized.replace(target, entry, locals, operands, depth, functions, *instance);
+    return target.hasResult;
+}
+
+WasmTiering::TierScope::TierScope(WasmTiering& t, Tier tier) : tiering(t), previous(t.running) {
+    ++tiering.nesting;
+    if (!tiering.options.stats) return;
+    tiering.switchTo(tier);
+    ++tiering.scopes;
+}
+
+WasmTiering::TierScope::~TierScope() {
+    --tiering.nesting;
+    if (!tiering.options.stats) return;
+    tiering.switchTo(previous);
+    --tiering.scopes;
+}
+
+void WasmTiering::switchTo(Tier tier) {
+    Clock::time_point now = Clock::now();
+    if (scopes) timeIn[static_cast<size_t>(running)] += now - since;
+    since = now;
+    running = tier;
+}
+
+void WasmTiering::report(std::ostream& out) const {
+    const char* tag = "\033[1;34m[tiering:stats]\033[0m ";
+    size_t defined = 0;
+    for (const RegFunction& f : functions) defined += f.def != nullptr;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    out << tag << "thresholds: " << options.callThreshold << " call(s), "
+        << options.loopThreshold << " loop back-edge(s)\n";
+    out << tag << "promoted " << (promotedByCalls + promotedByLoops) << " of " << defined << " function(s): "
+        << promotedByCalls << " by calls, " << promotedByLoops << " by loops; "
+        << failures << " left in the baseline tier (not translatable)\n";
+    out << tag << "on-stack replacements: " << replacements << "\n";
+    if (options.stats) {
+        std::ios::fmtflags flags = out.flags();
+        out << tag << std::fixed << std::setprecision(3)
+            << "time: baseline " << ms(timeIn[static_cast<size_t>(Tier::Baseline)]) << " ms, optimized "
+            << ms(timeIn[static_cast<size_t>(Tier::Optimized)]) << " ms, translation " << ms(translating) << " ms\n";
+        out.flags(flags);
+    }
+}
@@ -0,0 +1,44 @@
+#include "wasm_trace.hpp"
+#include <sstream>
+
+bool WasmTrace::configure(const std::string& spec) {
+    std::istringstream iss(spec);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        if (item.empty()) continue;
+
+        TraceLevel level = TraceLevel::Debug;
+        size_t colon = item.find(':');
+        if (colon != std::string::npos) {
+            std::string lv = item.substr(colon + 1);
+            item = item.substr(0, colon);
+            if (lv == "info") level = TraceLevel::Info;
+            else if (lv == "debug") level = TraceLevel::Debug;
+            else if (lv == "off") level = TraceLevel::Off;
+            else {
+                std::cerr << "\033[1;31m[trace]\033[0m Unknown trace level: " << lv << "\n";
+                return false;
+            }
+        }
+
+        if (item == "all") {
+            for (auto& l : levels) l = level;
+        } else if (item == "parser") {
+            levels[static_cast<size_t>(TraceCategory::Parser)] = level;
+        } else if (item == "stack") {
+            levels[static_cast<size_t>(TraceCategory::Stack)] = level;
+        } else if (item == "exec") {
+            levels[static_cast<size_t>(TraceCategory::Exec)] = level;
+        } else if (item == "memory") {
+            levels[static_cast<size_t>(TraceCategory::Memory)] = level;
+        } else {
+            std::cerr << "\033[1;31m[trace]\033[0m Unknown trace category: " << item << "\n";
+            return false;
+        }
+    }
+
+#if !WASM_TRACE_ENABLED
+    std::cerr << "\033[1;33m[trace]\033[0m Tracing was compiled out (configure with -DWASM_TRACE=ON).\n";
+#endif
+    return true;
+}
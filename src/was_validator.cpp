@@ -0,0 +1,373 @@
+#include "wasm_validator.hpp"
+#include "wasm_module.hpp"
+#include "wasm_numeric.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Operand types; Any stands for an operand of unreachable code, which matches everything
+enum class Type : uint8_t { I32, I64, F32, F64, Any };
+
+const char* typeName(Type t) {
+    switch (t) {
+        case Type::I32: return "i32";
+        case Type::I64: return "i64";
+        case Type::F32: return "f32";
+        case Type::F64: return "f64";
+        default: return "any";
+    }
+}
+
+Type fromValue(ValueType t) {
+    switch (t) {
+        case ValueType::I32: return Type::I32;
+        case ValueType::I64: return Type::I64;
+        case ValueType::F32: return Type::F32;
+        default: return Type::F64;
+    }
+}
+
+// Numeric conversions are named after the type they produce
+constexpr Type resultOf(const char* name) {
+    return name[0] == 'I' ? (name[1] == '3' ? Type::I32 : Type::I64)
+                          : (name[1] == '3' ? Type::F32 : Type::F64);
+}
+
+class Checker {
+public:
+    Checker(FuncDef& func, const WasmModule& module, const WasmInstance& instance)
+        : func(func), module(module), instance(instance) {}
+
+    void run();
+
+private:
+    struct Ctl {
+        Opcode kind;
+        size_t height;            // operands below the block
+        uint32_t arity;
+        Type result;              // declared type of the result, when arity is 1
+        bool unreachable = false;
+        bool hasElse = false;
+    };
+
+    FuncDef& func;
+    const WasmModule& module;
+    const WasmInstance& instance;
+    std::vector<Type> stack;
+    std::vector<Ctl> ctl;          // ctl[0] is the function body
+    size_t maxHeight = 0;
+    size_t pc = 0;
+
+    [[noreturn]] void fail(const std::string& why) const {
+        throw std::runtime_error("function " + std::to_string(func.index) + " at pc " + std::to_string(pc)
+                                 + ": " + why);
+    }
+
+    Type type(const std::string& name) const {
+        if (name == "i32" || name == "funcref" || name == "externref") return Type::I32;
+        if (name == "i64") return Type::I64;
+        if (name == "f32") return Type::F32;
+        if (name == "f64") return Type::F64;
+        fail("unsupported value type " + name);
+    }
+
+    void push(Type t) {
+        stack.push_back(t);
+        maxHeight = std::max(maxHeight, stack.size());
+    }
+    Type pop(Type expected = Type::Any) {
+        Ctl& c = ctl.back();
+        if (stack.size() == c.height) {
+            if (c.unreachable) return expected;
+            fail("operand stack underflow");
+        }
+        Type t = stack.back();
+        stack.pop_back();
+        if (t != expected && t != Type::Any && expected != Type::Any)
+            fail(std::string("expected ") + typeName(expected) + ", found " + typeName(t));
+        return t == Type::Any ? expected : t;
+    }
+    // The rest of the block is not reached; its operands become polymorphic
+    void unreachable() {
+        stack.resize(ctl.back().height);
+        ctl.back().unreachable = true;
+    }
+    Type functionResult() const {
+        const std::string& r = module.decoder.signature(func.typeId).resultType;
+        return r == "void" ? Type::Any : type(r);
+    }
+    bool hasResult() const { return module.decoder.signature(func.typeId).resultType != "void"; }
+
+    // Leaving the function takes its result from the top of the stack; the
+    // executor drops any operands below it
+    void checkReturn() {
+        if (hasResult()) pop(functionResult());
+    }
+    // Checks the values carried against the label's declared type, and records the
+    // height of the label, which validated code branches to without a run-time label
+    // stack. Operands below the values are dropped by the branch.
+    void checkBranch(BranchTarget& t) {
+        if (t.isReturn || t.depth + 1 >= ctl.size()) {
+            checkReturn();
+            if (hasResult()) push(functionResult());   // br_if leaves them when not taken
+            return;
+        }
+        Ctl& target = ctl[ctl.size() - 1 - t.depth];
+        t.height = static_cast<uint32_t>(target.height);
+        if (target.kind == Opcode::Loop || !target.arity) return;
+        pop(fromValue(t.type));
+        push(fromValue(t.type));
+    }
+    // The operands at the end of a block (or `then` arm) are exactly its results
+    void checkEnd(Ctl& c) {
+        if (c.arity) pop(c.result);
+        if (stack.size() != c.height)
+            fail("block ends with " + std::to_string(stack.size() - c.height + c.arity) + " operand(s), expected "
+                 + std::to_string(c.arity));
+    }
+
+    const FuncType& callee(uint32_t a, bool byName) const;
+    void call(const FuncType& type) {
+        for (size_t i = type.params.size(); i > 0; --i) pop(this->type(type.params[i - 1]));
+        if (type.resultType != "void") push(this->type(type.resultType));
+    }
+    Type local(uint32_t index) const {
+        if (index >= func.locals.size()) fail("local index out of range");
+        return fromValue(func.locals[index].type);
+    }
+    const WasmGlobal& global(uint32_t index) const {
+        if (index >= instance.globals.size()) fail("global index out of range");
+        return instance.globals[index];
+    }
+    void table(uint32_t index) const {
+        if (index >= instance.tables.size()) fail("unknown table " + std::to_string(index));
+    }
+};
+
+const FuncType& Checker::callee(uint32_t a, bool byName) const {
+    uint32_t index = a;
+    if (byName) {
+        if (a >= func.symbols.size()) fail("function symbol out of range");
+        auto it = module.functionByName.find(func.symbols[a]);
+        if (it == module.functionByName.end()) fail("unknown function " + func.symbols[a]);
+        index = it->second;
+    }
+    if (index < instance.funcImports.size()) return instance.funcImports[index].type;
+    auto it = module.functionsByID.find(static_cast<int>(index));
+    if (it == module.functionsByID.end()) fail("unknown function index " + std::to_string(index));
+    return module.decoder.signature(it->second.typeId);
+}
+
+void Checker::run() {
+    ctl.push_back({Opcode::Block, 0, hasResult() ? 1u : 0u, functionResult()});
+    const std::vector<Instr>& code = func.code;
+    for (pc = 0; pc < code.size(); ++pc) {
+        const Instr& in = code[pc];
+        // Superinstructions leave the instructions they stand for in place, so the
+        // plain sequence describes their stack effect
+        Opcode op = WasmDecoder::unfused(in.op);
+        switch (op) {
+            case Opcode::Nop:
+                break;
+
+            case Opcode::Block:
+            case Opcode::Loop:
+            case Opcode::If:
+                if (in.imm.i32 < 0 || in.imm.i32 > 1) fail("multi-value block");
+                if (op == Opcode::If) pop(Type::I32);
+                ctl.push_back({op, stack.size(), static_cast<uint32_t>(in.imm.i32), fromValue(in.blockType)});
+                break;
+            case Opcode::Else: {
+                Ctl& c = ctl.back();
+                if (ctl.size() == 1 || c.kind != Opcode::If || c.hasElse) fail("else without if");
+                checkEnd(c);
+                c.unreachable = false;
+                c.hasElse = true;
+                break;
+            }
+            case Opcode::End: {
+                if (ctl.size() == 1) break;   // the decoder has already turned these into nops
+                Ctl& c = ctl.back();
+                checkEnd(c);
+                if (c.kind == Opcode::If && !c.hasElse && c.arity) fail("if without else produces a result");
+                Ctl done = c;
+                ctl.pop_back();
+                if (done.arity) push(done.result);
+                break;
+            }
+
+            case Opcode::Br:
+                checkBranch(func.branches.at(in.a));
+                unreachable();
+                break;
+            case Opcode::BrIf:
+                pop(Type::I32);
+                checkBranch(func.branches.at(in.a));
+                break;
+            case Opcode::BrTable: {
+                std::vector<BranchTarget>& targets = func.brTables.at(in.a);
+                if (targets.empty()) fail("br_table without labels");
+                pop(Type::I32);
+                for (BranchTarget& t : targets) checkBranch(t);
+                unreachable();
+                break;
+            }
+            case Opcode::Return:
+                checkReturn();
+                unreachable();
+                break;
+
+            case Opcode::Call:
+                call(callee(in.a, in.b != 0));
+                break;
+            case Opcode::CallIndirect:
+                table(in.b);
+                pop(Type::I32);
+                call(module.decoder.signature(in.a));
+                break;
+
+            case Opcode::Drop:
+                pop();
+                break;
+            case Opcode::Select: {
+                pop(Type::I32);
+                Type b = pop();
+                Type a = pop(b);
+                push(a == Type::Any ? b : a);
+                break;
+            }
+
+            case Opcode::LocalGet: push(local(in.a)); break;
+            case Opcode::LocalSet: pop(local(in.a)); break;
+            case Opcode::LocalTee: {
+                Type t = local(in.a);
+                pop(t);
+                push(t);
+                break;
+            }
+            case Opcode::GlobalGet: push(fromValue(global(in.a).type)); break;
+            case Opcode::GlobalSet: {
+                const WasmGlobal& g = global(in.a);
+                if (!g.mutableFlag) fail("global.set of immutable global " + g.name);
+                pop(fromValue(g.type));
+                break;
+            }
+
+            case Opcode::I32Const: push(Type::I32); break;
+            case Opcode::I64Const: push(Type::I64); break;
+            case Opcode::F32Const: push(Type::F32); break;
+            case Opcode::F64Const: push(Type::F64); break;
+
+#define LOAD(name, type) \
+            case Opcode::name: pop(Type::I32); push(Type::type); break;
+            LOAD(I32Load, I32) LOAD(I32Load8S, I32) LOAD(I32Load8U, I32) LOAD(I32Load16S, I32) LOAD(I32Load16U, I32)
+            LOAD(I64Load, I64) LOAD(I64Load8S, I64) LOAD(I64Load8U, I64) LOAD(I64Load16S, I64) LOAD(I64Load16U, I64)
+            LOAD(I64Load32S, I64) LOAD(I64Load32U, I64)
+            LOAD(F32Load, F32) LOAD(F64Load, F64)
+#undef LOAD
+#define STORE(name, type) \
+            case Opcode::name: pop(Type::type); pop(Type::I32); break;
+            STORE(I32Store, I32) STORE(I32Store8, I32) STORE(I32Store16, I32)
+            STORE(I64Store, I64) STORE(I64Store8, I64) STORE(I64Store16, I64) STORE(I64Store32, I64)
+            STORE(F32Store, F32) STORE(F64Store, F64)
+#undef STORE
+
+#define BINARY(name, type, ...) case Opcode::name: pop(Type::type); pop(Type::type); push(Type::type); break;
+#define COMPARE(name, type, ...) case Opcode::name: pop(Type::type); pop(Type::type); push(Type::I32); break;
+// i64.eqz is a test: the executors write its 0 / 1 as an i64, which reads the same as i32
+#define UNARY(name, type, ...) \
+            case Opcode::name: pop(Type::type); push(Opcode::name == Opcode::I64Eqz ? Type::I32 : Type::type); break;
+#define CONVERT(name, from, ...) case Opcode::name: pop(Type::from); push(resultOf(#name)); break;
+            WASM_NUMERIC_OPS(BINARY, COMPARE, UNARY, CONVERT)
+#undef BINARY
+#undef COMPARE
+#undef UNARY
+#undef CONVERT
+
+            case Opcode::RefNull: push(Type::I32); break;
+            case Opcode::RefFunc: push(Type::I32); break;
+            case Opcode::RefIsNull: pop(Type::I32); push(Type::I32); break;
+
+            case Opcode::MemorySize: push(Type::I32); break;
+            case Opcode::MemoryGrow: pop(Type::I32); push(Type::I32); break;
+            case Opcode::MemoryCopy:
+            case Opcode::MemoryFill:
+            case Opcode::MemoryInit:
+                pop(Type::I32);
+                pop(Type::I32);
+                pop(Type::I32);
+                break;
+            case Opcode::DataDrop:
+            case Opcode::ElemDrop:
+                break;
+
+            case Opcode::TableGet: table(in.a); pop(Type::I32); push(Type::I32); break;
+            case Opcode::TableSet: table(in.a); pop(Type::I32); pop(Type::I32); break;
+            case Opcode::TableSize: table(in.a); push(Type::I32); break;
+            case Opcode::TableGrow: table(in.a); pop(Type::I32); pop(Type::I32); push(Type::I32); break;
+            case Opcode::TableFill:
+                table(in.a);
+                pop(Type::I32);
+                pop(Type::I32);
+                pop(Type::I32);
+                break;
+            case Opcode::TableCopy:
+            case Opcode::TableInit:
+                table(op == Opcode::TableCopy ? in.a : in.b);
+                if (op == Opcode::TableCopy) table(in.b);
+                pop(Type::I32);
+                pop(Type::I32);
+                pop(Type::I32);
+                break;
+
+            default:
+                fail(std::string("unsupported instruction ")
+                     + (op == Opcode::Unknown && in.a < func.symbols.size() ? func.symbols[in.a].c_str()
+                                                                          : WasmDecoder::opcodeName(op)));
+        }
+    }
+
+    if (ctl.size() > 1) fail("unterminated block");
+    // Falling off the end returns what is left, which must be exactly the result
+    Ctl& body = ctl.back();
+    if (body.arity) pop(body.result);
+    if (!stack.empty()) fail("function ends with " + std::to_string(stack.size() + body.arity) + " operand(s)");
+    func.maxStack = static_cast<uint32_t>(maxHeight);
+}
+
+} // namespace
+
+bool WasmValidator::validateFunction(FuncDef& func, const WasmModule& module, const WasmInstance& instance,
+                                     std::string& reason) {
+    try {
+        Checker(func, module, instance).run();
+        return true;
+    } catch (const std::exception& e) {
+        reason = e.what();
+        func.maxStack = 0;
+        return false;
+    }
+}
+
+void WasmValidator::validate(WasmModule& module, const WasmInstance& instance) {
+    module.invalidFunctions = 0;
+    module.invalidReason.clear();
+    // By index, so the reason kept is the first invalid function's
+    size_t count = 0;
+    for (const auto& [index, func] : module.functionsByID)
+        if (index >= 0) count = std::max(count, static_cast<size_t>(index) + 1);
+    for (size_t index = 0; index < count; ++index) {
+        auto it = module.functionsByID.find(static_cast<int>(index));
+        if (it == module.functionsByID.end()) continue;
+        std::string reason;
+        if (validateFunction(it->second, module, instance, reason)) continue;
+        WASM_TRACE(Parser, Debug, "\033[1;33m[validator]\033[0m " << reason << "\n");
+        if (module.invalidFunctions++ == 0) module.invalidReason = reason;
+    }
+    WASM_TRACE(Parser, Info, "\033[1;34m[validator]\033[0m " << module.functionsByID.size() - module.invalidFunctions
+              << " of " << module.functionsByID.size() << " function(s) valid"
+              << (module.invalidFunctions ? "; the stack executor keeps its run-time checks\n" : "\n"));
+}
@@ -0,0 +1,163 @@
+#include "wasm_wasi.hpp"
+#include "wasm_host.hpp"
+#include "wasm_instance.hpp"
+#include "wasm_trace.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// wasi_snapshot_preview1 errno values
+constexpr int32_t WASI_ESUCCESS = 0;
+constexpr int32_t WASI_EBADF = 8;
+constexpr int32_t WASI_EFAULT = 21;
+constexpr int32_t WASI_EIO = 29;
+
+// fd_write(fd, *iovs, iovs_len, *nwritten) -> errno
+// Each guest iovec {u32 base, u32 len} becomes a host iovec pointing into linear
+// memory; the bytes are handed to writev without being copied.
+int32_t fdWrite(WasmInstance& instance, int32_t fd, uint32_t iovs, uint32_t count, uint32_t nwritten) {
+    if (fd != 1 && fd != 2) return WASI_EBADF;
+    WasmMemory& memory = instance.memory;
+    uint32_t total = 0;
+    try {
+        const uint8_t* guest = memory.view(iovs, static_cast<uint64_t>(count) * 8);
+        memory.view(nwritten, 4);
+        struct iovec iov[WasiOutput::MAX_IOV];
+        for (uint32_t done = 0; done < count;) {
+            int n = static_cast<int>(std::min<uint32_t>(count - done, WasiOutput::MAX_IOV));
+            for (int i = 0; i < n; ++i, ++done) {
+                uint32_t entry[2];
+                std::memcpy(entry, guest + static_cast<size_t>(done) * 8, 8);
+                iov[i].iov_base = const_cast<uint8_t*>(memory.view(entry[0], entry[1]));
+                iov[i].iov_len = entry[1];
+            }
+            ssize_t written = instance.stdio.write(fd, iov, n);
+            if (written < 0) return WASI_EIO;
+            total += static_cast<uint32_t>(written);
+        }
+    } catch (const std::out_of_range&) {
+        return WASI_EFAULT;
+    }
+    memory.store32(nwritten, static_cast<int32_t>(total));
+    WASM_TRACE(Exec, Debug, "\033[1;36m[wasi:fd_write]\033[0m fd " << fd << ": " << total << " byte(s) from "
+              << count << " iovec(s)\n");
+    return WASI_ESUCCESS;
+}
+
+void procExit(WasmInstance& instance, int32_t code) {
+    instance.stdio.flush();
+    throw WasiExit(code);
+}
+
+// args_sizes_get / environ_sizes_get(*count, *bufSize): nothing is passed to the guest
+int32_t sizesGet(WasmInstance& instance, uint32_t countPtr, uint32_t sizePtr) {
+    try {
+        instance.memory.view(countPtr, 4);
+        instance.memory.view(sizePtr, 4);
+    } catch (const std::out_of_range&) {
+        return WASI_EFAULT;
+    }
+    instance.memory.store32(countPtr, 0);
+    instance.memory.store32(sizePtr, 0);
+    return WASI_ESUCCESS;
+}
+
+int32_t listGet(WasmInstance&, uint32_t, uint32_t) {
+    return WASI_ESUCCESS;
+}
+
+} // namespace
+
+WasiOutput::~WasiOutput() {
+    flush();
+}
+
+void WasiOutput::setBufferSize(size_t bytes) {
+    flush();
+    capacity = bytes;
+    for (auto& buf : pending) buf.reserve(bytes);
+}
+
+void WasiOutput::capture(std::ostream* out, std::ostream* err) {
+    flush();
+    captured[0] = out;
+    captured[1] = err;
+}
+
+ssize_t WasiOutput::write(int fd, const struct iovec* iov, int count) {
+    size_t len = 0;
+    for (int i = 0; i < count; ++i) len += iov[i].iov_len;
+    if (std::ostream* sink = captured[fd - 1]) {
+        for (int i = 0; i < count; ++i) sink->write(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+        return static_cast<ssize_t>(len);
+    }
+    std::vector<char>& buf = pending[fd - 1];
+
+    if (capacity > 0 && buf.size() + len <= capacity) {
+        for (int i = 0; i < count; ++i) {
+            const char* p = static_cast<const char*>(iov[i].iov_base);
+            buf.insert(buf.end(), p, p + iov[i].iov_len);
+        }
+        return static_cast<ssize_t>(len);
+    }
+
+    // Doesn't fit (or unbuffered): pending bytes and the guest's iovecs go out in one writev
+    struct iovec all[MAX_IOV + 1];
+    int n = 0;
+    if (!buf.empty()) all[n++] = {buf.data(), buf.size()};
+    std::copy(iov, iov + count, all + n);
+    if (fd == 1) std::fflush(stdout);   // keep ordering with the interpreter's own output
+    ssize_t written = writeAll(fd, all, n + count);
+    if (written < 0) return written;
+    written -= static_cast<ssize_t>(buf.size());
+    buf.clear();
+    return written;
+}
+
+void WasiOutput::flush() {
+    for (int fd = 1; fd <= 2; ++fd) {
+        std::vector<char>& buf = pending[fd - 1];
+        if (buf.empty()) continue;
+        if (fd == 1) std::fflush(stdout);
+        struct iovec iov = {buf.data(), buf.size()};
+        writeAll(fd, &iov, 1);
+        buf.clear();
+    }
+}
+
+// writev until everything is out, resuming after short writes
+ssize_t WasiOutput::writeAll(int fd, struct iovec* iov, int count) {
+    ssize_t total = 0;
+    while (count > 0) {
+        ssize_t n = ::writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        total += n;
+        while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= static_cast<ssize_t>(iov->iov_len);
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= static_cast<size_t>(n);
+        }
+    }
+    return total;
+}
+
+void WasmWasi::install(WasmHost& host) {
+    const char* module = "wasi_snapshot_preview1";
+    host.define<&fdWrite>(module, "fd_write");
+    host.define<&procExit>(module, "proc_exit");
+    host.define<&sizesGet>(module, "args_sizes_get");
+    host.define<&sizesGet>(module, "environ_sizes_get");
+    host.define<&listGet>(module, "args_get");
+    host.define<&listGet>(module, "environ_get");
+}
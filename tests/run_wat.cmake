@@ -0,0 +1,100 @@
+# Runs one module on one engine and checks the result:
+#   cmake -DINTERPRETER=<wasm_interpreter> -DENGINE=<engine> -DMODULE=<file> -P run_wat.cmake
+#
+# ENGINE is stack, register, jit, tiered, or eager (tiered, promoting on the first
+# call or loop back-edge). The run must exit with the status in <name>.status (0
+# when there is none; a crash always fails), print exactly <name>.expected on
+# stdout (nothing when there is none) and report each trap listed in <name>.traps,
+# one "Trap in '<export>': <message>" per line; a module without a .traps file
+# must not trap. <name>.<engine>.<kind> stands in for <name>.<kind> on an engine
+# that differs on purpose; -DEXPECT=<engine> checks against another engine's files.
+#
+# A ";; flags: ..." line in a .wat adds command-line options. A --cache-dir=@CACHE@
+# flag gets a fresh directory and the module runs twice, the second time out of the
+# cache, with the same checks both times.
+
+cmake_minimum_required(VERSION 3.14)
+
+foreach(var INTERPRETER ENGINE MODULE)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "run_wat.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+if(NOT DEFINED EXPECT)
+    set(EXPECT ${ENGINE})
+endif()
+get_filename_component(dir ${MODULE} DIRECTORY)
+get_filename_component(name ${MODULE} NAME_WE)
+
+if(ENGINE STREQUAL "eager")
+    set(args --engine=tiered --tier-calls=1 --tier-loops=1)
+else()
+    set(args --engine=${ENGINE})
+endif()
+
+set(runs 1)
+if(MODULE MATCHES "\\.wat$")
+    file(STRINGS ${MODULE} flags REGEX "^;; flags:")
+    foreach(line ${flags})
+        string(REGEX REPLACE "^;; flags:[ ]*" "" line "${line}")
+        separate_arguments(line UNIX_COMMAND "${line}")
+        list(APPEND args ${line})
+    endforeach()
+endif()
+if(args MATCHES "@CACHE@")
+    set(cache ${CMAKE_CURRENT_BINARY_DIR}/cache.${name}.${ENGINE})
+    file(REMOVE_RECURSE ${cache})
+    file(MAKE_DIRECTORY ${cache})
+    string(REPLACE "@CACHE@" "${cache}" args "${args}")
+    set(runs 2)
+endif()
+
+# Expectation file of one kind, engine-specific first; empty when there is none
+function(expectation kind out)
+    foreach(candidate ${dir}/${name}.${EXPECT}.${kind} ${dir}/${name}.${kind})
+        if(EXISTS ${candidate})
+            file(READ ${candidate} content)
+            set(${out} "${content}" PARENT_SCOPE)
+            set(${out}_FOUND TRUE PARENT_SCOPE)
+            return()
+        endif()
+    endforeach()
+    set(${out} "" PARENT_SCOPE)
+    set(${out}_FOUND FALSE PARENT_SCOPE)
+endfunction()
+
+expectation(expected expectedOut)
+expectation(traps expectedTraps)
+expectation(status expectedStatus)
+string(STRIP "${expectedStatus}" expectedStatus)
+if(NOT expectedStatus_FOUND)
+    set(expectedStatus 0)
+endif()
+
+foreach(run RANGE 1 ${runs})
+    execute_process(COMMAND ${INTERPRETER} ${args} ${MODULE}
+                    RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT status STREQUAL expectedStatus)
+        string(REPLACE ";" " " command "${INTERPRETER};${args};${MODULE}")
+        message(FATAL_ERROR "run ${run}: ${command} ended with '${status}', "
+                            "not ${expectedStatus}\n${err}")
+    endif()
+    if(NOT out STREQUAL expectedOut)
+        message(FATAL_ERROR "run ${run}: stdout differs\n--- expected\n${expectedOut}--- actual\n${out}\n${err}")
+    endif()
+    if(expectedTraps_FOUND)
+        string(REPLACE "\n" ";" lines "${expectedTraps}")
+        foreach(line ${lines})
+            if(line STREQUAL "")
+                continue()
+            endif()
+            string(FIND "${err}" "Trap in ${line}" at)
+            if(at EQUAL -1)
+                message(FATAL_ERROR "run ${run}: no \"Trap in ${line}\" reported\n${err}")
+            endif()
+        endforeach()
+    elseif(err MATCHES "Trap in ")
+        message(FATAL_ERROR "run ${run}: unexpected trap\n${err}")
+    endif()
+endforeach()
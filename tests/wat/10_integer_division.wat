@@ -0,0 +1,107 @@
+;;
+;; Signed integer division corner cases, identical on every engine
+;;
+;; Division by zero yields 0 (see wasm_numeric.hpp); the most negative value
+;; divided by -1 does not fit and traps, its remainder is 0. Operands come in as
+;; parameters, so the division runs, and as constants, which the load-time
+;; optimizer may fold.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    (func $print64 (param $v i64)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i64.lt_s (local.get $v) (i64.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i64.sub (i64.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.wrap_i64 (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48))))
+            (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+            (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    (func $div32 (param $a i32) (param $b i32)
+        (call $print (i32.div_s (local.get $a) (local.get $b)))
+        (call $print (i32.rem_s (local.get $a) (local.get $b))))
+
+    (func $div64 (param $a i64) (param $b i64)
+        (call $print64 (i64.div_s (local.get $a) (local.get $b)))
+        (call $print64 (i64.rem_s (local.get $a) (local.get $b))))
+
+    ;; Expected: 3 1, -3 1, -3 -1, 3 -1, 0 0, 7 0, -7 0, 2147483647 0, 0 0
+    (func (export "divide_i32")
+        (call $div32 (i32.const 7) (i32.const 2))
+        (call $div32 (i32.const 7) (i32.const -2))
+        (call $div32 (i32.const -7) (i32.const 2))
+        (call $div32 (i32.const -7) (i32.const -2))
+        (call $div32 (i32.const 7) (i32.const 0))
+        (call $div32 (i32.const -7) (i32.const -1))
+        (call $div32 (i32.const 7) (i32.const -1))
+        (call $div32 (i32.const -2147483647) (i32.const -1))
+        (call $print (i32.rem_s (i32.const -2147483648) (call $minusOne))))
+
+    ;; Expected: 3 1, -3 -1, 0 0, -9223372036854775807 0, 0
+    (func (export "divide_i64")
+        (call $div64 (i64.const 7) (i64.const 2))
+        (call $div64 (i64.const -7) (i64.const 2))
+        (call $div64 (i64.const 7) (i64.const 0))
+        (call $div64 (i64.const 9223372036854775807) (i64.const -1))
+        (call $print64 (i64.rem_s (i64.const -9223372036854775808) (i64.const -1))))
+
+    ;; Expected: -3 -1 0 0 -2147483648
+    (func (export "folded")
+        (call $print (i32.div_s (i32.const -7) (i32.const 2)))
+        (call $print (i32.rem_s (i32.const -7) (i32.const 2)))
+        (call $print (i32.div_s (i32.const 5) (i32.const 0)))
+        (call $print (i32.rem_s (i32.const -2147483648) (i32.const -1)))
+        (call $print (i32.div_s (i32.const -2147483648) (i32.const 1))))
+
+    (func $minusOne (result i32) (i32.const -1))
+
+    ;; Traps: integer overflow; nothing is printed
+    (func (export "overflow_i32")
+        (call $print (i32.div_s (i32.const -2147483648) (call $minusOne))))
+
+    ;; Traps: integer overflow; nothing is printed
+    (func (export "overflow_i64")
+        (call $print64 (i64.div_s (i64.const -9223372036854775808) (i64.const -1))))
+
+    ;; Expected: 1 (the traps above did not end the run)
+    (func (export "after_overflow")
+        (call $print (i32.const 1)))
+)
@@ -0,0 +1,65 @@
+;;
+;; Mutual recursion across the tiers of --engine=tiered
+;;
+;; $pong has a multi-value block, which the register form does not cover, so it
+;; stays in the baseline tier while $ping is promoted: every call between them
+;; switches tiers. Deep chains of such calls must count against the call depth
+;; limit like any other call rather than run the native stack out.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    (func $ping (param $n i32) (result i32)
+        (if (result i32) (i32.eqz (local.get $n))
+            (then (i32.const 0))
+            (else (i32.add (call $pong (i32.sub (local.get $n) (i32.const 1))) (i32.const 1)))))
+
+    (func $pong (param $n i32) (result i32)
+        (block (result i32 i32) (local.get $n) (i32.const 1))
+        (drop)
+        (drop)
+        (if (result i32) (i32.eqz (local.get $n))
+            (then (i32.const 0))
+            (else (i32.add (call $ping (i32.sub (local.get $n) (i32.const 1))) (i32.const 1)))))
+
+    ;; Expected: 9000
+    (func (export "ping_pong")
+        (call $print (call $ping (i32.const 9000))))
+
+    ;; Traps: call stack exhausted; nothing is printed
+    (func (export "too_deep")
+        (call $print (call $ping (i32.const 20000))))
+
+    ;; Expected: 9000 (both functions are warm by now)
+    (func (export "ping_pong_again")
+        (call $print (call $ping (i32.const 9000))))
+)
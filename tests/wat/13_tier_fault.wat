@@ -0,0 +1,84 @@
+;;
+;; Out-of-bounds accesses in code reached across tiers
+;;
+;; Under --engine=tiered, $load is promoted by "warm" and then called from the
+;; baseline tier, and $fetch (which stays in the baseline tier: it has a
+;; multi-value block) is called from promoted code. A guard-page fault in either
+;; must become a trap of its own call, leaving the tiers usable for the next
+;; export.
+;;
+;; flags: --tier-stats
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; The branches to self are never taken: they make $load and $indirect
+    ;; recursive, so the inliner leaves the calls to them in place
+    (func $load (param $address i32) (result i32)
+        (if (i32.eq (local.get $address) (i32.const 1))
+            (then (return (call $load (i32.const 0)))))
+        (i32.load (local.get $address)))
+
+    (func $fetch (param $address i32) (result i32)
+        (block (result i32 i32) (local.get $address) (i32.const 0))
+        (drop)
+        (i32.load))
+
+    ;; Promoted once warm; calls the baseline-only $fetch
+    (func $indirect (param $address i32) (result i32)
+        (if (i32.eq (local.get $address) (i32.const 1))
+            (then (return (call $indirect (i32.const 0)))))
+        (call $fetch (local.get $address)))
+
+    ;; Expected: 300 calls of each, summing the zeroed words at 2048..: 0
+    (func (export "warm")
+        (local $i i32)
+        (local $sum i32)
+        (loop $again
+            (local.set $sum (i32.add (local.get $sum) (call $load (i32.add (i32.const 2048) (local.get $i)))))
+            (local.set $sum (i32.add (local.get $sum) (call $indirect (i32.add (i32.const 2048) (local.get $i)))))
+            (local.set $i (i32.add (local.get $i) (i32.const 1)))
+            (br_if $again (i32.lt_u (local.get $i) (i32.const 300))))
+        (call $print (local.get $sum)))
+
+    ;; Traps: out of bounds memory access; nothing is printed
+    (func (export "fault_optimized")
+        (call $print (call $load (i32.const 65536))))
+
+    ;; Traps: out of bounds memory access; nothing is printed
+    (func (export "fault_baseline")
+        (call $print (call $indirect (i32.const -4))))
+
+    ;; Expected: 7
+    (func (export "after_faults")
+        (i32.store (i32.const 2048) (i32.const 7))
+        (call $print (call $indirect (i32.const 2048))))
+)
@@ -0,0 +1,92 @@
+;;
+;; Branches that leave operands behind
+;;
+;; Each branch drops the operands pushed since its target label and keeps the
+;; label's results. The module validates, so the stack executor takes these
+;; branches by the heights the validator records (BranchTarget::height) rather
+;; than from a run-time label stack.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; 100 + (block: 1 2 3, br 0 with 7) = 107
+    (func $nested (result i32)
+        (i32.const 100)
+        (block (result i32)
+            (i32.const 1)
+            (i32.const 2)
+            (block
+                (i32.const 3)
+                (br 1 (i32.const 7)))
+            (drop)
+            (drop)
+            (i32.const 0))
+        (i32.add))
+
+    ;; br_if out of two blocks from under a loop, with operands at every level
+    (func $search (param $limit i32) (result i32)
+        (local $i i32)
+        (i32.const 1000)
+        (block $found (result i32)
+            (i32.const 5)
+            (loop $next
+                (i32.const 6)
+                (local.set $i (i32.add (local.get $i) (i32.const 1)))
+                (br_if $found (local.get $i) (i32.ge_u (local.get $i) (local.get $limit)))
+                (drop)
+                (br $next)))
+        (i32.add))
+
+    ;; br_table to each of three labels, each with something left on the stack
+    (func $select (param $k i32) (result i32)
+        (i32.const 10)
+        (block $c (result i32)
+            (i32.const 20)
+            (block $b (result i32)
+                (i32.const 30)
+                (block $a (result i32)
+                    (i32.const 40)
+                    (br_table $a $b $c (i32.const 1) (local.get $k)))
+                (i32.add (i32.const 100))
+                (return))
+            (i32.add (i32.const 200))
+            (return))
+        (i32.add))
+
+    ;; Expected: 107 1003 1017 101 201 11 11
+    (func (export "branches")
+        (call $print (call $nested))
+        (call $print (call $search (i32.const 3)))
+        (call $print (call $search (i32.const 17)))
+        (call $print (call $select (i32.const 0)))
+        (call $print (call $select (i32.const 1)))
+        (call $print (call $select (i32.const 2)))
+        (call $print (call $select (i32.const 9))))
+)
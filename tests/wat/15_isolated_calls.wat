@@ -0,0 +1,156 @@
+;;
+;; Exports run isolated: each one starts from the state the module was loaded in
+;;
+;; "change" alters everything a checkpoint covers (a global, memory contents and
+;; size, a dropped data segment, a table slot) with plain stores, the bulk memory
+;; instructions and table.init, and checks that it did; "check" then expects none
+;; of it, and "init_again" reads the passive segment once more. 16_persist runs
+;; the same exports with --persist. A failed check traps in the export that made
+;; it: function 0 recurses until the call stack is exhausted.
+;;
+
+(module
+  (type (;0;) (func))
+  (type (;1;) (func (param i32 i32)))
+  (type (;2;) (func (result i32)))
+  (memory 1)
+  (global $counter (mut i32) (i32.const 0))
+  (data (i32.const 4096) "abcd")
+  (data $passive "wxyz")
+  (table 1 funcref)
+  (elem (i32.const 0) $one)
+  (elem $spare func $two)
+
+  ;; Fail: trap with "call stack exhausted"
+  (func (;0;) (type 0)
+    call 0)
+
+  ;; Expect: fail unless both operands are equal
+  (func (;1;) (type 1) (param i32 i32)
+    local.get 0
+    local.get 1
+    i32.ne
+    if
+      call 0
+    end)
+
+  ;; Count, store on both pages and grow; every change is there
+  (func (;2;) (type 0)
+    global.get $counter
+    i32.const 1
+    i32.add
+    global.set $counter
+    i32.const 2048
+    i32.const 42
+    i32.store
+    i32.const 65532
+    i32.const 7
+    i32.store
+    i32.const 1
+    memory.grow
+    drop
+    i32.const 70000
+    i32.const 9
+    i32.store
+    i32.const 4096
+    i32.const 0
+    i32.const 4
+    memory.init $passive
+    data.drop $passive
+    i32.const 8192
+    i32.const 4096
+    i32.const 4
+    memory.copy
+    i32.const 66000
+    i32.const 7
+    i32.const 100
+    memory.fill
+    i32.const 0
+    i32.const 0
+    i32.const 1
+    table.init $spare
+    global.get $counter
+    i32.const 1
+    call 1
+    memory.size
+    i32.const 2
+    call 1
+    i32.const 2048
+    i32.load
+    i32.const 42
+    call 1
+    i32.const 65532
+    i32.load
+    i32.const 7
+    call 1
+    i32.const 70000
+    i32.load
+    i32.const 9
+    call 1
+    i32.const 4096
+    i32.load
+    i32.const 2054781047
+    call 1
+    i32.const 8192
+    i32.load
+    i32.const 2054781047
+    call 1
+    i32.const 66099
+    i32.load8_u
+    i32.const 7
+    call 1
+    i32.const 0
+    call_indirect (type 2)
+    i32.const 2
+    call 1)
+
+  ;; None of the changes is left
+  (func (;3;) (type 0)
+    global.get $counter
+    i32.const 0
+    call 1
+    memory.size
+    i32.const 1
+    call 1
+    i32.const 2048
+    i32.load
+    i32.const 0
+    call 1
+    i32.const 65532
+    i32.load
+    i32.const 0
+    call 1
+    i32.const 4096
+    i32.load
+    i32.const 1684234849
+    call 1
+    i32.const 8192
+    i32.load
+    i32.const 0
+    call 1
+    i32.const 0
+    call_indirect (type 2)
+    i32.const 1
+    call 1)
+
+  ;; The passive segment was not dropped for good ("wxyz" is 2054781047)
+  (func (;4;) (type 0)
+    i32.const 2048
+    i32.const 0
+    i32.const 4
+    memory.init $passive
+    i32.const 2048
+    i32.load
+    i32.const 2054781047
+    call 1)
+
+  (func $one (;5;) (type 2)
+    i32.const 1)
+
+  (func $two (;6;) (type 2)
+    i32.const 2)
+
+  (export "change" (func 2))
+  (export "check" (func 3))
+  (export "init_again" (func 4))
+)
@@ -0,0 +1,79 @@
+;;
+;; call_indirect sees every change to the table it calls through
+;;
+;; All calls go through the one call_indirect in $at, so its inline cache entry is
+;; reused across table.set, table.copy, table.init, table.fill and table.grow, and
+;; across the rollback after each export. Each lookup runs in a loop first, so the
+;; cache is warm by the time the table changes. A failed check traps in the
+;; export that made it: $fail recurses until the call stack is exhausted.
+;;
+(module
+    (table 4 8 funcref)
+    (elem (i32.const 0) $one $two)
+    (elem $spare func $three $four)
+    (type $constant (func (result i32)))
+
+    (func $fail
+        (call $fail))
+
+    (func $expect (param $actual i32) (param $wanted i32)
+        (if (i32.ne (local.get $actual) (local.get $wanted))
+            (then (call $fail))))
+
+    (func $one (result i32) (i32.const 1))
+    (func $two (result i32) (i32.const 2))
+    (func $three (result i32) (i32.const 3))
+    (func $four (result i32) (i32.const 4))
+
+    (func $at (param $slot i32) (result i32)
+        (call_indirect (type $constant) (local.get $slot)))
+
+    ;; Expect slot `slot` to return `wanted`, after calling it 50 times
+    (func $check (param $slot i32) (param $wanted i32)
+        (local $i i32)
+        (loop $warm
+            (drop (call $at (local.get $slot)))
+            (local.set $i (i32.add (local.get $i) (i32.const 1)))
+            (br_if $warm (i32.lt_u (local.get $i) (i32.const 50))))
+        (call $expect (call $at (local.get $slot)) (local.get $wanted)))
+
+    (func (export "mutate")
+        (call $check (i32.const 0) (i32.const 1))
+        (call $check (i32.const 1) (i32.const 2))
+        (table.set (i32.const 0) (ref.func $three))
+        (call $check (i32.const 0) (i32.const 3))
+        (table.copy (i32.const 0) (i32.const 1) (i32.const 1))
+        (call $check (i32.const 0) (i32.const 2))
+        (table.init $spare (i32.const 0) (i32.const 1) (i32.const 1))
+        (call $check (i32.const 0) (i32.const 4))
+        (table.fill (i32.const 0) (ref.func $one) (i32.const 1))
+        (call $check (i32.const 0) (i32.const 1))
+        (call $expect (table.grow (ref.func $four) (i32.const 2)) (i32.const 4))
+        (call $check (i32.const 5) (i32.const 4))
+        (call $check (i32.const 4) (i32.const 4))
+        (call $expect (table.size) (i32.const 6))
+        ;; Overlapping copy one slot up: 1 2 null null becomes 1 1 2 null
+        (table.copy (i32.const 1) (i32.const 0) (i32.const 3))
+        (call $check (i32.const 2) (i32.const 2)))
+
+    ;; The table is back to how it was loaded
+    (func (export "after_rollback")
+        (call $check (i32.const 0) (i32.const 1))
+        (call $check (i32.const 1) (i32.const 2))
+        (call $expect (table.size) (i32.const 4)))
+
+    ;; Traps: uninitialized element
+    (func (export "null_slot")
+        (drop (call $at (i32.const 2))))
+
+    ;; Traps: undefined element
+    (func (export "past_end")
+        (drop (call $at (i32.const 4))))
+
+    ;; Traps: indirect call type mismatch (the cached slot now holds a function
+    ;; of another type)
+    (func (export "type_mismatch")
+        (call $check (i32.const 1) (i32.const 2))
+        (table.set (i32.const 1) (ref.func $fail))
+        (drop (call $at (i32.const 1))))
+)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#
+# Writes 18_binary_module.wasm, the test of the binary parser:
+#   python3 18_binary_module.py 18_binary_module.wasm
+#
+# The module uses every section the parser reads (types, an import, functions, a
+# table, memory, globals, exports, a start function, elements, data count, code,
+# active and passive data and a name section), multi-byte LEB128 immediates and the
+# 0xFC-prefixed bulk memory instructions. Each export checks its results and
+# traps when one is wrong: function 1 recurses until the call stack is exhausted.
+#
+# Exports:
+#   numbers   6765 (iterative fib 20), 1073741823 (i64 shift, wrapped), 123456
+#             (negated immutable global), 10 (f64 arithmetic, truncated), 99 (set
+#             by the start function)
+#   data      the bytes of the active data segment, then "ok\n" copied from the
+#             passive one by memory.init
+#   branch    10 11 12 12 (br_table on 0, 1, 2 and 7)
+#   indirect  77 (call_indirect through the table)
+#   hello     prints "hello from a .wasm" (the active data segment) through the
+#             imported fd_write
+
+import struct
+import sys
+
+def u(n):
+    out = b''
+    while True:
+        b = n & 0x7f
+        n >>= 7
+        if n:
+            out += bytes([b | 0x80])
+        else:
+            return out + bytes([b])
+
+def s(n):
+    out = b''
+    while True:
+        b = n & 0x7f
+        n >>= 7
+        if (n == 0 and not b & 0x40) or (n == -1 and b & 0x40):
+            return out + bytes([b])
+        out += bytes([b | 0x80])
+
+def vec(items): return u(len(items)) + b''.join(items)
+def section(id, body): return bytes([id]) + u(len(body)) + body
+def name(text): return vec([bytes([c]) for c in text.encode()])
+def functype(params, results): return b'\x60' + vec(params) + vec(results)
+def body(locals_, code): b = vec(locals_) + code + b'\x0b'; return u(len(b)) + b
+
+I32, I64, F64 = b'\x7f', b'\x7e', b'\x7c'
+def i32(n): return b'\x41' + s(n)
+def i64(n): return b'\x42' + s(n)
+def f64(x): return b'\x44' + struct.pack('<d', x)
+def get(i): return b'\x20' + u(i)
+def put(i): return b'\x21' + u(i)
+def call(i): return b'\x10' + u(i)
+def load(offset=0): return b'\x28\x02' + u(offset)
+
+# Types: 0 fd_write, 1 (), 2 (i32 i32), 3 (i32) -> i32, 4 () -> i32
+types = vec([functype([I32] * 4, [I32]), functype([], []), functype([I32, I32], []),
+             functype([I32], [I32]), functype([], [I32])])
+imports = vec([name("wasi_snapshot_preview1") + name("fd_write") + b'\x00' + u(0)])
+
+# Function indices: 0 fd_write, 1 fail, 2 expect, 3 numbers, 4 data, 5 branch,
+# 6 select, 7 start, 8 seventy_seven, 9 indirect, 10 hello
+FAIL, EXPECT, SELECT, START, SEVENTY_SEVEN = 1, 2, 6, 7, 8
+functions = vec([u(1), u(2), u(1), u(1), u(1), u(3), u(1), u(4), u(1), u(1)])
+table = vec([b'\x70\x00' + u(1)])
+memory = vec([b'\x00' + u(1)])
+globals_ = vec([I32 + b'\x01' + i32(0) + b'\x0b',           # 0: set by start
+                I32 + b'\x00' + i32(-123456) + b'\x0b'])    # 1: immutable
+exports = vec([name("numbers") + b'\x00' + u(3), name("data") + b'\x00' + u(4),
+               name("branch") + b'\x00' + u(5), name("indirect") + b'\x00' + u(9),
+               name("hello") + b'\x00' + u(10)])
+start = u(START)
+elements = vec([u(0) + i32(0) + b'\x0b' + vec([u(SEVENTY_SEVEN)])])
+
+def expect(value_code, wanted): return value_code + i32(wanted) + call(EXPECT)
+
+fail = body([], call(FAIL))
+# expect(actual, wanted): fail unless they are equal
+expect_ = body([], get(0) + get(1) + b'\x47' + b'\x04\x40' + call(FAIL) + b'\x0b')
+numbers = body([u(3) + I32],
+    # a, b = 0, 1; 20 times: a, b = b, a + b
+    i32(1) + put(1) +
+    b'\x03\x40' +
+        get(0) + get(1) + b'\x6a' + get(1) + put(0) + put(1) +
+        get(2) + i32(1) + b'\x6a' + b'\x22' + u(2) + i32(20) + b'\x49' + b'\x0d\x00' +
+    b'\x0b' +
+    expect(get(0), 6765) +
+    expect(i64(0x7fffffffffffffff) + i64(33) + b'\x88' + b'\xa7', 1073741823) +
+    expect(i32(0) + b'\x23' + u(1) + b'\x6b', 123456) +
+    expect(f64(2.5) + f64(4.0) + b'\xa2' + b'\xaa', 10) +
+    expect(b'\x23' + u(0), 99))
+data_ = body([],
+    expect(i32(3000) + b'\x2d\x00' + u(0), ord('h')) +
+    expect(i32(0) + load(3001), int.from_bytes(b'ello', 'little')) +
+    expect(i32(3018) + b'\x2d\x00' + u(0), ord('\n')) +
+    i32(3100) + i32(0) + i32(3) + b'\xfc' + u(8) + u(1) + b'\x00' + b'\xfc' + u(9) + u(1) +
+    expect(i32(3100) + b'\x2d\x00' + u(0), ord('o')) +
+    expect(i32(3102) + b'\x2d\x00' + u(0), ord('\n')))
+branch = body([],
+    expect(i32(0) + call(SELECT), 10) + expect(i32(1) + call(SELECT), 11) +
+    expect(i32(2) + call(SELECT), 12) + expect(i32(7) + call(SELECT), 12))
+# select(i): block block block (br_table 0 1 2 on i) return 10 end return 11 end return 12 end
+select = body([],
+    b'\x02\x40\x02\x40\x02\x40' + get(0) + b'\x0e' + vec([u(0), u(1)]) + u(2) +
+    b'\x0b' + i32(10) + b'\x0f' +
+    b'\x0b' + i32(11) + b'\x0f' +
+    b'\x0b' + i32(12))
+start_ = body([], i32(99) + b'\x24' + u(0))
+seventy_seven = body([], i32(77))
+indirect = body([], expect(i32(0) + b'\x11' + u(4) + u(0), 77))
+# hello: fd_write(stdout, the iovec at 1040, 1 iovec, written count at 1048)
+hello = body([],
+    i32(1040) + i32(3000) + b'\x36\x02\x00' + i32(1044) + i32(19) + b'\x36\x02\x00' +
+    i32(1) + i32(1040) + i32(1) + i32(1048) + call(0) + b'\x1a')
+code = vec([fail, expect_, numbers, data_, branch, select, start_, seventy_seven, indirect, hello])
+data = vec([b'\x00' + i32(3000) + b'\x0b' + name("hello from a .wasm\n"),
+            b'\x01' + name("ok\n")])
+
+function_names = vec([u(i) + name(n) for i, n in
+                      [(1, "fail"), (2, "expect"), (6, "select"), (7, "start"),
+                       (8, "seventy_seven")]])
+names = section(0, name("name") + b'\x01' + u(len(function_names)) + function_names)
+
+module = (b'\x00asm\x01\x00\x00\x00' + section(1, types) + section(2, imports) + section(3, functions)
+          + section(4, table) + section(5, memory) + section(6, globals_) + section(7, exports)
+          + section(8, start) + section(9, elements) + section(12, u(2)) + section(10, code) + section(11, data) + names)
+with open(sys.argv[1], 'wb') as out:
+    out.write(module)
@@ -0,0 +1,111 @@
+;;
+;; A module run out of the decoded-module cache behaves like a freshly parsed one
+;;
+;; The harness runs this file twice in an empty cache directory: the first run
+;; decodes it and stores the result, the second loads it from there. Everything
+;; the cache records has to come back: the start function, globals of every type,
+;; active and passive data, the table and its element segments, optimized and
+;; inlined code and calls resolved by name.
+;;
+;; flags: --cache-dir=@CACHE@
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1 4)
+    (global $started (mut i32) (i32.const 0))
+    (global $big i64 (i64.const -81985529216486895))
+    (global $half f64 (f64.const 0.5))
+    (global $scale f32 (f32.const 3))
+    (data (i32.const 3000) "cached\n")
+    (data $tail "segment\n")
+    (table 3 funcref)
+    (elem (i32.const 0) $square $negate)
+    (elem $later func $twice)
+    (type $unary (func (param i32) (result i32)))
+    (start $init)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    (func $print64 (param $v i64)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i64.lt_s (local.get $v) (i64.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i64.sub (i64.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.wrap_i64 (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48))))
+            (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+            (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    (func $init
+        (global.set $started (i32.const 17)))
+
+    (func $square (param $x i32) (result i32) (i32.mul (local.get $x) (local.get $x)))
+    (func $negate (param $x i32) (result i32) (i32.sub (i32.const 0) (local.get $x)))
+    (func $twice (param $x i32) (result i32) (i32.shl (local.get $x) (i32.const 1)))
+
+    ;; Expected: 17, -81985529216486895, 30 (0.5 * 3 * 20), 1 (page)
+    (func (export "state")
+        (call $print (global.get $started))
+        (call $print64 (global.get $big))
+        (call $print (i32.trunc_f64_s (f64.mul (f64.mul (global.get $half)
+            (f64.promote_f32 (global.get $scale))) (f64.const 20))))
+        (call $print (memory.size)))
+
+    ;; Expected: "cached", then "segment" from the passive segment
+    (func (export "data")
+        (call $write (i32.const 3000) (i32.const 7))
+        (memory.init $tail (i32.const 3100) (i32.const 0) (i32.const 8))
+        (call $write (i32.const 3100) (i32.const 8)))
+
+    ;; Expected: 49 -7 14
+    (func (export "table")
+        (call $print (call_indirect (type $unary) (i32.const 7) (i32.const 0)))
+        (call $print (call_indirect (type $unary) (i32.const 7) (i32.const 1)))
+        (table.init $later (i32.const 2) (i32.const 0) (i32.const 1))
+        (call $print (call_indirect (type $unary) (i32.const 7) (i32.const 2))))
+
+    ;; Expected: 42 (folded), 5 (17 / 3, strength-reduced), 1 and 120 (inlined calls)
+    (func (export "code")
+        (local $n i32)
+        (call $print (i32.add (i32.mul (i32.const 6) (i32.const 5)) (i32.const 12)))
+        (local.set $n (i32.const 17))
+        (call $print (i32.div_u (local.get $n) (i32.const 3)))
+        (call $print (call $square (call $square (i32.const 1))))
+        (call $print (call $step (call $step (call $step (call $step (i32.const 1) (i32.const 2))
+            (i32.const 3)) (i32.const 4)) (i32.const 5))))
+
+    (func $step (param $acc i32) (param $k i32) (result i32)
+        (i32.mul (local.get $acc) (local.get $k)))
+)
@@ -0,0 +1,228 @@
+;;
+;; Load-time folding and strength reduction give the same results as the
+;; instructions they replace
+;;
+;; i32 division and remainder by a constant that is not a power of two become a
+;; multiply-high; each such divisor is checked against division by the same value
+;; read from a mutable global, which is never rewritten, for the corner-case
+;; dividends and a pseudo-random sweep. Multiplication, division and remainder by
+;; powers of two become shifts and masks; constant expressions, immutable globals,
+;; branches and selects on constants are folded away.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+    (global $divisor (mut i32) (i32.const 1))
+    (global $seven i32 (i32.const 7))
+    (global $wide i64 (i64.const 0x123456789))
+    (global $pow i64 (i64.const 4096))
+    (type $checker (func (param i32) (result i32)))
+    (table 15 funcref)
+    (elem (i32.const 0) $by_3 $by_5 $by_6 $by_7 $by_10 $by_11 $by_25 $by_100 $by_641 $by_1000 $by_65537
+        $by_2147483647 $by_2147483649 $by_4294967294 $by_4294967295)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    (func $print64 (param $v i64)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i64.lt_s (local.get $v) (i64.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i64.sub (i64.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.wrap_i64 (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48))))
+            (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+            (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; Number of dividends among the corner cases and 2000 pseudo-random values for
+    ;; which $check finds a difference; `check` is one function per divisor
+    (func $sweep (param $check i32) (result i32)
+        (local $x i32)
+        (local $i i32)
+        (local $wrong i32)
+        (local.set $wrong
+            (i32.add (call_indirect (type $checker) (i32.const 0) (local.get $check))
+            (i32.add (call_indirect (type $checker) (i32.const 1) (local.get $check))
+            (i32.add (call_indirect (type $checker) (i32.const 0x7fffffff) (local.get $check))
+            (i32.add (call_indirect (type $checker) (i32.const 0x80000000) (local.get $check))
+            (i32.add (call_indirect (type $checker) (i32.const 0xfffffffe) (local.get $check))
+                     (call_indirect (type $checker) (i32.const 0xffffffff) (local.get $check))))))))
+        (local.set $x (i32.const 12345))
+        (loop $next
+            (local.set $x (i32.add (i32.mul (local.get $x) (i32.const 1103515245)) (i32.const 12345)))
+            (local.set $wrong (i32.add (local.get $wrong)
+                (call_indirect (type $checker) (local.get $x) (local.get $check))))
+            (local.set $wrong (i32.add (local.get $wrong)
+                (call_indirect (type $checker) (i32.shr_u (local.get $x) (i32.const 7)) (local.get $check))))
+            (local.set $i (i32.add (local.get $i) (i32.const 1)))
+            (br_if $next (i32.lt_u (local.get $i) (i32.const 1000))))
+        (local.get $wrong))
+
+    (func $by_3 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 3))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 3)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 3)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_5 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 5))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 5)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 5)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_6 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 6))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 6)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 6)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_7 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 7))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 7)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 7)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_10 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 10))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 10)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 10)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_11 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 11))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 11)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 11)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_25 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 25))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 25)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 25)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_100 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 100))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 100)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 100)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_641 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 641))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 641)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 641)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_1000 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 1000))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 1000)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 1000)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_65537 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 65537))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 65537)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 65537)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_2147483647 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 2147483647))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 2147483647)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 2147483647)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_2147483649 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 2147483649))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 2147483649)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 2147483649)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_4294967294 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 4294967294))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 4294967294)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 4294967294)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+    (func $by_4294967295 (param $x i32) (result i32)
+        (global.set $divisor (i32.const 4294967295))
+        (i32.add
+            (i32.ne (i32.div_u (local.get $x) (i32.const 4294967295)) (i32.div_u (local.get $x) (global.get $divisor)))
+            (i32.ne (i32.rem_u (local.get $x) (i32.const 4294967295)) (i32.rem_u (local.get $x) (global.get $divisor)))))
+
+    (func $quotient_7 (param $x i32) (result i32) (i32.div_u (local.get $x) (i32.const 7)))
+    (func $quotient_641 (param $x i32) (result i32) (i32.div_u (local.get $x) (i32.const 641)))
+    (func $remainder_1000 (param $x i32) (result i32) (i32.rem_u (local.get $x) (i32.const 1000)))
+    (func $remainder_max (param $x i32) (result i32) (i32.rem_u (local.get $x) (i32.const 0x7fffffff)))
+
+    ;; Expected: 0 (no divisor differs), 613566756 1560 295 1
+    (func (export "magic")
+        (local $check i32)
+        (local $wrong i32)
+        (loop $next
+            (local.set $wrong (i32.add (local.get $wrong) (call $sweep (local.get $check))))
+            (local.set $check (i32.add (local.get $check) (i32.const 1)))
+            (br_if $next (i32.lt_u (local.get $check) (i32.const 15))))
+        (call $print (local.get $wrong))
+        (call $print (call $quotient_7 (i32.const -1)))
+        (call $print (call $quotient_641 (i32.const 1000000)))
+        (call $print (call $remainder_1000 (i32.const -1)))
+        (call $print (call $remainder_max (i32.const 0x80000000))))
+
+    ;; Operands loaded from memory, so only the constant side is known at load time.
+    ;; Expected: -800 268435449 12 -100 -100 -25 -4,
+    ;; then -409600 4503599627370495 3996 -100 305419896
+    (func (export "powers")
+        (local $x i32)
+        (local $y i64)
+        (i32.store (i32.const 2048) (i32.const -100))
+        (i64.store (i32.const 2056) (i64.const -100))
+        (local.set $x (i32.load (i32.const 2048)))
+        (local.set $y (i64.load (i32.const 2056)))
+        (call $print (i32.mul (local.get $x) (i32.const 8)))
+        (call $print (i32.div_u (local.get $x) (i32.const 16)))
+        (call $print (i32.rem_u (local.get $x) (i32.const 16)))
+        (call $print (i32.add (i32.mul (local.get $x) (i32.const 1)) (i32.const 0)))
+        (call $print (i32.div_s (local.get $x) (i32.const 1)))
+        (call $print (i32.div_s (local.get $x) (i32.const 4)))
+        (call $print (i32.rem_s (local.get $x) (i32.const 8)))
+        (call $print64 (i64.mul (local.get $y) (global.get $pow)))
+        (call $print64 (i64.div_u (local.get $y) (global.get $pow)))
+        (call $print64 (i64.rem_u (local.get $y) (global.get $pow)))
+        (call $print64 (i64.shl (i64.div_u (local.get $y) (i64.const 1)) (i64.const 0)))
+        (call $print64 (i64.div_u (global.get $wide) (i64.const 16))))
+
+    ;; Expected: 49 3 2 -4 7 1069547520, 0 0 (division by zero is left to run
+    ;; time), 2 20 5
+    (func (export "folding")
+        (call $print (i32.add (i32.mul (i32.const 6) (i32.const 7)) (global.get $seven)))
+        (call $print (i32.rotl (i32.const 0x80000001) (i32.const 1)))
+        (call $print (i32.shl (i32.const 1) (i32.const 33)))
+        (call $print64 (i64.shr_s (i64.const -16) (i64.const 2)))
+        (call $print (i32.trunc_f32_s (f32.mul (f32.const 2.5) (f32.const 3))))
+        (call $print (i32.reinterpret_f32 (f32.const 1.5)))
+        (call $print (i32.div_s (i32.const 7) (i32.const 0)))
+        (call $print (i32.rem_u (global.get $seven) (i32.const 0)))
+        (call $print (if (result i32) (i32.eqz (global.get $seven)) (then (i32.const 1)) (else (i32.const 2))))
+        (call $print (select (i32.const 10) (i32.const 20) (i32.sub (global.get $seven) (i32.const 7))))
+        (call $print (block $done (result i32)
+            (br_if $done (i32.const 5) (i32.const 1))
+            (drop)
+            (i32.const 6))))
+)
@@ -0,0 +1,156 @@
+;;
+;; Calls to small non-recursive functions are inlined at load time
+;;
+;; Callees of every shape the inliner accepts: leaves, nested inlining, several
+;; returns (through br_table and from inside blocks), block results, indirect
+;; calls, globals, parameters of every type, fresh locals on every call, and a
+;; trap. Recursive and mutually recursive callees stay calls.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+    (global $g (mut i32) (i32.const 5))
+    (global $k i64 (i64.const 9))
+    (table 2 funcref)
+    (elem (i32.const 0) $square $double)
+    (type $unary (func (param i32) (result i32)))
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    (func $print64 (param $v i64)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i64.lt_s (local.get $v) (i64.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i64.sub (i64.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.wrap_i64 (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48))))
+            (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+            (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    (func $square (param i32) (result i32) local.get 0 local.get 0 i32.mul)
+    (func $double (param i32) (result i32) local.get 0 i32.const 2 i32.mul)
+    (func $sub (param i32 i32) (result i32) local.get 0 local.get 1 i32.sub)
+    (func $indirect (param i32 i32) (result i32) local.get 1 local.get 0 call_indirect (type $unary))
+
+    ;; Its local must start at zero on every call
+    (func $accumulate (param i32) (result i32) (local i32)
+        local.get 1 local.get 0 i32.add local.set 1
+        local.get 1 local.get 1 i32.mul)
+
+    (func $early (param i32) (result i32)
+        block
+            block
+                local.get 0
+                br_table 0 1 1
+            end
+            i32.const 100
+            return
+        end
+        local.get 0 i32.eqz
+        if i32.const 7 return end
+        i32.const 300)
+
+    (func $deep (param i32) (result i32)
+        block (result i32)
+            block (result i32)
+                local.get 0
+                local.get 0
+                br_if 1
+                drop
+                i32.const 11
+            end
+        end)
+
+    (func $bump global.get $g i32.const 1 i32.add global.set $g)
+
+    (func $wide (param i64 f64 f32) (result f64)
+        local.get 1 local.get 2 f64.promote_f32 f64.mul local.get 1 local.get 0 i64.const 3 i64.eq select)
+
+    (func $twice_squared (param i32) (result i32) local.get 0 call $square call $double)
+    (func $chain (param i32) (result i32) local.get 0 call $twice_squared i32.const 1 call $sub)
+
+    (func $factorial (param i32) (result i32)
+        local.get 0 i32.eqz
+        if (result i32)
+            i32.const 1
+        else
+            local.get 0 local.get 0 i32.const 1 i32.sub call $factorial i32.mul
+        end)
+
+    (func $even (param i32) (result i32)
+        local.get 0 i32.eqz if (result i32) i32.const 1 else local.get 0 i32.const 1 i32.sub call $odd end)
+    (func $odd (param i32) (result i32)
+        local.get 0 i32.eqz if (result i32) i32.const 0 else local.get 0 i32.const 1 i32.sub call $even end)
+
+    (func $constant (result i64) global.get $k)
+
+    (func $load (param i32) (result i32) local.get 0 i32.load)
+
+    ;; Expected: 4, 36 12 (indirect), 100 300 300 300 (early returns), 11 9 (block
+    ;; results), 7 (global), 1 (mixed parameters), 31 (nested), 720 1 0 (recursive),
+    ;; 9, 285 (fresh locals in a loop)
+    (func (export "run")
+        (local $i i32)
+        (local $sum i32)
+        (call $print (call $sub (i32.const 7) (i32.const 3)))
+        (call $print (call $indirect (i32.const 0) (i32.const 6)))
+        (call $print (call $indirect (i32.const 1) (i32.const 6)))
+        (call $print (call $early (i32.const 0)))
+        (call $print (call $early (i32.const 1)))
+        (call $print (call $early (i32.const 5)))
+        (call $print (call $early (i32.const -1)))
+        (call $print (call $deep (i32.const 0)))
+        (call $print (call $deep (i32.const 9)))
+        (call $bump)
+        (call $bump)
+        (call $print (global.get $g))
+        (call $print (i32.trunc_f64_s (call $wide (i64.const 3) (f64.const 0.5) (f32.const 2))))
+        (call $print (call $chain (i32.const 4)))
+        (call $print (call $factorial (i32.const 6)))
+        (call $print (call $even (i32.const 10)))
+        (call $print (call $odd (i32.const 10)))
+        (call $print64 (call $constant))
+        (loop $next
+            (local.set $sum (i32.add (local.get $sum) (call $accumulate (local.get $i))))
+            (local.set $i (i32.add (local.get $i) (i32.const 1)))
+            (br_if $next (i32.lt_u (local.get $i) (i32.const 10))))
+        (call $print (local.get $sum)))
+
+    ;; Expected: 0, then traps: out of bounds memory access (inside the inlined $load)
+    (func (export "trap_in_callee")
+        (call $print (call $load (i32.const 65532)))
+        (call $print (call $load (i32.const 65533))))
+)
@@ -0,0 +1,147 @@
+;;
+;; Calls reach the right function however they name it
+;;
+;; Calls by name are resolved to function indices at load time, before any
+;; function runs; this module calls forward and backward by name, by index
+;; (including an anonymous function and the import), into exports and through the
+;; table, and recurses directly, mutually and with calls nested in arguments, so
+;; every frame has to get its own arguments and locals.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+    (global $counter (mut i32) (i32.const 0))
+    (data (i32.const 3000) "by index\n")
+    (table 1 funcref)
+    (elem (i32.const 0) $exported)
+    (type $unary (func (param i32) (result i32)))
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    (func $print64 (param $v i64)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i64.lt_s (local.get $v) (i64.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i64.sub (i64.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.wrap_i64 (i64.add (i64.rem_u (local.get $v) (i64.const 10)) (i64.const 48))))
+            (local.set $v (i64.div_u (local.get $v) (i64.const 10)))
+            (br_if $digits (i64.ne (local.get $v) (i64.const 0))))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; Function 4: after the import and the three printers
+    (func (param i32) (result i32)
+        (i32.add (local.get 0) (i32.const 1000)))
+
+    ;; Expected: 1005 (by index), 1006 (by name, defined further down), "by index"
+    ;; (the import called by index)
+    (func (export "by_index")
+        (call $print (call 4 (i32.const 5)))
+        (call $print (call $later (i32.const 5)))
+        (i32.store (i32.const 2000) (i32.const 3000))
+        (i32.store (i32.const 2004) (i32.const 9))
+        (drop (call 0 (i32.const 1) (i32.const 2000) (i32.const 1) (i32.const 2008))))
+
+    (func $exported (export "exported") (param $x i32) (result i32)
+        (i32.mul (local.get $x) (i32.const 3)))
+
+    ;; Expected: 21 (call of an export), 21 (the same function through the table)
+    (func (export "into_exports")
+        (call $print (call $exported (i32.const 7)))
+        (call $print (call_indirect (type $unary) (i32.const 7) (i32.const 0))))
+
+    (func $fib (param $n i32) (result i32)
+        (if (result i32) (i32.lt_u (local.get $n) (i32.const 2))
+            (then (local.get $n))
+            (else (i32.add (call $fib (i32.sub (local.get $n) (i32.const 1)))
+                           (call $fib (i32.sub (local.get $n) (i32.const 2)))))))
+
+    (func $ackermann (param $m i32) (param $n i32) (result i32)
+        (if (result i32) (i32.eqz (local.get $m))
+            (then (i32.add (local.get $n) (i32.const 1)))
+            (else
+                (if (result i32) (i32.eqz (local.get $n))
+                    (then (call $ackermann (i32.sub (local.get $m) (i32.const 1)) (i32.const 1)))
+                    (else (call $ackermann (i32.sub (local.get $m) (i32.const 1))
+                              (call $ackermann (local.get $m) (i32.sub (local.get $n) (i32.const 1)))))))))
+
+    (func $is_even (param $n i32) (result i32)
+        (if (result i32) (i32.eqz (local.get $n))
+            (then (i32.const 1))
+            (else (call $is_odd (i32.sub (local.get $n) (i32.const 1))))))
+
+    (func $is_odd (param $n i32) (result i32)
+        (if (result i32) (i32.eqz (local.get $n))
+            (then (i32.const 0))
+            (else (call $is_even (i32.sub (local.get $n) (i32.const 1))))))
+
+    ;; Expected: 6765 (fib 20), 61 (ackermann 3 3), 1 0 (mutual recursion 1000 deep)
+    (func (export "recursion")
+        (call $print (call $fib (i32.const 20)))
+        (call $print (call $ackermann (i32.const 3) (i32.const 3)))
+        (call $print (call $is_even (i32.const 1000)))
+        (call $print (call $is_odd (i32.const 1000))))
+
+    ;; The next counter value; the recursion never happens, it only keeps the calls
+    ;; from being inlined
+    (func $next (result i32)
+        (global.set $counter (i32.add (global.get $counter) (i32.const 1)))
+        (if (i32.gt_u (global.get $counter) (i32.const 1000))
+            (then (drop (call $next))))
+        (global.get $counter))
+
+    (func $digits (param $a i32) (param $b i32) (param $c i32) (result i32)
+        (i32.add (i32.mul (i32.add (i32.mul (local.get $a) (i32.const 10)) (local.get $b)) (i32.const 10))
+                 (local.get $c)))
+
+    (func $mixed (param $a i32) (param $b i64) (param $c f32) (param $d f64) (param $e i32) (result f64)
+        (local $scratch i64)
+        (local.set $scratch (i64.mul (local.get $b) (i64.const 3)))
+        (f64.add (f64.add (f64.convert_i32_s (i32.add (local.get $a) (i32.wrap_i64 (local.get $scratch))))
+                          (f64.promote_f32 (local.get $c)))
+                 (f64.mul (local.get $d) (f64.convert_i32_s (local.get $e)))))
+
+    ;; Expected: 123 (arguments are evaluated in order), 456 (calls nested in the
+    ;; arguments of calls), 1234 (parameters of every type)
+    (func (export "arguments")
+        (call $print (call $digits (call $next) (call $next) (call $next)))
+        (call $print (call $digits (call $next) (call $digits (i32.const 0) (i32.const 0) (call $next))
+                                   (call $next)))
+        (call $print (i32.trunc_f64_s (call $mixed (i32.const 1) (i64.const 400) (f32.const 32.5)
+                                                   (f64.const 0.25) (i32.const 2)))))
+
+    (func $later (param $x i32) (result i32)
+        (i32.add (call 4 (local.get $x)) (i32.const 1)))
+)
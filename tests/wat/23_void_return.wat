@@ -0,0 +1,78 @@
+;;
+;; A return leaves exactly the callee's declared results to the caller
+;;
+;; return, and br or br_if to the function's own label, may leave operands under
+;; the results; they are dropped with the frame. Each callee below leaves extra
+;; values behind and the caller prints what it finds under and above them.
+;;
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; Void callees: nothing of theirs may reach the caller
+    (func $return_void
+        (i32.const 7)
+        (return))
+    (func $branch_void
+        (i32.const 9)
+        (br 0))
+    (func $branch_if_void (param $x i32)
+        (i32.const 11)
+        (br_if 0 (local.get $x))
+        (drop))
+    (func $nested_void
+        (block
+            (i32.const 13)
+            (br 1)))
+
+    ;; Callees with one result: only the top value is returned
+    (func $return_one (result i32)
+        (i32.const 1)
+        (i32.const 2)
+        (return))
+    (func $branch_one (result i32)
+        (i64.const 3)
+        (loop (result i32)
+            (i32.const 4)
+            (i32.const 6)
+            (br 1)))
+
+    ;; Expected: 5 5 5 5 5
+    (func (export "void")
+        (call $print (block (result i32) (i32.const 5) (call $return_void)))
+        (call $print (block (result i32) (i32.const 5) (call $branch_void)))
+        (call $print (block (result i32) (i32.const 5) (call $branch_if_void (i32.const 1))))
+        (call $print (block (result i32) (i32.const 5) (call $branch_if_void (i32.const 0))))
+        (call $print (block (result i32) (i32.const 5) (call $nested_void))))
+
+    ;; Expected: 42 (40 + 2), 46 (40 + 6)
+    (func (export "value")
+        (call $print (i32.add (i32.const 40) (call $return_one)))
+        (call $print (i32.add (i32.const 40) (call $branch_one))))
+)
@@ -0,0 +1,102 @@
+;;
+;; Operands left under a branch's values are valid
+;;
+;; br, br_if, br_table and return take only the values their target declares and
+;; drop whatever is under them; a block's result has the type it declares, even
+;; when its end is not reached. The module has to validate, and then runs by the
+;; heights the validator records.
+;;
+;; flags: --validate
+(module
+    (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+    (memory 1)
+
+    ;; Decimal text of a value and a newline, built downwards from address 1024
+    (func $print (param $v i32)
+        (local $p i32)
+        (local $negative i32)
+        (local.set $p (i32.const 1024))
+        (i32.store8 (local.get $p) (i32.const 10))
+        (local.set $negative (i32.lt_s (local.get $v) (i32.const 0)))
+        (if (local.get $negative)
+            (then (local.set $v (i32.sub (i32.const 0) (local.get $v)))))
+        (loop $digits
+            (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+            (i32.store8 (local.get $p) (i32.add (i32.rem_u (local.get $v) (i32.const 10)) (i32.const 48)))
+            (local.set $v (i32.div_u (local.get $v) (i32.const 10)))
+            (br_if $digits (local.get $v)))
+        (if (local.get $negative)
+            (then
+                (local.set $p (i32.sub (local.get $p) (i32.const 1)))
+                (i32.store8 (local.get $p) (i32.const 45))))
+        (call $write (local.get $p) (i32.sub (i32.const 1025) (local.get $p))))
+
+    ;; fd_write of `length` bytes at `address` to stdout; the iovec sits at 1040
+    (func $write (param $address i32) (param $length i32)
+        (i32.store (i32.const 1040) (local.get $address))
+        (i32.store (i32.const 1044) (local.get $length))
+        (drop (call $fd_write (i32.const 1) (i32.const 1040) (i32.const 1) (i32.const 1048))))
+
+    ;; return under operands of other types
+    (func $return_extra (result i32)
+        (i32.const 1)
+        (i64.const 2)
+        (f32.const 3)
+        (return (i32.const 4)))
+
+    ;; br to an i32 block from above an f32 and an i64: 7 + 1
+    (func $br_extra (result i32)
+        (block (result i32)
+            (f32.const 1)
+            (i64.const 2)
+            (br 0 (i32.const 7)))
+        (i32.add (i32.const 1)))
+
+    ;; br_if with an i64 under its value; not taken, the value stays for the drops
+    (func $br_if_extra (param $x i32) (result i32)
+        (block (result i32)
+            (i64.const 9)
+            (i32.const 10)
+            (br_if 0 (local.get $x))
+            (drop)
+            (drop)
+            (i32.const 20)))
+
+    ;; br_if to the function's own label: it returns the value when taken
+    (func $br_if_return (param $x i32) (result i32)
+        (i64.const 3)
+        (i32.const 41)
+        (br_if 0 (local.get $x))
+        (i32.add (i32.const 1))
+        (return))
+
+    ;; br_table to two labels of the same type, from above an f64
+    (func $br_table_extra (param $k i32) (result i32)
+        (block $a (result i32)
+            (block $b (result i32)
+                (f64.const 5)
+                (br_table $b $a (i32.const 30) (local.get $k)))
+            (i32.add (i32.const 1))))
+
+    ;; Blocks whose end is not reached still have their declared type: the f32
+    ;; block's result goes to f32.neg, the i64 block's to an i64 drop
+    (func $declared (param $x i32) (result i32)
+        (if (local.get $x)
+            (then
+                (drop (f32.neg (block (result f32) (br 2 (i32.const 60)))))
+                (drop (block (result i64) (return (i32.const 70))))))
+        (i32.const 50))
+
+    ;; Expected: 4 8 10 20 41 42 31 30 50 60
+    (func (export "operands")
+        (call $print (call $return_extra))
+        (call $print (call $br_extra))
+        (call $print (call $br_if_extra (i32.const 1)))
+        (call $print (call $br_if_extra (i32.const 0)))
+        (call $print (call $br_if_return (i32.const 1)))
+        (call $print (call $br_if_return (i32.const 0)))
+        (call $print (call $br_table_extra (i32.const 0)))
+        (call $print (call $br_table_extra (i32.const 1)))
+        (call $print (call $declared (i32.const 0)))
+        (call $print (call $declared (i32.const 1))))
+)
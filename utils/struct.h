@@ -15,6 +15,9 @@ struct Value {
     std::string type = "";
 };
 
+// Reference values (funcref / externref) travel as i32: a function index, or NULL_REF
+constexpr int32_t NULL_REF = -1;
+
 enum class ValueType {
     I32,
     I64,
@@ -22,6 +25,27 @@ enum class ValueType {
     F64
 };
 
+struct WasmValue;
+
+// Untagged value as the executors keep it on the operand stack, in frames and in
+// globals: the instruction (or the declaration) that reads a slot knows its type.
+union WasmSlot {
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+
+    WasmSlot() : i64(0) {}
+    explicit WasmSlot(int32_t v) : i64(0) { i32 = v; }
+    explicit WasmSlot(int64_t v) : i64(v) {}
+    explicit WasmSlot(float v) : i64(0) { f32 = v; }
+    explicit WasmSlot(double v) : f64(v) {}
+    inline WasmSlot(const WasmValue& v);
+};
+static_assert(sizeof(WasmSlot) == 8, "a slot is one 64-bit word");
+
+// Value with its type, as it crosses the embedding API (arguments, host results,
+// constants in the decoded module)
 struct WasmValue {
     ValueType type;
     union {
@@ -36,14 +60,291 @@ struct WasmValue {
     explicit WasmValue(int64_t v) : type(ValueType::I64), i64(v) {}
     explicit WasmValue(float v)   : type(ValueType::F32), f32(v) {}
     explicit WasmValue(double v)  : type(ValueType::F64), f64(v) {}
+    WasmValue(ValueType t, WasmSlot s) : type(t), i64(s.i64) {}
+};
+
+inline WasmSlot::WasmSlot(const WasmValue& v) : i64(v.i64) {}
+
+// Opcode table: X(enumName, "wat mnemonic")
+#define WASM_OPCODES(X) \
+    X(Unknown, "<unknown>") \
+    X(Nop, "nop") \
+    X(Block, "block") \
+    X(Loop, "loop") \
+    X(If, "if") \
+    X(Else, "else") \
+    X(End, "end") \
+    X(Br, "br") \
+    X(BrIf, "br_if") \
+    X(BrTable, "br_table") \
+    X(Return, "return") \
+    X(Call, "call") \
+    X(CallIndirect, "call_indirect") \
+    X(Drop, "drop") \
+    X(Select, "select") \
+    X(LocalGet, "local.get") \
+    X(LocalSet, "local.set") \
+    X(LocalTee, "local.tee") \
+    X(GlobalGet, "global.get") \
+    X(GlobalSet, "global.set") \
+    X(I32Load, "i32.load") \
+    X(I64Load, "i64.load") \
+    X(F32Load, "f32.load") \
+    X(F64Load, "f64.load") \
+    X(I32Load8S, "i32.load8_s") \
+    X(I32Load8U, "i32.load8_u") \
+    X(I32Load16S, "i32.load16_s") \
+    X(I32Load16U, "i32.load16_u") \
+    X(I64Load8S, "i64.load8_s") \
+    X(I64Load8U, "i64.load8_u") \
+    X(I64Load16S, "i64.load16_s") \
+    X(I64Load16U, "i64.load16_u") \
+    X(I64Load32S, "i64.load32_s") \
+    X(I64Load32U, "i64.load32_u") \
+    X(I32Store, "i32.store") \
+    X(I64Store, "i64.store") \
+    X(F32Store, "f32.store") \
+    X(F64Store, "f64.store") \
+    X(I32Store8, "i32.store8") \
+    X(I32Store16, "i32.store16") \
+    X(I64Store8, "i64.store8") \
+    X(I64Store16, "i64.store16") \
+    X(I64Store32, "i64.store32") \
+    X(MemorySize, "memory.size") \
+    X(MemoryGrow, "memory.grow") \
+    X(MemoryInit, "memory.init") \
+    X(DataDrop, "data.drop") \
+    X(MemoryCopy, "memory.copy") \
+    X(MemoryFill, "memory.fill") \
+    X(RefNull, "ref.null") \
+    X(RefIsNull, "ref.is_null") \
+    X(RefFunc, "ref.func") \
+    X(TableGet, "table.get") \
+    X(TableSet, "table.set") \
+    X(TableSize, "table.size") \
+    X(TableGrow, "table.grow") \
+    X(TableFill, "table.fill") \
+    X(TableCopy, "table.copy") \
+    X(TableInit, "table.init") \
+    X(ElemDrop, "elem.drop") \
+    X(I32Const, "i32.const") \
+    X(I64Const, "i64.const") \
+    X(F32Const, "f32.const") \
+    X(F64Const, "f64.const") \
+    X(I32Eqz, "i32.eqz") \
+    X(I32Eq, "i32.eq") \
+    X(I32Ne, "i32.ne") \
+    X(I32LtS, "i32.lt_s") \
+    X(I32LtU, "i32.lt_u") \
+    X(I32GtS, "i32.gt_s") \
+    X(I32GtU, "i32.gt_u") \
+    X(I32LeS, "i32.le_s") \
+    X(I32LeU, "i32.le_u") \
+    X(I32GeS, "i32.ge_s") \
+    X(I32GeU, "i32.ge_u") \
+    X(I64Eqz, "i64.eqz") \
+    X(I64Eq, "i64.eq") \
+    X(I64Ne, "i64.ne") \
+    X(I64LtS, "i64.lt_s") \
+    X(I64LtU, "i64.lt_u") \
+    X(I64GtS, "i64.gt_s") \
+    X(I64GtU, "i64.gt_u") \
+    X(I64LeS, "i64.le_s") \
+    X(I64LeU, "i64.le_u") \
+    X(I64GeS, "i64.ge_s") \
+    X(I64GeU, "i64.ge_u") \
+    X(F32Eq, "f32.eq") \
+    X(F32Ne, "f32.ne") \
+    X(F32Lt, "f32.lt") \
+    X(F32Gt, "f32.gt") \
+    X(F32Le, "f32.le") \
+    X(F32Ge, "f32.ge") \
+    X(F64Eq, "f64.eq") \
+    X(F64Ne, "f64.ne") \
+    X(F64Lt, "f64.lt") \
+    X(F64Gt, "f64.gt") \
+    X(F64Le, "f64.le") \
+    X(F64Ge, "f64.ge") \
+    X(I32Clz, "i32.clz") \
+    X(I32Ctz, "i32.ctz") \
+    X(I32Popcnt, "i32.popcnt") \
+    X(I32Add, "i32.add") \
+    X(I32Sub, "i32.sub") \
+    X(I32Mul, "i32.mul") \
+    X(I32DivS, "i32.div_s") \
+    X(I32DivU, "i32.div_u") \
+    X(I32RemS, "i32.rem_s") \
+    X(I32RemU, "i32.rem_u") \
+    X(I32And, "i32.and") \
+    X(I32Or, "i32.or") \
+    X(I32Xor, "i32.xor") \
+    X(I32Shl, "i32.shl") \
+    X(I32ShrS, "i32.shr_s") \
+    X(I32ShrU, "i32.shr_u") \
+    X(I32Rotl, "i32.rotl") \
+    X(I32Rotr, "i32.rotr") \
+    X(I32Min, "i32.min") \
+    X(I32Max, "i32.max") \
+    X(I32Abs, "i32.abs") \
+    X(I32Neg, "i32.neg") \
+    X(I64Clz, "i64.clz") \
+    X(I64Ctz, "i64.ctz") \
+    X(I64Popcnt, "i64.popcnt") \
+    X(I64Add, "i64.add") \
+    X(I64Sub, "i64.sub") \
+    X(I64Mul, "i64.mul") \
+    X(I64DivS, "i64.div_s") \
+    X(I64DivU, "i64.div_u") \
+    X(I64RemS, "i64.rem_s") \
+    X(I64RemU, "i64.rem_u") \
+    X(I64And, "i64.and") \
+    X(I64Or, "i64.or") \
+    X(I64Xor, "i64.xor") \
+    X(I64Shl, "i64.shl") \
+    X(I64ShrS, "i64.shr_s") \
+    X(I64ShrU, "i64.shr_u") \
+    X(I64Rotl, "i64.rotl") \
+    X(I64Rotr, "i64.rotr") \
+    X(I64Min, "i64.min") \
+    X(I64Max, "i64.max") \
+    X(I64Abs, "i64.abs") \
+    X(I64Neg, "i64.neg") \
+    X(F32Abs, "f32.abs") \
+    X(F32Neg, "f32.neg") \
+    X(F32Ceil, "f32.ceil") \
+    X(F32Floor, "f32.floor") \
+    X(F32Trunc, "f32.trunc") \
+    X(F32Nearest, "f32.nearest") \
+    X(F32Sqrt, "f32.sqrt") \
+    X(F32Add, "f32.add") \
+    X(F32Sub, "f32.sub") \
+    X(F32Mul, "f32.mul") \
+    X(F32Div, "f32.div") \
+    X(F32Min, "f32.min") \
+    X(F32Max, "f32.max") \
+    X(F64Abs, "f64.abs") \
+    X(F64Neg, "f64.neg") \
+    X(F64Ceil, "f64.ceil") \
+    X(F64Floor, "f64.floor") \
+    X(F64Trunc, "f64.trunc") \
+    X(F64Nearest, "f64.nearest") \
+    X(F64Sqrt, "f64.sqrt") \
+    X(F64Add, "f64.add") \
+    X(F64Sub, "f64.sub") \
+    X(F64Mul, "f64.mul") \
+    X(F64Div, "f64.div") \
+    X(F64Min, "f64.min") \
+    X(F64Max, "f64.max") \
+    X(I32WrapI64, "i32.wrap_i64") \
+    X(I32TruncF32S, "i32.trunc_f32_s") \
+    X(I32TruncF32U, "i32.trunc_f32_u") \
+    X(I32TruncF64S, "i32.trunc_f64_s") \
+    X(F32ConvertI32S, "f32.convert_i32_s") \
+    X(F32ConvertI32U, "f32.convert_i32_u") \
+    X(F32DemoteF64, "f32.demote_f64") \
+    X(F64ConvertI32S, "f64.convert_i32_s") \
+    X(F64PromoteF32, "f64.promote_f32") \
+    X(I32ReinterpretF32, "i32.reinterpret_f32") \
+    X(I64ReinterpretF64, "i64.reinterpret_f64") \
+    X(F32ReinterpretI32, "f32.reinterpret_i32") \
+    /* Superinstructions, written only by WasmDecoder::fuse. Each replaces the first \
+       instruction of its sequence; the rest stay in place, carrying their immediates. */ \
+    X(LocalGet2, "local.get local.get") \
+    X(LocalGetI32Const, "local.get i32.const") \
+    X(LocalSetGet, "local.set local.get") \
+    X(LocalI32Load, "local.get i32.load") \
+    X(LocalsI32Add, "local.get local.get i32.add") \
+    X(LocalI32AddImm, "local.get i32.const i32.add") \
+    X(LocalI32SubImm, "local.get i32.const i32.sub") \
+    X(LocalI32AddImmSet, "local.get i32.const i32.add local.set") \
+    X(I32AddImm, "i32.const i32.add") \
+    X(I32SubImm, "i32.const i32.sub") \
+    X(I32ShlImm, "i32.const i32.shl") \
+    X(I32EqzBrIf, "i32.eqz br_if") \
+    X(I32EqBrIf, "i32.eq br_if") \
+    X(I32NeBrIf, "i32.ne br_if") \
+    X(I32LtSBrIf, "i32.lt_s br_if") \
+    X(I32LtUBrIf, "i32.lt_u br_if") \
+    X(I32GtSBrIf, "i32.gt_s br_if") \
+    X(I32GtUBrIf, "i32.gt_u br_if") \
+    X(I32LeSBrIf, "i32.le_s br_if") \
+    X(I32LeUBrIf, "i32.le_u br_if") \
+    X(I32GeSBrIf, "i32.ge_s br_if") \
+    X(I32GeUBrIf, "i32.ge_u br_if") \
+    X(I32EqzIf, "i32.eqz if") \
+    X(I32EqIf, "i32.eq if") \
+    X(I32NeIf, "i32.ne if") \
+    X(I32LtSIf, "i32.lt_s if") \
+    X(I32LtUIf, "i32.lt_u if") \
+    X(I32GtSIf, "i32.gt_s if") \
+    X(I32GtUIf, "i32.gt_u if") \
+    X(I32LeSIf, "i32.le_s if") \
+    X(I32LeUIf, "i32.le_u if") \
+    X(I32GeSIf, "i32.ge_s if") \
+    X(I32GeUIf, "i32.ge_u if") \
+    /* Written by WasmOptimizer: division by a constant that is not a power of two, \
+       by multiply-high. Instr::a and Instr::b of the i32.const hold the multiplier \
+       and shift (divideByConstant); its imm keeps the divisor. */ \
+    X(I32DivUImm, "i32.const i32.div_u") \
+    X(I32RemUImm, "i32.const i32.rem_u")
+
+enum class Opcode : uint16_t {
+#define X(name, text) name,
+    WASM_OPCODES(X)
+#undef X
+    Count
+};
+
+// Decoded instruction with pre-parsed immediates
+struct Instr {
+    Opcode op = Opcode::Nop;
+    uint32_t a = 0;          // index immediate: symbol / global / branch target / br_table / else pc / memarg offset
+    uint32_t b = 0;          // secondary immediate: named flag / end pc / memarg align
+    ValueType blockType = ValueType::I32;   // declared result of a block / loop / if of arity 1
+    union {
+        int32_t i32;
+        int64_t i64;
+        float f32;
+        double f64;
+    } imm = {0};
+};
+
+// Precomputed destination of a branch, resolved once per function by the decoder
+struct BranchTarget {
+    uint32_t pc = 0;         // instruction to continue at
+    uint32_t depth = 0;      // relative depth of the target label
+    uint32_t arity = 0;      // values carried to the target
+    ValueType type = ValueType::I32;   // their declared type, when arity is 1
+    uint32_t height = 0;     // operands of the function below the target label (WasmValidator)
+    bool isLoop = false;
+    bool isReturn = false;   // targets the function body itself
+};
+
+struct FuncDef;
+
+// Monomorphic inline cache of one call_indirect site: the last table slot called
+// through, and the callee it held, already signature-checked, while the table
+// is unchanged (same epoch).
+struct IndirectCallCache {
+    uint32_t slot = UINT32_MAX;
+    uint64_t epoch = 0;
+    const FuncDef* target = nullptr;
 };
 
 struct FuncDef {
     int index = -1;
-    std::unordered_map<std::string, WasmValue> params = {};  // 🔥 nome → valore
+    uint32_t typeId = 0;                                // canonical signature (WasmDecoder::signatureId)
+    std::vector<std::pair<std::string, WasmValue>> params = {};  // declaration order: param i is local slot i
     WasmValue result = {};
+    bool hasResult = false;                             // the signature returns a value, of result.type
     std::string name = "";
-    std::vector<std::string> body = {};
+    std::vector<Instr> code = {};                       // decoded body
+    std::vector<WasmValue> locals = {};                 // frame layout: params, then declared locals, by slot
+    std::vector<std::string> symbols = {};              // $names referenced by code
+    std::vector<BranchTarget> branches = {};            // side table for br / br_if
+    std::vector<std::vector<BranchTarget>> brTables = {};   // side table for br_table
+    uint32_t indirectCallSites = 0;                     // call_indirect count; Instr::imm.i32 numbers them
+    uint32_t maxStack = 0;                              // operand stack high-water mark (WasmValidator)
 };
 
 struct WasmExport {
@@ -52,15 +353,39 @@ struct WasmExport {
     int index;
 };
 
+struct DataSegment {
+    std::vector<uint8_t> bytes;
+    bool active = false;     // copied into memory at instantiation
+    uint32_t offset = 0;     // active segments only
+};
+
+struct ElemSegment {
+    std::vector<int32_t> refs;   // function indices / NULL_REF
+    bool active = false;         // copied into `table` at instantiation
+    bool declarative = false;    // only declares ref.func targets; never readable
+    uint32_t table = 0;
+    uint32_t offset = 0;
+};
+
+class WasmInstance;
+
+// Host implementation of an imported function. Arguments are read in place from
+// the operand stack (typed by the import's signature); the result is ignored when
+// the import returns nothing.
+using HostFunction = WasmValue (*)(WasmInstance& instance, const WasmSlot* args);
+
+struct FuncImport {
+    std::string module;
+    std::string field;
+    FuncType type;
+    uint32_t typeId = 0;             // canonical signature, checked by call_indirect
+    HostFunction fn = nullptr;       // bound by WasmHost::link
+};
+
+// WasmInstance::globals entry, at the index global.get / global.set carry in Instr::a
 struct WasmGlobal {
     std::string name;
     ValueType type;
     bool mutableFlag;
-    WasmValue value;
-};
-
-struct BlockInfo {
-    size_t startPC;
-    bool isLoop;
-    std::string label;
+    WasmSlot value;          // of `type`
 };